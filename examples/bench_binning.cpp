@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "orcacam_bin.h"
+
+// ORCA-Quest full sensor
+#define SENSOR_WIDTH 4096
+#define SENSOR_HEIGHT 2304
+#define ITERATIONS 100
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench(ORCA_FRAME *src, char *out, int32 bx, int32 by, ORCA_BIN_OP op)
+{
+    ORCA_FRAME dst;
+    dst.data = out;
+    // warm up
+    DCAMERR err = orca_bin_frame(src, bx, by, op, &dst);
+    if (orcaerr_failed(err))
+    {
+        printf("%dx%d: %s\n", bx, by, orcacam_sterr(err));
+        return;
+    }
+    double start = now_sec();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        orca_bin_frame(src, bx, by, op, &dst);
+    }
+    double dt  = (now_sec() - start) / ITERATIONS;
+    double gbs = (double)src->row_stride * src->height / dt * 1e-9;
+    printf("%-6s %-4s %2dx%-2d -> %4d x %4d: %8.3f ms/frame, %7.1f fps, %6.2f GB/s\n",
+           src->fmt == DCAM_PIXELTYPE_MONO8 ? "MONO8" : "MONO16",
+           op == ORCA_BIN_SUM ? "SUM" : "MEAN", bx, by, dst.width, dst.height,
+           dt * 1e3, 1.0 / dt, gbs);
+}
+
+int main(int argc, char *argv[])
+{
+    int32 width  = SENSOR_WIDTH;
+    int32 height = SENSOR_HEIGHT;
+    if (argc > 2)
+    {
+        width  = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    printf("Binning benchmark, %d x %d, %d iterations\n", width, height,
+           ITERATIONS);
+    char *buf = (char *)malloc((size_t)width * height * 2);
+    char *out = (char *)malloc((size_t)width * height * 2);
+    if (!buf || !out)
+    {
+        return 1;
+    }
+    for (size_t i = 0; i < (size_t)width * height * 2; i++)
+    {
+        buf[i] = (char)rand();
+    }
+    const int32 bins[][2] = {{2, 2}, {4, 4}, {3, 3}, {8, 2}};
+    const DCAM_PIXELTYPE fmts[] = {DCAM_PIXELTYPE_MONO8, DCAM_PIXELTYPE_MONO16};
+    for (DCAM_PIXELTYPE fmt : fmts)
+    {
+        ORCA_FRAME src;
+        src.data       = buf;
+        src.width      = width;
+        src.height     = height;
+        src.fmt        = fmt;
+        src.row_stride = width * (fmt == DCAM_PIXELTYPE_MONO8 ? 1 : 2);
+        src.rsvd       = 0;
+        for (auto &bin : bins)
+        {
+            bench(&src, out, bin[0], bin[1], ORCA_BIN_SUM);
+            bench(&src, out, bin[0], bin[1], ORCA_BIN_MEAN);
+        }
+    }
+    free(buf);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "orcacam.h"
+
+#define NUM_FRAMES 16
+#define PASSES 20
+#define FRAME_BYTES (2304 * 2304 * 2) // full frame MONO16
+#define MAX_NODES 1024
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool node_cpus(int node, cpu_set_t *cpus)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+             node);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        return false;
+    }
+    char list[4096];
+    bool ok = fgets(list, sizeof(list), fp) != NULL;
+    fclose(fp);
+    if (!ok)
+    {
+        return false;
+    }
+    CPU_ZERO(cpus);
+    for (char *s = list; *s && *s != '\n';)
+    {
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last  = first;
+        if (end == s)
+        {
+            break;
+        }
+        if (*end == '-')
+        {
+            last = strtol(end + 1, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+        {
+            CPU_SET(cpu, cpus);
+        }
+        s = *end == ',' ? end + 1 : end;
+    }
+    return CPU_COUNT(cpus) > 0;
+}
+
+struct consumer
+{
+    uint16_t *ring;
+    size_t pixels; // per frame
+    uint64_t sum;
+    double seconds;
+};
+
+// Read every frame of the ring, as a processing stage would
+static void *consume(void *inp)
+{
+    consumer *c  = (consumer *)inp;
+    uint64_t sum = 0;
+    // warm up the caches and the TLB
+    for (size_t i = 0; i < c->pixels * NUM_FRAMES; i++)
+    {
+        sum += c->ring[i];
+    }
+    uint64_t start = now_ns();
+    for (int pass = 0; pass < PASSES; pass++)
+    {
+        for (int f = 0; f < NUM_FRAMES; f++)
+        {
+            const uint16_t *frame = c->ring + f * c->pixels;
+            for (size_t i = 0; i < c->pixels; i++)
+            {
+                sum += frame[i];
+            }
+        }
+    }
+    c->seconds = (now_ns() - start) * 1e-9;
+    c->sum     = sum;
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t frame_bytes = FRAME_BYTES;
+    int local          = 0;
+    // use the frame size and the node of the camera if there is one
+    int32 count;
+    DCAMERR err = orca_list_devices(&count, 0, NULL);
+    if (!orcaerr_failed(err) && count > 0)
+    {
+        ORCACAM cam;
+        err = orca_open_camera(0, &cam, DEFAULT_FRAME_COUNT);
+        if (!orcaerr_failed(err))
+        {
+            int32 node;
+            double v;
+            orca_get_numa_node(cam, &node);
+            if (node >= 0)
+            {
+                local = node;
+            }
+            if (!orcaerr_failed(
+                    orca_get_value(cam, DCAM_IDPROP_BUFFER_FRAMEBYTES, &v)))
+            {
+                frame_bytes = (size_t)v;
+            }
+            printf("Camera NUMA node: %d\n", node);
+            orca_close_camera(&cam);
+        }
+    }
+    if (argc > 1)
+    {
+        local = atoi(argv[1]);
+    }
+    std::vector<int> nodes;
+    cpu_set_t cpus;
+    for (int node = 0; node < MAX_NODES; node++)
+    {
+        if (node_cpus(node, &cpus))
+        {
+            nodes.push_back(node);
+        }
+    }
+    size_t bytes = frame_bytes * NUM_FRAMES;
+    uint16_t *ring =
+        (uint16_t *)mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+    {
+        printf("Could not allocate %zu bytes\n", bytes);
+        return 1;
+    }
+    // place the ring on the node of the camera, as orcacam does
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+    mask[local / (8 * sizeof(unsigned long))] |=
+        1UL << (local % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_mbind, ring, bytes, MPOL_BIND, mask, MAX_NODES, 0))
+    {
+        printf("Could not bind the ring to node %d\n", local);
+    }
+    memset(ring, 1, bytes);
+    printf("%d frames of %zu bytes on node %d, %d passes\n", NUM_FRAMES,
+           frame_bytes, local, PASSES);
+    for (int node : nodes)
+    {
+        consumer c = {ring, frame_bytes / sizeof(uint16_t), 0, 0};
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        node_cpus(node, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpus);
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, consume, &c))
+        {
+            printf("Could not start a consumer on node %d\n", node);
+            pthread_attr_destroy(&attr);
+            continue;
+        }
+        pthread_join(thread, NULL);
+        pthread_attr_destroy(&attr);
+        double gbps = (double)bytes * PASSES / c.seconds * 1e-9;
+        printf("Consumer on node %d (%s): %8.2f GB/s (checksum %llu)\n", node,
+               node == local ? "local" : "cross-node", gbps,
+               (unsigned long long)c.sum);
+    }
+    if (nodes.size() < 2)
+    {
+        printf("Single NUMA node, no cross-node consumer\n");
+    }
+    munmap(ring, bytes);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "orcacam_pipe.h"
+
+#define WIDTH 2304 // full frame MONO16
+#define HEIGHT 2304
+#define NUM_FRAMES 8 // ring of submitted frames
+#define PASSES 200   // frames per run
+#define TARGET_FPS 100
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct output
+{
+    uint64_t next; // expected frame, from rsvd
+    uint64_t frames;
+    uint64_t out_of_order;
+};
+
+static void check_order(ORCA_FRAME *frame, void *user_data, size_t sz)
+{
+    output *out = (output *)user_data;
+    if ((uint64_t)frame->rsvd != out->next % NUM_FRAMES)
+    {
+        out->out_of_order++;
+    }
+    out->next++;
+    out->frames++;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : 0;
+    if (max_threads < 1)
+    {
+        max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (max_threads > ORCA_PIPE_MAX_THREADS)
+    {
+        max_threads = ORCA_PIPE_MAX_THREADS;
+    }
+    size_t pixels = (size_t)WIDTH * HEIGHT;
+    std::vector<uint16_t> ring(pixels * NUM_FRAMES);
+    std::vector<uint16_t> dark(pixels);
+    std::vector<float> gain(pixels);
+    for (size_t i = 0; i < pixels; i++)
+    {
+        dark[i] = 100 + i % 7;
+        gain[i] = 0.9f + (i % 13) * 0.01f;
+    }
+    for (size_t i = 0; i < ring.size(); i++)
+    {
+        ring[i] = 1000 + i % 4000;
+    }
+    ORCA_FLATFIELD ff = {WIDTH, HEIGHT, dark.data(), gain.data()};
+    ORCA_FRAME frames[NUM_FRAMES];
+    for (int f = 0; f < NUM_FRAMES; f++)
+    {
+        memset(&frames[f], 0, sizeof(ORCA_FRAME));
+        frames[f].data       = (char *)(ring.data() + f * pixels);
+        frames[f].width      = WIDTH;
+        frames[f].height     = HEIGHT;
+        frames[f].fmt        = DCAM_PIXELTYPE_MONO16;
+        frames[f].row_stride = WIDTH * sizeof(uint16_t);
+        frames[f].rsvd       = f;
+    }
+    printf("%d x %d MONO16 flat field, %d frames per run, %d online CPUs\n",
+           WIDTH, HEIGHT, PASSES, (int)sysconf(_SC_NPROCESSORS_ONLN));
+
+    // the kernel on the calling thread, one tile per frame
+    uint64_t start = now_ns();
+    for (int pass = 0; pass < PASSES; pass++)
+    {
+        ORCA_TILE tile = {&frames[pass % NUM_FRAMES], 0, HEIGHT, 0, 1, 0,
+                          (uint64_t)pass};
+        orca_tile_flatfield(&tile, &ff);
+    }
+    double serial = PASSES / ((now_ns() - start) * 1e-9);
+    printf("Serial:     %8.1f fps\n", serial);
+
+    for (int threads = 1; threads <= max_threads; threads++)
+    {
+        output out = {0, 0, 0};
+        ORCA_PIPE_CONFIG config;
+        memset(&config, 0, sizeof(config));
+        config.num_threads  = threads;
+        config.output       = check_order;
+        config.user_data    = &out;
+        config.sz_user_data = sizeof(out);
+        ORCA_PIPE pipe;
+        DCAMERR err = orca_pipe_create(&pipe, &config);
+        if (orcaerr_failed(err))
+        {
+            printf("Could not create a pipeline of %d threads: 0x%08x\n",
+                   threads, err);
+            return 1;
+        }
+        orca_pipe_add_kernel(pipe, orca_tile_flatfield, &ff);
+        start = now_ns();
+        for (int pass = 0; pass < PASSES; pass++)
+        {
+            orca_pipe_submit(pipe, &frames[pass % NUM_FRAMES]);
+        }
+        orca_pipe_flush(pipe);
+        double fps = PASSES / ((now_ns() - start) * 1e-9);
+        ORCA_PIPE_STATS stats;
+        orca_pipe_get_stats(pipe, &stats);
+        orca_pipe_destroy(&pipe);
+        printf("%2d threads: %8.1f fps (%5.2fx serial, %s %d fps), "
+               "%llu steals, %llu waits, %llu out of order\n",
+               threads, fps, fps / serial,
+               fps >= TARGET_FPS ? "above" : "below", TARGET_FPS,
+               (unsigned long long)stats.steals,
+               (unsigned long long)stats.waits,
+               (unsigned long long)out.out_of_order);
+    }
+    return 0;
+}
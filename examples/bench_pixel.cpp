@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "orcacam_pixel.hpp"
+
+#define WIDTH 2304
+#define HEIGHT 2304
+#define PASSES 20
+#define BIN_FACTOR 2
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Read a sample, checking the format on every access
+static uint32_t load_runtime(DCAM_PIXELTYPE fmt, const char *row, int32 x,
+                             int c)
+{
+    switch (fmt)
+    {
+    case DCAM_PIXELTYPE_MONO8:
+        return ((const uint8_t *)row)[x];
+    case DCAM_PIXELTYPE_MONO16:
+        return ((const uint16_t *)row)[x];
+    case DCAM_PIXELTYPE_MONO12:
+    {
+        const uint8_t *p = (const uint8_t *)row + (size_t)(x >> 1) * 3;
+        return x & 1 ? (p[1] >> 4) | ((uint32_t)p[2] << 4)
+                     : ((uint32_t)p[0] << 4) | (p[1] & 0xf);
+    }
+    case DCAM_PIXELTYPE_MONO12P:
+    {
+        const uint8_t *p = (const uint8_t *)row + (size_t)(x >> 1) * 3;
+        return x & 1 ? (p[1] >> 4) | ((uint32_t)p[2] << 4)
+                     : p[0] | ((uint32_t)(p[1] & 0xf) << 8);
+    }
+    case DCAM_PIXELTYPE_RGB24:
+    case DCAM_PIXELTYPE_BGR24:
+        return ((const uint8_t *)row)[(size_t)x * 3 + c];
+    case DCAM_PIXELTYPE_RGB48:
+    case DCAM_PIXELTYPE_BGR48:
+        return ((const uint16_t *)row)[(size_t)x * 3 + c];
+    default:
+        return 0;
+    }
+}
+
+static int channels_runtime(DCAM_PIXELTYPE fmt)
+{
+    return (fmt & 0xf0) == 0x20 ? 3 : 1;
+}
+
+static orca::PixelStats stats_runtime(const ORCA_FRAME *frame)
+{
+    int channels       = channels_runtime(frame->fmt);
+    orca::PixelStats s = {0, UINT32_MAX, 0, 0, 0};
+    for (int32 y = 0; y < frame->height; y++)
+    {
+        const char *row = frame->data + (size_t)y * frame->row_stride;
+        for (int32 x = 0; x < frame->width; x++)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                uint32_t v = load_runtime(frame->fmt, row, x, c);
+                s.sum += v;
+                s.min = v < s.min ? v : s.min;
+                s.max = v > s.max ? v : s.max;
+            }
+        }
+    }
+    s.count = (uint64_t)frame->width * frame->height * channels;
+    return s;
+}
+
+static void bin_runtime(const ORCA_FRAME *frame, int32 factor, uint32_t *dst)
+{
+    int channels = channels_runtime(frame->fmt);
+    int32 bw = frame->width / factor, bh = frame->height / factor;
+    memset(dst, 0, (size_t)bw * bh * channels * sizeof(uint32_t));
+    for (int32 y = 0; y < bh * factor; y++)
+    {
+        const char *row = frame->data + (size_t)y * frame->row_stride;
+        uint32_t *out   = dst + (size_t)(y / factor) * bw * channels;
+        for (int32 x = 0; x < bw * factor; x++)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                out[(size_t)(x / factor) * channels + c] +=
+                    load_runtime(frame->fmt, row, x, c);
+            }
+        }
+    }
+}
+
+static void bench(const char *name, DCAM_PIXELTYPE fmt)
+{
+    ORCA_FRAME frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.width  = WIDTH;
+    frame.height = HEIGHT;
+    frame.fmt    = fmt;
+    size_t row_bytes =
+        orca::dispatch(fmt, [](auto p) { return p.row_bytes(WIDTH); });
+    frame.row_stride = (int32)((row_bytes + 63) & ~(size_t)63);
+    std::vector<char> data((size_t)frame.row_stride * HEIGHT);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = (char)(rand() & 0xff);
+    }
+    frame.data = data.data();
+    orca::FrameView view(frame);
+
+    int channels = channels_runtime(fmt);
+    std::vector<uint32_t> bin_a((size_t)(WIDTH / BIN_FACTOR) *
+                                (HEIGHT / BIN_FACTOR) * channels);
+    std::vector<uint32_t> bin_b(bin_a.size());
+    orca::PixelStats sa = {}, sb = {};
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < PASSES; i++)
+    {
+        sa = stats_runtime(&frame);
+    }
+    uint64_t t1 = now_ns();
+    for (int i = 0; i < PASSES; i++)
+    {
+        sb = orca::stats(view);
+    }
+    uint64_t t2 = now_ns();
+    for (int i = 0; i < PASSES; i++)
+    {
+        bin_runtime(&frame, BIN_FACTOR, bin_a.data());
+    }
+    uint64_t t3 = now_ns();
+    for (int i = 0; i < PASSES; i++)
+    {
+        orca::bin(view, BIN_FACTOR, bin_b.data());
+    }
+    uint64_t t4 = now_ns();
+
+    bool same = sa.sum == sb.sum && sa.min == sb.min && sa.max == sb.max &&
+                bin_a == bin_b;
+    printf("%-8s %10.3f %10.3f %6.1fx %10.3f %10.3f %6.1fx %s\n", name,
+           (t1 - t0) * 1e-6 / PASSES, (t2 - t1) * 1e-6 / PASSES,
+           (double)(t1 - t0) / (t2 - t1), (t3 - t2) * 1e-6 / PASSES,
+           (t4 - t3) * 1e-6 / PASSES, (double)(t3 - t2) / (t4 - t3),
+           same ? "" : "MISMATCH");
+}
+
+int main()
+{
+    printf("%dx%d frames, ms/frame, runtime switch per sample vs "
+           "PixelTraits:\n",
+           WIDTH, HEIGHT);
+    printf("%-8s %10s %10s %7s %10s %10s %7s\n", "Format", "stats", "traits",
+           "gain", "bin 2x2", "traits", "gain");
+    bench("MONO8", DCAM_PIXELTYPE_MONO8);
+    bench("MONO16", DCAM_PIXELTYPE_MONO16);
+    bench("MONO12", DCAM_PIXELTYPE_MONO12);
+    bench("MONO12P", DCAM_PIXELTYPE_MONO12P);
+    bench("RGB24", DCAM_PIXELTYPE_RGB24);
+    bench("RGB48", DCAM_PIXELTYPE_RGB48);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "orcacam_pnr.h"
+
+// ORCA-Quest full sensor
+#define SENSOR_WIDTH 4096
+#define SENSOR_HEIGHT 2304
+#define ITERATIONS 200
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const char *mode_str(ORCA_PNR_MODE mode)
+{
+    switch (mode)
+    {
+    case ORCA_PNR_COUNT:
+        return "COUNT";
+    case ORCA_PNR_EVENT:
+        return "EVENT";
+    case ORCA_PNR_CLUSTER:
+        return "CLUSTER";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int32 width  = SENSOR_WIDTH;
+    int32 height = SENSOR_HEIGHT;
+    if (argc > 2)
+    {
+        width  = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    printf("PNR accumulation benchmark, %d x %d, %d frames\n", width, height,
+           ITERATIONS);
+    size_t npix = (size_t)width * height;
+    char *buf   = (char *)malloc(npix);
+    if (!buf)
+    {
+        return 1;
+    }
+    // low light: ~5% of the pixels see a photon
+    for (size_t i = 0; i < npix; i++)
+    {
+        int r  = rand() % 1000;
+        buf[i] = r < 40 ? 1 : r < 48 ? 2 : r < 50 ? 3 : 0;
+    }
+    ORCA_FRAME frame;
+    frame.data       = buf;
+    frame.width      = width;
+    frame.height     = height;
+    frame.fmt        = DCAM_PIXELTYPE_MONO8;
+    frame.row_stride = width;
+    frame.rsvd       = 0;
+
+    const ORCA_PNR_MODE modes[] = {ORCA_PNR_COUNT, ORCA_PNR_EVENT,
+                                   ORCA_PNR_CLUSTER};
+    for (ORCA_PNR_MODE mode : modes)
+    {
+        for (int32 threads = 1; threads <= 2; threads++)
+        {
+            ORCA_PNR_CONFIG config;
+            memset(&config, 0, sizeof(config));
+            config.mode        = mode;
+            config.threshold   = 1;
+            config.num_threads = threads;
+            ORCA_PNR pnr;
+            DCAMERR err = orca_pnr_create(&pnr, &config);
+            if (orcaerr_failed(err))
+            {
+                printf("Could not create PNR engine: %s\n", orcacam_sterr(err));
+                return 1;
+            }
+            orca_pnr_accumulate(pnr, &frame); // warm up
+            double start = now_sec();
+            for (int i = 0; i < ITERATIONS; i++)
+            {
+                orca_pnr_accumulate(pnr, &frame);
+            }
+            double dt = (now_sec() - start) / ITERATIONS;
+            printf("%-8s %d thread(s): %8.3f ms/frame, %7.1f fps\n",
+                   mode_str(mode), threads, dt * 1e3, 1.0 / dt);
+            orca_pnr_destroy(&pnr);
+        }
+    }
+    free(buf);
+    return 0;
+}
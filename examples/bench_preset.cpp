@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "orcacam.h"
+
+#define ITERATIONS 100
+#define ROI_SIZE 256
+#define FRAMES_PER_SWITCH 5
+
+static std::atomic<int> frames(0);
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void print_stats(const char *name, std::vector<double> &v)
+{
+    if (v.empty())
+    {
+        printf("%s: no samples\n", name);
+        return;
+    }
+    std::sort(v.begin(), v.end());
+    double mean = 0;
+    for (double x : v)
+    {
+        mean += x;
+    }
+    mean /= v.size();
+    printf("%s: mean %8.3f ms, p50 %8.3f ms, p99 %8.3f ms, max %8.3f ms\n", name,
+           mean, v[v.size() / 2], v[v.size() * 99 / 100], v.back());
+}
+
+static void count_frame(ORCA_FRAME *frame, void *user_data, size_t sz_user_data)
+{
+    (void)frame;
+    (void)user_data;
+    (void)sz_user_data;
+    frames++;
+}
+
+static void wait_frames(int n)
+{
+    int start = frames.load();
+    for (int i = 0; i < 1000 && frames.load() - start < n; i++)
+    {
+        usleep(1000);
+    }
+}
+
+struct config
+{
+    DCAMPROPMODEVALUE mode;
+    DCAM_PIXELTYPE fmt;
+    int32 x, y, w, h;
+    double exposure;
+};
+
+// The sequence of setter calls a switch needs without presets
+static DCAMERR apply_setters(ORCACAM cam, const config &c)
+{
+    DCAMERR err = orca_stop_capture(cam);
+    if (orcaerr_failed(err) && err != DCAMERR_NOTREADY)
+    {
+        return err;
+    }
+    err = orca_switch_mode(cam, c.mode);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    err = orca_set_pixel_fmt(cam, c.fmt);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    err = orca_set_roi(cam, c.x, c.y, c.w, c.h);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    err = orca_set_exposure(cam, c.exposure);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    return orca_start_capture(cam, count_frame, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+    int32 count;
+    DCAMERR err = orca_list_devices(&count, 0, NULL);
+    if (orcaerr_failed(err) || count == 0)
+    {
+        printf("No camera found\n");
+        return 1;
+    }
+    ORCACAM cam;
+    err = orca_open_camera(0, &cam, DEFAULT_FRAME_COUNT);
+    if (orcaerr_failed(err))
+    {
+        printf("Could not open camera: %s\n", orcacam_sterr(err));
+        return 1;
+    }
+    int32 w, h;
+    orca_get_sensor_size(cam, &w, &h);
+    // PNR mode by default, progressive mode if the camera has no PNR mode
+    DCAMPROPMODEVALUE small_mode =
+        argc > 1 ? (DCAMPROPMODEVALUE)atoi(argv[1])
+                 : DCAMPROP_SENSORMODE__PHOTONNUMBERRESOLVING;
+    config configs[2] = {
+        {DCAMPROP_SENSORMODE__AREA, DCAM_PIXELTYPE_MONO16, 0, 0, w, h, 0.01},
+        {small_mode, DCAM_PIXELTYPE_MONO8, (w - ROI_SIZE) / 2,
+         (h - ROI_SIZE) / 2, ROI_SIZE, ROI_SIZE, 0.001},
+    };
+    const char *names[2] = {"full", "small"};
+    for (int i = 0; i < 2; i++)
+    {
+        err = apply_setters(cam, configs[i]);
+        if (orcaerr_failed(err))
+        {
+            printf("Could not apply configuration %s: %s\n", names[i],
+                   orcacam_sterr(err));
+            if (i == 1)
+            {
+                printf("Pass a sensor mode the camera supports as argument\n");
+            }
+            goto close_cam;
+        }
+        orca_stop_capture(cam);
+        err = orca_preset_save(cam, names[i], DEFAULT_FRAME_COUNT);
+        if (orcaerr_failed(err))
+        {
+            printf("Could not save preset %s: %s\n", names[i],
+                   orcacam_sterr(err));
+            goto close_cam;
+        }
+    }
+    printf("Switching between %d x %d AREA MONO16 and %d x %d mode %d MONO8, "
+           "%d switches\n",
+           w, h, ROI_SIZE, ROI_SIZE, small_mode, ITERATIONS);
+    {
+        std::vector<double> setters, presets;
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            uint64_t start = now_ns();
+            err            = apply_setters(cam, configs[i % 2]);
+            setters.push_back((now_ns() - start) * 1e-6);
+            if (orcaerr_failed(err))
+            {
+                printf("Setter switch failed: %s\n", orcacam_sterr(err));
+                break;
+            }
+            wait_frames(FRAMES_PER_SWITCH);
+        }
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            uint64_t start = now_ns();
+            err = orca_preset_switch(cam, names[i % 2], count_frame, NULL, 0);
+            presets.push_back((now_ns() - start) * 1e-6);
+            if (orcaerr_failed(err))
+            {
+                printf("Preset switch failed: %s\n", orcacam_sterr(err));
+                break;
+            }
+            wait_frames(FRAMES_PER_SWITCH);
+        }
+        orca_stop_capture(cam);
+        print_stats("Individual setters", setters);
+        print_stats("Preset switch     ", presets);
+        printf("Frames received: %d\n", frames.load());
+    }
+close_cam:
+    orca_close_camera(&cam);
+    return 0;
+}
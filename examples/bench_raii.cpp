@@ -0,0 +1,188 @@
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "orcacam.hpp"
+
+#define WIDTH 2304
+#define HEIGHT 2304
+#define ROW_STRIDE (WIDTH * 2 + 64) // padded rows, as with a narrow ROI
+#define PASSES 50
+#define CAMERA_FRAMES 200
+
+// Count the heap allocations made while measuring
+static std::atomic<size_t> allocations(0);
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Sum the pixels the way the C examples do
+static uint64_t sum_c(const ORCA_FRAME *frame)
+{
+    uint64_t sum = 0;
+    for (int32 y = 0; y < frame->height; y++)
+    {
+        const uint16_t *row =
+            (const uint16_t *)(frame->data + (size_t)y * frame->row_stride);
+        for (int32 x = 0; x < frame->width; x++)
+        {
+            sum += row[x];
+        }
+    }
+    return sum;
+}
+
+static uint64_t sum_view(orca::FrameView view)
+{
+    uint64_t sum = 0;
+    for (int32 y = 0; y < view.height(); y++)
+    {
+        for (uint16_t v : view.row<const uint16_t>(y))
+        {
+            sum += v;
+        }
+    }
+    return sum;
+}
+
+static volatile uint64_t sink;
+
+static void c_callback(ORCA_FRAME *frame, void *user_data, size_t sz_user_data)
+{
+    (void)user_data;
+    (void)sz_user_data;
+    sink = sink + (uint64_t)frame->width;
+}
+
+int main()
+{
+    ORCA_FRAME frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.width      = WIDTH;
+    frame.height     = HEIGHT;
+    frame.fmt        = DCAM_PIXELTYPE_MONO16;
+    frame.row_stride = ROW_STRIDE;
+    frame.data       = (char *)malloc((size_t)ROW_STRIDE * HEIGHT);
+    for (size_t i = 0; i < (size_t)ROW_STRIDE * HEIGHT; i++)
+    {
+        frame.data[i] = (char)(i * 7);
+    }
+
+    // row access
+    uint64_t a = 0, b = 0;
+    size_t before = allocations.load();
+    uint64_t t0   = now_ns();
+    for (int i = 0; i < PASSES; i++)
+    {
+        a += sum_c(&frame);
+    }
+    uint64_t t1 = now_ns();
+    for (int i = 0; i < PASSES; i++)
+    {
+        b += sum_view(orca::FrameView(frame));
+    }
+    uint64_t t2 = now_ns();
+    printf("Row access, %dx%d MONO16, stride %d:\n", WIDTH, HEIGHT, ROW_STRIDE);
+    printf("  C pointers: %8.3f ms/frame\n", (t1 - t0) * 1e-6 / PASSES);
+    printf("  FrameView:  %8.3f ms/frame (%s)\n", (t2 - t1) * 1e-6 / PASSES,
+           a == b ? "same sum" : "SUM MISMATCH");
+
+    // callback dispatch: what the capture thread calls per frame
+    const int calls = 10000000;
+    OrcaFrameCallback cb = c_callback;
+    auto fn = [](orca::FrameView view) { sink = sink + (uint64_t)view.width(); };
+    auto tramp = [](ORCA_FRAME *f, void *ud, size_t) {
+        (*static_cast<decltype(fn) *>(ud))(orca::FrameView(*f));
+    };
+    OrcaFrameCallback cpp_cb = tramp;
+    t0 = now_ns();
+    for (int i = 0; i < calls; i++)
+    {
+        cb(&frame, NULL, 0);
+    }
+    t1 = now_ns();
+    for (int i = 0; i < calls; i++)
+    {
+        cpp_cb(&frame, &fn, sizeof(fn));
+    }
+    t2 = now_ns();
+    printf("Callback dispatch:\n");
+    printf("  C callback:       %6.2f ns/frame\n", (t1 - t0) / (double)calls);
+    printf("  Capture callable: %6.2f ns/frame\n", (t2 - t1) / (double)calls);
+    printf("Heap allocations while measuring: %zu\n",
+           allocations.load() - before);
+
+    // polled acquisition, when a camera is connected
+    try
+    {
+        if (orca::Camera::count() > 0)
+        {
+            orca::Camera cam(0);
+            cam.set_roi(0, 0, 512, 512);
+            double c_ms, cpp_ms;
+            {
+                ORCA_FRAME f;
+                orca::check(orca_start_acquisition(cam.get(), &f),
+                            "orca_start_acquisition");
+                t0 = now_ns();
+                for (int i = 0; i < CAMERA_FRAMES; i++)
+                {
+                    orca::check(orca_acquire_image(cam.get(), &f, 1000),
+                                "orca_acquire_image");
+                    sink = sink + sum_c(&f);
+                }
+                c_ms = (now_ns() - t0) * 1e-6 / CAMERA_FRAMES;
+                orca_stop_acquisition(cam.get());
+            }
+            {
+                orca::Acquisition acq = cam.acquire();
+                before = allocations.load();
+                t0     = now_ns();
+                for (int i = 0; i < CAMERA_FRAMES; i++)
+                {
+                    orca::FrameLease lease = acq.next(1000);
+                    sink = sink + sum_view(lease.view());
+                }
+                cpp_ms = (now_ns() - t0) * 1e-6 / CAMERA_FRAMES;
+            }
+            printf("Camera, %d frames of 512x512:\n", CAMERA_FRAMES);
+            printf("  C API:       %8.3f ms/frame\n", c_ms);
+            printf("  Acquisition: %8.3f ms/frame, %zu allocations\n", cpp_ms,
+                   allocations.load() - before);
+        }
+    }
+    catch (const orca::Error &e)
+    {
+        printf("Camera: %s\n", e.what());
+    }
+    free(frame.data);
+    return 0;
+}
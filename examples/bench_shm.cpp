@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "orcacam_shm.h"
+
+// ORCA-Fusion full sensor
+#define SENSOR_WIDTH 2304
+#define SENSOR_HEIGHT 2304
+#define NUM_SLOTS 16
+#define LEAD 2
+#define ITERATIONS 500
+#define PERIOD_US 2000
+#define SHM_NAME "/orcacam_bench"
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void print_stats(const char *name, std::vector<double> &v)
+{
+    if (v.empty())
+    {
+        printf("%s: no samples\n", name);
+        return;
+    }
+    std::sort(v.begin(), v.end());
+    double mean = 0;
+    for (double x : v)
+    {
+        mean += x;
+    }
+    mean /= v.size();
+    printf("%s: mean %8.2f us, p50 %8.2f us, p99 %8.2f us, max %8.2f us\n", name,
+           mean, v[v.size() / 2], v[v.size() * 99 / 100], v.back());
+}
+
+static int subscriber()
+{
+    ORCA_SHM_SUBSCRIBER sub = NULL;
+    for (int i = 0; i < 1000 && orcaerr_failed(orca_shm_subscribe(&sub, SHM_NAME)); i++)
+    {
+        usleep(1000);
+    }
+    if (!sub)
+    {
+        printf("Could not subscribe\n");
+        return 1;
+    }
+    std::vector<double> wake;
+    uint64_t dropped = 0, lost = 0, checksum = 0;
+    while (true)
+    {
+        ORCA_FRAME frame;
+        ORCA_SHM_INFO info;
+        DCAMERR err = orca_shm_next(sub, &frame, &info, 1000);
+        if (orcaerr_failed(err))
+        {
+            break;
+        }
+        wake.push_back((now_ns() - info.timestamp_ns) * 1e-3);
+        dropped += info.dropped;
+        checksum += ((uint16_t *)frame.data)[frame.width * (frame.height / 2) + frame.width / 2];
+        if (orcaerr_failed(orca_shm_release(sub)))
+        {
+            lost++;
+        }
+    }
+    print_stats("Subscriber wake-up latency", wake);
+    printf("Frames read: %zu, dropped: %llu, overwritten while reading: %llu (checksum %llu)\n",
+           wake.size(), (unsigned long long)dropped, (unsigned long long)lost,
+           (unsigned long long)checksum);
+    orca_shm_unsubscribe(&sub);
+    return 0;
+}
+
+// Publish ITERATIONS frames, copied into the ring or written in place
+static int run(bool in_place, const uint16_t *src, int32 width, int32 height)
+{
+    size_t size = sizeof(uint16_t) * width * height;
+    ORCA_SHM_PUBLISHER pub;
+    DCAMERR err = orca_shm_create(&pub, SHM_NAME, size, NUM_SLOTS);
+    if (orcaerr_failed(err))
+    {
+        printf("Could not create publisher: %s\n", orcacam_sterr(err));
+        return 1;
+    }
+    void *slots[NUM_SLOTS];
+    size_t slot_bytes;
+    if (in_place)
+    {
+        err = orca_shm_buffers(pub, slots, &slot_bytes, LEAD);
+        if (orcaerr_failed(err))
+        {
+            printf("Could not get the ring buffers: %s\n", orcacam_sterr(err));
+            orca_shm_destroy(&pub);
+            return 1;
+        }
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        exit(subscriber());
+    }
+    ORCA_FRAME frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.data       = (char *)src;
+    frame.width      = width;
+    frame.height     = height;
+    frame.fmt        = DCAM_PIXELTYPE_MONO16;
+    frame.row_stride = width * sizeof(uint16_t);
+    usleep(200000); // let the subscriber attach
+    std::vector<double> publish;
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        if (in_place)
+        {
+            // stands in for the camera writing the frame into the ring
+            frame.data = (char *)slots[i % NUM_SLOTS];
+            memcpy(frame.data, src, size);
+        }
+        uint64_t start = now_ns();
+        orca_shm_publish(pub, &frame);
+        publish.push_back((now_ns() - start) * 1e-3);
+        usleep(PERIOD_US);
+    }
+    print_stats(in_place ? "Publish (in place)" : "Publish (copy into ring)",
+                publish);
+    orca_shm_destroy(&pub);
+    waitpid(pid, NULL, 0);
+    return 0;
+}
+
+int main()
+{
+    int32 width = SENSOR_WIDTH, height = SENSOR_HEIGHT;
+    printf("Shared-memory publishing benchmark, %d x %d MONO16, %d frames every %d us\n",
+           width, height, ITERATIONS, PERIOD_US);
+    uint16_t *buf = (uint16_t *)malloc(sizeof(uint16_t) * width * height);
+    if (!buf)
+    {
+        return 1;
+    }
+    for (int32 i = 0; i < width * height; i++)
+    {
+        buf[i] = rand() % 4096;
+    }
+    int ret = run(false, buf, width, height) || run(true, buf, width, height);
+    free(buf);
+    return ret;
+}
@@ -0,0 +1,101 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "orcacam_spot.h"
+
+// ORCA-Fusion full sensor
+#define SENSOR_WIDTH 2304
+#define SENSOR_HEIGHT 2304
+#define NUM_SPOTS 50
+#define ITERATIONS 200
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    int32 max_threads = (int32)sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 1)
+    {
+        max_threads = atoi(argv[1]);
+    }
+    if (max_threads < 1)
+    {
+        max_threads = 1;
+    }
+    int32 width = SENSOR_WIDTH, height = SENSOR_HEIGHT;
+    printf("Spot finding benchmark, %d x %d MONO16, %d spots, %d frames\n",
+           width, height, NUM_SPOTS, ITERATIONS);
+    uint16_t *buf = (uint16_t *)malloc(sizeof(uint16_t) * width * height);
+    if (!buf)
+    {
+        return 1;
+    }
+    // noisy background with gaussian spots
+    for (int32 i = 0; i < width * height; i++)
+    {
+        buf[i] = 100 + rand() % 20;
+    }
+    for (int32 s = 0; s < NUM_SPOTS; s++)
+    {
+        double cx = 10 + rand() % (width - 20) + (rand() % 100) * 0.01;
+        double cy = 10 + rand() % (height - 20) + (rand() % 100) * 0.01;
+        for (int32 y = (int32)cy - 6; y <= (int32)cy + 6; y++)
+        {
+            for (int32 x = (int32)cx - 6; x <= (int32)cx + 6; x++)
+            {
+                double r2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+                buf[y * width + x] += (uint16_t)(20000 * exp(-r2 / 4.5));
+            }
+        }
+    }
+    ORCA_FRAME frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.data       = (char *)buf;
+    frame.width      = width;
+    frame.height     = height;
+    frame.fmt        = DCAM_PIXELTYPE_MONO16;
+    frame.row_stride = width * sizeof(uint16_t);
+
+    for (int32 threads = 1; threads <= max_threads; threads *= 2)
+    {
+        ORCA_SPOT_CONFIG config;
+        memset(&config, 0, sizeof(config));
+        config.threshold   = 500;
+        config.background  = 110;
+        config.min_pixels  = 4;
+        config.max_spots   = 1024;
+        config.num_threads = threads;
+        ORCA_SPOTFINDER finder;
+        DCAMERR err = orca_spot_create(&finder, &config);
+        if (orcaerr_failed(err))
+        {
+            printf("Could not create spot finder: %s\n", orcacam_sterr(err));
+            return 1;
+        }
+        ORCA_SPOT_LIST spots;
+        orca_spot_find(finder, &frame, &spots); // warm up
+        double start = now_sec();
+        for (int i = 0; i < ITERATIONS; i++)
+        {
+            orca_spot_find(finder, &frame, &spots);
+        }
+        double dt = (now_sec() - start) / ITERATIONS;
+        printf("%2d thread(s): %8.3f ms/frame, %7.1f fps, %zu spots\n", threads,
+               dt * 1e3, 1.0 / dt, spots.num_spots);
+        orca_spot_destroy(&finder);
+        if (threads < max_threads && threads * 2 > max_threads)
+        {
+            threads = max_threads / 2; // always measure max_threads
+        }
+    }
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "orcacam_server.h"
+
+#define DEFAULT_SOCKET "/tmp/orcacam.sock"
+#define NUM_SLOTS 32
+
+static volatile sig_atomic_t done = 0;
+
+static void sighandler(int sig)
+{
+    (void)sig;
+    done = 1;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : DEFAULT_SOCKET;
+    int32 count;
+    DCAMERR err = orca_list_devices(&count, 0, NULL);
+    if (orcaerr_failed(err) || count == 0)
+    {
+        printf("No camera found\n");
+        return 1;
+    }
+    ORCACAM cam;
+    err = orca_open_camera(0, &cam, DEFAULT_FRAME_COUNT);
+    if (orcaerr_failed(err))
+    {
+        printf("Could not open camera: %s\n", orcacam_sterr(err));
+        return 1;
+    }
+    ORCA_SERVER server;
+    err = orca_server_create(&server, cam, path, NUM_SLOTS);
+    if (orcaerr_failed(err))
+    {
+        printf("Could not create server: %s\n", orcacam_sterr(err));
+        goto close_cam;
+    }
+    err = orca_server_start_capture(server);
+    if (orcaerr_failed(err))
+    {
+        printf("Could not start capture: %s\n", orcacam_sterr(err));
+        goto close_server;
+    }
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+    printf("Serving frames on %s, press Ctrl+C to stop\n", path);
+    while (!done)
+    {
+        pause();
+    }
+    printf("\nStopping\n");
+close_server:
+    orca_server_destroy(&server);
+close_cam:
+    orca_close_camera(&cam);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "orcacam_pixel.hpp"
+#include "orcacam_stream.hpp"
+
+#define NUM_FRAMES 32
+#define STATUS_INTERVAL std::chrono::seconds(1)
+
+// Frames, processed on the executor thread
+static orca::Task consume(orca::FrameStream &stream, uint64_t *frames,
+                          double *mean)
+{
+    while (auto frame = co_await stream.next())
+    {
+        *mean = orca::stats(frame->view()).mean();
+        (*frames)++;
+    }
+    printf("Stream stopped after %llu frames\n", (unsigned long long)*frames);
+}
+
+// Timer, on the same thread, requesting the stop when done
+static orca::Task status(orca::Executor &ex, orca::FrameStream &stream,
+                         const uint64_t *frames, const double *mean,
+                         int seconds, int stop_fd)
+{
+    uint64_t last = 0;
+    for (int i = 0; i < seconds; i++)
+    {
+        co_await ex.sleep_for(STATUS_INTERVAL);
+        printf("%llu fps, mean %.1f, pending %zu/%zu, dropped %llu\n",
+               (unsigned long long)(*frames - last), *mean, stream.pending(),
+               stream.capacity(), (unsigned long long)stream.dropped());
+        last = *frames;
+    }
+    (void)!write(stop_fd, "q", 1);
+}
+
+// IPC, on the same thread: a byte written to the socket stops the stream
+static orca::Task control(orca::Executor &ex, orca::FrameStream &stream,
+                          int fd)
+{
+    co_await ex.readable(fd);
+    char c;
+    if (read(fd, &c, 1) == 1)
+    {
+        printf("Stop requested\n");
+        stream.stop();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 5;
+    try
+    {
+        if (orca::Camera::count() < 1)
+        {
+            printf("No camera found\n");
+            return 0;
+        }
+        orca::Camera cam(0, NUM_FRAMES);
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+        {
+            perror("socketpair");
+            return 1;
+        }
+        orca::Executor ex;
+        orca::FrameStream stream(cam.get(), ex);
+        uint64_t frames = 0;
+        double mean     = 0;
+        ex.spawn(consume(stream, &frames, &mean));
+        ex.spawn(status(ex, stream, &frames, &mean, seconds, sv[1]));
+        ex.spawn(control(ex, stream, sv[0]));
+        ex.run();
+        close(sv[0]);
+        close(sv[1]);
+    }
+    catch (const std::exception &e)
+    {
+        printf("%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
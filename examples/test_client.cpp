@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "orcacam_server.h"
+
+#define DEFAULT_SOCKET "/tmp/orcacam.sock"
+#define NUM_FRAMES 1000
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : DEFAULT_SOCKET;
+    ORCA_CLIENT client;
+    DCAMERR err = orca_client_connect(&client, path);
+    if (orcaerr_failed(err))
+    {
+        printf("Could not connect to %s: %s\n", path, orcacam_sterr(err));
+        return 1;
+    }
+    ORCA_SERVER_MSG msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = ORCA_SERVER_GET_EXPOSURE;
+    err      = orca_client_request(client, &msg);
+    if (orcaerr_failed(err))
+    {
+        printf("Could not get exposure: %s\n", orcacam_sterr(err));
+    }
+    else
+    {
+        printf("Camera exposure: %.6f s\n", msg.value);
+    }
+    if (argc > 2)
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.type  = ORCA_SERVER_SET_EXPOSURE;
+        msg.value = atof(argv[2]);
+        err       = orca_client_request(client, &msg);
+        printf("Set exposure %.6f s: %s\n", msg.value, orcacam_sterr(err));
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.type = ORCA_SERVER_SUBSCRIBE;
+    err      = orca_client_request(client, &msg);
+    if (orcaerr_failed(err))
+    {
+        printf("Could not subscribe: %s\n", orcacam_sterr(err));
+        orca_client_close(&client);
+        return 1;
+    }
+    uint64_t dropped = 0, lost = 0, latency_ns = 0;
+    int32 frames     = 0;
+    double start     = now_sec();
+    for (; frames < NUM_FRAMES; frames++)
+    {
+        ORCA_FRAME frame;
+        ORCA_SHM_INFO info;
+        err = orca_client_next(client, &frame, &info, 2000);
+        if (orcaerr_failed(err))
+        {
+            printf("Stopped receiving frames: %s\n", orcacam_sterr(err));
+            break;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        latency_ns += (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec - info.timestamp_ns;
+        dropped += info.dropped;
+        if (frames == 0)
+        {
+            printf("Frame: %d x %d, format %d\n", frame.width, frame.height,
+                   frame.fmt);
+        }
+        if (orcaerr_failed(orca_client_release(client)))
+        {
+            lost++;
+        }
+    }
+    double dt = now_sec() - start;
+    if (frames > 0)
+    {
+        printf("Received %d frames in %.2f s (%.1f fps), mean latency %.1f us\n",
+               frames, dt, frames / dt, latency_ns * 1e-3 / frames);
+        printf("Dropped: %llu, overwritten while reading: %llu\n",
+               (unsigned long long)dropped, (unsigned long long)lost);
+    }
+    orca_client_close(&client);
+    return 0;
+}
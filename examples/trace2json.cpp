@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+#include "orcacam_trace.h"
+
+// Convert a trace saved with orca_trace_save() to Chrome trace event JSON.
+// Open the output in ui.perfetto.dev or chrome://tracing.
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        printf("Usage: %s <trace.bin> <trace.json>\n", argv[0]);
+        return 1;
+    }
+    DCAMERR err = orca_trace_export(argv[1], argv[2]);
+    if (orcaerr_failed(err))
+    {
+        printf("Could not convert %s: %s\n", argv[1], orcacam_sterr(err));
+        return 1;
+    }
+    return 0;
+}
@@ -13,6 +13,7 @@
 #define _ORCACAM_H_
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h> // memset
 
 #include "dcamapi/dcamapi4.h"
@@ -53,6 +54,21 @@ typedef struct _ORCA_CAM_INFO
     double pixel_height; /*<! Pixel height */
 } ORCA_CAM_INFO;
 
+/**
+ * @brief Kinds of frame metadata attached by processing stages
+ *
+ */
+typedef enum _ORCA_META_KIND
+{
+    ORCA_META_SPARSE  = 0, //!< Sparse events (ORCA_SPARSE_FRAME, orcacam_sparse.h)
+    ORCA_META_SPOTS   = 1, //!< Spot centroids (ORCA_SPOT_LIST, orcacam_spot.h)
+    ORCA_META_SWEEP   = 2, //!< Sweep step of the frame (ORCA_SWEEP_INFO, orcacam_sweep.h)
+    ORCA_META_HISTORY = 3, //!< Position of the frame in a history event (ORCA_HISTORY_INFO)
+    ORCA_META_TRIGGER = 4, //!< Trigger that produced the frame (ORCA_TRIGGER_INFO), external and software triggers only
+    ORCA_META_CAPTURE = 5, //!< Position of the frame in the capture (ORCA_CAPTURE_INFO), orca_start_capture() only
+    ORCA_META_MAX,         //!< Number of metadata kinds
+} ORCA_META_KIND;
+
 /**
  * @brief ORCA Image Frame
  *
@@ -65,6 +81,7 @@ typedef struct _ORCA_FRAME
     DCAM_PIXELTYPE fmt; //!< Frame pixel format
     int32 row_stride;   //!< Frame row stride (bytes)
     int32 rsvd;        //!< Reserved
+    const void *meta[ORCA_META_MAX]; //!< Metadata attached by processing stages (indexed by ORCA_META_KIND), valid until the next frame
 } ORCA_FRAME;
 
 /**
@@ -82,6 +99,12 @@ typedef void (*OrcaFrameCallback)(ORCA_FRAME * _Nonnull, void * _Nullable,  size
  */
 #define DEFAULT_FRAME_COUNT 10
 
+/**
+ * @brief Maximum number of frame processing stages per camera
+ *
+ */
+#define ORCA_MAX_STAGES 8
+
 /**
  * @brief ORCA Camera handle
  *
@@ -130,6 +153,11 @@ DCAMERR orca_list_devices(int32 *_Nonnull count, int32 sz_initopt,
 /**
  * @brief Open a device
  *
+ * The attributes of all the properties of the device are read once here.
+ * Property values are cached after their first read, except for volatile
+ * properties, and are invalidated when they, or properties the driver
+ * reports as updated, are set.
+ *
  * @param index Device index
  * @param hdcam Output HDCAM handle
  * @return DCAMERR
@@ -154,6 +182,71 @@ DCAMERR orca_device_info(ORCACAM cam, ORCA_CAM_INFO *_Nonnull info);
  */
 DCAMERR orca_realloc_framebuffer(ORCACAM cam, size_t num_frames);
 
+/**
+ * @brief Alignment required of caller frame buffers (bytes)
+ *
+ */
+#define ORCA_BUFFER_ALIGN 16
+
+/**
+ * @brief Attach a caller-owned frame buffer ring, used instead of the library ring by the following acquisitions.
+ *
+ * Lifetime rules:
+ * - The pointer array is copied; the buffers remain owned by the caller and
+ *   are never freed by the library.
+ * - The buffers must stay valid until orca_detach_buffers() or
+ *   orca_close_camera() returns. They are written by the camera while
+ *   capturing, and frames handed to callbacks point into them.
+ * - The ring can not be changed while capturing.
+ * - The buffers are checked again when an acquisition starts, which fails
+ *   with DCAMERR_INVALIDPARAM if a format change made the frames larger
+ *   than the buffers. orca_realloc_framebuffer() and presets only change
+ *   the library ring.
+ *
+ * Frames keep the DCAM layout: the image starts at
+ * DCAM_IDPROP_BUFFER_TOPOFFSETBYTES, with rows of DCAM_IDPROP_BUFFER_ROWBYTES
+ * bytes.
+ *
+ * @param cam ORCACAM handle
+ * @param buffers Array of num_frames frame buffers, aligned to ORCA_BUFFER_ALIGN
+ * @param num_frames Number of frames
+ * @param buffer_bytes Size of each buffer, at least DCAM_IDPROP_BUFFER_FRAMEBYTES
+ * @return DCAMERR DCAMERR_BUSY if the camera is capturing, DCAMERR_INVALIDPARAM if a buffer is too small or misaligned
+ */
+DCAMERR orca_attach_buffers(ORCACAM cam, void *_Nonnull *_Nonnull buffers, size_t num_frames, size_t buffer_bytes);
+
+/**
+ * @brief Detach the caller-owned frame buffer ring, and go back to the library ring.
+ *
+ * @param cam ORCACAM handle
+ * @return DCAMERR DCAMERR_BUSY if the camera is capturing
+ */
+DCAMERR orca_detach_buffers(ORCACAM cam);
+
+/**
+ * @brief Get the NUMA node the frame buffer rings and the capture threads are placed on.
+ *
+ * The node is discovered when the camera is opened, from the sysfs device of
+ * the host controller of a USB camera (ORCA_CAM_INFO::bus and
+ * ORCA_CAM_INFO::id). The library and preset rings are allocated on that
+ * node, and the capture threads are restricted to its CPUs. The worker
+ * threads of processing stages follow the thread that runs them.
+ *
+ * @param cam ORCACAM handle
+ * @param node NUMA node, -1 if unknown (no placement)
+ * @return DCAMERR
+ */
+DCAMERR orca_get_numa_node(ORCACAM cam, int32 *_Nonnull node);
+
+/**
+ * @brief Set the NUMA node the frame buffer rings and the capture threads are placed on, and move the rings already allocated there.
+ *
+ * @param cam ORCACAM handle
+ * @param node NUMA node, -1 to stop placing new rings and threads
+ * @return DCAMERR DCAMERR_BUSY if the camera is capturing, DCAMERR_INVALIDPARAM if the node does not exist
+ */
+DCAMERR orca_set_numa_node(ORCACAM cam, int32 node);
+
 /**
  * @brief Get the frame width and height
  *
@@ -209,9 +302,23 @@ DCAMERR orca_acquire_image(ORCACAM cam, ORCA_FRAME *_Nonnull frame, int32 timeou
  */
 DCAMERR orca_stop_acquisition(ORCACAM cam);
 
+/**
+ * @brief Position of a frame in a capture
+ *
+ */
+typedef struct _ORCA_CAPTURE_INFO
+{
+    uint64_t frame_count; //!< Frame number since the capture started, starting at 1
+    uint64_t skipped;     //!< Frames captured since the previous frame delivered that were not delivered
+} ORCA_CAPTURE_INFO;
+
 /**
  * @brief Start image acquisition (callback API)
  *
+ * Only the newest frame of the ring is delivered when the callback falls
+ * behind; every frame carries its ORCA_CAPTURE_INFO in
+ * frame->meta[ORCA_META_CAPTURE].
+ *
  * @param cam ORCACAM handle
  * @param cb Frame callback function
  * @param user_data User data pointer
@@ -220,14 +327,195 @@ DCAMERR orca_stop_acquisition(ORCACAM cam);
  */
 DCAMERR orca_start_capture(ORCACAM cam, OrcaFrameCallback _Nonnull cb, void *_Nullable user_data, size_t sz_user_data DCAM_DEFAULT_ARG);
 
+/**
+ * @brief Get the number of frames the camera has captured since the capture
+ * started, which may be ahead of the frames delivered. A frame with
+ * ORCA_CAPTURE_INFO::frame_count k is overwritten once the camera writes
+ * frame k plus the ring size.
+ *
+ * @param cam ORCACAM handle
+ * @param frame_count Output frame count
+ * @return DCAMERR DCAMERR_NOTREADY if the camera is not capturing
+ */
+DCAMERR orca_get_frame_count(ORCACAM cam, uint64_t *_Nonnull frame_count);
+
 /**
  * @brief Stop image acquisition (callback API)
  *
  * @param cam ORCACAM handle
- * @return DCAMERR
+ * @return DCAMERR DCAMERR_BUSY if the acquisition was not started by orca_start_capture() or orca_start_history()
  */
 DCAMERR orca_stop_capture(ORCACAM cam);
 
+/**
+ * @brief Orca snap completion callback
+ *
+ * @param err Result of the snap
+ * @param num_frames Number of frames captured
+ * @param user_data Pointer to user data
+ * @param sz_user_data Size of user data
+ */
+typedef void (*OrcaSnapCallback)(DCAMERR, int32, void * _Nullable, size_t);
+
+/**
+ * @brief Capture a burst of frames directly into caller buffers (blocking).
+ *
+ * The buffers are attached as the DCAM ring and the camera is started in
+ * snap mode, so it stops after num_frames frames and every frame lands in
+ * its own buffer without a copy. Frames keep the DCAM layout: the image
+ * starts at DCAM_IDPROP_BUFFER_TOPOFFSETBYTES, with rows of
+ * DCAM_IDPROP_BUFFER_ROWBYTES bytes. The processing stages are not run.
+ *
+ * @param cam ORCACAM handle
+ * @param num_frames Number of frames
+ * @param buffers Array of num_frames frame buffers, aligned to ORCA_BUFFER_ALIGN
+ * @param buffer_bytes Size of each buffer, at least DCAM_IDPROP_BUFFER_FRAMEBYTES
+ * @param timestamps Optional array of num_frames camera timestamps (s)
+ * @param timeout Maximum time to wait for each frame (ms)
+ * @return DCAMERR DCAMERR_BUSY if the camera is capturing, DCAMERR_INVALIDPARAM if a buffer is too small or misaligned
+ */
+DCAMERR orca_snap(ORCACAM cam, int32 num_frames, void *_Nonnull *_Nonnull buffers, size_t buffer_bytes, double *_Nullable timestamps, int32 timeout);
+
+/**
+ * @brief Start a burst capture into caller buffers (see orca_snap), and return immediately.
+ *
+ * When the burst completes, the timestamps are filled in and done is called
+ * from the capture thread; done must not call orca_stop_capture(). The
+ * buffers must stay valid until orca_stop_capture() is called, which also
+ * aborts an unfinished burst and returns the result of the burst.
+ *
+ * @param cam ORCACAM handle
+ * @param num_frames Number of frames
+ * @param buffers Array of num_frames frame buffers, aligned to ORCA_BUFFER_ALIGN
+ * @param buffer_bytes Size of each buffer, at least DCAM_IDPROP_BUFFER_FRAMEBYTES
+ * @param timestamps Optional array of num_frames camera timestamps (s)
+ * @param done Completion callback
+ * @param user_data User data pointer
+ * @param sz_user_data Size of user data
+ * @return DCAMERR If the burst could not be started, the error is only returned here and done is not called
+ */
+DCAMERR orca_snap_start(ORCACAM cam, int32 num_frames, void *_Nonnull *_Nonnull buffers, size_t buffer_bytes, double *_Nullable timestamps, OrcaSnapCallback _Nonnull done, void *_Nullable user_data, size_t sz_user_data DCAM_DEFAULT_ARG);
+
+/**
+ * @brief Position of a frame in a history event
+ *
+ */
+typedef struct _ORCA_HISTORY_INFO
+{
+    uint64_t event;       //!< Event number, starting at 1
+    int64_t index;        //!< Frame index relative to the trigger: up to 0 before, from 1 after
+    uint64_t frame_count; //!< Frame number since the capture started
+    uint64_t lost;        //!< Frames of the event overwritten before they could be delivered, so far
+    int32 last;           //!< Non-zero for the last frame of the event
+    int32 rsvd;           //!< Reserved
+} ORCA_HISTORY_INFO;
+
+/**
+ * @brief Start capturing in history mode (callback API).
+ *
+ * The camera captures continuously into the frame buffer ring, which is
+ * grown to twice the pre-trigger window (plus two frames) if it is smaller.
+ * A caller ring (orca_attach_buffers) is not grown, and must be that large.
+ * Frames are not touched until orca_history_trigger() is called: the
+ * pre_frames frames up to the trigger and the post_frames frames after it
+ * are then passed to the sink in order, directly from the ring, with their
+ * ORCA_HISTORY_INFO in frame->meta[ORCA_META_HISTORY]. The processing stages
+ * only run on the frames passed to the sink, and see the same
+ * ORCA_HISTORY_INFO.
+ *
+ * The pre-trigger frames remain valid until the camera wraps around the
+ * ring; frames overwritten before the sink reaches them are counted as lost.
+ *
+ * @param cam ORCACAM handle
+ * @param pre_frames Number of frames kept before the trigger
+ * @param post_frames Number of frames delivered after the trigger
+ * @param sink Sink callback, called from the capture thread
+ * @param user_data User data pointer
+ * @param sz_user_data Size of user data
+ * @return DCAMERR DCAMERR_NORESOURCE if the ring can not hold twice the pre-trigger window
+ */
+DCAMERR orca_start_history(ORCACAM cam, int32 pre_frames, int32 post_frames, OrcaFrameCallback _Nonnull sink, void *_Nullable user_data, size_t sz_user_data DCAM_DEFAULT_ARG);
+
+/**
+ * @brief Trigger a history event. The event window is anchored at the
+ * newest frame at the time of the call. Stop with orca_stop_capture().
+ *
+ * @param cam ORCACAM handle
+ * @return DCAMERR DCAMERR_NOTREADY if not capturing in history mode, DCAMERR_BUSY if an event is being delivered
+ */
+DCAMERR orca_history_trigger(ORCACAM cam);
+
+/**
+ * @brief Trigger that produced a frame
+ *
+ */
+typedef struct _ORCA_TRIGGER_INFO
+{
+    uint64_t sequence; //!< Trigger number since the capture started, starting at 1
+    uint64_t fired;    //!< Software triggers fired so far with orca_fire_trigger()
+    int32 source;      //!< Trigger source (DCAMPROP_TRIGGERSOURCE__*)
+    int32 active;      //!< Trigger active (DCAMPROP_TRIGGERACTIVE__*)
+} ORCA_TRIGGER_INFO;
+
+/**
+ * @brief Set the trigger of the acquisition, as one configuration transaction.
+ *
+ * With an external or software trigger source, every frame carries its
+ * ORCA_TRIGGER_INFO in frame->meta[ORCA_META_TRIGGER]. The trigger sequence
+ * number assumes one frame per trigger; in synchronous readout mode a frame
+ * is produced by the trigger that ends its exposure.
+ *
+ * @param cam ORCACAM handle
+ * @param source Trigger source (DCAMPROP_TRIGGERSOURCE__*)
+ * @param active Trigger active (DCAMPROP_TRIGGERACTIVE__EDGE, LEVEL or SYNCREADOUT), 0 to leave unchanged
+ * @param polarity Trigger polarity (DCAMPROP_TRIGGERPOLARITY__*), 0 to leave unchanged
+ * @return DCAMERR DCAMERR_BUSY if the camera is capturing
+ */
+DCAMERR orca_set_trigger(ORCACAM cam, DCAMPROPMODEVALUE source, DCAMPROPMODEVALUE active, DCAMPROPMODEVALUE polarity);
+
+/**
+ * @brief Get the trigger of the acquisition
+ *
+ * @param cam ORCACAM handle
+ * @param source Trigger source (DCAMPROP_TRIGGERSOURCE__*)
+ * @param active Trigger active (DCAMPROP_TRIGGERACTIVE__*)
+ * @param polarity Trigger polarity (DCAMPROP_TRIGGERPOLARITY__*)
+ * @return DCAMERR
+ */
+DCAMERR orca_get_trigger(ORCACAM cam, DCAMPROPMODEVALUE *_Nonnull source, DCAMPROPMODEVALUE *_Nonnull active, DCAMPROPMODEVALUE *_Nonnull polarity);
+
+/**
+ * @brief Fire a software trigger. The camera must be capturing with the software trigger source.
+ *
+ * @param cam ORCACAM handle
+ * @return DCAMERR DCAMERR_NOTREADY if the camera is not capturing
+ */
+DCAMERR orca_fire_trigger(ORCACAM cam);
+
+/**
+ * @brief Append a frame processing stage to the capture pipeline.
+ *
+ * Stages are executed in the order they were added, on every frame, before
+ * the frame is handed to the frame callback (callback API) or returned by
+ * orca_acquire_image (no callback API). A stage may modify the frame data in
+ * place. Stages can not be added while the camera is capturing.
+ *
+ * @param cam ORCACAM handle
+ * @param stage Stage function
+ * @param user_data Stage data pointer
+ * @param sz_user_data Size of stage data
+ * @return DCAMERR
+ */
+DCAMERR orca_add_stage(ORCACAM cam, OrcaFrameCallback _Nonnull stage, void *_Nullable user_data, size_t sz_user_data DCAM_DEFAULT_ARG);
+
+/**
+ * @brief Remove all frame processing stages from the capture pipeline.
+ *
+ * @param cam ORCACAM handle
+ * @return DCAMERR
+ */
+DCAMERR orca_clear_stages(ORCACAM cam);
+
 /**
  * @brief Close the camera and release resources
  *
@@ -352,7 +640,174 @@ DCAMERR orca_get_acq_framerate(ORCACAM cam, double *_Nonnull fps);
 DCAMERR orca_set_acq_framerate(ORCACAM cam, double fps);
 
 /**
- * @brief Get property attributes. NOT FOR GENERAL USE.
+ * @brief Maximum number of properties staged in a configuration transaction. Presets are not limited by it.
+ *
+ */
+#define ORCA_CONFIG_MAX_PROPS 64
+
+/**
+ * @brief Configuration transaction handle
+ *
+ */
+typedef struct _ORCA_CONFIG *ORCA_CONFIG;
+
+/**
+ * @brief Begin a configuration transaction. Property changes are staged, and applied together by orca_config_commit().
+ *
+ * @param cam ORCACAM handle
+ * @param cfg Output transaction handle
+ * @return DCAMERR
+ */
+DCAMERR orca_config_begin(ORCACAM cam, ORCA_CONFIG *_Nonnull cfg);
+
+/**
+ * @brief Stage a property value. Staging a property again replaces its value.
+ *
+ * @param cfg Transaction handle
+ * @param prop Property ID
+ * @param value Property value
+ * @return DCAMERR DCAMERR_NORESOURCE if ORCA_CONFIG_MAX_PROPS properties are staged
+ */
+DCAMERR orca_config_set(ORCA_CONFIG cfg, DCAMIDPROP prop, double value);
+
+/**
+ * @brief Stage a sensor mode (see orca_switch_mode).
+ *
+ * @param cfg Transaction handle
+ * @param mode Mode (DCAMPROPMODEVALUE::DCAMPROP_SENSORMODE__*)
+ * @return DCAMERR
+ */
+DCAMERR orca_config_mode(ORCA_CONFIG cfg, DCAMPROPMODEVALUE mode);
+
+/**
+ * @brief Stage a pixel format (see orca_set_pixel_fmt).
+ *
+ * @param cfg Transaction handle
+ * @param fmt Pixel format (MONO8 or MONO16)
+ * @return DCAMERR
+ */
+DCAMERR orca_config_pixel_fmt(ORCA_CONFIG cfg, DCAM_PIXELTYPE fmt);
+
+/**
+ * @brief Stage a region of interest (see orca_set_roi).
+ *
+ * @param cfg Transaction handle
+ * @param x X offset
+ * @param y Y offset
+ * @param w Width
+ * @param h Height
+ * @return DCAMERR
+ */
+DCAMERR orca_config_roi(ORCA_CONFIG cfg, int32 x, int32 y, int32 w, int32 h);
+
+/**
+ * @brief Stage an exposure time (see orca_set_exposure).
+ *
+ * @param cfg Transaction handle
+ * @param exposure Exposure time (s)
+ * @return DCAMERR
+ */
+DCAMERR orca_config_exposure(ORCA_CONFIG cfg, double exposure);
+
+/**
+ * @brief Stage a trigger (see orca_set_trigger).
+ *
+ * @param cfg Transaction handle
+ * @param source Trigger source (DCAMPROP_TRIGGERSOURCE__*)
+ * @param active Trigger active (DCAMPROP_TRIGGERACTIVE__*), 0 to leave unchanged
+ * @param polarity Trigger polarity (DCAMPROP_TRIGGERPOLARITY__*), 0 to leave unchanged
+ * @return DCAMERR
+ */
+DCAMERR orca_config_trigger(ORCA_CONFIG cfg, DCAMPROPMODEVALUE source, DCAMPROPMODEVALUE active, DCAMPROPMODEVALUE polarity);
+
+/**
+ * @brief Apply a configuration transaction, and free it.
+ *
+ * The staged properties are first checked against the attribute table
+ * (writability, and ranges unless the sensor mode or the image format
+ * changes), then applied with dcamprop_setgetvalue in dependency order:
+ * sensor mode, pixel format, ROI, other properties, and timing properties.
+ * The frame buffer is rebuilt once at the end. If any step fails, the
+ * properties already applied are restored to their previous values in the
+ * same dependency order, so that, e.g., the sensor mode is restored before
+ * the exposure time whose range depends on it, and the subarray is switched
+ * off while its position and size are restored.
+ *
+ * @param cfg Transaction handle
+ * @return DCAMERR DCAMERR_BUSY if the camera is capturing
+ */
+DCAMERR orca_config_commit(ORCA_CONFIG *_Nonnull cfg);
+
+/**
+ * @brief Discard a configuration transaction.
+ *
+ * @param cfg Transaction handle
+ */
+void orca_config_abort(ORCA_CONFIG *_Nonnull cfg);
+
+/**
+ * @brief Maximum number of presets per camera
+ *
+ */
+#define ORCA_MAX_PRESETS 8
+
+/**
+ * @brief Maximum length of a preset name, including the terminating NUL
+ *
+ */
+#define ORCA_PRESET_NAME_MAX 32
+
+/**
+ * @brief Save the current configuration as a named preset.
+ *
+ * The preset records the value of every writable property, and allocates a
+ * frame buffer ring that matches the current image format. Saving a preset
+ * under an existing name replaces it.
+ *
+ * @param cam ORCACAM handle
+ * @param name Preset name
+ * @param num_frames Number of frames in the preset ring (0 for the default)
+ * @return DCAMERR DCAMERR_NORESOURCE if ORCA_MAX_PRESETS presets exist
+ */
+DCAMERR orca_preset_save(ORCACAM cam, const char *_Nonnull name, size_t num_frames);
+
+/**
+ * @brief Apply a preset.
+ *
+ * Only the properties that differ from the cached current values are
+ * written, in a single configuration transaction (see orca_config_commit()).
+ * The preset ring is then used for the next acquisition instead of
+ * re-allocating the frame buffer.
+ *
+ * @param cam ORCACAM handle
+ * @param name Preset name
+ * @return DCAMERR DCAMERR_BUSY if the camera is capturing, DCAMERR_INVALIDPARAM if the preset does not exist
+ */
+DCAMERR orca_preset_apply(ORCACAM cam, const char *_Nonnull name);
+
+/**
+ * @brief Stop capturing if needed, apply a preset, and start capturing.
+ *
+ * @param cam ORCACAM handle
+ * @param name Preset name
+ * @param cb Frame callback (see orca_start_capture())
+ * @param user_data Pointer to user data
+ * @param sz_user_data Size of user data
+ * @return DCAMERR DCAMERR_BUSY if the camera is capturing with orca_start_acquisition() or a snap
+ */
+DCAMERR orca_preset_switch(ORCACAM cam, const char *_Nonnull name, OrcaFrameCallback _Nonnull cb, void *_Nullable user_data, size_t sz_user_data DCAM_DEFAULT_ARG);
+
+/**
+ * @brief Remove a preset and free its ring.
+ *
+ * @param cam ORCACAM handle
+ * @param name Preset name
+ * @return DCAMERR DCAMERR_BUSY if the preset ring is in use by a capture
+ */
+DCAMERR orca_preset_remove(ORCACAM cam, const char *_Nonnull name);
+
+/**
+ * @brief Get property attributes (cached). NOT FOR GENERAL USE.
  *
  * @param cam ORCACAM handle
  * @param prop Property ID
@@ -408,6 +863,9 @@ DCAMERR orca_query_value(ORCACAM cam, DCAMIDPROP prop, double *_Nonnull value,
 /**
  * @brief Get next property ID. NOT FOR GENERAL USE.
  *
+ * Enumerating with DCAMPROP_OPTION_UPDATED consumes the update list of the
+ * property cache, so all cached values are invalidated.
+ *
  * @param cam ORCACAM handle
  * @param prop Property ID
  * @param option Property option
@@ -0,0 +1,597 @@
+/**
+ * @file orcacam.hpp
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Header-only C++17 RAII layer over the orcacam C API
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Failed calls throw orca::Error. Frames are never copied nor allocated:
+ * FrameView and FrameLease only refer to the frame ring of the camera.
+ *
+ */
+
+#ifndef _ORCACAM_HPP_
+#define _ORCACAM_HPP_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#include "orcacam.h"
+
+namespace orca
+{
+
+/**
+ * @brief Failed orcacam call
+ *
+ */
+class Error : public std::runtime_error
+{
+  public:
+    /**
+     * @brief Construct an error.
+     *
+     * @param err DCAMERR of the call
+     * @param call Name of the call
+     */
+    Error(DCAMERR err, const char *call)
+        : std::runtime_error(std::string(call) + ": " + orcacam_sterr(err)),
+          code_(err)
+    {
+    }
+
+    /**
+     * @brief Get the DCAMERR of the failed call.
+     *
+     * @return DCAMERR
+     */
+    DCAMERR code() const noexcept
+    {
+        return code_;
+    }
+
+  private:
+    DCAMERR code_;
+};
+
+/**
+ * @brief Throw orca::Error if a call failed.
+ *
+ * @param err DCAMERR of the call
+ * @param call Name of the call
+ */
+inline void check(DCAMERR err, const char *call)
+{
+    if (orcaerr_failed(err))
+    {
+        throw Error(err, call);
+    }
+}
+
+#if __cplusplus >= 202002L
+template <typename T> using span = std::span<T>;
+#else
+/**
+ * @brief Contiguous range of pixels, a subset of C++20 std::span
+ *
+ * @tparam T Pixel type
+ */
+template <typename T> class span
+{
+  public:
+    constexpr span() noexcept = default;
+    constexpr span(T *data, size_t size) noexcept : data_(data), size_(size)
+    {
+    }
+    constexpr T *data() const noexcept
+    {
+        return data_;
+    }
+    constexpr size_t size() const noexcept
+    {
+        return size_;
+    }
+    constexpr bool empty() const noexcept
+    {
+        return size_ == 0;
+    }
+    constexpr T &operator[](size_t i) const noexcept
+    {
+        return data_[i];
+    }
+    constexpr T *begin() const noexcept
+    {
+        return data_;
+    }
+    constexpr T *end() const noexcept
+    {
+        return data_ + size_;
+    }
+
+  private:
+    T *data_     = nullptr;
+    size_t size_ = 0;
+};
+#endif
+
+/**
+ * @brief Non-owning view of a frame, with typed row access
+ *
+ */
+class FrameView
+{
+  public:
+    /**
+     * @brief View a frame of the C API.
+     *
+     * @param frame Frame, which must outlive the view
+     */
+    explicit FrameView(const ORCA_FRAME &frame) noexcept : frame_(&frame)
+    {
+    }
+
+    int32 width() const noexcept
+    {
+        return frame_->width;
+    }
+    int32 height() const noexcept
+    {
+        return frame_->height;
+    }
+    DCAM_PIXELTYPE fmt() const noexcept
+    {
+        return frame_->fmt;
+    }
+    int32 row_stride() const noexcept
+    {
+        return frame_->row_stride;
+    }
+    char *data() const noexcept
+    {
+        return frame_->data;
+    }
+
+    /**
+     * @brief Get the pixels of a row. Rows are row_stride() bytes apart,
+     * which may be more than width() pixels.
+     *
+     * @tparam T Pixel type, uint16_t for DCAM_PIXELTYPE_MONO16 and
+     * uint8_t for DCAM_PIXELTYPE_MONO8
+     * @param y Row
+     * @return span<T> width() pixels
+     */
+    template <typename T = uint16_t> span<T> row(int32 y) const noexcept
+    {
+        static_assert(std::is_arithmetic<std::remove_const_t<T>>::value,
+                      "pixels are arithmetic types");
+        assert(y >= 0 && y < frame_->height);
+        assert((size_t)frame_->width * sizeof(T) <=
+               (size_t)frame_->row_stride);
+        return span<T>(reinterpret_cast<T *>(frame_->data +
+                                             (size_t)y * frame_->row_stride),
+                       (size_t)frame_->width);
+    }
+
+    /**
+     * @brief Get the metadata a processing stage attached to the frame.
+     *
+     * @tparam T Metadata type, e.g. ORCA_TRIGGER_INFO for ORCA_META_TRIGGER
+     * @param kind ORCA_META_KIND
+     * @return const T* Metadata, nullptr if there is none
+     */
+    template <typename T> const T *meta(ORCA_META_KIND kind) const noexcept
+    {
+        return static_cast<const T *>(frame_->meta[kind]);
+    }
+
+    /**
+     * @brief Get the frame of the C API.
+     *
+     * @return const ORCA_FRAME&
+     */
+    const ORCA_FRAME &get() const noexcept
+    {
+        return *frame_;
+    }
+
+  private:
+    const ORCA_FRAME *frame_;
+};
+
+class Acquisition;
+
+/**
+ * @brief Frame of an Acquisition, held until the lease is destroyed
+ *
+ * Only one lease of an Acquisition can be held at a time. The frame lives
+ * in the camera ring, and is overwritten once the camera wraps around it,
+ * so leases are meant to be short.
+ *
+ */
+class FrameLease
+{
+  public:
+    FrameLease(const FrameLease &)            = delete;
+    FrameLease &operator=(const FrameLease &) = delete;
+    FrameLease(FrameLease &&other) noexcept
+        : frame_(other.frame_), held_(std::exchange(other.held_, nullptr))
+    {
+    }
+    FrameLease &operator=(FrameLease &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            frame_ = other.frame_;
+            held_  = std::exchange(other.held_, nullptr);
+        }
+        return *this;
+    }
+    ~FrameLease()
+    {
+        release();
+    }
+
+    /**
+     * @brief Get a view of the frame.
+     *
+     * @return FrameView
+     */
+    FrameView view() const noexcept
+    {
+        assert(held_);
+        return FrameView(*frame_);
+    }
+    FrameView operator*() const noexcept
+    {
+        return view();
+    }
+
+    /**
+     * @brief Return the frame to the acquisition early.
+     *
+     */
+    void release() noexcept
+    {
+        if (held_)
+        {
+            *held_ = false;
+            held_  = nullptr;
+        }
+    }
+
+  private:
+    friend class Acquisition;
+    FrameLease(const ORCA_FRAME *frame, bool *held) noexcept
+        : frame_(frame), held_(held)
+    {
+    }
+
+    const ORCA_FRAME *frame_;
+    bool *held_;
+};
+
+/**
+ * @brief Polled acquisition (orca_start_acquisition), stopped on
+ * destruction
+ *
+ */
+class Acquisition
+{
+  public:
+    /**
+     * @brief Start acquiring.
+     *
+     * @param cam Camera handle
+     */
+    explicit Acquisition(ORCACAM cam) : cam_(cam)
+    {
+        frame_ = ORCA_FRAME();
+        check(orca_start_acquisition(cam_, &frame_), "orca_start_acquisition");
+    }
+    Acquisition(const Acquisition &)            = delete;
+    Acquisition &operator=(const Acquisition &) = delete;
+    /**
+     * @brief Move an acquisition, which must not have a frame leased.
+     *
+     */
+    Acquisition(Acquisition &&other) noexcept
+        : cam_(std::exchange(other.cam_, nullptr)), frame_(other.frame_)
+    {
+        assert(!other.held_);
+    }
+    Acquisition &operator=(Acquisition &&other) noexcept
+    {
+        assert(!held_ && !other.held_);
+        if (this != &other)
+        {
+            stop();
+            cam_   = std::exchange(other.cam_, nullptr);
+            frame_ = other.frame_;
+        }
+        return *this;
+    }
+    ~Acquisition()
+    {
+        stop();
+    }
+
+    /**
+     * @brief Wait for the next frame.
+     *
+     * @param timeout Timeout (ms)
+     * @return std::optional<FrameLease> Frame, std::nullopt on timeout
+     */
+    std::optional<FrameLease> try_next(int32 timeout)
+    {
+        if (!cam_ || held_)
+        {
+            throw Error(cam_ ? DCAMERR_BUSY : DCAMERR_NOTREADY,
+                        "orca_acquire_image");
+        }
+        frame_.data = nullptr;
+        DCAMERR err = orca_acquire_image(cam_, &frame_, timeout);
+        if (err == DCAMERR_TIMEOUT)
+        {
+            return std::nullopt;
+        }
+        check(err, "orca_acquire_image");
+        if (!frame_.data)
+        {
+            // the acquisition stopped on a failed wait
+            cam_ = nullptr;
+            throw Error(DCAMERR_ABORT, "orca_acquire_image");
+        }
+        held_ = true;
+        return FrameLease(&frame_, &held_);
+    }
+
+    /**
+     * @brief Wait for the next frame.
+     *
+     * @param timeout Timeout (ms)
+     * @return FrameLease Frame
+     */
+    FrameLease next(int32 timeout)
+    {
+        std::optional<FrameLease> lease = try_next(timeout);
+        if (!lease)
+        {
+            throw Error(DCAMERR_TIMEOUT, "orca_acquire_image");
+        }
+        return std::move(*lease);
+    }
+
+    /**
+     * @brief Stop acquiring. Errors are ignored, as on destruction.
+     *
+     */
+    void stop() noexcept
+    {
+        assert(!held_);
+        if (cam_)
+        {
+            orca_stop_acquisition(cam_);
+            cam_ = nullptr;
+        }
+    }
+
+  private:
+    ORCACAM cam_;
+    ORCA_FRAME frame_;
+    bool held_ = false;
+};
+
+/**
+ * @brief Callback capture (orca_start_capture), stopped on destruction
+ *
+ * The callable is stored in the capture, which therefore can not move.
+ * It is called on the capture thread with a FrameView.
+ *
+ * @tparam F Callable taking a FrameView
+ */
+template <typename F> class Capture
+{
+  public:
+    /**
+     * @brief Start capturing.
+     *
+     * @param cam Camera handle
+     * @param fn Callable, called for every frame
+     */
+    Capture(ORCACAM cam, F fn) : cam_(cam), fn_(std::move(fn))
+    {
+        check(orca_start_capture(cam_, &Capture::frame, this, sizeof(*this)),
+              "orca_start_capture");
+    }
+    Capture(const Capture &)            = delete;
+    Capture &operator=(const Capture &) = delete;
+    ~Capture()
+    {
+        if (cam_)
+        {
+            orca_stop_capture(cam_);
+        }
+    }
+
+    /**
+     * @brief Stop capturing.
+     *
+     */
+    void stop()
+    {
+        ORCACAM cam = std::exchange(cam_, nullptr);
+        if (cam)
+        {
+            check(orca_stop_capture(cam), "orca_stop_capture");
+        }
+    }
+
+  private:
+    static void frame(ORCA_FRAME *frame, void *user_data, size_t)
+    {
+        static_cast<Capture *>(user_data)->fn_(FrameView(*frame));
+    }
+
+    ORCACAM cam_;
+    F fn_;
+};
+
+/**
+ * @brief Camera, closed on destruction
+ *
+ */
+class Camera
+{
+  public:
+    /**
+     * @brief Get the number of cameras, initializing the DCAM API.
+     *
+     * @return int32 Number of cameras
+     */
+    static int32 count()
+    {
+        int32 n = 0;
+        check(orca_list_devices(&n, 0, nullptr), "orca_list_devices");
+        return n;
+    }
+
+    /**
+     * @brief Open a camera.
+     *
+     * @param index Camera index
+     * @param num_frames Number of frames of the ring
+     */
+    explicit Camera(int32 index, size_t num_frames = DEFAULT_FRAME_COUNT)
+    {
+        check(orca_open_camera(index, &cam_, num_frames), "orca_open_camera");
+    }
+    Camera(const Camera &)            = delete;
+    Camera &operator=(const Camera &) = delete;
+    Camera(Camera &&other) noexcept : cam_(std::exchange(other.cam_, nullptr))
+    {
+    }
+    Camera &operator=(Camera &&other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            cam_ = std::exchange(other.cam_, nullptr);
+        }
+        return *this;
+    }
+    ~Camera()
+    {
+        close();
+    }
+
+    /**
+     * @brief Get the camera handle, for the C API.
+     *
+     * @return ORCACAM
+     */
+    ORCACAM get() const noexcept
+    {
+        return cam_;
+    }
+
+    /**
+     * @brief Close the camera. Errors are ignored, as on destruction.
+     *
+     */
+    void close() noexcept
+    {
+        if (cam_)
+        {
+            orca_close_camera(&cam_);
+            cam_ = nullptr;
+        }
+    }
+
+    ORCA_CAM_INFO info() const
+    {
+        ORCA_CAM_INFO info;
+        check(orca_device_info(cam_, &info), "orca_device_info");
+        return info;
+    }
+    double exposure() const
+    {
+        double v;
+        check(orca_get_exposure(cam_, &v), "orca_get_exposure");
+        return v;
+    }
+    void set_exposure(double exposure)
+    {
+        check(orca_set_exposure(cam_, exposure), "orca_set_exposure");
+    }
+    double temperature() const
+    {
+        double v;
+        check(orca_get_temperature(cam_, &v), "orca_get_temperature");
+        return v;
+    }
+    DCAMPROPMODEVALUE mode() const
+    {
+        DCAMPROPMODEVALUE v;
+        check(orca_get_mode(cam_, &v), "orca_get_mode");
+        return v;
+    }
+    void switch_mode(DCAMPROPMODEVALUE mode)
+    {
+        check(orca_switch_mode(cam_, mode), "orca_switch_mode");
+    }
+    void set_roi(int32 x, int32 y, int32 w, int32 h)
+    {
+        check(orca_set_roi(cam_, x, y, w, h), "orca_set_roi");
+    }
+    double value(DCAMIDPROP prop) const
+    {
+        double v;
+        check(orca_get_value(cam_, prop, &v), "orca_get_value");
+        return v;
+    }
+    void set_value(DCAMIDPROP prop, double value)
+    {
+        check(orca_set_value(cam_, prop, value), "orca_set_value");
+    }
+
+    /**
+     * @brief Start a polled acquisition.
+     *
+     * @return Acquisition
+     */
+    Acquisition acquire()
+    {
+        return Acquisition(cam_);
+    }
+
+    /**
+     * @brief Start capturing with a callable taking a FrameView.
+     *
+     * @tparam F Callable type
+     * @param fn Callable
+     * @return Capture<F>
+     */
+    template <typename F> Capture<std::decay_t<F>> capture(F &&fn)
+    {
+        return Capture<std::decay_t<F>>(cam_, std::forward<F>(fn));
+    }
+
+  private:
+    ORCACAM cam_ = nullptr;
+};
+
+} // namespace orca
+
+#endif // _ORCACAM_HPP_
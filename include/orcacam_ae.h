@@ -0,0 +1,130 @@
+/**
+ * @file orcacam_ae.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Closed-loop auto-exposure stage
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_AE_H_
+#define _ORCACAM_AE_H_
+
+#include <stdint.h>
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Brightness metric
+ *
+ */
+typedef enum _ORCA_AE_METRIC
+{
+    ORCA_AE_MEAN       = 0, //!< Mean of the sampled pixels
+    ORCA_AE_PERCENTILE = 1, //!< Percentile of the sampled pixels (MONO16: 16-count bins)
+} ORCA_AE_METRIC;
+
+/**
+ * @brief Auto-exposure configuration
+ *
+ * The controller works on the logarithm of the exposure time, since the
+ * metric is proportional to the exposure time: kp = 1 with ki = kd = 0
+ * corrects the full error in one adjustment.
+ *
+ */
+typedef struct _ORCA_AE_CONFIG
+{
+    ORCA_AE_METRIC metric; //!< Brightness metric
+    double percentile;     //!< Percentile (0 - 100) for ORCA_AE_PERCENTILE
+    double target;         //!< Target metric value (counts)
+    double min_exposure;   //!< Minimum exposure time (s)
+    double max_exposure;   //!< Maximum exposure time (s)
+    double kp;             //!< Proportional gain
+    double ki;             //!< Integral gain
+    double kd;             //!< Derivative gain
+    double tolerance;      //!< Relative deviation from the target that is left uncorrected
+    double max_ratio;      //!< Maximum change of the exposure time per adjustment (ratio, 0 for 4)
+    int32 interval;        //!< Number of frames between adjustments, at least the exposure latency of the camera (0 for 4)
+    int32 samples;         //!< Approximate number of sampled pixels per measurement (0 for 1024)
+} ORCA_AE_CONFIG;
+
+/**
+ * @brief Auto-exposure state
+ *
+ */
+typedef struct _ORCA_AE_STATE
+{
+    double metric;        //!< Last measured metric
+    double exposure;      //!< Exposure time in effect after the last adjustment (s)
+    uint64_t frames;      //!< Number of frames seen by the stage at the last measurement
+    uint64_t adjustments; //!< Number of exposure time changes
+    int32 settled;        //!< Non-zero if the last measurement was within the tolerance
+    int32 rsvd;           //!< Reserved
+} ORCA_AE_STATE;
+
+/**
+ * @brief Auto-exposure handle
+ *
+ */
+typedef struct _ORCA_AE *ORCA_AE;
+
+/**
+ * @brief Create an auto-exposure controller.
+ *
+ * @param ae Output auto-exposure handle
+ * @param cam Camera handle
+ * @param config Configuration
+ * @return DCAMERR DCAMERR_NOTWRITABLE if the exposure time can not be written during capture
+ */
+DCAMERR orca_ae_create(ORCA_AE *_Nonnull ae, ORCACAM cam, const ORCA_AE_CONFIG *_Nonnull config);
+
+/**
+ * @brief Auto-exposure stage function. Add to the camera using orca_add_stage(cam, orca_ae_stage, ae, sizeof(ae)).
+ *
+ * Frames between adjustments only increment a counter. Every interval
+ * frames, the metric is computed on a subsampled grid of MONO8 or MONO16
+ * pixels, and the exposure time is adjusted if the metric is outside the
+ * tolerance.
+ *
+ * @param frame Frame data
+ * @param ae ORCA_AE handle
+ * @param sz_ae Unused
+ */
+void orca_ae_stage(ORCA_FRAME *_Nonnull frame, void *_Nullable ae, size_t sz_ae);
+
+/**
+ * @brief Change the target metric value while capturing.
+ *
+ * @param ae Auto-exposure handle
+ * @param target Target metric value (counts)
+ * @return DCAMERR
+ */
+DCAMERR orca_ae_set_target(ORCA_AE ae, double target);
+
+/**
+ * @brief Get the auto-exposure state.
+ *
+ * @param ae Auto-exposure handle
+ * @param state Output state
+ * @return DCAMERR
+ */
+DCAMERR orca_ae_get_state(ORCA_AE ae, ORCA_AE_STATE *_Nonnull state);
+
+/**
+ * @brief Destroy an auto-exposure controller. The controller must not be in use by a capturing camera.
+ *
+ * @param ae Auto-exposure handle
+ */
+void orca_ae_destroy(ORCA_AE *_Nonnull ae);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // _ORCACAM_AE_H_
@@ -0,0 +1,113 @@
+/**
+ * @file orcacam_bin.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Software binning and downsampling of ORCA frames
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_BIN_H_
+#define _ORCACAM_BIN_H_
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Maximum number of pixels in a bin (bin_x * bin_y)
+ *
+ */
+#define ORCA_BIN_MAX_PIXELS 16384
+
+/**
+ * @brief Binning operation
+ *
+ */
+typedef enum _ORCA_BIN_OP
+{
+    ORCA_BIN_SUM  = 0, //!< Sum of the binned pixels (output is MONO16, saturated at 65535)
+    ORCA_BIN_MEAN = 1, //!< Rounded mean of the binned pixels (output has the input pixel format)
+} ORCA_BIN_OP;
+
+/**
+ * @brief Software binning stage handle
+ *
+ */
+typedef struct _ORCA_BINNER *ORCA_BINNER;
+
+/**
+ * @brief Get the size of the output of a binning operation.
+ *
+ * Trailing columns and rows that do not fill a complete bin are dropped.
+ *
+ * @param src Source frame
+ * @param bin_x Horizontal bin size
+ * @param bin_y Vertical bin size
+ * @param op Binning operation
+ * @param dst Output frame. The width, height, format and row stride are filled in, the data pointer is left untouched.
+ * @return size_t Number of bytes required for the output data, 0 if the binning is not supported.
+ */
+size_t orca_bin_output_size(const ORCA_FRAME *_Nonnull src, int32 bin_x, int32 bin_y, ORCA_BIN_OP op, ORCA_FRAME *_Nonnull dst);
+
+/**
+ * @brief Bin a MONO8 or MONO16 frame.
+ *
+ * The source row stride is honored. 2x2 binning uses a dedicated SIMD kernel,
+ * other bin sizes accumulate rows with SIMD widening adds and reduce columns
+ * afterwards.
+ *
+ * @param src Source frame
+ * @param bin_x Horizontal bin size
+ * @param bin_y Vertical bin size
+ * @param op Binning operation
+ * @param dst Output frame. Must point to a buffer of at least orca_bin_output_size() bytes. The frame information is filled in.
+ * @return DCAMERR
+ */
+DCAMERR orca_bin_frame(const ORCA_FRAME *_Nonnull src, int32 bin_x, int32 bin_y, ORCA_BIN_OP op, ORCA_FRAME *_Nonnull dst);
+
+/**
+ * @brief Create a binning stage.
+ *
+ * The stage bins every frame of the capture pipeline into its own buffer and
+ * passes the reduced frame to the secondary stream callback. The primary frame
+ * is neither modified nor copied. The binned frame carries the sweep, history,
+ * trigger and capture metadata of the primary frame; the sparse and spot
+ * metadata, positioned in the primary frame, are not passed on.
+ *
+ * @param binner Output binning stage handle
+ * @param bin_x Horizontal bin size
+ * @param bin_y Vertical bin size
+ * @param op Binning operation
+ * @param cb Secondary stream callback, receives the binned frame
+ * @param user_data User data pointer for the secondary stream callback
+ * @param sz_user_data Size of user data
+ * @return DCAMERR
+ */
+DCAMERR orca_binner_create(ORCA_BINNER *_Nonnull binner, int32 bin_x, int32 bin_y, ORCA_BIN_OP op, OrcaFrameCallback _Nonnull cb, void *_Nullable user_data, size_t sz_user_data);
+
+/**
+ * @brief Binning stage function. Add to the camera using orca_add_stage(cam, orca_bin_stage, binner, sizeof(binner)).
+ *
+ * @param frame Frame data
+ * @param binner ORCA_BINNER handle
+ * @param sz_binner Unused
+ */
+void orca_bin_stage(ORCA_FRAME *_Nonnull frame, void *_Nullable binner, size_t sz_binner);
+
+/**
+ * @brief Destroy a binning stage. The stage must not be in use by a capturing camera.
+ *
+ * @param binner Binning stage handle
+ */
+void orca_binner_destroy(ORCA_BINNER *_Nonnull binner);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // _ORCACAM_BIN_H_
@@ -0,0 +1,135 @@
+/**
+ * @file orcacam_defect.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Host-side hot/defect pixel map and correction
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_DEFECT_H_
+#define _ORCACAM_DEFECT_H_
+
+#include <stdint.h>
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Defect pixel map handle
+ *
+ */
+typedef struct _ORCA_DEFECT_MAP *ORCA_DEFECT_MAP;
+
+/**
+ * @brief Create an empty defect pixel map for a camera.
+ *
+ * @param map Output defect map handle
+ * @param camera_id Camera ID (ORCA_CAM_INFO::id)
+ * @param width Sensor width
+ * @param height Sensor height
+ * @return DCAMERR
+ */
+DCAMERR orca_defect_create(ORCA_DEFECT_MAP *_Nonnull map, const char *_Nonnull camera_id, int32 width, int32 height);
+
+/**
+ * @brief Accumulate per-pixel statistics of a dark MONO8 or MONO16 frame.
+ *
+ * @param map Defect map handle
+ * @param dark Dark frame, the size of the map
+ * @return DCAMERR
+ */
+DCAMERR orca_defect_learn(ORCA_DEFECT_MAP map, const ORCA_FRAME *_Nonnull dark);
+
+/**
+ * @brief Classify the defect pixels from the learned dark frames, and release the statistics.
+ *
+ * A pixel is hot if its mean dark level exceeds the median over the sensor by
+ * more than hot_sigma robust standard deviations (1.4826 MAD), and noisy if
+ * its temporal standard deviation exceeds the median by more than
+ * noisy_sigma robust standard deviations (requires at least 2 dark frames).
+ * The pixels are added to the existing map.
+ *
+ * @param map Defect map handle
+ * @param hot_sigma Hot pixel threshold, <= 0 to disable
+ * @param noisy_sigma Noisy pixel threshold, <= 0 to disable
+ * @return DCAMERR DCAMERR_NOTREADY if no dark frame was learned
+ */
+DCAMERR orca_defect_build(ORCA_DEFECT_MAP map, double hot_sigma, double noisy_sigma);
+
+/**
+ * @brief Mark a pixel as defective.
+ *
+ * @param map Defect map handle
+ * @param x Column
+ * @param y Row
+ * @return DCAMERR
+ */
+DCAMERR orca_defect_add(ORCA_DEFECT_MAP map, int32 x, int32 y);
+
+/**
+ * @brief Get the number of defect pixels.
+ *
+ * @param map Defect map handle
+ * @return size_t Number of defect pixels
+ */
+size_t orca_defect_count(ORCA_DEFECT_MAP map);
+
+/**
+ * @brief Replace every defect pixel of a frame with the (lower) median of its non-defective 3x3 neighbours.
+ *
+ * The neighbour lists are precomputed, so the cost is proportional to the
+ * number of defects. Medians are computed 8 defects at a time with a SIMD
+ * sorting network. Frames whose size differs from the map are not corrected.
+ *
+ * @param map Defect map handle
+ * @param frame MONO8 or MONO16 frame, corrected in place
+ * @return DCAMERR
+ */
+DCAMERR orca_defect_correct(ORCA_DEFECT_MAP map, ORCA_FRAME *_Nonnull frame);
+
+/**
+ * @brief Defect correction stage function. Add to the camera using orca_add_stage(cam, orca_defect_stage, map, sizeof(map)).
+ *
+ * @param frame Frame data
+ * @param map ORCA_DEFECT_MAP handle
+ * @param sz_map Unused
+ */
+void orca_defect_stage(ORCA_FRAME *_Nonnull frame, void *_Nullable map, size_t sz_map);
+
+/**
+ * @brief Save the defect map to <dir>/orcacam_defects_<camera ID>.bin.
+ *
+ * @param map Defect map handle
+ * @param dir Directory
+ * @return DCAMERR
+ */
+DCAMERR orca_defect_save(ORCA_DEFECT_MAP map, const char *_Nonnull dir);
+
+/**
+ * @brief Load the defect map of a camera from <dir>/orcacam_defects_<camera ID>.bin.
+ *
+ * @param map Output defect map handle
+ * @param dir Directory
+ * @param camera_id Camera ID (ORCA_CAM_INFO::id)
+ * @return DCAMERR DCAMERR_NOTSUPPORT if no map is stored for the camera, DCAMERR_INVALIDPARAM if the stored map belongs to another camera
+ */
+DCAMERR orca_defect_load(ORCA_DEFECT_MAP *_Nonnull map, const char *_Nonnull dir, const char *_Nonnull camera_id);
+
+/**
+ * @brief Destroy a defect map. The map must not be in use by a capturing camera.
+ *
+ * @param map Defect map handle
+ */
+void orca_defect_destroy(ORCA_DEFECT_MAP *_Nonnull map);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // _ORCACAM_DEFECT_H_
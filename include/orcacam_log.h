@@ -0,0 +1,119 @@
+/**
+ * @file orcacam_log.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Asynchronous, rate-limited error logging
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_LOG_H_
+#define _ORCACAM_LOG_H_
+
+#include <stdint.h>
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#define ORCA_LOG_MESSAGE_LEN 160 //!< Longest message, including the terminating null
+#define ORCA_LOG_QUEUE_LEN 256   //!< Number of records waiting for the sink; more are dropped
+
+#define ORCA_LOG_DEFAULT_BURST 10       //!< Default number of records per call site and interval
+#define ORCA_LOG_DEFAULT_INTERVAL 1000  //!< Default rate limiting interval (ms)
+
+/**
+ * @brief Log severity
+ *
+ */
+typedef enum _ORCA_LOG_LEVEL
+{
+    ORCA_LOG_DEBUG = 0, //!< Expected failures, e.g. a wait aborted by orca_stop_capture
+    ORCA_LOG_INFO,      //!< Informational
+    ORCA_LOG_WARNING,   //!< Recoverable failures, e.g. a frame wait timeout
+    ORCA_LOG_ERROR,     //!< Failed driver calls
+    ORCA_LOG_NONE,      //!< Disable logging
+} ORCA_LOG_LEVEL;
+
+/**
+ * @brief Log record
+ *
+ */
+typedef struct _ORCA_LOG_RECORD
+{
+    uint64_t timestamp_ns;              //!< CLOCK_REALTIME time of the event (ns)
+    int32 level;                        //!< ORCA_LOG_LEVEL
+    DCAMERR err;                        //!< DCAMERR of a failed call, DCAMERR_SUCCESS otherwise
+    const char *file;                   //!< Source file of the call site
+    const char *func;                   //!< Function of the call site
+    int32 line;                         //!< Line of the call site
+    uint32_t tid;                       //!< Thread ID
+    uint32_t suppressed;                //!< Records of this call site suppressed by rate limiting since its previous record
+    char message[ORCA_LOG_MESSAGE_LEN]; //!< Message
+} ORCA_LOG_RECORD;
+
+/**
+ * @brief Log sink, called on the logger thread.
+ *
+ * @param record Log record, valid for the duration of the call
+ * @param user_data User data
+ */
+typedef void (*OrcaLogCallback)(const ORCA_LOG_RECORD *record, void *user_data);
+
+/**
+ * @brief Set the log sink. The default sink writes to stderr.
+ *
+ * Records are queued without locks by the calling thread, and passed to the
+ * sink by a logger thread, so a slow sink never stalls the capture thread.
+ * Returns once the previous sink is no longer called.
+ *
+ * @param cb Sink, NULL for the default sink
+ * @param user_data User data passed to the sink
+ */
+void orca_log_set_sink(OrcaLogCallback _Nullable cb, void *_Nullable user_data);
+
+/**
+ * @brief Set the lowest severity logged. The default is ORCA_LOG_WARNING.
+ *
+ * @param level ORCA_LOG_LEVEL, ORCA_LOG_NONE disables logging
+ */
+void orca_log_set_level(ORCA_LOG_LEVEL level);
+
+/**
+ * @brief Get the lowest severity logged.
+ *
+ * @return ORCA_LOG_LEVEL
+ */
+ORCA_LOG_LEVEL orca_log_get_level(void);
+
+/**
+ * @brief Set the rate limit of each call site: at most burst records per
+ * interval. Suppressed records are counted in the next record of the site.
+ *
+ * @param burst Number of records per interval, 0 for no limit
+ * @param interval_ms Interval (ms)
+ */
+void orca_log_set_rate(uint32_t burst, uint32_t interval_ms);
+
+/**
+ * @brief Wait until the records queued so far have been passed to the sink.
+ *
+ */
+void orca_log_flush(void);
+
+/**
+ * @brief Get the number of records dropped as the queue was full.
+ *
+ * @return uint64_t Number of records
+ */
+uint64_t orca_log_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // _ORCACAM_LOG_H_
@@ -0,0 +1,80 @@
+/**
+ * @file orcacam_metrics.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief OpenMetrics exporter of the camera and capture metrics
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_METRICS_H_
+#define _ORCACAM_METRICS_H_
+
+#include <stddef.h>
+#include "orcacam.h"
+#include "orcacam_stats.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#define ORCA_METRICS_DEFAULT_PORT 9464 //!< Default TCP port of the exporter
+
+/**
+ * @brief Metrics exporter handle
+ *
+ */
+typedef struct _ORCA_METRICS *ORCA_METRICS;
+
+/**
+ * @brief Serve the metrics of a camera as OpenMetrics text over HTTP.
+ *
+ * The exporter answers GET /metrics on a TCP port or a Unix domain socket,
+ * e.g. `curl http://127.0.0.1:9464/metrics` or
+ * `curl --unix-socket /tmp/orcacam.sock http://localhost/metrics`.
+ * It serves:
+ * - the frame, drop, timeout and error counters, and the frame rate since
+ *   the previous scrape,
+ * - the frames of the ring waiting for delivery, and the ring size,
+ * - the sensor temperature and the cooler status,
+ * - quantiles of the capture latencies of orca_get_stats.
+ *
+ * Requests are served one at a time by a SCHED_OTHER thread at nice 19,
+ * which only reads the relaxed statistics counters and the camera
+ * properties, and never waits on the capture thread. It is not run at
+ * SCHED_IDLE, as the property reads share a lock with the capture path.
+ *
+ * @param metrics Output exporter handle
+ * @param cam Camera handle
+ * @param address Unix socket path if it contains a '/', else "[host:]port"
+ * with an IPv4 host, 127.0.0.1 by default
+ * @return DCAMERR DCAMERR_BUSY if an exporter is running on the socket path, DCAMERR_INVALIDPARAM if the path exists and is not a socket
+ */
+DCAMERR orca_metrics_create(ORCA_METRICS *_Nonnull metrics, ORCACAM cam, const char *_Nonnull address);
+
+/**
+ * @brief Format the metrics of a camera as OpenMetrics text.
+ *
+ * @param metrics Exporter handle
+ * @param buf Output buffer
+ * @param size Size of the buffer
+ * @return size_t Length of the text, larger than or equal to size if the
+ * buffer is too small
+ */
+size_t orca_metrics_format(ORCA_METRICS metrics, char *_Nonnull buf, size_t size);
+
+/**
+ * @brief Stop the exporter and close its socket.
+ *
+ * @param metrics Exporter handle, set to NULL
+ */
+void orca_metrics_destroy(ORCA_METRICS *_Nonnull metrics);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // _ORCACAM_METRICS_H_
@@ -0,0 +1,181 @@
+/**
+ * @file orcacam_pipe.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Tile-parallel frame pipelines on a work-stealing thread pool
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_PIPE_H_
+#define _ORCACAM_PIPE_H_
+
+#include <stdint.h>
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#define ORCA_PIPE_MAX_THREADS 64       //!< Maximum number of worker threads
+#define ORCA_PIPE_MAX_KERNELS 8        //!< Maximum number of kernels of a pipeline
+#define ORCA_PIPE_DEFAULT_TILE_ROWS 64 //!< Default number of rows of a tile
+#define ORCA_PIPE_DEFAULT_FRAMES 4     //!< Default number of frames in flight
+
+/**
+ * @brief Tile of a frame, passed to the kernels
+ *
+ */
+typedef struct _ORCA_TILE
+{
+    ORCA_FRAME *_Nonnull frame; //!< Frame, shared by its tiles; kernels may modify their rows in place
+    int32 y0;                   //!< First row
+    int32 y1;                   //!< One past the last row
+    int32 index;                //!< Tile index, from the top
+    int32 count;                //!< Number of tiles of the frame
+    int32 slot;                 //!< Frame slot, from 0 to max_frames - 1, for per-frame kernel state
+    uint64_t seq;               //!< Frame number in the pipeline, from 0
+} ORCA_TILE;
+
+/**
+ * @brief Tile kernel, called on a worker thread. The kernels of a pipeline
+ * run in order on every tile; tiles of the same frame run concurrently.
+ *
+ * @param tile Tile
+ * @param user_data User data of the kernel
+ */
+typedef void (*OrcaTileKernel)(const ORCA_TILE *_Nonnull tile, void *_Nullable user_data);
+
+/**
+ * @brief Pipeline configuration
+ *
+ */
+typedef struct _ORCA_PIPE_CONFIG
+{
+    int32 num_threads;             //!< Number of worker threads, 0 for the online CPUs
+    int32 tile_rows;               //!< Rows per tile, 0 for ORCA_PIPE_DEFAULT_TILE_ROWS
+    int32 max_frames;              //!< Frames in flight, 0 for ORCA_PIPE_DEFAULT_FRAMES. Keep below the ring size less 2 when processing ring frames.
+    OrcaFrameCallback _Nullable output; //!< Called with every processed frame, in submission order, on a worker thread. Must not submit to the same pipeline.
+    void *_Nullable user_data;     //!< User data of the output callback
+    size_t sz_user_data;           //!< Size of the user data
+} ORCA_PIPE_CONFIG;
+
+/**
+ * @brief Pipeline statistics
+ *
+ */
+typedef struct _ORCA_PIPE_STATS
+{
+    uint64_t frames; //!< Frames output
+    uint64_t tiles;  //!< Tiles processed
+    uint64_t steals; //!< Tile ranges stolen by idle workers
+    uint64_t waits;  //!< Submissions that waited for a free frame slot
+} ORCA_PIPE_STATS;
+
+/**
+ * @brief Pipeline handle
+ *
+ */
+typedef struct _ORCA_PIPE *ORCA_PIPE;
+
+/**
+ * @brief Create a pipeline.
+ *
+ * Every submitted frame is split into horizontal tiles, dealt as
+ * contiguous ranges to the deques of the workers. A worker takes tiles
+ * from the oldest range of its deque, and steals half of the oldest range
+ * of another worker when its deque is empty. The worker finishing the last
+ * tile of a frame outputs the frames completed so far, in order, so frames
+ * finishing early wait for the ones before them.
+ *
+ * @param pipe Output pipeline handle
+ * @param config Configuration
+ * @return DCAMERR
+ */
+DCAMERR orca_pipe_create(ORCA_PIPE *_Nonnull pipe, const ORCA_PIPE_CONFIG *_Nonnull config);
+
+/**
+ * @brief Append a kernel to a pipeline, before the first frame is submitted.
+ *
+ * @param pipe Pipeline handle
+ * @param kernel Tile kernel
+ * @param user_data User data of the kernel
+ * @return DCAMERR DCAMERR_NORESOURCE beyond ORCA_PIPE_MAX_KERNELS kernels, DCAMERR_BUSY once frames were submitted
+ */
+DCAMERR orca_pipe_add_kernel(ORCA_PIPE pipe, OrcaTileKernel _Nonnull kernel, void *_Nullable user_data);
+
+/**
+ * @brief Submit a frame. Waits while max_frames frames are in flight.
+ *
+ * The frame data must stay valid until the frame is output. The frame
+ * metadata is not kept, as stages only keep it until the next frame.
+ *
+ * @param pipe Pipeline handle
+ * @param frame Frame
+ * @return DCAMERR
+ */
+DCAMERR orca_pipe_submit(ORCA_PIPE pipe, const ORCA_FRAME *_Nonnull frame);
+
+/**
+ * @brief Pipeline frame callback. Start a capture with orca_start_capture(cam, orca_pipe_frame, pipe, sizeof(pipe)) to process its frames, or add it as the last stage of a camera.
+ *
+ * @param frame Frame
+ * @param pipe ORCA_PIPE handle
+ * @param sz_pipe Unused
+ */
+void orca_pipe_frame(ORCA_FRAME *_Nonnull frame, void *_Nullable pipe, size_t sz_pipe);
+
+/**
+ * @brief Wait until the submitted frames are output.
+ *
+ * @param pipe Pipeline handle
+ */
+void orca_pipe_flush(ORCA_PIPE pipe);
+
+/**
+ * @brief Get the statistics of a pipeline.
+ *
+ * @param pipe Pipeline handle
+ * @param stats Output statistics
+ */
+void orca_pipe_get_stats(ORCA_PIPE pipe, ORCA_PIPE_STATS *_Nonnull stats);
+
+/**
+ * @brief Flush a pipeline, stop its workers and free it.
+ *
+ * @param pipe Pipeline handle
+ */
+void orca_pipe_destroy(ORCA_PIPE *_Nonnull pipe);
+
+/**
+ * @brief Dark offset and gain correction maps, for orca_tile_flatfield
+ *
+ */
+typedef struct _ORCA_FLATFIELD
+{
+    int32 width;                     //!< Map width
+    int32 height;                    //!< Map height
+    const uint16_t *_Nullable dark;  //!< width x height dark offsets, NULL for none
+    const float *_Nullable gain;     //!< width x height gains below 32768, NULL for none
+} ORCA_FLATFIELD;
+
+/**
+ * @brief Built-in kernel correcting MONO16 tiles in place:
+ * (pixel - dark) * gain, clamped to 0-65535. Tiles of frames of another
+ * format or size are left unchanged. Add with
+ * orca_pipe_add_kernel(pipe, orca_tile_flatfield, &flatfield).
+ *
+ * @param tile Tile
+ * @param flatfield ORCA_FLATFIELD
+ */
+void orca_tile_flatfield(const ORCA_TILE *_Nonnull tile, void *_Nullable flatfield);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // _ORCACAM_PIPE_H_
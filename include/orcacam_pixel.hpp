@@ -0,0 +1,451 @@
+/**
+ * @file orcacam_pixel.hpp
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Compile-time pixel format traits and frame processing kernels
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * orca::dispatch() turns the DCAM_PIXELTYPE of a frame into a PixelTraits
+ * type once per frame, so that kernels are instantiated per format with
+ * inner loops free of format checks.
+ *
+ */
+
+#ifndef _ORCACAM_PIXEL_HPP_
+#define _ORCACAM_PIXEL_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "orcacam.hpp"
+
+namespace orca
+{
+
+namespace detail
+{
+template <DCAM_PIXELTYPE Fmt, typename T, int Channels, int Bits,
+          bool Packed = false, int Red = 0>
+struct PixelLayout
+{
+    using sample_type = T;                          //!< Type of a sample, unpacked
+    static constexpr DCAM_PIXELTYPE fmt = Fmt;      //!< Pixel format
+    static constexpr int channels       = Channels; //!< Samples per pixel
+    static constexpr int bits           = Bits;     //!< Significant bits per sample
+    static constexpr bool packed        = Packed;   //!< Two pixels in three bytes
+    static constexpr bool msb_first     = Fmt == DCAM_PIXELTYPE_MONO12; //!< Packed high bits first
+    static constexpr int red            = Red;      //!< Channel of red, for color formats
+    static constexpr uint32_t max_value = (1u << Bits) - 1; //!< Largest sample value
+    static constexpr int32 block        = 64;       //!< Pixels processed at a time by the kernels
+
+    /**
+     * @brief Get the number of bytes of the pixels of a row.
+     *
+     * @param width Pixels
+     * @return size_t Bytes
+     */
+    static constexpr size_t row_bytes(int32 width) noexcept
+    {
+        return Packed ? ((size_t)width * 3 + 1) / 2
+                      : (size_t)width * Channels * sizeof(T);
+    }
+
+    /**
+     * @brief Get the samples of consecutive pixels of a row, interleaved.
+     * Only packed rows are copied.
+     *
+     * @param row First byte of the row
+     * @param x First pixel, even
+     * @param n Pixels, at most block
+     * @param buf block x channels samples
+     * @return const T* n x channels samples
+     */
+    static const T *samples(const char *row, int32 x, int32 n,
+                            T *buf) noexcept
+    {
+        if constexpr (Packed)
+        {
+            const uint8_t *p =
+                reinterpret_cast<const uint8_t *>(row) + (size_t)(x >> 1) * 3;
+            for (int32 i = 0; i < n / 2; i++, p += 3)
+            {
+                buf[2 * i]     = first(p);
+                buf[2 * i + 1] = second(p);
+            }
+            if (n & 1)
+            {
+                buf[n - 1] = first(p);
+            }
+            return buf;
+        }
+        else
+        {
+            (void)n;
+            (void)buf;
+            return reinterpret_cast<const T *>(row) + (size_t)x * Channels;
+        }
+    }
+
+  private:
+    // The two pixels of three packed bytes. The middle byte holds the low
+    // bits of both, MONO12 puts the high bits of the first pixel in the first
+    // byte, MONO12P its low bits.
+    static T first(const uint8_t *p) noexcept
+    {
+        return msb_first ? (T)((p[0] << 4) | (p[1] & 0xf))
+                         : (T)(p[0] | ((p[1] & 0xf) << 8));
+    }
+
+    static T second(const uint8_t *p) noexcept
+    {
+        return (T)((p[1] >> 4) | (p[2] << 4));
+    }
+};
+} // namespace detail
+
+/**
+ * @brief Layout of a pixel format, known at compile time
+ *
+ * @tparam Fmt DCAM_PIXELTYPE
+ */
+template <DCAM_PIXELTYPE Fmt> struct PixelTraits;
+
+/// 8 bits per pixel
+template <>
+struct PixelTraits<DCAM_PIXELTYPE_MONO8>
+    : detail::PixelLayout<DCAM_PIXELTYPE_MONO8, uint8_t, 1, 8>
+{
+};
+
+/// 16 bits per pixel
+template <>
+struct PixelTraits<DCAM_PIXELTYPE_MONO16>
+    : detail::PixelLayout<DCAM_PIXELTYPE_MONO16, uint16_t, 1, 16>
+{
+};
+
+/// 12 bits per pixel, two pixels in three bytes, high bits first
+template <>
+struct PixelTraits<DCAM_PIXELTYPE_MONO12>
+    : detail::PixelLayout<DCAM_PIXELTYPE_MONO12, uint16_t, 1, 12, true>
+{
+};
+
+/// 12 bits per pixel, two pixels in three bytes, low bits first
+template <>
+struct PixelTraits<DCAM_PIXELTYPE_MONO12P>
+    : detail::PixelLayout<DCAM_PIXELTYPE_MONO12P, uint16_t, 1, 12, true>
+{
+};
+
+/// 8 bits per channel, red first
+template <>
+struct PixelTraits<DCAM_PIXELTYPE_RGB24>
+    : detail::PixelLayout<DCAM_PIXELTYPE_RGB24, uint8_t, 3, 8>
+{
+};
+
+/// 16 bits per channel, red first
+template <>
+struct PixelTraits<DCAM_PIXELTYPE_RGB48>
+    : detail::PixelLayout<DCAM_PIXELTYPE_RGB48, uint16_t, 3, 16>
+{
+};
+
+/// 8 bits per channel, blue first
+template <>
+struct PixelTraits<DCAM_PIXELTYPE_BGR24>
+    : detail::PixelLayout<DCAM_PIXELTYPE_BGR24, uint8_t, 3, 8, false, 2>
+{
+};
+
+/// 16 bits per channel, blue first
+template <>
+struct PixelTraits<DCAM_PIXELTYPE_BGR48>
+    : detail::PixelLayout<DCAM_PIXELTYPE_BGR48, uint16_t, 3, 16, false, 2>
+{
+};
+
+/**
+ * @brief Call f with the PixelTraits of a pixel format.
+ *
+ * f is instantiated for every format, and must return the same type for
+ * all of them.
+ *
+ * @param fmt DCAM_PIXELTYPE
+ * @param f Callable taking a PixelTraits by value, e.g. a generic lambda
+ * @return The result of f
+ * @throws Error DCAMERR_NOTSUPPORT for other formats
+ */
+template <typename F> decltype(auto) dispatch(DCAM_PIXELTYPE fmt, F &&f)
+{
+    switch (fmt)
+    {
+    case DCAM_PIXELTYPE_MONO8:
+        return f(PixelTraits<DCAM_PIXELTYPE_MONO8>());
+    case DCAM_PIXELTYPE_MONO16:
+        return f(PixelTraits<DCAM_PIXELTYPE_MONO16>());
+    case DCAM_PIXELTYPE_MONO12:
+        return f(PixelTraits<DCAM_PIXELTYPE_MONO12>());
+    case DCAM_PIXELTYPE_MONO12P:
+        return f(PixelTraits<DCAM_PIXELTYPE_MONO12P>());
+    case DCAM_PIXELTYPE_RGB24:
+        return f(PixelTraits<DCAM_PIXELTYPE_RGB24>());
+    case DCAM_PIXELTYPE_RGB48:
+        return f(PixelTraits<DCAM_PIXELTYPE_RGB48>());
+    case DCAM_PIXELTYPE_BGR24:
+        return f(PixelTraits<DCAM_PIXELTYPE_BGR24>());
+    case DCAM_PIXELTYPE_BGR48:
+        return f(PixelTraits<DCAM_PIXELTYPE_BGR48>());
+    default:
+        throw Error(DCAMERR_NOTSUPPORT, "orca::dispatch");
+    }
+}
+
+/**
+ * @brief Sample statistics of a frame
+ *
+ */
+struct PixelStats
+{
+    uint64_t sum;    //!< Sum of the samples
+    uint32_t min;    //!< Smallest sample
+    uint32_t max;    //!< Largest sample
+    uint64_t count;  //!< Number of samples
+    uint32_t bits;   //!< Significant bits per sample
+
+    double mean() const noexcept
+    {
+        return count ? (double)sum / count : 0;
+    }
+};
+
+/**
+ * @brief Get the statistics of the samples of a frame, all channels
+ * together.
+ *
+ * @tparam P PixelTraits of the frame
+ * @param frame Frame
+ * @return PixelStats
+ */
+template <typename P> PixelStats stats(FrameView frame, P = P()) noexcept
+{
+    using T        = typename P::sample_type;
+    PixelStats s   = {0, std::numeric_limits<T>::max(), 0, 0,
+                      (uint32_t)P::bits};
+    T buf[P::block * P::channels];
+    // a full block has a constant trip count, which -O2 vectorizes
+    auto reduce = [&](const T *v, int32 count) {
+        uint32_t sum = 0;
+        T lo = std::numeric_limits<T>::max(), hi = 0;
+        for (int32 i = 0; i < count; i++)
+        {
+            sum += v[i];
+            lo = std::min(lo, v[i]);
+            hi = std::max(hi, v[i]);
+        }
+        s.sum += sum;
+        s.min = std::min(s.min, (uint32_t)lo);
+        s.max = std::max(s.max, (uint32_t)hi);
+    };
+    for (int32 y = 0; y < frame.height(); y++)
+    {
+        const char *row = frame.data() + (size_t)y * frame.row_stride();
+        for (int32 x = 0; x < frame.width(); x += P::block)
+        {
+            int32 n    = std::min(P::block, frame.width() - x);
+            const T *v = P::samples(row, x, n, buf);
+            if (n == P::block)
+            {
+                reduce(v, P::block * P::channels);
+            }
+            else
+            {
+                reduce(v, n * P::channels);
+            }
+        }
+    }
+    s.count = (uint64_t)frame.width() * frame.height() * P::channels;
+    return s;
+}
+
+/**
+ * @brief Get the statistics of the samples of a frame of any format.
+ *
+ * @param frame Frame
+ * @return PixelStats
+ * @throws Error DCAMERR_NOTSUPPORT for unknown formats
+ */
+inline PixelStats stats(FrameView frame)
+{
+    return dispatch(frame.fmt(),
+                    [&](auto p) { return stats<decltype(p)>(frame); });
+}
+
+namespace detail
+{
+// Factor is 0 when only known at run time
+template <typename P, int32 Factor>
+void bin_rows(FrameView frame, int32 factor, uint32_t *dst) noexcept
+{
+    using T             = typename P::sample_type;
+    constexpr int C     = P::channels;
+    const int32 f       = Factor ? Factor : factor;
+    const int32 bw      = frame.width() / f, bh = frame.height() / f;
+    const int32 w       = bw * f;
+    std::fill(dst, dst + (size_t)bw * bh * C, 0u);
+    T buf[P::block * C];
+    for (int32 y = 0; y < bh * f; y++)
+    {
+        const char *row = frame.data() + (size_t)y * frame.row_stride();
+        uint32_t *out   = dst + (size_t)(y / f) * bw * C;
+        for (int32 x = 0; x < w; x += P::block)
+        {
+            int32 n    = std::min(P::block, w - x);
+            const T *v = P::samples(row, x, n, buf);
+            if constexpr (Factor != 0)
+            {
+                static_assert(P::block % Factor == 0,
+                              "blocks hold whole bins");
+                if (n == P::block)
+                {
+                    uint32_t *o = out + (size_t)(x / Factor) * C;
+                    for (int32 j = 0; j < P::block / Factor; j++)
+                    {
+                        for (int c = 0; c < C; c++)
+                        {
+                            uint32_t acc = 0;
+                            for (int32 i = 0; i < Factor; i++)
+                            {
+                                acc += v[(j * Factor + i) * C + c];
+                            }
+                            o[j * C + c] += acc;
+                        }
+                    }
+                    continue;
+                }
+            }
+            for (int32 i = 0; i < n; i++)
+            {
+                for (int c = 0; c < C; c++)
+                {
+                    out[(size_t)((x + i) / f) * C + c] += v[i * C + c];
+                }
+            }
+        }
+    }
+}
+} // namespace detail
+
+/**
+ * @brief Sum blocks of factor x factor pixels, per channel. Pixels beyond
+ * the last full block are dropped. Factors of 2, 4 and 8 are unrolled.
+ *
+ * @tparam P PixelTraits of the frame
+ * @param frame Frame
+ * @param factor Block size
+ * @param dst (width / factor) x (height / factor) x channels sums, pixels
+ * interleaved
+ */
+template <typename P>
+void bin(FrameView frame, int32 factor, uint32_t *dst, P = P()) noexcept
+{
+    switch (factor)
+    {
+    case 2:
+        detail::bin_rows<P, 2>(frame, factor, dst);
+        break;
+    case 4:
+        detail::bin_rows<P, 4>(frame, factor, dst);
+        break;
+    case 8:
+        detail::bin_rows<P, 8>(frame, factor, dst);
+        break;
+    default:
+        detail::bin_rows<P, 0>(frame, factor, dst);
+        break;
+    }
+}
+
+/**
+ * @brief Bin a frame of any format.
+ *
+ * @throws Error DCAMERR_NOTSUPPORT for unknown formats
+ */
+inline void bin(FrameView frame, int32 factor, uint32_t *dst)
+{
+    dispatch(frame.fmt(),
+             [&](auto p) { bin<decltype(p)>(frame, factor, dst); });
+}
+
+/**
+ * @brief Convert a frame to 16-bit monochrome, keeping sample values.
+ * Color pixels become (r + 2g + b) / 4.
+ *
+ * @tparam P PixelTraits of the frame
+ * @param frame Frame
+ * @param dst width x height pixels
+ * @param dst_stride Bytes between rows of dst
+ */
+template <typename P>
+void to_mono16(FrameView frame, uint16_t *dst, size_t dst_stride,
+               P = P()) noexcept
+{
+    using T = typename P::sample_type;
+    T buf[P::block * P::channels];
+    auto convert = [](const T *v, uint16_t *out, int32 count) {
+        for (int32 i = 0; i < count; i++)
+        {
+            if constexpr (P::channels == 1)
+            {
+                out[i] = v[i];
+            }
+            else
+            {
+                const T *px = v + i * 3;
+                out[i]      = (uint16_t)(((uint32_t)px[P::red] + 2 * px[1] +
+                                     px[2 - P::red]) >> 2);
+            }
+        }
+    };
+    for (int32 y = 0; y < frame.height(); y++)
+    {
+        const char *row = frame.data() + (size_t)y * frame.row_stride();
+        uint16_t *out   = reinterpret_cast<uint16_t *>(
+            reinterpret_cast<char *>(dst) + (size_t)y * dst_stride);
+        for (int32 x = 0; x < frame.width(); x += P::block)
+        {
+            int32 n    = std::min(P::block, frame.width() - x);
+            const T *v = P::samples(row, x, n, buf);
+            if (n == P::block)
+            {
+                convert(v, out + x, P::block);
+            }
+            else
+            {
+                convert(v, out + x, n);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Convert a frame of any format to 16-bit monochrome.
+ *
+ * @throws Error DCAMERR_NOTSUPPORT for unknown formats
+ */
+inline void to_mono16(FrameView frame, uint16_t *dst, size_t dst_stride)
+{
+    dispatch(frame.fmt(), [&](auto p) {
+        to_mono16<decltype(p)>(frame, dst, dst_stride);
+    });
+}
+
+} // namespace orca
+
+#endif // _ORCACAM_PIXEL_HPP_
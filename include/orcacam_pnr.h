@@ -0,0 +1,128 @@
+/**
+ * @file orcacam_pnr.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Photon counting accumulation for photon number resolving (PNR) frames
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_PNR_H_
+#define _ORCACAM_PNR_H_
+
+#include <stdint.h>
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Photon counting mode
+ *
+ */
+typedef enum _ORCA_PNR_MODE
+{
+    ORCA_PNR_COUNT   = 0, //!< Accumulate the photon number of every pixel at or above the threshold
+    ORCA_PNR_EVENT   = 1, //!< Count one event for every pixel at or above the threshold
+    ORCA_PNR_CLUSTER = 2, //!< Count one event per cluster, at the local maximum (3x3) at or above the threshold. Border pixels are ignored.
+} ORCA_PNR_MODE;
+
+/**
+ * @brief Photon counting snapshot callback
+ *
+ * @param image Accumulated image (width x height, row stride = width)
+ * @param width Image width
+ * @param height Image height
+ * @param frames Number of accumulated frames
+ * @param user_data Pointer to user data
+ */
+typedef void (*OrcaPnrSnapshotCallback)(const uint32_t *_Nonnull, int32, int32, uint64_t, void *_Nullable);
+
+/**
+ * @brief Photon counting configuration
+ *
+ */
+typedef struct _ORCA_PNR_CONFIG
+{
+    ORCA_PNR_MODE mode;                         //!< Counting mode
+    int32 threshold;                            //!< Minimum pixel value that is counted (0 or 1 counts every photon)
+    int32 num_threads;                          //!< Number of threads processing horizontal tiles, including the capture thread
+    int32 snapshot_interval;                    //!< Number of frames between snapshots, 0 to disable
+    OrcaPnrSnapshotCallback _Nullable snapshot; //!< Snapshot callback
+    void *_Nullable user_data;                  //!< User data pointer for the snapshot callback
+} ORCA_PNR_CONFIG;
+
+/**
+ * @brief Photon counting engine handle
+ *
+ */
+typedef struct _ORCA_PNR *ORCA_PNR;
+
+/**
+ * @brief Create a photon counting engine.
+ *
+ * Frames are summed into a 16-bit staging accumulator with SIMD widening adds,
+ * which is flushed into the 32-bit accumulator before it can overflow. The
+ * accumulator is sized on the first frame, and reset if the frame geometry
+ * changes.
+ *
+ * @param pnr Output photon counting engine handle
+ * @param config Configuration
+ * @return DCAMERR
+ */
+DCAMERR orca_pnr_create(ORCA_PNR *_Nonnull pnr, const ORCA_PNR_CONFIG *_Nonnull config);
+
+/**
+ * @brief Accumulate a MONO8 frame.
+ *
+ * @param pnr Photon counting engine handle
+ * @param frame Frame
+ * @return DCAMERR
+ */
+DCAMERR orca_pnr_accumulate(ORCA_PNR pnr, const ORCA_FRAME *_Nonnull frame);
+
+/**
+ * @brief Photon counting stage function. Add to the camera using orca_add_stage(cam, orca_pnr_stage, pnr, sizeof(pnr)).
+ *
+ * @param frame Frame data
+ * @param pnr ORCA_PNR handle
+ * @param sz_pnr Unused
+ */
+void orca_pnr_stage(ORCA_FRAME *_Nonnull frame, void *_Nullable pnr, size_t sz_pnr);
+
+/**
+ * @brief Copy the accumulated image. Safe to call while the engine is in use by a capturing camera.
+ *
+ * @param pnr Photon counting engine handle
+ * @param image Output image buffer
+ * @param sz_image Size of the output image buffer in bytes
+ * @param width Output image width
+ * @param height Output image height
+ * @param frames Output number of accumulated frames
+ * @return DCAMERR DCAMERR_NOTREADY if no frame has been accumulated, DCAMERR_INVALIDPARAM if the buffer is too small
+ */
+DCAMERR orca_pnr_export(ORCA_PNR pnr, uint32_t *_Nonnull image, size_t sz_image, int32 *_Nonnull width, int32 *_Nonnull height, uint64_t *_Nullable frames);
+
+/**
+ * @brief Clear the accumulated image.
+ *
+ * @param pnr Photon counting engine handle
+ */
+void orca_pnr_reset(ORCA_PNR pnr);
+
+/**
+ * @brief Destroy a photon counting engine. The engine must not be in use by a capturing camera.
+ *
+ * @param pnr Photon counting engine handle
+ */
+void orca_pnr_destroy(ORCA_PNR *_Nonnull pnr);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // _ORCACAM_PNR_H_
@@ -0,0 +1,175 @@
+/**
+ * @file orcacam_server.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Unix domain socket frame server and client
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_SERVER_H_
+#define _ORCACAM_SERVER_H_
+
+#include <stdint.h>
+
+#include "orcacam.h"
+#include "orcacam_shm.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#define ORCA_SERVER_MAX_CLIENTS 16 //!< Maximum number of connected clients
+#define ORCA_SERVER_MAX_SLOTS 512  //!< Maximum number of frames in the server ring
+
+/**
+ * @brief Server message types
+ *
+ */
+typedef enum _ORCA_SERVER_MSG_TYPE
+{
+    ORCA_SERVER_HELLO = 0,    //!< Get the frame ring; the reply carries the ring memfd
+    ORCA_SERVER_SUBSCRIBE,    //!< Start receiving ORCA_SERVER_FRAME messages
+    ORCA_SERVER_UNSUBSCRIBE,  //!< Stop receiving ORCA_SERVER_FRAME messages
+    ORCA_SERVER_START,        //!< Start capturing
+    ORCA_SERVER_STOP,         //!< Stop capturing
+    ORCA_SERVER_GET_EXPOSURE, //!< Get the exposure time (value)
+    ORCA_SERVER_SET_EXPOSURE, //!< orca_set_exposure(value)
+    ORCA_SERVER_SET_ROI,      //!< orca_set_roi(roi[0], roi[1], roi[2], roi[3])
+    ORCA_SERVER_SWITCH_MODE,  //!< orca_switch_mode(value)
+    ORCA_SERVER_FRAME,        //!< Frame notification (server to client)
+} ORCA_SERVER_MSG_TYPE;
+
+/**
+ * @brief Server request, reply and frame notification
+ *
+ * Capture is stopped and restarted around requests that are refused with
+ * DCAMERR_BUSY while capturing (e.g. ORCA_SERVER_SET_ROI).
+ *
+ */
+typedef struct _ORCA_SERVER_MSG
+{
+    int32 type;            //!< ORCA_SERVER_MSG_TYPE
+    int32 status;          //!< Reply: DCAMERR of the request
+    double value;          //!< Exposure time (s) or sensor mode
+    int32 roi[4];          //!< ROI x, y, width, height
+    uint64_t ring_bytes;   //!< HELLO: Size of the frame ring
+    uint64_t slot_bytes;   //!< HELLO: Size of a ring slot
+    int32 num_slots;       //!< HELLO: Number of ring slots
+    int32 rsvd;            //!< Reserved
+    uint64_t index;        //!< FRAME: Frame index
+    uint64_t offset;       //!< FRAME: Offset of the frame data in the ring
+    uint64_t timestamp_ns; //!< FRAME: CLOCK_MONOTONIC time the frame was stored (ns)
+    int32 width;           //!< FRAME: Frame width
+    int32 height;          //!< FRAME: Frame height
+    int32 fmt;             //!< FRAME: Frame pixel format
+    int32 row_stride;      //!< FRAME: Frame row stride (bytes)
+} ORCA_SERVER_MSG;
+
+/**
+ * @brief Frame server handle
+ *
+ */
+typedef struct _ORCA_SERVER *ORCA_SERVER;
+
+/**
+ * @brief Frame server client handle
+ *
+ */
+typedef struct _ORCA_CLIENT *ORCA_CLIENT;
+
+/**
+ * @brief Serve the frames of a camera on a Unix domain socket.
+ *
+ * Frames are copied once into a sealed memfd ring that clients receive with
+ * SCM_RIGHTS and map read-only; ORCA_SERVER_FRAME messages then only carry
+ * the offset and metadata of each frame. Clients that fall behind miss frame
+ * messages instead of stalling the capture. A reply that does not fit in the
+ * socket of a client is sent once the client reads, and the client gets no
+ * frame messages nor has its further requests read until then. A socket
+ * left at path by a server that exited is replaced.
+ *
+ * @param server Output server handle
+ * @param cam Camera handle
+ * @param path Socket path
+ * @param num_slots Number of frames in the ring
+ * @return DCAMERR DCAMERR_BUSY if a server is running on path, DCAMERR_INVALIDPARAM if path exists and is not a socket
+ */
+DCAMERR orca_server_create(ORCA_SERVER *_Nonnull server, ORCACAM cam, const char *_Nonnull path, int32 num_slots);
+
+/**
+ * @brief Start capturing into the server ring.
+ *
+ * @param server Server handle
+ * @return DCAMERR
+ */
+DCAMERR orca_server_start_capture(ORCA_SERVER server);
+
+/**
+ * @brief Stop capturing into the server ring.
+ *
+ * @param server Server handle
+ * @return DCAMERR
+ */
+DCAMERR orca_server_stop_capture(ORCA_SERVER server);
+
+/**
+ * @brief Stop capturing, disconnect the clients and remove the socket.
+ *
+ * @param server Server handle
+ */
+void orca_server_destroy(ORCA_SERVER *_Nonnull server);
+
+/**
+ * @brief Connect to a frame server and map its frame ring.
+ *
+ * @param client Output client handle
+ * @param path Socket path
+ * @return DCAMERR
+ */
+DCAMERR orca_client_connect(ORCA_CLIENT *_Nonnull client, const char *_Nonnull path);
+
+/**
+ * @brief Send a request and wait for its reply.
+ *
+ * Frame messages received while waiting are queued for orca_client_next().
+ *
+ * @param client Client handle
+ * @param msg Request, overwritten with the reply
+ * @return DCAMERR Transport error, or the status of the request
+ */
+DCAMERR orca_client_request(ORCA_CLIENT client, ORCA_SERVER_MSG *_Nonnull msg);
+
+/**
+ * @brief Wait for the next frame and map it without copying. Requires ORCA_SERVER_SUBSCRIBE.
+ *
+ * @param client Client handle
+ * @param frame Output frame, pointing into the server ring
+ * @param info Output frame information (dropped counts missed frame messages)
+ * @param timeout_ms Timeout in milliseconds, negative to wait forever
+ * @return DCAMERR DCAMERR_TIMEOUT on timeout, DCAMERR_ABORT if the server closed
+ */
+DCAMERR orca_client_next(ORCA_CLIENT client, ORCA_FRAME *_Nonnull frame, ORCA_SHM_INFO *_Nullable info, int32 timeout_ms);
+
+/**
+ * @brief Finish reading the frame returned by orca_client_next().
+ *
+ * @param client Client handle
+ * @return DCAMERR DCAMERR_LOSTFRAME if the frame was overwritten while it was read
+ */
+DCAMERR orca_client_release(ORCA_CLIENT client);
+
+/**
+ * @brief Disconnect from a frame server.
+ *
+ * @param client Client handle
+ */
+void orca_client_close(ORCA_CLIENT *_Nonnull client);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // _ORCACAM_SERVER_H_
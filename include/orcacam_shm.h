@@ -0,0 +1,166 @@
+/**
+ * @file orcacam_shm.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Shared-memory frame publisher and subscriber
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_SHM_H_
+#define _ORCACAM_SHM_H_
+
+#include <stdint.h>
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Shared-memory frame publisher handle
+ *
+ */
+typedef struct _ORCA_SHM_PUBLISHER *ORCA_SHM_PUBLISHER;
+
+/**
+ * @brief Shared-memory frame subscriber handle
+ *
+ */
+typedef struct _ORCA_SHM_SUBSCRIBER *ORCA_SHM_SUBSCRIBER;
+
+/**
+ * @brief Information about a frame read from shared memory
+ *
+ */
+typedef struct _ORCA_SHM_INFO
+{
+    uint64_t index;        //!< Publish index of the frame
+    uint64_t timestamp_ns; //!< CLOCK_MONOTONIC time the frame was published (ns)
+    uint64_t dropped;      //!< Frames skipped since the previous read because the subscriber was lapped
+} ORCA_SHM_INFO;
+
+/**
+ * @brief Create a named POSIX shared-memory frame ring and publish frames into it.
+ *
+ * Each slot of the ring carries a seqlock'd header with the frame metadata.
+ * Subscribers are woken through a futex in the shared segment; the futex is
+ * only signaled when a subscriber is waiting. The segment is only accessible
+ * to the user of the publisher. A segment left by a publisher that exited
+ * without orca_shm_destroy() is replaced.
+ *
+ * Published frames are copied into the ring, unless the ring is the frame
+ * buffer ring of the camera (orca_shm_attach()).
+ *
+ * @param pub Output publisher handle
+ * @param name Shared memory object name (e.g. "/orcacam0")
+ * @param max_frame_bytes Largest frame (row stride x height) that will be published
+ * @param num_slots Number of frames in the ring
+ * @return DCAMERR DCAMERR_BUSY if a running publisher uses the name
+ */
+DCAMERR orca_shm_create(ORCA_SHM_PUBLISHER *_Nonnull pub, const char *_Nonnull name, size_t max_frame_bytes, int32 num_slots);
+
+/**
+ * @brief Use the slots of the ring as the frame buffers of the camera (orca_attach_buffers()), so that frames are published without copying them.
+ *
+ * The camera writes into the slots while subscribers may still be reading
+ * them. A frame is reported overwritten by orca_shm_release() as long as
+ * the camera is at most lead frames ahead of the last published frame;
+ * subscribers can then read the num_slots - lead newest frames. Publish
+ * every frame delivered by the capture (orca_shm_stage()): the frames the
+ * camera captured in between are reported as dropped.
+ *
+ * The slots must hold DCAM_IDPROP_BUFFER_FRAMEBYTES. Detach the buffers
+ * (orca_detach_buffers()) or close the camera before orca_shm_destroy().
+ *
+ * @param pub Publisher handle
+ * @param cam ORCACAM handle, not capturing
+ * @param lead Frames the camera may capture ahead of the published frame, from 1 to num_slots - 1
+ * @return DCAMERR DCAMERR_INVALIDPARAM if lead is out of range or the slots are too small, DCAMERR_BUSY if the camera is capturing
+ */
+DCAMERR orca_shm_attach(ORCA_SHM_PUBLISHER pub, ORCACAM cam, int32 lead);
+
+/**
+ * @brief Get the slots of the ring to write frames into them in place, and publish frames from the slots from then on (see orca_shm_attach()).
+ *
+ * @param pub Publisher handle
+ * @param buffers Output array of num_slots frame buffers, in ring order
+ * @param buffer_bytes Output size of each buffer
+ * @param lead Frames the producer may write ahead of the published frame, from 1 to num_slots - 1
+ * @return DCAMERR DCAMERR_INVALIDPARAM if lead is out of range
+ */
+DCAMERR orca_shm_buffers(ORCA_SHM_PUBLISHER pub, void *_Nonnull *_Nonnull buffers, size_t *_Nonnull buffer_bytes, int32 lead);
+
+/**
+ * @brief Publish a frame. Must be called from a single thread.
+ *
+ * @param pub Publisher handle
+ * @param frame Frame
+ * @return DCAMERR DCAMERR_INVALIDPARAM if the frame does not fit in a slot, or is not in one once the ring is written in place
+ */
+DCAMERR orca_shm_publish(ORCA_SHM_PUBLISHER pub, const ORCA_FRAME *_Nonnull frame);
+
+/**
+ * @brief Shared-memory publishing stage function. Add to the camera using orca_add_stage(cam, orca_shm_stage, pub, sizeof(pub)).
+ *
+ * @param frame Frame data
+ * @param pub ORCA_SHM_PUBLISHER handle
+ * @param sz_pub Unused
+ */
+void orca_shm_stage(ORCA_FRAME *_Nonnull frame, void *_Nullable pub, size_t sz_pub);
+
+/**
+ * @brief Close and unlink the shared-memory ring. Waiting subscribers return DCAMERR_ABORT.
+ *
+ * @param pub Publisher handle
+ */
+void orca_shm_destroy(ORCA_SHM_PUBLISHER *_Nonnull pub);
+
+/**
+ * @brief Attach to a shared-memory frame ring. Reading starts at the next published frame.
+ *
+ * @param sub Output subscriber handle
+ * @param name Shared memory object name
+ * @return DCAMERR DCAMERR_NOTREADY if no publisher exists
+ */
+DCAMERR orca_shm_subscribe(ORCA_SHM_SUBSCRIBER *_Nonnull sub, const char *_Nonnull name);
+
+/**
+ * @brief Wait for the next frame and map it without copying.
+ *
+ * If the subscriber was lapped, it skips ahead to the newest frame and
+ * reports the skipped frames in info->dropped. The frame data stays in the
+ * ring, mapped read-only, and may be overwritten by the publisher; call orca_shm_release()
+ * after reading it to check that it was not.
+ *
+ * @param sub Subscriber handle
+ * @param frame Output frame, pointing into the shared ring
+ * @param info Output frame information
+ * @param timeout_ms Timeout in milliseconds, negative to wait forever
+ * @return DCAMERR DCAMERR_TIMEOUT on timeout, DCAMERR_ABORT if the publisher closed
+ */
+DCAMERR orca_shm_next(ORCA_SHM_SUBSCRIBER sub, ORCA_FRAME *_Nonnull frame, ORCA_SHM_INFO *_Nullable info, int32 timeout_ms);
+
+/**
+ * @brief Finish reading the frame returned by orca_shm_next().
+ *
+ * @param sub Subscriber handle
+ * @return DCAMERR DCAMERR_LOSTFRAME if the frame was overwritten while it was read
+ */
+DCAMERR orca_shm_release(ORCA_SHM_SUBSCRIBER sub);
+
+/**
+ * @brief Detach from a shared-memory frame ring.
+ *
+ * @param sub Subscriber handle
+ */
+void orca_shm_unsubscribe(ORCA_SHM_SUBSCRIBER *_Nonnull sub);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // _ORCACAM_SHM_H_
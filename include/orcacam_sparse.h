@@ -0,0 +1,134 @@
+/**
+ * @file orcacam_sparse.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Sparse event extraction for low-light frames
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_SPARSE_H_
+#define _ORCACAM_SPARSE_H_
+
+#include <stdint.h>
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Sparse event: a pixel above the background threshold
+ *
+ */
+typedef struct _ORCA_EVENT
+{
+    uint16_t x;          //!< Column
+    uint16_t y;          //!< Row
+    uint16_t value;      //!< Pixel value
+    uint16_t background; //!< Background value of the pixel
+} ORCA_EVENT;
+
+/**
+ * @brief ROI patch: a square tile of the frame containing at least one event
+ *
+ */
+typedef struct _ORCA_PATCH
+{
+    uint16_t x; //!< Left column of the tile
+    uint16_t y; //!< Top row of the tile
+} ORCA_PATCH;
+
+/**
+ * @brief Sparse representation of a frame
+ *
+ */
+typedef struct _ORCA_SPARSE_FRAME
+{
+    int32 width;                        //!< Frame width
+    int32 height;                       //!< Frame height
+    DCAM_PIXELTYPE fmt;                 //!< Frame pixel format
+    int32 truncated;                    //!< Non-zero if events or patches were dropped because the capacity was exceeded
+    size_t num_events;                  //!< Number of events
+    const ORCA_EVENT *_Nullable events; //!< Events, in raster order
+    int32 patch_size;                   //!< Side of the square patches (0 if disabled)
+    size_t num_patches;                 //!< Number of patches
+    const ORCA_PATCH *_Nullable patches; //!< Patch positions, in raster order
+    const void *_Nullable patch_data;   //!< Patch pixels, patch_size x patch_size pixels per patch, row stride = patch_size pixels, zero-padded at the frame edges
+} ORCA_SPARSE_FRAME;
+
+/**
+ * @brief Sparse extractor configuration
+ *
+ */
+typedef struct _ORCA_SPARSE_CONFIG
+{
+    int32 threshold;    //!< A pixel is an event if its value exceeds background + threshold
+    size_t max_events;  //!< Capacity of the event list
+    int32 patch_size;   //!< Side of the square patches to emit, 0 to disable patches
+    size_t max_patches; //!< Capacity of the patch list
+} ORCA_SPARSE_CONFIG;
+
+/**
+ * @brief Sparse extractor handle
+ *
+ */
+typedef struct _ORCA_SPARSE *ORCA_SPARSE;
+
+/**
+ * @brief Create a sparse extractor.
+ *
+ * @param sparse Output sparse extractor handle
+ * @param config Configuration
+ * @return DCAMERR
+ */
+DCAMERR orca_sparse_create(ORCA_SPARSE *_Nonnull sparse, const ORCA_SPARSE_CONFIG *_Nonnull config);
+
+/**
+ * @brief Set the background map from a (dark) MONO8 or MONO16 frame. Without a background map, events are thresholded against zero.
+ *
+ * @param sparse Sparse extractor handle
+ * @param background Background frame
+ * @return DCAMERR
+ */
+DCAMERR orca_sparse_set_background(ORCA_SPARSE sparse, const ORCA_FRAME *_Nonnull background);
+
+/**
+ * @brief Extract the events of a MONO8 or MONO16 frame.
+ *
+ * Pixels are compared against the precomputed threshold map 16 at a time with
+ * SIMD compares, and only the set bits of the comparison masks are visited.
+ *
+ * @param sparse Sparse extractor handle
+ * @param frame Frame
+ * @param out Output sparse frame. The lists are owned by the extractor and valid until the next call.
+ * @return DCAMERR
+ */
+DCAMERR orca_sparse_extract(ORCA_SPARSE sparse, const ORCA_FRAME *_Nonnull frame, ORCA_SPARSE_FRAME *_Nonnull out);
+
+/**
+ * @brief Sparse extraction stage function. Add to the camera using orca_add_stage(cam, orca_sparse_stage, sparse, sizeof(sparse)).
+ *
+ * The sparse frame is attached to the frame as frame->meta[ORCA_META_SPARSE].
+ *
+ * @param frame Frame data
+ * @param sparse ORCA_SPARSE handle
+ * @param sz_sparse Unused
+ */
+void orca_sparse_stage(ORCA_FRAME *_Nonnull frame, void *_Nullable sparse, size_t sz_sparse);
+
+/**
+ * @brief Destroy a sparse extractor. The extractor must not be in use by a capturing camera.
+ *
+ * @param sparse Sparse extractor handle
+ */
+void orca_sparse_destroy(ORCA_SPARSE *_Nonnull sparse);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // _ORCACAM_SPARSE_H_
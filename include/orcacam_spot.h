@@ -0,0 +1,115 @@
+/**
+ * @file orcacam_spot.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Spot detection and sub-pixel centroiding on MONO16 frames
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_SPOT_H_
+#define _ORCACAM_SPOT_H_
+
+#include <stdint.h>
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Detected spot
+ *
+ */
+typedef struct _ORCA_SPOT
+{
+    double x;           //!< Intensity-weighted centroid column (pixel centers at integer coordinates)
+    double y;           //!< Intensity-weighted centroid row
+    double intensity;   //!< Sum of the background-subtracted pixel values
+    uint32_t npix;      //!< Number of pixels above the threshold
+    uint16_t peak;      //!< Maximum pixel value
+    uint16_t rsvd;      //!< Reserved
+    int32 xmin, ymin;   //!< Bounding box top-left corner
+    int32 xmax, ymax;   //!< Bounding box bottom-right corner (inclusive)
+} ORCA_SPOT;
+
+/**
+ * @brief Spots of a frame
+ *
+ */
+typedef struct _ORCA_SPOT_LIST
+{
+    size_t num_spots;                 //!< Number of spots
+    const ORCA_SPOT *_Nullable spots; //!< Spots, in raster order of their first pixel within each band
+    int32 truncated;                  //!< Non-zero if spots were dropped because the capacity was exceeded
+} ORCA_SPOT_LIST;
+
+/**
+ * @brief Spot finder configuration
+ *
+ */
+typedef struct _ORCA_SPOT_CONFIG
+{
+    int32 threshold;   //!< A pixel belongs to a spot if its value exceeds the threshold
+    int32 background;  //!< Background level subtracted from the pixel values before weighting
+    int32 min_pixels;  //!< Minimum number of pixels of a spot
+    size_t max_spots;  //!< Capacity of the spot list
+    int32 num_threads; //!< Number of threads processing row bands, including the capture thread
+} ORCA_SPOT_CONFIG;
+
+/**
+ * @brief Spot finder handle
+ *
+ */
+typedef struct _ORCA_SPOTFINDER *ORCA_SPOTFINDER;
+
+/**
+ * @brief Create a spot finder.
+ *
+ * Every row band is thresholded (skipping background 16 pixels at a time with
+ * SIMD compares), split into runs of bright pixels, and labeled into
+ * 8-connected components whose moments are accumulated in the band's thread.
+ * Components touching a band boundary are then merged.
+ *
+ * @param finder Output spot finder handle
+ * @param config Configuration
+ * @return DCAMERR
+ */
+DCAMERR orca_spot_create(ORCA_SPOTFINDER *_Nonnull finder, const ORCA_SPOT_CONFIG *_Nonnull config);
+
+/**
+ * @brief Find the spots of a MONO16 frame.
+ *
+ * @param finder Spot finder handle
+ * @param frame Frame
+ * @param out Output spot list. The list is owned by the spot finder and valid until the next call.
+ * @return DCAMERR
+ */
+DCAMERR orca_spot_find(ORCA_SPOTFINDER finder, const ORCA_FRAME *_Nonnull frame, ORCA_SPOT_LIST *_Nonnull out);
+
+/**
+ * @brief Spot finding stage function. Add to the camera using orca_add_stage(cam, orca_spot_stage, finder, sizeof(finder)).
+ *
+ * The spot list is attached to the frame as frame->meta[ORCA_META_SPOTS].
+ *
+ * @param frame Frame data
+ * @param finder ORCA_SPOTFINDER handle
+ * @param sz_finder Unused
+ */
+void orca_spot_stage(ORCA_FRAME *_Nonnull frame, void *_Nullable finder, size_t sz_finder);
+
+/**
+ * @brief Destroy a spot finder. The spot finder must not be in use by a capturing camera.
+ *
+ * @param finder Spot finder handle
+ */
+void orca_spot_destroy(ORCA_SPOTFINDER *_Nonnull finder);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // _ORCACAM_SPOT_H_
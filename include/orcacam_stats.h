@@ -0,0 +1,136 @@
+/**
+ * @file orcacam_stats.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Capture latency histograms and counters
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_STATS_H_
+#define _ORCACAM_STATS_H_
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Number of linear sub-buckets per power of two of a histogram, as a
+ * power of two. Values are recorded with a precision of 1/16 (6.25%).
+ *
+ */
+#define ORCA_HIST_SUB_BITS 4
+
+/**
+ * @brief Largest value recorded by a histogram, as a power of two (ns).
+ * Larger values are recorded in the last bucket.
+ *
+ */
+#define ORCA_HIST_MAX_BITS 40
+
+/**
+ * @brief Number of buckets of a histogram
+ *
+ */
+#define ORCA_HIST_BUCKETS                                                      \
+    ((ORCA_HIST_MAX_BITS - ORCA_HIST_SUB_BITS + 1) << ORCA_HIST_SUB_BITS)
+
+/**
+ * @brief Latency histogram, with logarithmic buckets of linear sub-buckets
+ *
+ */
+typedef struct _ORCA_HISTOGRAM
+{
+    uint64_t count;                      //!< Number of values
+    uint64_t sum;                        //!< Sum of the values (ns)
+    uint64_t min;                        //!< Smallest value (ns)
+    uint64_t max;                        //!< Largest value (ns)
+    uint64_t buckets[ORCA_HIST_BUCKETS]; //!< Number of values per bucket
+} ORCA_HISTOGRAM;
+
+/**
+ * @brief Intervals measured by the capture thread
+ *
+ */
+typedef enum _ORCA_STAT_KIND
+{
+    ORCA_STAT_WAKEUP       = 0, //!< Frame ready wakeup to callback entry, including the processing stages
+    ORCA_STAT_CALLBACK     = 1, //!< Duration of the frame callback
+    ORCA_STAT_TRANSFERINFO = 2, //!< Duration of the dcamcap_transferinfo call
+    ORCA_STAT_DELIVERY     = 3, //!< Frame timestamp to host receive, sampled every ORCA_STATS_STAMP_INTERVAL frames
+    ORCA_STAT_MAX,              //!< Number of intervals
+} ORCA_STAT_KIND;
+
+/**
+ * @brief Number of frames between two frame timestamp samples. Reading a
+ * timestamp costs a driver call.
+ *
+ */
+#define ORCA_STATS_STAMP_INTERVAL 16
+
+/**
+ * @brief Capture statistics
+ *
+ */
+typedef struct _ORCA_STATS
+{
+    uint64_t frames;                     //!< Frames delivered
+    uint64_t timeouts;                   //!< Waits that timed out
+    uint64_t aborts;                     //!< Waits aborted
+    uint64_t errors;                     //!< Failed waits and transfer info calls
+    uint64_t dropped;                    //!< Frames skipped, as only the newest frame is delivered when the callback falls behind
+    uint64_t pending;                    //!< Frames in the ring waiting for delivery at the last wakeup, 1 unless the callback falls behind
+    uint64_t ring_frames;                //!< Number of frames in the ring of the last capture
+    ORCA_HISTOGRAM hist[ORCA_STAT_MAX];  //!< Histograms, indexed by ORCA_STAT_KIND
+} ORCA_STATS;
+
+/**
+ * @brief Get the capture statistics accumulated since the camera was opened
+ * or the statistics were reset.
+ *
+ * Statistics are recorded by the capture thread of the callback API with
+ * relaxed atomic operations, and can be read at any time. A snapshot taken
+ * while capturing may be a few frames behind between counters.
+ *
+ * @param cam ORCACAM handle
+ * @param stats Output statistics
+ * @return DCAMERR
+ */
+DCAMERR orca_get_stats(ORCACAM cam, ORCA_STATS *_Nonnull stats);
+
+/**
+ * @brief Reset the capture statistics.
+ *
+ * @param cam ORCACAM handle
+ * @return DCAMERR
+ */
+DCAMERR orca_reset_stats(ORCACAM cam);
+
+/**
+ * @brief Get a percentile of a histogram: the largest value of the bucket
+ * holding it, limited to the largest value recorded.
+ *
+ * @param hist Histogram
+ * @param percentile Percentile (0 - 100)
+ * @return uint64_t Value (ns), 0 if the histogram is empty
+ */
+uint64_t orca_hist_percentile(const ORCA_HISTOGRAM *_Nonnull hist, double percentile);
+
+/**
+ * @brief Get the mean of a histogram.
+ *
+ * @param hist Histogram
+ * @return double Mean (ns), 0 if the histogram is empty
+ */
+double orca_hist_mean(const ORCA_HISTOGRAM *_Nonnull hist);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // _ORCACAM_STATS_H_
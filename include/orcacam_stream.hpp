@@ -0,0 +1,821 @@
+/**
+ * @file orcacam_stream.hpp
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief C++20 coroutine frame streams and a single-threaded executor
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * An orca::Executor runs coroutines on the thread calling run(), resuming
+ * them when a file descriptor becomes readable or a timer expires. An
+ * orca::FrameStream queues the frames of the capture thread for a
+ * coroutine, so that one thread can wait on cameras, timers and sockets
+ * together:
+ *
+ *     orca::Task consume(orca::FrameStream &stream)
+ *     {
+ *         while (auto frame = co_await stream.next())
+ *         {
+ *             process(frame->view());
+ *         }
+ *     }
+ *
+ */
+
+#ifndef _ORCACAM_STREAM_HPP_
+#define _ORCACAM_STREAM_HPP_
+
+#if __cplusplus < 202002L
+#error "orcacam_stream.hpp requires C++20"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "orcacam.hpp"
+#include "orcacam_stats.h"
+
+namespace orca
+{
+
+class Executor;
+
+/**
+ * @brief Coroutine run by an Executor. Tasks start once spawned, and an
+ * exception leaving a task is thrown by Executor::run().
+ *
+ */
+class Task
+{
+  public:
+    struct promise_type
+    {
+        Executor *executor = nullptr;
+        std::exception_ptr error;
+
+        struct Final
+        {
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+            void await_suspend(
+                std::coroutine_handle<promise_type> h) const noexcept;
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        Task get_return_object() noexcept
+        {
+            return Task(
+                std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+        Final final_suspend() const noexcept
+        {
+            return {};
+        }
+        void return_void() const noexcept
+        {
+        }
+        void unhandled_exception() noexcept
+        {
+            error = std::current_exception();
+        }
+    };
+
+    Task(const Task &)            = delete;
+    Task &operator=(const Task &) = delete;
+    Task(Task &&other) noexcept : h_(std::exchange(other.h_, nullptr))
+    {
+    }
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (h_)
+            {
+                h_.destroy();
+            }
+            h_ = std::exchange(other.h_, nullptr);
+        }
+        return *this;
+    }
+    ~Task()
+    {
+        if (h_)
+        {
+            h_.destroy();
+        }
+    }
+
+  private:
+    explicit Task(std::coroutine_handle<promise_type> h) noexcept : h_(h)
+    {
+    }
+
+    std::coroutine_handle<promise_type> h_;
+    friend class Executor;
+};
+
+/**
+ * @brief Single-threaded executor over epoll
+ *
+ * Coroutines wait on file descriptors without blocking the thread. Waiting
+ * allocates nothing; only spawning a task does.
+ *
+ */
+class Executor
+{
+  public:
+    /**
+     * @brief File descriptor watched for a suspended coroutine
+     *
+     */
+    struct Watch
+    {
+        int fd;
+        std::coroutine_handle<> h;
+    };
+
+    /**
+     * @brief Awaitable resuming once a file descriptor is readable
+     *
+     */
+    class Readable
+    {
+      public:
+        Readable(Executor *ex, int fd) noexcept : ex_(ex), watch_{fd, {}}
+        {
+        }
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            watch_.h = h;
+            ex_->watch(&watch_);
+        }
+        void await_resume() const noexcept
+        {
+        }
+
+      private:
+        Executor *ex_;
+        Watch watch_;
+    };
+
+    /**
+     * @brief Awaitable resuming after a delay
+     *
+     */
+    class Sleep
+    {
+      public:
+        Sleep(Executor *ex, std::chrono::nanoseconds delay) noexcept
+            : ex_(ex), delay_(delay), watch_{-1, {}}
+        {
+        }
+        Sleep(const Sleep &)            = delete;
+        Sleep &operator=(const Sleep &) = delete;
+        ~Sleep()
+        {
+            if (watch_.fd >= 0)
+            {
+                ::close(watch_.fd);
+            }
+        }
+        bool await_ready() const noexcept
+        {
+            return delay_.count() <= 0;
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            watch_.fd =
+                timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+            if (watch_.fd < 0)
+            {
+                throw std::system_error(errno, std::generic_category(),
+                                        "timerfd_create");
+            }
+            struct itimerspec its = {};
+            its.it_value.tv_sec   = delay_.count() / 1000000000;
+            its.it_value.tv_nsec  = delay_.count() % 1000000000;
+            timerfd_settime(watch_.fd, 0, &its, nullptr);
+            watch_.h = h;
+            ex_->watch(&watch_);
+        }
+        void await_resume() noexcept
+        {
+            ::close(std::exchange(watch_.fd, -1));
+        }
+
+      private:
+        Executor *ex_;
+        std::chrono::nanoseconds delay_;
+        Watch watch_;
+    };
+
+    /**
+     * @brief Awaitable letting the other ready coroutines run first
+     *
+     */
+    class Yield
+    {
+      public:
+        explicit Yield(Executor *ex) noexcept : ex_(ex)
+        {
+        }
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            ex_->ready_.push_back(h);
+        }
+        void await_resume() const noexcept
+        {
+        }
+
+      private:
+        Executor *ex_;
+    };
+
+    Executor()
+    {
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_  = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        struct epoll_event ev = {};
+        ev.events             = EPOLLIN;
+        ev.data.ptr           = nullptr;
+        if (epoll_ < 0 || wake_ < 0 ||
+            epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &ev) < 0)
+        {
+            int err = errno;
+            close();
+            throw std::system_error(err, std::generic_category(),
+                                    "orca::Executor");
+        }
+    }
+    Executor(const Executor &)            = delete;
+    Executor &operator=(const Executor &) = delete;
+    ~Executor()
+    {
+        for (auto h : tasks_)
+        {
+            h.destroy();
+        }
+        close();
+    }
+
+    /**
+     * @brief Run a task on the next run().
+     *
+     * @param task Task
+     */
+    void spawn(Task task)
+    {
+        auto h               = std::exchange(task.h_, nullptr);
+        h.promise().executor = this;
+        tasks_.push_back(h);
+        ready_.push_back(h);
+    }
+
+    /**
+     * @brief Run the tasks until they are all done, or stop() is called.
+     *
+     * @throws The exception leaving a task, which is then destroyed
+     */
+    void run()
+    {
+        while (!tasks_.empty())
+        {
+            while (!ready_.empty())
+            {
+                running_.swap(ready_);
+                for (auto h : running_)
+                {
+                    h.resume();
+                }
+                running_.clear();
+                reap();
+            }
+            if (stop_.exchange(false) || tasks_.empty())
+            {
+                break;
+            }
+            poll();
+        }
+    }
+
+    /**
+     * @brief Make run() return once the ready coroutines have run. May be
+     * called from any thread.
+     *
+     */
+    void stop() noexcept
+    {
+        stop_.store(true);
+        uint64_t one = 1;
+        (void)!::write(wake_, &one, sizeof(one));
+    }
+
+    /**
+     * @brief Wait until a file descriptor is readable, e.g. a socket.
+     *
+     * @param fd File descriptor, not watched by another coroutine
+     * @return Readable
+     */
+    Readable readable(int fd) noexcept
+    {
+        return Readable(this, fd);
+    }
+
+    /**
+     * @brief Wait for a delay.
+     *
+     * @param delay Delay
+     * @return Sleep
+     */
+    Sleep sleep_for(std::chrono::nanoseconds delay) noexcept
+    {
+        return Sleep(this, delay);
+    }
+
+    /**
+     * @brief Let the other ready coroutines run.
+     *
+     * @return Yield
+     */
+    Yield yield() noexcept
+    {
+        return Yield(this);
+    }
+
+    /**
+     * @brief Resume a coroutine once a file descriptor is readable.
+     *
+     * @param w Watch, valid until the coroutine is resumed
+     */
+    void watch(Watch *w)
+    {
+        struct epoll_event ev = {};
+        ev.events             = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr           = w;
+        if (epoll_ctl(epoll_, EPOLL_CTL_ADD, w->fd, &ev) < 0)
+        {
+            throw std::system_error(errno, std::generic_category(),
+                                    "epoll_ctl");
+        }
+    }
+
+  private:
+    void close() noexcept
+    {
+        if (wake_ >= 0)
+        {
+            ::close(wake_);
+        }
+        if (epoll_ >= 0)
+        {
+            ::close(epoll_);
+        }
+    }
+
+    // Wait for a watched file descriptor
+    void poll()
+    {
+        struct epoll_event events[16];
+        int n = epoll_wait(epoll_, events, 16, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                return;
+            }
+            throw std::system_error(errno, std::generic_category(),
+                                    "epoll_wait");
+        }
+        for (int i = 0; i < n; i++)
+        {
+            Watch *w = static_cast<Watch *>(events[i].data.ptr);
+            if (!w)
+            {
+                uint64_t v;
+                (void)!::read(wake_, &v, sizeof(v));
+                continue;
+            }
+            // the descriptor may be closed once the coroutine resumes
+            epoll_ctl(epoll_, EPOLL_CTL_DEL, w->fd, nullptr);
+            ready_.push_back(w->h);
+        }
+    }
+
+    // Destroy the finished tasks
+    void reap()
+    {
+        std::exception_ptr error;
+        for (auto h : done_)
+        {
+            tasks_.erase(std::find(tasks_.begin(), tasks_.end(), h));
+            if (h.promise().error && !error)
+            {
+                error = h.promise().error;
+            }
+            h.destroy();
+        }
+        done_.clear();
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    int epoll_ = -1;
+    int wake_  = -1;
+    std::atomic<bool> stop_{false};
+    std::vector<std::coroutine_handle<Task::promise_type>> tasks_;
+    std::vector<std::coroutine_handle<Task::promise_type>> done_;
+    std::vector<std::coroutine_handle<>> ready_;
+    std::vector<std::coroutine_handle<>> running_;
+
+    friend struct Task::promise_type::Final;
+};
+
+inline void Task::promise_type::Final::await_suspend(
+    std::coroutine_handle<promise_type> h) const noexcept
+{
+    h.promise().executor->done_.push_back(h);
+}
+
+/**
+ * @brief Frame of a FrameStream
+ *
+ * The pixels stay in the camera ring, and are valid until the camera
+ * captures FrameStream::capacity() more frames: check with
+ * FrameStream::valid() once done with them. Metadata is not kept, as
+ * stages only keep it until the next frame.
+ *
+ */
+class StreamFrame
+{
+  public:
+    FrameView view() const noexcept
+    {
+        return FrameView(frame_);
+    }
+    const ORCA_FRAME &get() const noexcept
+    {
+        return frame_;
+    }
+
+    /**
+     * @brief Get the number of the frame in the capture. Numbers skipped
+     * were dropped, by the stream or the capture thread.
+     *
+     * @return uint64_t Frame number, from 0
+     */
+    uint64_t sequence() const noexcept
+    {
+        return sequence_;
+    }
+
+  private:
+    ORCA_FRAME frame_;
+    uint64_t sequence_; // camera frame count, less 1
+    friend class FrameStream;
+};
+
+/**
+ * @brief Frames of a capture, awaited by a coroutine
+ *
+ * The capture thread queues every frame it delivers (see
+ * orca_start_capture()), waking the coroutine through an eventfd. Queued
+ * frames are dropped once the camera has captured capacity() frames after
+ * them, as their slot of the ring is about to be overwritten; frames the
+ * capture thread skips, when it falls behind, are also counted as dropped.
+ * Open the camera with a larger ring to absorb longer stalls.
+ *
+ * The stream can not move, as the capture thread refers to it.
+ *
+ */
+class FrameStream
+{
+  public:
+    /**
+     * @brief Awaitable of the next frame
+     *
+     */
+    class Next
+    {
+      public:
+        explicit Next(FrameStream *stream) noexcept
+            : stream_(stream), watch_{stream->event_, {}}
+        {
+        }
+        bool await_ready()
+        {
+            return stream_->ready();
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            watch_.h = h;
+            stream_->ex_->watch(&watch_);
+        }
+        std::optional<StreamFrame> await_resume()
+        {
+            return stream_->pop();
+        }
+
+      private:
+        FrameStream *stream_;
+        Executor::Watch watch_;
+    };
+
+    /**
+     * @brief Start capturing into a stream.
+     *
+     * @param cam Camera handle
+     * @param ex Executor of the consumer
+     */
+    FrameStream(ORCACAM cam, Executor &ex) : cam_(cam), ex_(&ex)
+    {
+        event_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (event_ < 0)
+        {
+            throw std::system_error(errno, std::generic_category(),
+                                    "orca::FrameStream");
+        }
+        // the capture thread waits until the queue is sized to the ring
+        std::unique_lock<std::mutex> lock(lock_);
+        DCAMERR err = orca_start_capture(cam_, &FrameStream::frame, this,
+                                         sizeof(*this));
+        if (orcaerr_failed(err))
+        {
+            ::close(event_);
+            throw Error(err, "orca_start_capture");
+        }
+        ORCA_STATS stats;
+        size_t ring = 0;
+        if (!orcaerr_failed(orca_get_stats(cam_, &stats)))
+        {
+            ring = (size_t)stats.ring_frames;
+        }
+        size_t capacity = ring > 2 ? ring - 2 : 1;
+        try
+        {
+            slots_ = std::make_unique<StreamFrame[]>(capacity);
+        }
+        catch (...)
+        {
+            // frames delivered until the capture stops are ignored
+            lock.unlock();
+            orca_stop_capture(cam_);
+            ::close(event_);
+            throw;
+        }
+        capacity_ = capacity;
+    }
+    FrameStream(const FrameStream &)            = delete;
+    FrameStream &operator=(const FrameStream &) = delete;
+    ~FrameStream()
+    {
+        if (cam_)
+        {
+            orca_stop_capture(cam_);
+        }
+        ::close(event_);
+    }
+
+    /**
+     * @brief Wait for the next frame.
+     *
+     * @return Next, resuming with the frame, or std::nullopt once the
+     * stream is stopped and empty
+     */
+    Next next() noexcept
+    {
+        return Next(this);
+    }
+
+    /**
+     * @brief Stop capturing. The frames queued can still be read.
+     *
+     * @throws Error The error that stopped the capture thread, if any
+     */
+    void stop()
+    {
+        ORCACAM cam = std::exchange(cam_, nullptr);
+        if (!cam)
+        {
+            return;
+        }
+        DCAMERR err = orca_stop_capture(cam);
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            stopped_ = true;
+            signal();
+        }
+        check(err, "orca_stop_capture");
+    }
+
+    /**
+     * @brief Get the number of frames queued, the backpressure of the
+     * consumer.
+     *
+     * @return size_t Frames
+     */
+    size_t pending()
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        return count_;
+    }
+
+    /**
+     * @brief Get the number of frames the queue holds before dropping
+     * frames: the frames of the ring, less the newest and the one being
+     * written.
+     *
+     * @return size_t Frames
+     */
+    size_t capacity() const noexcept
+    {
+        return capacity_;
+    }
+
+    /**
+     * @brief Get the number of frames dropped as the consumer, or the
+     * capture thread, fell behind.
+     *
+     * @return uint64_t Frames
+     */
+    uint64_t dropped()
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        return dropped_;
+    }
+
+    /**
+     * @brief Check that the pixels of a frame of the stream were not
+     * overwritten, e.g. after processing it.
+     *
+     * @param frame Frame of the stream
+     * @return true while the camera has captured less than capacity()
+     * frames after it
+     */
+    bool valid(const StreamFrame &frame)
+    {
+        uint64_t captured = camera_frames();
+        std::lock_guard<std::mutex> lock(lock_);
+        return newest(captured) - frame.sequence_ < capacity_;
+    }
+
+  private:
+    // Called on the capture thread
+    static void frame(ORCA_FRAME *frame, void *user_data, size_t)
+    {
+        FrameStream *s = static_cast<FrameStream *>(user_data);
+        auto capture   = static_cast<const ORCA_CAPTURE_INFO *>(
+            frame->meta[ORCA_META_CAPTURE]);
+        std::lock_guard<std::mutex> lock(s->lock_);
+        if (!s->slots_)
+        {
+            return; // the stream failed to start
+        }
+        uint64_t sequence =
+            capture ? capture->frame_count - 1 : s->latest_ + 1;
+        s->dropped_ += capture ? capture->skipped : 0;
+        s->latest_ = sequence;
+        // drop the frames whose slot of the ring the camera is about to
+        // overwrite, which also makes room for this one
+        while (s->count_ &&
+               (s->count_ == s->capacity_ ||
+                sequence - s->slots_[s->head_].sequence_ >= s->capacity_))
+        {
+            s->head_ = (s->head_ + 1) % s->capacity_;
+            s->count_--;
+            s->dropped_++;
+        }
+        StreamFrame &slot = s->slots_[(s->head_ + s->count_) % s->capacity_];
+        slot.frame_       = *frame;
+        slot.sequence_    = sequence;
+        std::fill(std::begin(slot.frame_.meta), std::end(slot.frame_.meta),
+                  nullptr);
+        // signaled with the lock held, so that a consumer finding the queue
+        // empty never consumes the wakeup of a frame it already took
+        if (++s->count_ == 1)
+        {
+            s->signal();
+        }
+    }
+
+    // Make the eventfd readable, unless it already is
+    void signal() noexcept
+    {
+        if (!signaled_.exchange(true))
+        {
+            uint64_t one = 1;
+            (void)!::write(event_, &one, sizeof(one));
+        }
+    }
+
+    // Check for a frame, clearing a stale wakeup before waiting
+    bool ready()
+    {
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (count_ || stopped_)
+            {
+                return true;
+            }
+        }
+        if (signaled_.exchange(false))
+        {
+            uint64_t v;
+            (void)!::read(event_, &v, sizeof(v));
+        }
+        std::lock_guard<std::mutex> lock(lock_);
+        return count_ || stopped_;
+    }
+
+    // Frames captured, ahead of the frames delivered when the capture thread
+    // falls behind; 0 once the capture is stopped
+    uint64_t camera_frames() noexcept
+    {
+        uint64_t count = 0;
+        ORCACAM cam    = cam_;
+        if (!cam || orcaerr_failed(orca_get_frame_count(cam, &count)))
+        {
+            return 0;
+        }
+        return count;
+    }
+
+    // Sequence of the newest frame, with the lock held
+    uint64_t newest(uint64_t captured) const noexcept
+    {
+        return std::max(captured, latest_ + 1) - 1;
+    }
+
+    std::optional<StreamFrame> pop()
+    {
+        uint64_t captured = camera_frames();
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!count_)
+        {
+            return std::nullopt;
+        }
+        // frames overwritten since they were queued, but for the newest
+        while (count_ > 1 &&
+               newest(captured) - slots_[head_].sequence_ >= capacity_)
+        {
+            head_ = (head_ + 1) % capacity_;
+            count_--;
+            dropped_++;
+        }
+        StreamFrame f = slots_[head_];
+        head_         = (head_ + 1) % capacity_;
+        count_--;
+        return f;
+    }
+
+    ORCACAM cam_;
+    Executor *ex_;
+    int event_ = -1;
+    std::atomic<bool> signaled_{false};
+    std::mutex lock_;
+    std::unique_ptr<StreamFrame[]> slots_;
+    size_t capacity_   = 0;
+    size_t head_       = 0;
+    size_t count_      = 0;
+    uint64_t latest_   = UINT64_MAX; // sequence of the newest frame
+    uint64_t dropped_  = 0;
+    bool stopped_      = false;
+};
+
+} // namespace orca
+
+#endif // _ORCACAM_STREAM_HPP_
@@ -0,0 +1,75 @@
+/**
+ * @file orcacam_sweep.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Exposure and frame rate sweeps without stopping the capture
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_SWEEP_H_
+#define _ORCACAM_SWEEP_H_
+
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Sweep step
+ *
+ */
+typedef struct _ORCA_SWEEP_STEP
+{
+    double exposure;  //!< Exposure time (s), 0 to leave unchanged
+    double framerate; //!< Internal frame rate (frames/s), 0 to leave unchanged
+    int32 roi[4];     //!< ROI x, y, width, height; width 0 to leave unchanged
+} ORCA_SWEEP_STEP;
+
+/**
+ * @brief Sweep step of a frame
+ *
+ */
+typedef struct _ORCA_SWEEP_INFO
+{
+    int32 step;       //!< Step index
+    int32 frame;      //!< Frame index within the step
+    double exposure;  //!< Exposure time in effect (s), as applied by the camera
+    double framerate; //!< Internal frame rate in effect (frames/s)
+    int32 restarted;  //!< Non-zero if the capture was restarted for this step
+    int32 rsvd;       //!< Reserved
+} ORCA_SWEEP_INFO;
+
+/**
+ * @brief Capture a number of frames at each step of a sweep.
+ *
+ * Properties that are writable while the camera is busy
+ * (DCAMPROP_ATTR_ACCESSBUSY) are changed without stopping the capture; the
+ * frames captured while the change settles are discarded. The capture is
+ * only stopped for a step that changes the ROI, or a property that can not
+ * be written while busy.
+ *
+ * The ORCA_SWEEP_INFO of each frame is attached to the frame as
+ * frame->meta[ORCA_META_SWEEP]. Processing stages run before the sweep
+ * assigns the frame to a step, and therefore see no sweep information.
+ *
+ * @param cam ORCACAM handle
+ * @param steps Sweep steps
+ * @param num_steps Number of steps
+ * @param frames_per_step Number of frames delivered per step
+ * @param settle_frames Number of frames discarded after a change while busy
+ * @param cb Frame callback, called from the capture thread
+ * @param user_data Pointer to user data
+ * @param sz_user_data Size of user data
+ * @return DCAMERR DCAMERR_BUSY if the camera is capturing, DCAMERR_TIMEOUT if frames stop arriving
+ */
+DCAMERR orca_sweep_run(ORCACAM cam, const ORCA_SWEEP_STEP *_Nonnull steps, int32 num_steps, int32 frames_per_step, int32 settle_frames, OrcaFrameCallback _Nonnull cb, void *_Nullable user_data, size_t sz_user_data DCAM_DEFAULT_ARG);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+#endif // _ORCACAM_SWEEP_H_
@@ -0,0 +1,113 @@
+/**
+ * @file orcacam_trace.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Binary trace recorder of the capture path
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_TRACE_H_
+#define _ORCACAM_TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "orcacam.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+/**
+ * @brief Number of records of the trace ring of a thread. Older records are
+ * overwritten.
+ *
+ */
+#define ORCA_TRACE_RING_RECORDS 16384
+
+/**
+ * @brief Traced events
+ *
+ */
+typedef enum _ORCA_TRACE_EVENT
+{
+    ORCA_TRACE_WAIT = 0,      //!< dcamwait_start; end: DCAMERR
+    ORCA_TRACE_TRANSFERINFO,  //!< dcamcap_transferinfo; end: DCAMERR
+    ORCA_TRACE_CALLBACK,      //!< Frame callback; begin: frame count
+    ORCA_TRACE_STAGE,         //!< Processing stage; begin: stage index
+    ORCA_TRACE_PROP_SET,      //!< Property set; begin: property ID, end: DCAMERR
+    ORCA_TRACE_BUF_ATTACH,    //!< dcambuf_attach; begin: number of frames, end: DCAMERR
+    ORCA_TRACE_BUF_RELEASE,   //!< dcambuf_release; end: DCAMERR
+    ORCA_TRACE_CAP_START,     //!< dcamcap_start; begin: DCAMCAP_START mode, end: DCAMERR
+    ORCA_TRACE_CAP_STOP,      //!< dcamcap_stop; end: DCAMERR
+    ORCA_TRACE_ERROR,         //!< Failed driver call (instant): DCAMERR
+    ORCA_TRACE_EVENT_MAX,     //!< Number of events
+} ORCA_TRACE_EVENT;
+
+/**
+ * @brief Phase of a traced event
+ *
+ */
+typedef enum _ORCA_TRACE_PHASE
+{
+    ORCA_TRACE_BEGIN = 0, //!< Start of a duration
+    ORCA_TRACE_END,       //!< End of a duration
+    ORCA_TRACE_INSTANT,   //!< Instant event
+} ORCA_TRACE_PHASE;
+
+/**
+ * @brief Trace record
+ *
+ */
+typedef struct _ORCA_TRACE_RECORD
+{
+    uint64_t tsc;   //!< Time stamp counter (CLOCK_MONOTONIC ns where there is no TSC)
+    uint64_t arg;   //!< Event argument
+    uint16_t event; //!< ORCA_TRACE_EVENT
+    uint16_t phase; //!< ORCA_TRACE_PHASE
+    uint32_t tid;   //!< Thread ID
+} ORCA_TRACE_RECORD;
+
+/**
+ * @brief Check whether the library was built with the trace points
+ * (-DORCACAM_TRACE). Without them, traces are empty.
+ *
+ * @return bool
+ */
+bool orca_trace_enabled(void);
+
+/**
+ * @brief Discard the records of all the threads.
+ *
+ */
+void orca_trace_clear(void);
+
+/**
+ * @brief Save the records of all the threads to a binary trace file.
+ *
+ * Recording continues while the rings are copied; records overwritten
+ * during the copy are left out.
+ *
+ * @param path File path
+ * @return DCAMERR
+ */
+DCAMERR orca_trace_save(const char *_Nonnull path);
+
+/**
+ * @brief Convert a binary trace file to Chrome trace event JSON, which
+ * chrome://tracing and ui.perfetto.dev open.
+ *
+ * @param path Binary trace file path
+ * @param json_path JSON file path
+ * @return DCAMERR
+ */
+DCAMERR orca_trace_export(const char *_Nonnull path, const char *_Nonnull json_path);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // _ORCACAM_TRACE_H_
@@ -1,43 +1,97 @@
+#define _GNU_SOURCE
 #include "orcacam.h"
+#include "orcacam_hist.h"
+#include "orcacam_logsite.h"
+#include "orcacam_numa.h"
+#include "orcacam_prop.h"
+#include "orcacam_tracepoint.h"
 #include <pthread.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <unistd.h>
 
-#ifndef NDEBUG
-#include <stdio.h>
-#endif
-
-#ifdef NDEBUG
-#define ORCACALL(func, ...) func(__VA_ARGS__)
-#else
+// Failed calls are logged asynchronously, see orcacam_log.h
 #define ORCACALL(func, ...)                                                    \
     ({                                                                         \
         DCAMERR err = func(__VA_ARGS__);                                       \
         if (orcaerr_failed(err))                                               \
         {                                                                      \
-            fprintf(stderr, "%s:%d:%s() -> %s\n", __FILE__, __LINE__,          \
-                    __func__, orcacam_sterr(err));                             \
-            fflush(stderr);                                                    \
+            ORCA_TRACE_INSTANT(ORCA_TRACE_ERROR, (uint32_t)err);               \
+            ORCA_LOG(orcacam_log_severity(err), err, "%s", #func);             \
         }                                                                      \
         err;                                                                   \
     })
-#endif
+
+// ORCACALL between the begin and end records of a trace event
+#define ORCATRACE(event, arg, func, ...)                                       \
+    ({                                                                         \
+        ORCA_TRACE_BEGIN(event, arg);                                          \
+        DCAMERR ret_ = ORCACALL(func, __VA_ARGS__);                            \
+        ORCA_TRACE_END(event, (uint32_t)ret_);                                 \
+        ret_;                                                                  \
+    })
+
+struct _ORCA_PRESET;
 
 static void *orcacam_capture_thread(void *inp);
+static void *orcacam_history_thread(void *inp);
+static void *orcacam_snap_thread(void *inp);
+static void orcacam_preset_detach(struct _ORCACAM *cam);
+static void orcacam_preset_free(struct _ORCA_PRESET *p);
 
 void orcapi_uninit(void)
 {
     DCAMERR err = dcamapi_uninit();
     if (orcaerr_failed(err))
     {
-        fprintf(stderr, "ERROR: Could not de-init DCAMAPI -> %s (%d)\n",
-                orcacam_sterr(err), err);
-        fflush(stderr);
+        ORCA_LOG(ORCA_LOG_ERROR, err, "Could not de-init DCAMAPI");
+    }
+}
+
+struct _ORCA_STAGE
+{
+    OrcaFrameCallback cb;
+    void *user_data;
+    size_t sz_user_data;
+};
+
+static inline void orcacam_run_stages(const struct _ORCA_STAGE *stages,
+                                      int32 num_stages, ORCA_FRAME *frame,
+                                      const ORCA_TRIGGER_INFO *trigger,
+                                      const ORCA_CAPTURE_INFO *capture,
+                                      const ORCA_HISTORY_INFO *history)
+{
+    memset(frame->meta, 0, sizeof(frame->meta));
+    frame->meta[ORCA_META_TRIGGER] = trigger;
+    frame->meta[ORCA_META_CAPTURE] = capture;
+    frame->meta[ORCA_META_HISTORY] = history;
+    for (int32 i = 0; i < num_stages; i++)
+    {
+        ORCA_TRACE_BEGIN(ORCA_TRACE_STAGE, i);
+        stages[i].cb(frame, stages[i].user_data, stages[i].sz_user_data);
+        ORCA_TRACE_END(ORCA_TRACE_STAGE, 0);
     }
 }
 
+// Fill in the trigger of the frame with the given frame count. Returns NULL
+// with the internal trigger, where frames carry no trigger information.
+static inline const ORCA_TRIGGER_INFO *
+orcacam_trigger_info(ORCA_TRIGGER_INFO *trigger, uint64_t frame_count,
+                     atomic_uint_fast64_t *fired)
+{
+    if (trigger->source == 0 ||
+        trigger->source == DCAMPROP_TRIGGERSOURCE__INTERNAL)
+    {
+        return NULL;
+    }
+    // in synchronous readout mode the first trigger only starts the exposure
+    trigger->sequence =
+        frame_count + (trigger->active == DCAMPROP_TRIGGERACTIVE__SYNCREADOUT);
+    trigger->fired = atomic_load(fired);
+    return trigger;
+}
+
 struct _ORCA_THREAD_ARGS
 {
     DCAMERR ret;
@@ -49,18 +103,46 @@ struct _ORCA_THREAD_ARGS
     OrcaFrameCallback cb;
     int32 topoffset, rowbytes, width, height;
     DCAM_PIXELTYPE fmt;
+    struct _ORCA_STAGE stages[ORCA_MAX_STAGES];
+    int32 num_stages;
+    // history mode
+    size_t num_frames;
+    int32 pre_frames, post_frames;
+    atomic_uint_fast64_t *event; // 1 + frame count at the trigger, 0 if none
+    ORCA_TRIGGER_INFO trigger;
+    atomic_uint_fast64_t *fired;
+    // snap mode
+    double *timestamps;
+    OrcaSnapCallback done;
+    struct _ORCA_STATS_REC *stats;
 };
 
 struct _ORCACAM
 {
     HDCAM hdcam;
     HDCAMWAIT hwait;
+    struct _ORCA_PROPCACHE *props;
     atomic_bool capturing;
     char *framebuf; // DO NOT USE
     void **frameptr;
     size_t num_frames;
     size_t frame_size;
     pthread_t capture_thread;
+    bool threaded; // capturing with a capture or history thread
+    struct _ORCA_STAGE stages[ORCA_MAX_STAGES];
+    int32 num_stages;
+    struct _ORCA_PRESET *presets[ORCA_MAX_PRESETS];
+    struct _ORCA_PRESET *preset; // preset whose ring is attached
+    atomic_bool history;         // capturing in history mode
+    atomic_uint_fast64_t history_event;
+    ORCA_TRIGGER_INFO trigger;          // trigger of the running acquisition
+    atomic_uint_fast64_t triggers_fired; // software triggers fired
+    void **user_frameptr;                // caller ring, NULL if none
+    size_t user_num_frames;
+    size_t user_bytes;
+    void **ring; // ring attached to the running acquisition
+    int32 numa_node; // node of the rings and capture threads, -1 if none
+    struct _ORCA_STATS_REC stats;
 };
 
 DCAMERR orca_list_devices(int32 *count, int32 sz_initopt, const int32 *initopt)
@@ -113,6 +195,20 @@ DCAMERR orca_open_camera(int32 idx, ORCACAM *hdcam, size_t num_frames)
     }
     cam->hwait     = wait.hwait;
     cam->capturing = ATOMIC_VAR_INIT(false);
+    // Build the property table
+    err = orcacam_prop_create(&(cam->props), cam->hdcam);
+    if (orcaerr_failed(err))
+    {
+        goto close_wait;
+    }
+    orcacam_stats_reset(&(cam->stats));
+    // Place the frame buffers on the node of the camera
+    cam->numa_node = -1;
+    ORCA_CAM_INFO info;
+    if (!orcaerr_failed(orca_device_info(cam, &info)))
+    {
+        cam->numa_node = orcacam_numa_node(info.bus, info.id);
+    }
     // Get the sensor size and set the ROI
     err = orca_get_sensor_size(cam, &w, &h);
     if (orcaerr_failed(err))
@@ -129,6 +225,7 @@ DCAMERR orca_open_camera(int32 idx, ORCACAM *hdcam, size_t num_frames)
     *hdcam = cam;
     goto ret; // success!
 close_wait:
+    orcacam_prop_destroy(&(cam->props));
     ORCACALL(dcamwait_close, cam->hwait);
 close_camera:
     ORCACALL(dcamdev_close, cam->hdcam);
@@ -147,6 +244,8 @@ DCAMERR orca_realloc_framebuffer(ORCACAM cam, size_t num_frames)
     {
         return DCAMERR_BUSY;
     }
+    // the camera ring is re-allocated, the preset ring is left as is
+    orcacam_preset_detach(cam);
     if (num_frames == 0)
     {
         num_frames = DEFAULT_FRAME_COUNT;
@@ -160,8 +259,8 @@ DCAMERR orca_realloc_framebuffer(ORCACAM cam, size_t num_frames)
         need_realloc = true;
     }
     double v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_BUFFER_FRAMEBYTES,
-                   &v);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                   DCAM_IDPROP_BUFFER_FRAMEBYTES, &v);
     if (orcaerr_failed(err))
     {
         return err;
@@ -209,9 +308,108 @@ DCAMERR orca_realloc_framebuffer(ORCACAM cam, size_t num_frames)
     {
         cam->frameptr[i] = cam->framebuf + i * frame_size;
     }
+    if (need_realloc)
+    {
+        orcacam_numa_bind(cam->framebuf, frame_size * num_frames,
+                          cam->numa_node);
+    }
+    return err;
+}
+
+// Check caller frame buffers against the frame size of the current format
+static DCAMERR orcacam_buffer_check(struct _ORCACAM *cam, void **buffers,
+                                    int32 count, size_t buffer_bytes)
+{
+    double v;
+    DCAMERR err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                           DCAM_IDPROP_BUFFER_FRAMEBYTES, &v);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    if (count <= 0 || buffer_bytes < (size_t)v)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    for (int32 i = 0; i < count; i++)
+    {
+        if (!buffers[i] || ((uintptr_t)buffers[i] % ORCA_BUFFER_ALIGN))
+        {
+            return DCAMERR_INVALIDPARAM;
+        }
+    }
+    return err;
+}
+
+// Get the ring to attach to an acquisition: the caller ring if one is
+// attached, checked against the current format, or the library ring.
+static DCAMERR orcacam_ring(struct _ORCACAM *cam, void ***frameptr,
+                            size_t *num_frames)
+{
+    if (!cam->user_frameptr)
+    {
+        *frameptr   = cam->frameptr;
+        *num_frames = cam->num_frames;
+        return DCAMERR_SUCCESS;
+    }
+    DCAMERR err =
+        orcacam_buffer_check(cam, cam->user_frameptr,
+                             (int32)cam->user_num_frames, cam->user_bytes);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    *frameptr   = cam->user_frameptr;
+    *num_frames = cam->user_num_frames;
+    return err;
+}
+
+DCAMERR orca_attach_buffers(ORCACAM cam, void **buffers, size_t num_frames,
+                            size_t buffer_bytes)
+{
+    assert(cam);
+    assert(buffers);
+    if (atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_BUSY;
+    }
+    if (num_frames == 0 || num_frames > INT32_MAX)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    DCAMERR err =
+        orcacam_buffer_check(cam, buffers, (int32)num_frames, buffer_bytes);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    void **frameptr = (void **)malloc(sizeof(void *) * num_frames);
+    if (!frameptr)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memcpy(frameptr, buffers, sizeof(void *) * num_frames);
+    free(cam->user_frameptr);
+    cam->user_frameptr   = frameptr;
+    cam->user_num_frames = num_frames;
+    cam->user_bytes      = buffer_bytes;
     return err;
 }
 
+DCAMERR orca_detach_buffers(ORCACAM cam)
+{
+    assert(cam);
+    if (atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_BUSY;
+    }
+    free(cam->user_frameptr);
+    cam->user_frameptr   = NULL;
+    cam->user_num_frames = 0;
+    cam->user_bytes      = 0;
+    return DCAMERR_SUCCESS;
+}
+
 DCAMERR orca_device_info(ORCACAM cam, ORCA_CAM_INFO *info)
 {
     assert(cam);
@@ -283,13 +481,13 @@ DCAMERR orca_device_info(ORCACAM cam, ORCA_CAM_INFO *info)
         return err;
     }
     double w, h;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam,
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
                    DCAM_IDPROP_IMAGEDETECTOR_PIXELNUMHORZ, &w);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam,
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
                    DCAM_IDPROP_IMAGEDETECTOR_PIXELNUMVERT, &h);
     if (orcaerr_failed(err))
     {
@@ -297,13 +495,13 @@ DCAMERR orca_device_info(ORCACAM cam, ORCA_CAM_INFO *info)
     }
     info->width  = (int32)w;
     info->height = (int32)h;
-    err          = ORCACALL(dcamprop_getvalue, cam->hdcam,
+    err          = ORCACALL(orcacam_prop_getvalue, cam->props,
                             DCAM_IDPROP_IMAGEDETECTOR_PIXELWIDTH, &w);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam,
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
                    DCAM_IDPROP_IMAGEDETECTOR_PIXELHEIGHT, &h);
     if (orcaerr_failed(err))
     {
@@ -321,13 +519,13 @@ DCAMERR orca_get_sensor_size(ORCACAM cam, int32 *wid, int32 *hei)
     assert(hei);
     DCAMERR err;
     double w, h;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam,
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
                    DCAM_IDPROP_IMAGEDETECTOR_PIXELNUMHORZ, &w);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam,
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
                    DCAM_IDPROP_IMAGEDETECTOR_PIXELNUMVERT, &h);
     if (orcaerr_failed(err))
     {
@@ -343,8 +541,8 @@ DCAMERR orca_get_temperature(ORCACAM cam, double *temp)
     assert(cam);
     assert(temp);
     DCAMERR err;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_SENSORTEMPERATURE,
-                   temp);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                   DCAM_IDPROP_SENSORTEMPERATURE, temp);
     return err;
 }
 
@@ -352,7 +550,7 @@ DCAMERR orca_set_tempsetpoint(ORCACAM cam, double temp)
 {
     assert(cam);
     DCAMERR err;
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam,
+    err = ORCACALL(orcacam_prop_setvalue, cam->props,
                    DCAM_IDPROP_SENSORTEMPERATURETARGET, temp);
     return err;
 }
@@ -361,7 +559,7 @@ DCAMERR orca_get_tempsetpoint(ORCACAM cam, double *temp)
 {
     assert(cam);
     DCAMERR err;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam,
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
                    DCAM_IDPROP_SENSORTEMPERATURETARGET, temp);
     return err;
 }
@@ -371,8 +569,8 @@ DCAMERR orca_get_exposure(ORCACAM cam, double *exp)
     assert(cam);
     assert(exp);
     DCAMERR err;
-    err =
-        ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_EXPOSURETIME, exp);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_EXPOSURETIME,
+                   exp);
     return err;
 }
 
@@ -380,8 +578,8 @@ DCAMERR orca_set_exposure(ORCACAM cam, double exp)
 {
     assert(cam);
     DCAMERR err;
-    err =
-        ORCACALL(dcamprop_setvalue, cam->hdcam, DCAM_IDPROP_EXPOSURETIME, exp);
+    err = ORCACALL(orcacam_prop_setvalue, cam->props, DCAM_IDPROP_EXPOSURETIME,
+                   exp);
     return err;
 }
 
@@ -391,8 +589,8 @@ DCAMERR orca_get_pixel_fmt(ORCACAM cam, DCAM_PIXELTYPE *fmt)
     assert(fmt);
     DCAMERR err;
     double f;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_IMAGE_PIXELTYPE,
-                   &f);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                   DCAM_IDPROP_IMAGE_PIXELTYPE, &f);
     if (orcaerr_failed(err))
     {
         return err;
@@ -417,8 +615,8 @@ DCAMERR orca_set_pixel_fmt(ORCACAM cam, DCAM_PIXELTYPE fmt)
     default:
         return DCAMERR_NOTSUPPORT;
     }
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam, DCAM_IDPROP_IMAGE_PIXELTYPE,
-                   (double)fmt);
+    err = ORCACALL(orcacam_prop_setvalue, cam->props,
+                   DCAM_IDPROP_IMAGE_PIXELTYPE, (double)fmt);
     if (orcaerr_failed(err))
     {
         return err;
@@ -434,13 +632,15 @@ DCAMERR orca_get_frame_size(ORCACAM cam, int32 *w, int32 *h)
     assert(h);
     DCAMERR err;
     double v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_IMAGE_WIDTH, &v);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_IMAGE_WIDTH,
+                   &v);
     if (orcaerr_failed(err))
     {
         return err;
     }
     *w  = (int32)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_IMAGE_HEIGHT, &v);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_IMAGE_HEIGHT,
+                   &v);
     if (orcaerr_failed(err))
     {
         return err;
@@ -458,27 +658,29 @@ DCAMERR orca_get_roi(ORCACAM cam, int32 *x, int32 *y, int32 *w, int32 *h)
     assert(h);
     DCAMERR err;
     double v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYHPOS, &v);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_SUBARRAYHPOS,
+                   &v);
     if (orcaerr_failed(err))
     {
         return err;
     }
     *x  = (int32)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYVPOS, &v);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_SUBARRAYVPOS,
+                   &v);
     if (orcaerr_failed(err))
     {
         return err;
     }
     *y = (int32)v;
-    err =
-        ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYHSIZE, &v);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_SUBARRAYHSIZE,
+                   &v);
     if (orcaerr_failed(err))
     {
         return err;
     }
     *w = (int32)v;
-    err =
-        ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYVSIZE, &v);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_SUBARRAYVSIZE,
+                   &v);
     if (orcaerr_failed(err))
     {
         return err;
@@ -495,42 +697,42 @@ DCAMERR orca_set_roi(ORCACAM cam, int32 x, int32 y, int32 w, int32 h)
         return DCAMERR_BUSY;
     }
     DCAMERR err;
-    err = ORCACALL(dcambuf_release, cam->hdcam, 0);
+    err = ORCATRACE(ORCA_TRACE_BUF_RELEASE, 0, dcambuf_release, cam->hdcam, 0);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYMODE,
+    err = ORCACALL(orcacam_prop_setvalue, cam->props, DCAM_IDPROP_SUBARRAYMODE,
                    DCAMPROP_MODE__OFF);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYHPOS,
+    err = ORCACALL(orcacam_prop_setvalue, cam->props, DCAM_IDPROP_SUBARRAYHPOS,
                    (double)x);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYVPOS,
+    err = ORCACALL(orcacam_prop_setvalue, cam->props, DCAM_IDPROP_SUBARRAYVPOS,
                    (double)y);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYHSIZE,
+    err = ORCACALL(orcacam_prop_setvalue, cam->props, DCAM_IDPROP_SUBARRAYHSIZE,
                    (double)w);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYVSIZE,
+    err = ORCACALL(orcacam_prop_setvalue, cam->props, DCAM_IDPROP_SUBARRAYVSIZE,
                    (double)h);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam, DCAM_IDPROP_SUBARRAYMODE,
+    err = ORCACALL(orcacam_prop_setvalue, cam->props, DCAM_IDPROP_SUBARRAYMODE,
                    DCAMPROP_MODE__ON);
     if (orcaerr_failed(err))
     {
@@ -545,8 +747,8 @@ DCAMERR orca_get_acq_framerate(ORCACAM cam, double *fps)
     assert(cam);
     assert(fps);
     DCAMERR err;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_INTERNALFRAMERATE,
-                   fps);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                   DCAM_IDPROP_INTERNALFRAMERATE, fps);
     return err;
 }
 
@@ -558,8 +760,8 @@ DCAMERR orca_set_acq_framerate(ORCACAM cam, double fps)
         return DCAMERR_BUSY;
     }
     DCAMERR err;
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam, DCAM_IDPROP_INTERNALFRAMERATE,
-                   fps);
+    err = ORCACALL(orcacam_prop_setvalue, cam->props,
+                   DCAM_IDPROP_INTERNALFRAMERATE, fps);
     return err;
 }
 
@@ -570,7 +772,7 @@ DCAMERR orca_get_attr(ORCACAM cam, DCAMIDPROP prop, DCAMPROP_ATTR *attr)
     DCAMERR err;
     ORCA_PTR_SUBINIT(DCAMPROP_ATTR, param, cbSize);
     param.iProp = prop;
-    err         = ORCACALL(dcamprop_getattr, cam->hdcam, &param);
+    err         = ORCACALL(orcacam_prop_getattr, cam->props, &param);
     if (orcaerr_failed(err))
     {
         return err;
@@ -584,7 +786,7 @@ DCAMERR orca_get_value(ORCACAM cam, DCAMIDPROP prop, double *value)
     assert(cam);
     assert(value);
     DCAMERR err;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, prop, value);
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, prop, value);
     return err;
 }
 
@@ -592,7 +794,7 @@ DCAMERR orca_set_value(ORCACAM cam, DCAMIDPROP prop, double value)
 {
     assert(cam);
     DCAMERR err;
-    err = ORCACALL(dcamprop_setvalue, cam->hdcam, prop, value);
+    err = ORCACALL(orcacam_prop_setvalue, cam->props, prop, value);
     return err;
 }
 
@@ -602,7 +804,7 @@ DCAMERR orca_setget_value(ORCACAM cam, DCAMIDPROP prop, double *value,
     assert(cam);
     assert(value);
     DCAMERR err;
-    err = ORCACALL(dcamprop_setgetvalue, cam->hdcam, prop, value, option);
+    err = ORCACALL(orcacam_prop_setgetvalue, cam->props, prop, value, option);
     return err;
 }
 
@@ -623,6 +825,11 @@ DCAMERR orca_get_next_id(ORCACAM cam, int32 *prop,
     assert(prop);
     DCAMERR err;
     err = ORCACALL(dcamprop_getnextid, cam->hdcam, prop, option);
+    if (option & DCAMPROP_OPTION_UPDATED)
+    {
+        // the update list the cache relies on was consumed here
+        orcacam_prop_invalidate(cam->props);
+    }
     return err;
 }
 
@@ -650,79 +857,121 @@ DCAMERR orca_get_value_text(ORCACAM cam, DCAMIDPROP prop, double value,
     return err;
 }
 
-DCAMERR orca_start_acquisition(ORCACAM cam, ORCA_FRAME *_Nonnull frame)
+// Get the layout of the frames of the current image format
+static DCAMERR orcacam_frame_format(struct _ORCACAM *cam, int32 *topoffset,
+                                   ORCA_FRAME *frame)
 {
-    assert(cam);
-    assert(frame);
     DCAMERR err;
-    int32 topoffset, rowbytes, width, height;
-    DCAM_PIXELTYPE pixeltype;
     double v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam,
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
                    DCAM_IDPROP_BUFFER_TOPOFFSETBYTES, &v);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    topoffset = (int32)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_BUFFER_ROWBYTES,
+    *topoffset = (int32)v;
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                   DCAM_IDPROP_BUFFER_ROWBYTES, &v);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    frame->row_stride = (int32)v;
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                   DCAM_IDPROP_IMAGE_PIXELTYPE, &v);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    frame->fmt = (DCAM_PIXELTYPE)v;
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_IMAGE_WIDTH,
                    &v);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    rowbytes = (int32)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_IMAGE_PIXELTYPE,
+    frame->width = (int32)v;
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_IMAGE_HEIGHT,
                    &v);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    pixeltype = (DCAM_PIXELTYPE)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_IMAGE_WIDTH, &v);
+    frame->height = (int32)v;
+    return err;
+}
+
+// Record the trigger of an acquisition about to start
+static void orcacam_trigger_arm(struct _ORCACAM *cam)
+{
+    double v;
+    memset(&(cam->trigger), 0, sizeof(ORCA_TRIGGER_INFO));
+    if (!orcaerr_failed(orcacam_prop_getvalue(
+            cam->props, DCAM_IDPROP_TRIGGERSOURCE, &v)))
+    {
+        cam->trigger.source = (int32)v;
+    }
+    if (!orcaerr_failed(orcacam_prop_getvalue(
+            cam->props, DCAM_IDPROP_TRIGGERACTIVE, &v)))
+    {
+        cam->trigger.active = (int32)v;
+    }
+    atomic_store(&(cam->triggers_fired), 0);
+}
+
+DCAMERR orca_start_acquisition(ORCACAM cam, ORCA_FRAME *_Nonnull frame)
+{
+    assert(cam);
+    assert(frame);
+    DCAMERR err;
+    int32 topoffset;
+    ORCA_FRAME fmt;
+    err = orcacam_frame_format(cam, &topoffset, &fmt);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    width = (int32)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_IMAGE_HEIGHT, &v);
+    void **frameptr;
+    size_t num_frames;
+    err = orcacam_ring(cam, &frameptr, &num_frames);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    height = (int32)v;
 
-    if (atomic_load(&(cam->capturing)))
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&(cam->capturing), &idle, true))
     {
         return DCAMERR_BUSY;
     }
-    else
-    {
-        atomic_store(&(cam->capturing), true);
-    }
 
     ORCA_PTR_INIT(DCAMBUF_ATTACH, attach);
     attach.iKind       = DCAMBUF_ATTACHKIND_FRAME;
-    attach.buffer      = cam->frameptr;
-    attach.buffercount = cam->num_frames;
-    err                = ORCACALL(dcambuf_attach, cam->hdcam, &attach);
+    attach.buffer      = frameptr;
+    attach.buffercount = num_frames;
+    err                = ORCATRACE(ORCA_TRACE_BUF_ATTACH, attach.buffercount,
+                                   dcambuf_attach, cam->hdcam, &attach);
     if (orcaerr_failed(err))
     {
         atomic_store(&(cam->capturing), false);
         return err;
     }
 
+    orcacam_trigger_arm(cam);
+    cam->ring = frameptr;
     atomic_store(&(cam->capturing), true);
+    ORCA_TRACE_BEGIN(ORCA_TRACE_CAP_START, DCAMCAP_START_SEQUENCE);
     err = dcamcap_start(cam->hdcam, DCAMCAP_START_SEQUENCE);
+    ORCA_TRACE_END(ORCA_TRACE_CAP_START, (uint32_t)err);
     if (orcaerr_failed(err))
     {
         atomic_store(&(cam->capturing), false);
         return err;
     }
-    frame->fmt        = pixeltype;
-    frame->width      = width;
-    frame->height     = height;
-    frame->row_stride = rowbytes;
+    frame->fmt        = fmt.fmt;
+    frame->width      = fmt.width;
+    frame->height     = fmt.height;
+    frame->row_stride = fmt.row_stride;
     frame->data       = NULL;
     frame->rsvd       = topoffset;
     return DCAMERR_SUCCESS;
@@ -735,12 +984,12 @@ DCAMERR orca_stop_acquisition(ORCACAM cam)
     {
         return DCAMERR_NOTREADY;
     }
-    DCAMERR err = ORCACALL(dcamcap_stop, cam->hdcam);
+    DCAMERR err = ORCATRACE(ORCA_TRACE_CAP_STOP, 0, dcamcap_stop, cam->hdcam);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcambuf_release, cam->hdcam, 0);
+    err = ORCATRACE(ORCA_TRACE_BUF_RELEASE, 0, dcambuf_release, cam->hdcam, 0);
     if (orcaerr_failed(err))
     {
         return err;
@@ -769,7 +1018,7 @@ DCAMERR orca_acquire_image(ORCACAM cam, ORCA_FRAME *_Nonnull frame,
     // transfer info
     ORCA_PTR_INIT(DCAMCAP_TRANSFERINFO, xferinfo);
 
-    err = ORCACALL(dcamwait_start, cam->hwait, &start);
+    err = ORCATRACE(ORCA_TRACE_WAIT, 0, dcamwait_start, cam->hwait, &start);
     if (orcaerr_failed(err))
     {
         if (err != DCAMERR_TIMEOUT)
@@ -782,77 +1031,60 @@ DCAMERR orca_acquire_image(ORCACAM cam, ORCA_FRAME *_Nonnull frame,
         }
     }
     // get capture info
-    err = ORCACALL(dcamcap_transferinfo, cam->hdcam, &xferinfo);
+    err = ORCATRACE(ORCA_TRACE_TRANSFERINFO, 0, dcamcap_transferinfo,
+                    cam->hdcam, &xferinfo);
     if (orcaerr_failed(err))
     {
         return err;
     }
     // create the frame
-    char *buf = (char *)(cam->frameptr[xferinfo.nNewestFrameIndex]);
+    char *buf = (char *)(cam->ring[xferinfo.nNewestFrameIndex]);
     buf += frame->rsvd; // top offset
     frame->data = buf;
+    // run the processing stages
+    orcacam_run_stages(cam->stages, cam->num_stages, frame,
+                       orcacam_trigger_info(&(cam->trigger),
+                                            xferinfo.nFrameCount,
+                                            &(cam->triggers_fired)),
+                       NULL, NULL);
 
     return DCAMERR_SUCCESS;
 }
 
-DCAMERR orca_start_capture(ORCACAM cam, OrcaFrameCallback cb, void *user_data,
-                           size_t sz_user_data)
+static DCAMERR orcacam_start_thread(struct _ORCACAM *cam,
+                                   void *(*thread)(void *),
+                                   OrcaFrameCallback cb, void *user_data,
+                                   size_t sz_user_data, int32 pre_frames,
+                                   int32 post_frames)
 {
-    assert(cam);
-    assert(cb);
-
     DCAMERR err;
-    int32 topoffset, rowbytes, width, height;
-    DCAM_PIXELTYPE pixeltype;
-    double v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam,
-                   DCAM_IDPROP_BUFFER_TOPOFFSETBYTES, &v);
-    if (orcaerr_failed(err))
-    {
-        return err;
-    }
-    topoffset = (int32)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_BUFFER_ROWBYTES,
-                   &v);
-    if (orcaerr_failed(err))
-    {
-        return err;
-    }
-    rowbytes = (int32)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_IMAGE_PIXELTYPE,
-                   &v);
-    if (orcaerr_failed(err))
-    {
-        return err;
-    }
-    pixeltype = (DCAM_PIXELTYPE)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_IMAGE_WIDTH, &v);
+    int32 topoffset;
+    ORCA_FRAME fmt;
+    err = orcacam_frame_format(cam, &topoffset, &fmt);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    width = (int32)v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_IMAGE_HEIGHT, &v);
+    void **frameptr;
+    size_t num_frames;
+    err = orcacam_ring(cam, &frameptr, &num_frames);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    height = (int32)v;
 
-    if (atomic_load(&(cam->capturing)))
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&(cam->capturing), &idle, true))
     {
         return DCAMERR_BUSY;
     }
-    else
-    {
-        atomic_store(&(cam->capturing), true);
-    }
 
     ORCA_PTR_INIT(DCAMBUF_ATTACH, attach);
     attach.iKind       = DCAMBUF_ATTACHKIND_FRAME;
-    attach.buffer      = cam->frameptr;
-    attach.buffercount = cam->num_frames;
-    err                = ORCACALL(dcambuf_attach, cam->hdcam, &attach);
+    attach.buffer      = frameptr;
+    attach.buffercount = num_frames;
+    err                = ORCATRACE(ORCA_TRACE_BUF_ATTACH, attach.buffercount,
+                                   dcambuf_attach, cam->hdcam, &attach);
     if (orcaerr_failed(err))
     {
         atomic_store(&(cam->capturing), false);
@@ -863,35 +1095,161 @@ DCAMERR orca_start_capture(ORCACAM cam, OrcaFrameCallback cb, void *user_data,
         (struct _ORCA_THREAD_ARGS *)malloc(sizeof(struct _ORCA_THREAD_ARGS));
     if (!args)
     {
+        ORCATRACE(ORCA_TRACE_BUF_RELEASE, 0, dcambuf_release, cam->hdcam, 0);
+        atomic_store(&(cam->capturing), false);
         return DCAMERR_NORESOURCE;
     }
     args->cam          = cam->hdcam;
     args->wait         = cam->hwait;
-    args->frameptr     = cam->frameptr;
+    args->frameptr     = frameptr;
     args->cb           = cb;
     args->user_data    = user_data;
     args->sz_user_data = sz_user_data;
     args->topoffset    = topoffset;
-    args->rowbytes     = rowbytes;
-    args->width        = width;
-    args->height       = height;
-    args->fmt          = pixeltype;
-    atomic_store(&(cam->capturing), true);
-    err = pthread_create(&(cam->capture_thread), NULL, orcacam_capture_thread,
-                         (void *)args);
-    if (err)
+    args->rowbytes     = fmt.row_stride;
+    args->width        = fmt.width;
+    args->height       = fmt.height;
+    args->fmt          = fmt.fmt;
+    args->num_stages   = cam->num_stages;
+    args->num_frames   = num_frames;
+    args->pre_frames   = pre_frames;
+    args->post_frames  = post_frames;
+    args->event        = &(cam->history_event);
+    orcacam_trigger_arm(cam);
+    args->trigger = cam->trigger;
+    args->fired   = &(cam->triggers_fired);
+    args->stats   = &(cam->stats);
+    memcpy(args->stages, cam->stages, sizeof(cam->stages));
+    // set before the start returns, for consumers sizing their queues
+    atomic_store_explicit(&(cam->stats.ring_frames), num_frames,
+                          memory_order_relaxed);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    orcacam_numa_pin(&attr, cam->numa_node);
+    int rc = pthread_create(&(cam->capture_thread), &attr, thread,
+                            (void *)args);
+    pthread_attr_destroy(&attr);
+    if (rc)
     {
+        free(args);
+        ORCATRACE(ORCA_TRACE_BUF_RELEASE, 0, dcambuf_release, cam->hdcam, 0);
+        atomic_store(&(cam->capturing), false);
         return DCAMERR_NORESOURCE;
     }
+    ORCA_TRACE_BEGIN(ORCA_TRACE_CAP_START, DCAMCAP_START_SEQUENCE);
     err = dcamcap_start(cam->hdcam, DCAMCAP_START_SEQUENCE);
+    ORCA_TRACE_END(ORCA_TRACE_CAP_START, (uint32_t)err);
     if (orcaerr_failed(err))
     {
+        // the thread waits for a frame; release it and collect its args
+        ORCACALL(dcamwait_abort, cam->hwait);
+        void *ret = NULL;
+        pthread_join(cam->capture_thread, &ret);
+        free(ret);
+        ORCATRACE(ORCA_TRACE_BUF_RELEASE, 0, dcambuf_release, cam->hdcam, 0);
         atomic_store(&(cam->capturing), false);
-        pthread_cancel(cam->capture_thread);
+        return err;
     }
+    cam->threaded = true;
     return DCAMERR_SUCCESS;
 }
 
+DCAMERR orca_start_capture(ORCACAM cam, OrcaFrameCallback cb, void *user_data,
+                           size_t sz_user_data)
+{
+    assert(cam);
+    assert(cb);
+    return orcacam_start_thread(cam, orcacam_capture_thread, cb, user_data,
+                                sz_user_data, 0, 0);
+}
+
+DCAMERR orca_start_history(ORCACAM cam, int32 pre_frames, int32 post_frames,
+                           OrcaFrameCallback sink, void *user_data,
+                           size_t sz_user_data)
+{
+    assert(cam);
+    assert(sink);
+    DCAMERR err;
+    if (pre_frames < 0 || post_frames < 0 || pre_frames + post_frames == 0)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    if (atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_BUSY;
+    }
+    // the sink has the duration of the pre-trigger window to drain it, and
+    // the slot being written is never delivered
+    size_t num_frames = 2 * (size_t)pre_frames + 2;
+    if (cam->user_frameptr && cam->user_num_frames < num_frames)
+    {
+        return DCAMERR_NORESOURCE;
+    }
+    if (!cam->user_frameptr && cam->num_frames < num_frames)
+    {
+        err = orca_realloc_framebuffer(cam, num_frames);
+        if (orcaerr_failed(err))
+        {
+            return err;
+        }
+        if (cam->num_frames < num_frames)
+        {
+            return DCAMERR_NORESOURCE;
+        }
+    }
+    atomic_store(&(cam->history_event), 0);
+    err = orcacam_start_thread(cam, orcacam_history_thread, sink, user_data,
+                               sz_user_data, pre_frames, post_frames);
+    if (!orcaerr_failed(err))
+    {
+        atomic_store(&(cam->history), true);
+    }
+    return err;
+}
+
+DCAMERR orca_get_frame_count(ORCACAM cam, uint64_t *frame_count)
+{
+    assert(cam);
+    assert(frame_count);
+    if (!atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_NOTREADY;
+    }
+    ORCA_PTR_INIT(DCAMCAP_TRANSFERINFO, xferinfo);
+    DCAMERR err = ORCATRACE(ORCA_TRACE_TRANSFERINFO, 0, dcamcap_transferinfo,
+                            cam->hdcam, &xferinfo);
+    if (!orcaerr_failed(err))
+    {
+        *frame_count = (uint64_t)xferinfo.nFrameCount;
+    }
+    return err;
+}
+
+DCAMERR orca_history_trigger(ORCACAM cam)
+{
+    assert(cam);
+    DCAMERR err;
+    if (!atomic_load(&(cam->history)))
+    {
+        return DCAMERR_NOTREADY;
+    }
+    ORCA_PTR_INIT(DCAMCAP_TRANSFERINFO, xferinfo);
+    err = ORCATRACE(ORCA_TRACE_TRANSFERINFO, 0, dcamcap_transferinfo,
+                    cam->hdcam, &xferinfo);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    uint_fast64_t none = 0;
+    if (!atomic_compare_exchange_strong(&(cam->history_event), &none,
+                                        (uint_fast64_t)xferinfo.nFrameCount +
+                                            1))
+    {
+        return DCAMERR_BUSY;
+    }
+    return err;
+}
+
 DCAMERR orca_stop_capture(ORCACAM cam)
 {
     assert(cam);
@@ -901,17 +1259,23 @@ DCAMERR orca_stop_capture(ORCACAM cam)
         // fflush(stdout);
         return DCAMERR_NOTREADY;
     }
-    DCAMERR err = ORCACALL(dcamcap_stop, cam->hdcam);
+    if (!cam->threaded)
+    {
+        return DCAMERR_BUSY; // polled acquisition or snap, no thread to join
+    }
+    DCAMERR err = ORCATRACE(ORCA_TRACE_CAP_STOP, 0, dcamcap_stop, cam->hdcam);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    err = ORCACALL(dcambuf_release, cam->hdcam, 0);
+    err = ORCATRACE(ORCA_TRACE_BUF_RELEASE, 0, dcambuf_release, cam->hdcam, 0);
     if (orcaerr_failed(err))
     {
         return err;
     }
     err = ORCACALL(dcamwait_abort, cam->hwait);
+    atomic_store(&(cam->history), false);
+    cam->threaded = false;
     atomic_store(&(cam->capturing), false);
     if (orcaerr_failed(err))
     {
@@ -937,96 +1301,1112 @@ DCAMERR orca_stop_capture(ORCACAM cam)
     return (DCAMERR)err;
 }
 
-DCAMERR orca_close_camera(ORCACAM *cam_)
+// Attach caller buffers as the ring of a snap
+static DCAMERR orcacam_snap_attach(struct _ORCACAM *cam, int32 num_frames,
+                                   void **buffers, size_t buffer_bytes)
 {
-    DCAMERR err = DCAMERR_SUCCESS;
-    ORCACAM cam = *cam_;
-    if (!cam)
-    {
-        goto ret;
-    }
-    err = orca_stop_capture(cam);
-    if (orcaerr_failed(err) && err != DCAMERR_NOTREADY)
+    DCAMERR err = orcacam_buffer_check(cam, buffers, num_frames, buffer_bytes);
+    if (orcaerr_failed(err))
     {
-        fprintf(stderr, "Failed to stop capture: %s\n", orcacam_sterr(err));
+        return err;
     }
-    err = ORCACALL(dcamwait_close, cam->hwait);
-    if (orcaerr_failed(err))
+    bool idle = false;
+    if (!atomic_compare_exchange_strong(&(cam->capturing), &idle, true))
     {
-        fprintf(stderr, "Failed to close wait object: %s\n",
-                orcacam_sterr(err));
+        return DCAMERR_BUSY;
     }
-    // printf("Closed wait object\n");
-    // fflush(stdout);
-    sleep(1);
-    err = ORCACALL(dcamdev_close, cam->hdcam);
+    ORCA_PTR_INIT(DCAMBUF_ATTACH, attach);
+    attach.iKind       = DCAMBUF_ATTACHKIND_FRAME;
+    attach.buffer      = buffers;
+    attach.buffercount = num_frames;
+    err                = ORCATRACE(ORCA_TRACE_BUF_ATTACH, attach.buffercount,
+                                   dcambuf_attach, cam->hdcam, &attach);
     if (orcaerr_failed(err))
     {
-        fprintf(stderr, "Failed to close camera: %s\n", orcacam_sterr(err));
+        atomic_store(&(cam->capturing), false);
+        return err;
     }
-    // printf("Closed camera\n");
-    // fflush(stdout);
-    if (cam->framebuf)
+    orcacam_trigger_arm(cam);
+    return err;
+}
+
+// Wait for a snap to complete. The transfer info is checked before every
+// wait, as frames may arrive between two waits.
+static DCAMERR orcacam_snap_wait(HDCAM cam, HDCAMWAIT wait, int32 num_frames,
+                                 int32 timeout, int32 *captured)
+{
+    DCAMERR err = DCAMERR_SUCCESS;
+    ORCA_PTR_INIT(DCAMWAIT_START, start);
+    start.eventmask = DCAMWAIT_CAPEVENT_FRAMEREADY | DCAMWAIT_CAPEVENT_STOPPED;
+    start.timeout   = timeout;
+    ORCA_PTR_INIT(DCAMCAP_TRANSFERINFO, xferinfo);
+    while (true)
     {
-        free(cam->framebuf);
+        DCAMERR ret = ORCATRACE(ORCA_TRACE_TRANSFERINFO, 0,
+                                dcamcap_transferinfo, cam, &xferinfo);
+        if (orcaerr_failed(ret))
+        {
+            return ret;
+        }
+        *captured = xferinfo.nFrameCount;
+        if (*captured >= num_frames)
+        {
+            return DCAMERR_SUCCESS;
+        }
+        if (start.eventhappened & DCAMWAIT_CAPEVENT_STOPPED)
+        {
+            return DCAMERR_ABORT; // stopped before the end of the burst
+        }
+        if (err == DCAMERR_TIMEOUT)
+        {
+            return err;
+        }
+        ORCA_TRACE_BEGIN(ORCA_TRACE_WAIT, 0);
+        err = dcamwait_start(wait, &start);
+        ORCA_TRACE_END(ORCA_TRACE_WAIT, (uint32_t)err);
+        if (orcaerr_failed(err) && err != DCAMERR_TIMEOUT)
+        {
+            return err;
+        }
+    }
+}
+
+// Read the camera timestamps of the frames of a snap
+static DCAMERR orcacam_snap_stamps(HDCAM cam, int32 captured,
+                                   double *timestamps)
+{
+    DCAMERR err = DCAMERR_SUCCESS;
+    ORCA_PTR_INIT(DCAMBUF_FRAME, bufframe);
+    for (int32 i = 0; i < captured; i++)
+    {
+        bufframe.iFrame = i;
+        err             = ORCACALL(dcambuf_lockframe, cam, &bufframe);
+        if (orcaerr_failed(err))
+        {
+            break;
+        }
+        timestamps[i] = bufframe.timestamp.sec +
+                        bufframe.timestamp.microsec * 1e-6;
+    }
+    return err;
+}
+
+DCAMERR orca_snap(ORCACAM cam, int32 num_frames, void **buffers,
+                  size_t buffer_bytes, double *timestamps, int32 timeout)
+{
+    assert(cam);
+    assert(buffers);
+    DCAMERR err;
+    int32 captured = 0;
+    err = orcacam_snap_attach(cam, num_frames, buffers, buffer_bytes);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    if (timestamps)
+    {
+        memset(timestamps, 0, sizeof(double) * num_frames);
+    }
+    err = ORCATRACE(ORCA_TRACE_CAP_START, DCAMCAP_START_SNAP, dcamcap_start,
+                    cam->hdcam, DCAMCAP_START_SNAP);
+    if (!orcaerr_failed(err))
+    {
+        err = orcacam_snap_wait(cam->hdcam, cam->hwait, num_frames, timeout,
+                                &captured);
+    }
+    if (!orcaerr_failed(err) && timestamps)
+    {
+        err = orcacam_snap_stamps(cam->hdcam, captured, timestamps);
+    }
+    ORCATRACE(ORCA_TRACE_CAP_STOP, 0, dcamcap_stop, cam->hdcam);
+    ORCATRACE(ORCA_TRACE_BUF_RELEASE, 0, dcambuf_release, cam->hdcam, 0);
+    atomic_store(&(cam->capturing), false);
+    return err;
+}
+
+DCAMERR orca_snap_start(ORCACAM cam, int32 num_frames, void **buffers,
+                        size_t buffer_bytes, double *timestamps,
+                        OrcaSnapCallback done, void *user_data,
+                        size_t sz_user_data)
+{
+    assert(cam);
+    assert(buffers);
+    assert(done);
+    DCAMERR err;
+    err = orcacam_snap_attach(cam, num_frames, buffers, buffer_bytes);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    if (timestamps)
+    {
+        memset(timestamps, 0, sizeof(double) * num_frames);
+    }
+    struct _ORCA_THREAD_ARGS *args =
+        (struct _ORCA_THREAD_ARGS *)malloc(sizeof(struct _ORCA_THREAD_ARGS));
+    if (!args)
+    {
+        err = DCAMERR_LESSSYSTEMMEMORY;
+        goto release;
+    }
+    memset(args, 0, sizeof(struct _ORCA_THREAD_ARGS));
+    args->cam          = cam->hdcam;
+    args->wait         = cam->hwait;
+    args->num_frames   = num_frames;
+    args->timestamps   = timestamps;
+    args->done         = done;
+    args->user_data    = user_data;
+    args->sz_user_data = sz_user_data;
+    // started before the thread, so that done is only called for a burst
+    // that ran; the wait counts the frames captured before it starts
+    err = ORCATRACE(ORCA_TRACE_CAP_START, DCAMCAP_START_SNAP, dcamcap_start,
+                    cam->hdcam, DCAMCAP_START_SNAP);
+    if (orcaerr_failed(err))
+    {
+        free(args);
+        goto release;
+    }
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    orcacam_numa_pin(&attr, cam->numa_node);
+    int rc = pthread_create(&(cam->capture_thread), &attr, orcacam_snap_thread,
+                            (void *)args);
+    pthread_attr_destroy(&attr);
+    if (rc)
+    {
+        ORCATRACE(ORCA_TRACE_CAP_STOP, 0, dcamcap_stop, cam->hdcam);
+        free(args);
+        err = DCAMERR_NORESOURCE;
+        goto release;
+    }
+    return err;
+release:
+    ORCATRACE(ORCA_TRACE_BUF_RELEASE, 0, dcambuf_release, cam->hdcam, 0);
+    atomic_store(&(cam->capturing), false);
+    return err;
+}
+
+DCAMERR orca_set_trigger(ORCACAM cam, DCAMPROPMODEVALUE source,
+                         DCAMPROPMODEVALUE active, DCAMPROPMODEVALUE polarity)
+{
+    assert(cam);
+    if (atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_BUSY;
+    }
+    ORCA_CONFIG cfg;
+    DCAMERR err = orca_config_begin(cam, &cfg);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    err = orca_config_trigger(cfg, source, active, polarity);
+    if (orcaerr_failed(err))
+    {
+        orca_config_abort(&cfg);
+        return err;
+    }
+    return orca_config_commit(&cfg);
+}
+
+DCAMERR orca_get_trigger(ORCACAM cam, DCAMPROPMODEVALUE *source,
+                         DCAMPROPMODEVALUE *active, DCAMPROPMODEVALUE *polarity)
+{
+    assert(cam);
+    assert(source);
+    assert(active);
+    assert(polarity);
+    DCAMERR err;
+    double v;
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                   DCAM_IDPROP_TRIGGERSOURCE, &v);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    *source = (DCAMPROPMODEVALUE)v;
+    err     = ORCACALL(orcacam_prop_getvalue, cam->props,
+                       DCAM_IDPROP_TRIGGERACTIVE, &v);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    *active = (DCAMPROPMODEVALUE)v;
+    err     = ORCACALL(orcacam_prop_getvalue, cam->props,
+                       DCAM_IDPROP_TRIGGERPOLARITY, &v);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    *polarity = (DCAMPROPMODEVALUE)v;
+    return err;
+}
+
+DCAMERR orca_fire_trigger(ORCACAM cam)
+{
+    assert(cam);
+    if (!atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_NOTREADY;
+    }
+    // counted first, so that a frame never reports more triggers than fired
+    atomic_fetch_add(&(cam->triggers_fired), 1);
+    DCAMERR err = ORCACALL(dcamcap_firetrigger, cam->hdcam, 0);
+    if (orcaerr_failed(err))
+    {
+        atomic_fetch_sub(&(cam->triggers_fired), 1);
+    }
+    return err;
+}
+
+DCAMERR orca_add_stage(ORCACAM cam, OrcaFrameCallback stage, void *user_data,
+                       size_t sz_user_data)
+{
+    assert(cam);
+    assert(stage);
+    if (atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_BUSY;
+    }
+    if (cam->num_stages >= ORCA_MAX_STAGES)
+    {
+        return DCAMERR_NORESOURCE;
+    }
+    struct _ORCA_STAGE *st = &(cam->stages[cam->num_stages++]);
+    st->cb                 = stage;
+    st->user_data          = user_data;
+    st->sz_user_data       = sz_user_data;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_clear_stages(ORCACAM cam)
+{
+    assert(cam);
+    if (atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_BUSY;
+    }
+    memset(cam->stages, 0, sizeof(cam->stages));
+    cam->num_stages = 0;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_get_stats(ORCACAM cam, ORCA_STATS *_Nonnull stats)
+{
+    assert(cam);
+    assert(stats);
+    orcacam_stats_snapshot(&(cam->stats), stats);
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_reset_stats(ORCACAM cam)
+{
+    assert(cam);
+    orcacam_stats_reset(&(cam->stats));
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_close_camera(ORCACAM *cam_)
+{
+    DCAMERR err = DCAMERR_SUCCESS;
+    ORCACAM cam = *cam_;
+    if (!cam)
+    {
+        goto ret;
+    }
+    // stopped the way it was started
+    err = cam->threaded ? orca_stop_capture(cam) : orca_stop_acquisition(cam);
+    if (orcaerr_failed(err) && err != DCAMERR_NOTREADY)
+    {
+        ORCA_LOG(ORCA_LOG_ERROR, err, "Failed to stop capture");
+    }
+    err = ORCACALL(dcamwait_close, cam->hwait);
+    if (orcaerr_failed(err))
+    {
+        ORCA_LOG(ORCA_LOG_ERROR, err, "Failed to close wait object");
+    }
+    // printf("Closed wait object\n");
+    // fflush(stdout);
+    sleep(1);
+    err = ORCACALL(dcamdev_close, cam->hdcam);
+    if (orcaerr_failed(err))
+    {
+        ORCA_LOG(ORCA_LOG_ERROR, err, "Failed to close camera");
+    }
+    // printf("Closed camera\n");
+    // fflush(stdout);
+    orcacam_preset_detach(cam);
+    for (int32 i = 0; i < ORCA_MAX_PRESETS; i++)
+    {
+        orcacam_preset_free(cam->presets[i]);
+    }
+    if (cam->framebuf)
+    {
+        free(cam->framebuf);
+    }
+    // printf("Freed frame buffer\n");
+    // fflush(stdout);
+    if (cam->frameptr)
+    {
+        free(cam->frameptr);
+    }
+    free(cam->user_frameptr);
+    orcacam_prop_destroy(&(cam->props));
+    // printf("Freed frame pointer\n");
+    // fflush(stdout);
+    free(cam);
+    // printf("Freed camera object\n");
+    // fflush(stdout);
+    *cam_ = NULL; // prevent use after free
+    err   = dcamapi_uninit();
+ret:
+    return err;
+}
+
+DCAMERR orca_get_mode(ORCACAM cam, DCAMPROPMODEVALUE *mode)
+{
+    assert(cam);
+    assert(mode);
+    DCAMERR err;
+    double v;
+    err = ORCACALL(orcacam_prop_getvalue, cam->props, DCAM_IDPROP_SENSORMODE,
+                   &v);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    *mode = (DCAMPROPMODEVALUE)v;
+    return err;
+}
+
+DCAMERR orca_switch_mode(ORCACAM cam, DCAMPROPMODEVALUE mode)
+{
+    assert(cam);
+    if (atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_BUSY;
+    }
+    DCAMERR err;
+    double v = (double)mode;
+    err = ORCACALL(orcacam_prop_setgetvalue, cam->props, DCAM_IDPROP_SENSORMODE,
+                   &v, 0);
+    DCAMPROPMODEVALUE new_mode = (DCAMPROPMODEVALUE)v;
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    if (new_mode != mode)
+    {
+        ORCA_LOG(ORCA_LOG_ERROR, DCAMERR_NOTSUPPORT,
+                 "Failed to switch mode: Desired mode %d, got mode %d", mode,
+                 new_mode);
+        return DCAMERR_NOTSUPPORT;
+    }
+    return err;
+}
+
+struct _ORCA_CONFIG_STEP
+{
+    int32 prop;
+    double value;
+    double restore; // value to restore on rollback
+    bool has_restore;
+    bool undo; // applied, and to be restored on rollback
+};
+
+struct _ORCA_CONFIG
+{
+    struct _ORCACAM *cam;
+    struct _ORCA_CONFIG_STEP *steps;
+    int32 num_steps;
+    int32 max_steps;
+    bool roi;
+    // the subarray mode is switched off around the subarray properties
+    struct _ORCA_CONFIG_STEP *plan; // max_steps + 2 steps
+    int32 num_plan;
+    bool reshape; // the image format changes
+    struct _ORCA_CONFIG_STEP buf[];
+};
+
+// Order in which the properties of a transaction are applied: the sensor
+// mode and the pixel format change the ranges of the subarray, and the
+// subarray changes the ranges of the timing properties.
+static inline int orcacam_config_rank(int32 prop)
+{
+    switch (prop)
+    {
+    case DCAM_IDPROP_SENSORMODE:
+        return 0;
+    case DCAM_IDPROP_IMAGE_PIXELTYPE:
+        return 1;
+    case DCAM_IDPROP_SUBARRAYMODE:
+    case DCAM_IDPROP_SUBARRAYHPOS:
+    case DCAM_IDPROP_SUBARRAYVPOS:
+    case DCAM_IDPROP_SUBARRAYHSIZE:
+    case DCAM_IDPROP_SUBARRAYVSIZE:
+        return 2;
+    case DCAM_IDPROP_EXPOSURETIME:
+    case DCAM_IDPROP_INTERNALFRAMERATE:
+    case DCAM_IDPROP_INTERNAL_FRAMEINTERVAL:
+        return 4;
+    default:
+        return 3;
+    }
+}
+
+// Allocate a transaction of up to max_steps properties, with the steps and
+// the plan in the same block, so that it is released with free().
+static struct _ORCA_CONFIG *orcacam_config_alloc(struct _ORCACAM *cam,
+                                                 int32 max_steps)
+{
+    struct _ORCA_CONFIG *cfg = (struct _ORCA_CONFIG *)calloc(
+        1, sizeof(struct _ORCA_CONFIG) +
+               sizeof(struct _ORCA_CONFIG_STEP) * (2 * (size_t)max_steps + 2));
+    if (!cfg)
+    {
+        return NULL;
+    }
+    cfg->cam       = cam;
+    cfg->max_steps = max_steps;
+    cfg->steps     = cfg->buf;
+    cfg->plan      = cfg->buf + max_steps;
+    return cfg;
+}
+
+DCAMERR orca_config_begin(ORCACAM cam, ORCA_CONFIG *_Nonnull cfg)
+{
+    assert(cam);
+    assert(cfg);
+    *cfg = orcacam_config_alloc(cam, ORCA_CONFIG_MAX_PROPS);
+    if (!(*cfg))
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_config_set(ORCA_CONFIG cfg, DCAMIDPROP prop, double value)
+{
+    assert(cfg);
+    for (int32 i = 0; i < cfg->num_steps; i++)
+    {
+        if (cfg->steps[i].prop == prop)
+        {
+            cfg->steps[i].value = value;
+            return DCAMERR_SUCCESS;
+        }
+    }
+    if (cfg->num_steps >= cfg->max_steps)
+    {
+        return DCAMERR_NORESOURCE;
+    }
+    cfg->steps[cfg->num_steps].prop  = prop;
+    cfg->steps[cfg->num_steps].value = value;
+    cfg->num_steps++;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_config_mode(ORCA_CONFIG cfg, DCAMPROPMODEVALUE mode)
+{
+    return orca_config_set(cfg, DCAM_IDPROP_SENSORMODE, (double)mode);
+}
+
+DCAMERR orca_config_pixel_fmt(ORCA_CONFIG cfg, DCAM_PIXELTYPE fmt)
+{
+    switch (fmt)
+    {
+    case DCAM_PIXELTYPE_MONO8:
+    case DCAM_PIXELTYPE_MONO16:
+        break;
+    default:
+        return DCAMERR_NOTSUPPORT;
+    }
+    return orca_config_set(cfg, DCAM_IDPROP_IMAGE_PIXELTYPE, (double)fmt);
+}
+
+DCAMERR orca_config_roi(ORCA_CONFIG cfg, int32 x, int32 y, int32 w, int32 h)
+{
+    assert(cfg);
+    DCAMERR err;
+    err = orca_config_set(cfg, DCAM_IDPROP_SUBARRAYHPOS, (double)x);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    err = orca_config_set(cfg, DCAM_IDPROP_SUBARRAYVPOS, (double)y);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    err = orca_config_set(cfg, DCAM_IDPROP_SUBARRAYHSIZE, (double)w);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    err = orca_config_set(cfg, DCAM_IDPROP_SUBARRAYVSIZE, (double)h);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    cfg->roi = true;
+    return err;
+}
+
+DCAMERR orca_config_exposure(ORCA_CONFIG cfg, double exposure)
+{
+    return orca_config_set(cfg, DCAM_IDPROP_EXPOSURETIME, exposure);
+}
+
+DCAMERR orca_config_trigger(ORCA_CONFIG cfg, DCAMPROPMODEVALUE source,
+                            DCAMPROPMODEVALUE active,
+                            DCAMPROPMODEVALUE polarity)
+{
+    assert(cfg);
+    DCAMERR err;
+    err = orca_config_set(cfg, DCAM_IDPROP_TRIGGERSOURCE, (double)source);
+    if (!orcaerr_failed(err) && active)
+    {
+        err = orca_config_set(cfg, DCAM_IDPROP_TRIGGERACTIVE, (double)active);
+    }
+    if (!orcaerr_failed(err) && polarity)
+    {
+        err = orca_config_set(cfg, DCAM_IDPROP_TRIGGERPOLARITY,
+                              (double)polarity);
+    }
+    return err;
+}
+
+// Restore the applied steps. Restoring runs in the order of application,
+// so that the sensor mode is restored before the ranges that depend on it,
+// and the subarray off step comes before the ROI.
+static void orcacam_config_rollback(struct _ORCA_CONFIG *cfg)
+{
+    struct _ORCA_PROPCACHE *props = cfg->cam->props;
+    for (int32 i = 0; i < cfg->num_plan; i++)
+    {
+        struct _ORCA_CONFIG_STEP *step = &(cfg->plan[i]);
+        if (step->undo && step->has_restore)
+        {
+            ORCACALL(orcacam_prop_setvalue, props, step->prop, step->restore);
+        }
+    }
+}
+
+// Validate and apply the staged properties, without touching the frame
+// buffer. The properties are restored if any of them can not be applied.
+static DCAMERR orcacam_config_apply(struct _ORCA_CONFIG *cfg)
+{
+    struct _ORCACAM *cam           = cfg->cam;
+    struct _ORCA_CONFIG_STEP *plan = cfg->plan;
+    DCAMERR err                    = DCAMERR_SUCCESS;
+    int32 off_step = -1, on_step = -1;
+    double subarray_mode = DCAMPROP_MODE__ON;
+    bool skip_range      = false;
+    cfg->num_plan        = 0;
+    cfg->reshape         = false;
+    // stable sort by rank
+    for (int32 i = 1; i < cfg->num_steps; i++)
+    {
+        struct _ORCA_CONFIG_STEP step = cfg->steps[i];
+        int rank                      = orcacam_config_rank(step.prop);
+        int32 j                       = i - 1;
+        while (j >= 0 && orcacam_config_rank(cfg->steps[j].prop) > rank)
+        {
+            cfg->steps[j + 1] = cfg->steps[j];
+            j--;
+        }
+        cfg->steps[j + 1] = step;
+    }
+    for (int32 i = 0; i < cfg->num_steps; i++)
+    {
+        if (cfg->steps[i].prop == DCAM_IDPROP_SUBARRAYMODE)
+        {
+            subarray_mode = cfg->steps[i].value;
+        }
+    }
+    for (int32 i = 0; i < cfg->num_steps; i++)
+    {
+        int rank = orcacam_config_rank(cfg->steps[i].prop);
+        if (cfg->roi && off_step < 0 && rank >= 2)
+        {
+            off_step = cfg->num_plan++;
+            memset(&(plan[off_step]), 0, sizeof(struct _ORCA_CONFIG_STEP));
+            plan[off_step].prop  = DCAM_IDPROP_SUBARRAYMODE;
+            plan[off_step].value = DCAMPROP_MODE__OFF;
+        }
+        if (cfg->roi && on_step < 0 && rank > 2)
+        {
+            on_step = cfg->num_plan++;
+            memset(&(plan[on_step]), 0, sizeof(struct _ORCA_CONFIG_STEP));
+            plan[on_step].prop  = DCAM_IDPROP_SUBARRAYMODE;
+            plan[on_step].value = subarray_mode;
+        }
+        if (cfg->roi && cfg->steps[i].prop == DCAM_IDPROP_SUBARRAYMODE)
+        {
+            continue; // replaced by the off and on steps
+        }
+        plan[cfg->num_plan]             = cfg->steps[i];
+        plan[cfg->num_plan].has_restore = false;
+        plan[cfg->num_plan].undo        = false;
+        cfg->num_plan++;
+    }
+    if (cfg->roi && on_step < 0)
+    {
+        on_step = cfg->num_plan++;
+        memset(&(plan[on_step]), 0, sizeof(struct _ORCA_CONFIG_STEP));
+        plan[on_step].prop  = DCAM_IDPROP_SUBARRAYMODE;
+        plan[on_step].value = subarray_mode;
+    }
+    // validate every step against the attribute table before applying any
+    for (int32 i = 0; i < cfg->num_plan; i++)
+    {
+        ORCA_PTR_SUBINIT(DCAMPROP_ATTR, attr, cbSize);
+        attr.iProp = plan[i].prop;
+        err        = ORCACALL(orcacam_prop_getattr, cam->props, &attr);
+        if (orcaerr_failed(err))
+        {
+            return err;
+        }
+        if (!(attr.attribute & DCAMPROP_ATTR_WRITABLE))
+        {
+            return DCAMERR_NOTWRITABLE;
+        }
+        // ranges after a mode or image format change are not known yet
+        if (!skip_range && (attr.attribute & DCAMPROP_ATTR_HASRANGE) &&
+            (plan[i].value < attr.valuemin || plan[i].value > attr.valuemax))
+        {
+            return DCAMERR_OUTOFRANGE;
+        }
+        if (plan[i].prop == DCAM_IDPROP_SENSORMODE ||
+            (attr.attribute & DCAMPROP_ATTR_DATASTREAM))
+        {
+            skip_range = true;
+        }
+        if (orcacam_config_rank(plan[i].prop) <= 2 ||
+            (attr.attribute & DCAMPROP_ATTR_DATASTREAM))
+        {
+            cfg->reshape = true;
+        }
+    }
+    // record the values to restore on failure
+    for (int32 i = 0; i < cfg->num_plan; i++)
+    {
+        if (i == off_step)
+        {
+            plan[i].restore     = DCAMPROP_MODE__OFF;
+            plan[i].has_restore = true;
+            continue;
+        }
+        err = orcacam_prop_getvalue(cam->props, plan[i].prop,
+                                    &(plan[i].restore));
+        plan[i].has_restore = !orcaerr_failed(err);
+    }
+    err = DCAMERR_SUCCESS;
+    if (cfg->reshape)
+    {
+        err = ORCATRACE(ORCA_TRACE_BUF_RELEASE, 0, dcambuf_release, cam->hdcam,
+                        0);
+        if (orcaerr_failed(err))
+        {
+            return err;
+        }
+    }
+    for (int32 i = 0; i < cfg->num_plan; i++)
+    {
+        double v = plan[i].value;
+        err = ORCACALL(orcacam_prop_setgetvalue, cam->props, plan[i].prop, &v,
+                       0);
+        plan[i].undo = !orcaerr_failed(err);
+        if (!orcaerr_failed(err) && plan[i].prop == DCAM_IDPROP_SENSORMODE &&
+            v != plan[i].value)
+        {
+            err = DCAMERR_NOTSUPPORT;
+        }
+        if (orcaerr_failed(err))
+        {
+            if (off_step >= 0 && plan[off_step].undo)
+            {
+                plan[on_step].undo = true; // turn the subarray back on
+            }
+            orcacam_config_rollback(cfg);
+            return err;
+        }
+    }
+    return err;
+}
+
+DCAMERR orca_config_commit(ORCA_CONFIG *_Nonnull cfg_)
+{
+    assert(cfg_);
+    struct _ORCA_CONFIG *cfg = *cfg_;
+    assert(cfg);
+    struct _ORCACAM *cam = cfg->cam;
+    DCAMERR err;
+    if (atomic_load(&(cam->capturing)))
+    {
+        err = DCAMERR_BUSY;
+        goto ret;
+    }
+    err = orcacam_config_apply(cfg);
+    if (orcaerr_failed(err))
+    {
+        goto ret;
     }
-    // printf("Freed frame buffer\n");
-    // fflush(stdout);
-    if (cam->frameptr)
+    if (cfg->reshape)
     {
-        free(cam->frameptr);
+        err = orca_realloc_framebuffer(cam, cam->num_frames);
+        if (orcaerr_failed(err))
+        {
+            orcacam_config_rollback(cfg);
+            orca_realloc_framebuffer(cam, cam->num_frames);
+        }
     }
-    // printf("Freed frame pointer\n");
-    // fflush(stdout);
-    free(cam);
-    // printf("Freed camera object\n");
-    // fflush(stdout);
-    *cam_ = NULL; // prevent use after free
-    err   = dcamapi_uninit();
 ret:
+    free(cfg);
+    *cfg_ = NULL;
     return err;
 }
 
-DCAMERR orca_get_mode(ORCACAM cam, DCAMPROPMODEVALUE *mode)
+void orca_config_abort(ORCA_CONFIG *_Nonnull cfg)
+{
+    assert(cfg);
+    free(*cfg);
+    *cfg = NULL;
+}
+
+struct _ORCA_PRESET
+{
+    char name[ORCA_PRESET_NAME_MAX];
+    int32 num_props;
+    int32 *props;
+    double *values;
+    // ring, exchanged with the camera ring while the preset is attached
+    char *framebuf;
+    void **frameptr;
+    size_t num_frames;
+    size_t frame_size;
+};
+
+static void orcacam_preset_swap(struct _ORCACAM *cam, struct _ORCA_PRESET *p)
+{
+    char *framebuf    = cam->framebuf;
+    void **frameptr   = cam->frameptr;
+    size_t num_frames = cam->num_frames;
+    size_t frame_size = cam->frame_size;
+    cam->framebuf     = p->framebuf;
+    cam->frameptr     = p->frameptr;
+    cam->num_frames   = p->num_frames;
+    cam->frame_size   = p->frame_size;
+    p->framebuf       = framebuf;
+    p->frameptr       = frameptr;
+    p->num_frames     = num_frames;
+    p->frame_size     = frame_size;
+}
+
+// Give the attached preset its ring back. The caller must make sure the
+// camera ring matches the image format afterwards.
+static void orcacam_preset_detach(struct _ORCACAM *cam)
+{
+    if (cam->preset)
+    {
+        orcacam_preset_swap(cam, cam->preset);
+        cam->preset = NULL;
+    }
+}
+
+static void orcacam_preset_free(struct _ORCA_PRESET *p)
+{
+    if (!p)
+    {
+        return;
+    }
+    free(p->props);
+    free(p->values);
+    free(p->framebuf);
+    free(p->frameptr);
+    free(p);
+}
+
+static int32 orcacam_preset_find(struct _ORCACAM *cam, const char *name)
+{
+    for (int32 i = 0; i < ORCA_MAX_PRESETS; i++)
+    {
+        if (cam->presets[i] && !strcmp(cam->presets[i]->name, name))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+DCAMERR orca_preset_save(ORCACAM cam, const char *_Nonnull name,
+                         size_t num_frames)
 {
     assert(cam);
-    assert(mode);
+    assert(name);
     DCAMERR err;
     double v;
-    err = ORCACALL(dcamprop_getvalue, cam->hdcam, DCAM_IDPROP_SENSORMODE, &v);
+    if (strlen(name) >= ORCA_PRESET_NAME_MAX)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    int32 idx = orcacam_preset_find(cam, name);
+    if (idx < 0)
+    {
+        for (idx = 0; idx < ORCA_MAX_PRESETS && cam->presets[idx]; idx++)
+            ;
+        if (idx == ORCA_MAX_PRESETS)
+        {
+            return DCAMERR_NORESOURCE;
+        }
+    }
+    bool attached = cam->presets[idx] && cam->presets[idx] == cam->preset;
+    if (attached && atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_BUSY;
+    }
+    if (num_frames == 0)
+    {
+        num_frames = DEFAULT_FRAME_COUNT;
+    }
+    if (num_frames > 1000)
+    {
+        num_frames = 1000;
+    }
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                   DCAM_IDPROP_BUFFER_FRAMEBYTES, &v);
     if (orcaerr_failed(err))
     {
         return err;
     }
-    *mode = (DCAMPROPMODEVALUE)v;
-    return err;
+    size_t frame_size = (size_t)v;
+    size_t count =
+        orcacam_prop_list(cam->props, NULL, 0, DCAMPROP_ATTR_WRITABLE);
+    struct _ORCA_PRESET *p =
+        (struct _ORCA_PRESET *)calloc(1, sizeof(struct _ORCA_PRESET));
+    if (!p)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    p->props    = (int32 *)malloc(sizeof(int32) * (count + 1));
+    p->values   = (double *)malloc(sizeof(double) * (count + 1));
+    p->framebuf = (char *)malloc(frame_size * num_frames);
+    p->frameptr = (void **)malloc(sizeof(void *) * num_frames);
+    if (!p->props || !p->values || !p->framebuf || !p->frameptr)
+    {
+        orcacam_preset_free(p);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    strcpy(p->name, name);
+    p->num_frames = num_frames;
+    p->frame_size = frame_size;
+    for (size_t i = 0; i < num_frames; i++)
+    {
+        p->frameptr[i] = p->framebuf + i * frame_size;
+    }
+    orcacam_numa_bind(p->framebuf, frame_size * num_frames, cam->numa_node);
+    count = orcacam_prop_list(cam->props, p->props, count,
+                              DCAMPROP_ATTR_WRITABLE);
+    for (size_t i = 0; i < count; i++)
+    {
+        // properties that can not be read are left out
+        if (!orcaerr_failed(
+                orcacam_prop_getvalue(cam->props, p->props[i], &v)))
+        {
+            p->props[p->num_props]  = p->props[i];
+            p->values[p->num_props] = v;
+            p->num_props++;
+        }
+    }
+    // the new ring matches the current image format
+    if (attached)
+    {
+        orcacam_preset_detach(cam);
+    }
+    orcacam_preset_free(cam->presets[idx]);
+    cam->presets[idx] = p;
+    if (attached)
+    {
+        orcacam_preset_swap(cam, p);
+        cam->preset = p;
+    }
+    return DCAMERR_SUCCESS;
 }
 
-DCAMERR orca_switch_mode(ORCACAM cam, DCAMPROPMODEVALUE mode)
+DCAMERR orca_preset_apply(ORCACAM cam, const char *_Nonnull name)
 {
     assert(cam);
+    assert(name);
+    DCAMERR err;
+    double v;
     if (atomic_load(&(cam->capturing)))
     {
         return DCAMERR_BUSY;
     }
+    int32 idx = orcacam_preset_find(cam, name);
+    if (idx < 0)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    struct _ORCA_PRESET *p = cam->presets[idx];
+    // write only the properties that differ from the cached values, the
+    // transaction has room for every property of the preset
+    struct _ORCA_CONFIG *cfg = orcacam_config_alloc(cam, p->num_props + 1);
+    if (!cfg)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    double subarray_mode = DCAMPROP_MODE__ON;
+    for (int32 i = 0; i < p->num_props; i++)
+    {
+        if (p->props[i] == DCAM_IDPROP_SUBARRAYMODE)
+        {
+            subarray_mode = p->values[i];
+        }
+        err = orcacam_prop_getvalue(cam->props, p->props[i], &v);
+        if (!orcaerr_failed(err) && v == p->values[i])
+        {
+            continue;
+        }
+        err = orca_config_set(cfg, p->props[i], p->values[i]);
+        if (orcaerr_failed(err))
+        {
+            free(cfg);
+            return err;
+        }
+        if (orcacam_config_rank(p->props[i]) == 2)
+        {
+            cfg->roi = true;
+        }
+    }
+    if (cfg->roi)
+    {
+        // the subarray mode is switched back to the preset value
+        err = orca_config_set(cfg, DCAM_IDPROP_SUBARRAYMODE, subarray_mode);
+        if (orcaerr_failed(err))
+        {
+            free(cfg);
+            return err;
+        }
+    }
+    err = orcacam_config_apply(cfg);
+    free(cfg);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    err = ORCACALL(orcacam_prop_getvalue, cam->props,
+                   DCAM_IDPROP_BUFFER_FRAMEBYTES, &v);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    if (cam->preset == p && (size_t)v == cam->frame_size)
+    {
+        return err;
+    }
+    orcacam_preset_detach(cam);
+    if ((size_t)v != p->frame_size)
+    {
+        // the preset ring does not match, fall back to the camera ring
+        return orca_realloc_framebuffer(cam, cam->num_frames);
+    }
+    orcacam_preset_swap(cam, p);
+    cam->preset = p;
+    return err;
+}
+
+DCAMERR orca_preset_switch(ORCACAM cam, const char *_Nonnull name,
+                           OrcaFrameCallback cb, void *user_data,
+                           size_t sz_user_data)
+{
+    assert(cam);
+    assert(name);
+    assert(cb);
     DCAMERR err;
-    double v = (double)mode;
-    err = ORCACALL(dcamprop_setgetvalue, cam->hdcam, DCAM_IDPROP_SENSORMODE, &v,
-                   0);
-    DCAMPROPMODEVALUE new_mode = (DCAMPROPMODEVALUE)v;
+    bool capturing = atomic_load(&(cam->capturing));
+    if (capturing && !cam->threaded)
+    {
+        return DCAMERR_BUSY; // not started by orca_start_capture()
+    }
+    if (capturing)
+    {
+        err = orca_stop_capture(cam);
+        if (orcaerr_failed(err))
+        {
+            return err;
+        }
+    }
+    err = orca_preset_apply(cam, name);
     if (orcaerr_failed(err))
     {
+        // the previous configuration was restored, resume it
+        if (capturing)
+        {
+            orca_start_capture(cam, cb, user_data, sz_user_data);
+        }
         return err;
     }
-    if (new_mode != mode)
+    return orca_start_capture(cam, cb, user_data, sz_user_data);
+}
+
+DCAMERR orca_preset_remove(ORCACAM cam, const char *_Nonnull name)
+{
+    assert(cam);
+    assert(name);
+    DCAMERR err = DCAMERR_SUCCESS;
+    int32 idx   = orcacam_preset_find(cam, name);
+    if (idx < 0)
     {
-        fprintf(stderr, "Failed to switch mode: Desired mode %d, got mode %d\n",
-                mode, new_mode);
-        return DCAMERR_NOTSUPPORT;
+        return DCAMERR_INVALIDPARAM;
+    }
+    if (cam->presets[idx] == cam->preset)
+    {
+        if (atomic_load(&(cam->capturing)))
+        {
+            return DCAMERR_BUSY;
+        }
+        err = orca_realloc_framebuffer(cam, cam->num_frames);
     }
+    orcacam_preset_free(cam->presets[idx]);
+    cam->presets[idx] = NULL;
     return err;
 }
 
+DCAMERR orca_get_numa_node(ORCACAM cam, int32 *node)
+{
+    assert(cam);
+    assert(node);
+    *node = cam->numa_node;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_set_numa_node(ORCACAM cam, int32 node)
+{
+    assert(cam);
+    if (atomic_load(&(cam->capturing)))
+    {
+        return DCAMERR_BUSY;
+    }
+    if (node < -1 || (node >= 0 && !orcacam_numa_valid(node)))
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    cam->numa_node = node;
+    // move the rings allocated so far
+    orcacam_numa_bind(cam->framebuf, cam->frame_size * cam->num_frames, node);
+    for (int32 i = 0; i < ORCA_MAX_PRESETS; i++)
+    {
+        struct _ORCA_PRESET *p = cam->presets[i];
+        if (p)
+        {
+            orcacam_numa_bind(p->framebuf, p->frame_size * p->num_frames,
+                              node);
+        }
+    }
+    return DCAMERR_SUCCESS;
+}
+
 static void *orcacam_capture_thread(void *inp)
 {
     if (!inp)
@@ -1072,39 +2452,245 @@ static void *orcacam_capture_thread(void *inp)
     // transfer info
     ORCA_PTR_INIT(DCAMCAP_TRANSFERINFO, xferinfo);
 
+    // frame timestamps, sampled
+    struct _ORCA_STATS_REC *stats = args->stats;
+    ORCA_PTR_INIT(DCAMBUF_FRAME, bufframe);
+    uint32_t stamp = 0;
+    // frames captured when the last frame was delivered
+    int64_t delivered = 0;
+    ORCA_CAPTURE_INFO capture;
+
     while (true)
     {
-        err = ORCACALL(dcamwait_start, wait, &start);
+        err           = ORCATRACE(ORCA_TRACE_WAIT, 0, dcamwait_start, wait,
+                                  &start);
+        uint64_t woke = orcacam_stats_now();
         if (orcaerr_failed(err))
         {
             if (err == DCAMERR_ABORT)
             {
+                orcacam_stats_count(&(stats->aborts));
                 args->ret = DCAMERR_SUCCESS;
                 break;
             }
             else if (err == DCAMERR_TIMEOUT)
             {
+                orcacam_stats_count(&(stats->timeouts));
                 continue;
             }
             else
             {
+                orcacam_stats_count(&(stats->errors));
                 args->ret = err;
                 goto ret;
             }
         }
         // get capture info
-        err = ORCACALL(dcamcap_transferinfo, cam, &xferinfo);
+        err = ORCATRACE(ORCA_TRACE_TRANSFERINFO, 0, dcamcap_transferinfo, cam,
+                        &xferinfo);
+        orcacam_hist_record(&(stats->hist[ORCA_STAT_TRANSFERINFO]),
+                            orcacam_stats_now() - woke);
         if (orcaerr_failed(err))
         {
+            orcacam_stats_count(&(stats->errors));
             continue;
         }
+        // only the newest frame is delivered, older ones are skipped
+        int64_t pending = xferinfo.nFrameCount - delivered;
+        if (pending <= 0)
+        {
+            continue; // woken without a new frame, the newest was delivered
+        }
+        delivered = xferinfo.nFrameCount;
+        atomic_store_explicit(&(stats->pending), (uint64_t)pending,
+                              memory_order_relaxed);
+        atomic_fetch_add_explicit(&(stats->dropped), pending - 1,
+                                  memory_order_relaxed);
+        // the frame timestamps are taken from the system clock
+        if (++stamp == ORCA_STATS_STAMP_INTERVAL)
+        {
+            stamp           = 0;
+            bufframe.iFrame = xferinfo.nNewestFrameIndex;
+            if (!orcaerr_failed(dcambuf_lockframe(cam, &bufframe)))
+            {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                int64_t delay =
+                    ((int64_t)ts.tv_sec - bufframe.timestamp.sec) *
+                        1000000000LL +
+                    ts.tv_nsec - bufframe.timestamp.microsec * 1000LL;
+                if (delay >= 0)
+                {
+                    orcacam_hist_record(&(stats->hist[ORCA_STAT_DELIVERY]),
+                                        (uint64_t)delay);
+                }
+            }
+        }
         // create the frame
         char *buf = (char *)frameptr[xferinfo.nNewestFrameIndex];
         buf += args->topoffset;
-        frame.data = buf;
+        frame.data          = buf;
+        capture.frame_count = (uint64_t)xferinfo.nFrameCount;
+        capture.skipped     = (uint64_t)(pending - 1);
+        // Run the processing stages
+        orcacam_run_stages(args->stages, args->num_stages, &frame,
+                           orcacam_trigger_info(&(args->trigger),
+                                                xferinfo.nFrameCount,
+                                                args->fired),
+                           &capture, NULL);
         // Execute the callback
+        uint64_t entry = orcacam_stats_now();
+        orcacam_hist_record(&(stats->hist[ORCA_STAT_WAKEUP]), entry - woke);
+        ORCA_TRACE_BEGIN(ORCA_TRACE_CALLBACK, xferinfo.nFrameCount);
         cb(&frame, user_data, sz_user_data);
+        ORCA_TRACE_END(ORCA_TRACE_CALLBACK, 0);
+        orcacam_hist_record(&(stats->hist[ORCA_STAT_CALLBACK]),
+                            orcacam_stats_now() - entry);
+        orcacam_stats_count(&(stats->frames));
+    }
+ret:
+    return inp;
+}
+
+static void *orcacam_history_thread(void *inp)
+{
+    if (!inp)
+    {
+        return NULL;
+    }
+    struct _ORCA_THREAD_ARGS *args = (struct _ORCA_THREAD_ARGS *)inp;
+    if (!args->cam || !args->wait || !args->cb)
+    {
+        args->ret = DCAMERR_NORESOURCE;
+        goto ret;
+    }
+    HDCAM cam        = args->cam;
+    HDCAMWAIT wait   = args->wait;
+    void **frameptr  = args->frameptr;
+    uint64_t nf      = args->num_frames;
+    DCAMERR err      = DCAMERR_SUCCESS;
+    ORCA_FRAME frame = {
+        .data       = NULL,
+        .width      = args->width,
+        .height     = args->height,
+        .fmt        = args->fmt,
+        .row_stride = args->rowbytes,
+    };
+    ORCA_HISTORY_INFO info;
+    memset(&info, 0, sizeof(ORCA_HISTORY_INFO));
+    // frames [next, end] of the current event remain to be delivered
+    uint64_t next = 0, end = 0, trigger = 0;
+
+    ORCA_PTR_INIT(DCAMWAIT_START, start);
+    start.eventmask = DCAMWAIT_CAPEVENT_FRAMEREADY;
+    start.timeout   = 1000;
+
+    ORCA_PTR_INIT(DCAMCAP_TRANSFERINFO, xferinfo);
+
+    args->ret = DCAMERR_SUCCESS;
+    while (true)
+    {
+        err = ORCATRACE(ORCA_TRACE_WAIT, 0, dcamwait_start, wait, &start);
+        if (orcaerr_failed(err))
+        {
+            if (err == DCAMERR_ABORT)
+            {
+                break;
+            }
+            else if (err == DCAMERR_TIMEOUT)
+            {
+                continue;
+            }
+            else
+            {
+                args->ret = err;
+                goto ret;
+            }
+        }
+        // the ring is left alone until a trigger
+        uint64_t event = atomic_load(args->event);
+        if (!event)
+        {
+            continue;
+        }
+        err = ORCATRACE(ORCA_TRACE_TRANSFERINFO, 0, dcamcap_transferinfo, cam,
+                        &xferinfo);
+        if (orcaerr_failed(err))
+        {
+            continue;
+        }
+        if (!end)
+        {
+            trigger = event - 1;
+            next    = trigger >= (uint64_t)args->pre_frames
+                          ? trigger - args->pre_frames + 1
+                          : 1;
+            end     = trigger + args->post_frames;
+            info.event++;
+            info.lost = 0;
+        }
+        while (next <= end && next <= (uint64_t)xferinfo.nFrameCount)
+        {
+            uint64_t age = (uint64_t)xferinfo.nFrameCount - next;
+            // the oldest slot is the one being written
+            if (age + 1 >= nf)
+            {
+                uint64_t skip = age + 2 - nf;
+                if (skip > end + 1 - next)
+                {
+                    skip = end + 1 - next;
+                }
+                info.lost += skip;
+                next += skip;
+                continue;
+            }
+            size_t slot = (xferinfo.nNewestFrameIndex + nf - age) % nf;
+            frame.data  = (char *)frameptr[slot] + args->topoffset;
+            info.index  = (int64_t)next - (int64_t)trigger;
+            info.frame_count = next;
+            info.last        = next == end;
+            orcacam_run_stages(
+                args->stages, args->num_stages, &frame,
+                orcacam_trigger_info(&(args->trigger), next, args->fired),
+                NULL, &info);
+            ORCA_TRACE_BEGIN(ORCA_TRACE_CALLBACK, next);
+            args->cb(&frame, args->user_data, args->sz_user_data);
+            ORCA_TRACE_END(ORCA_TRACE_CALLBACK, 0);
+            next++;
+            // frames may have arrived while the sink was busy
+            ORCA_TRACE_BEGIN(ORCA_TRACE_TRANSFERINFO, 0);
+            DCAMERR xerr = dcamcap_transferinfo(cam, &xferinfo);
+            ORCA_TRACE_END(ORCA_TRACE_TRANSFERINFO, (uint32_t)xerr);
+            if (orcaerr_failed(xerr))
+            {
+                break;
+            }
+        }
+        if (next > end)
+        {
+            end = 0;
+            atomic_store(args->event, 0);
+        }
     }
 ret:
     return inp;
 }
+
+static void *orcacam_snap_thread(void *inp)
+{
+    struct _ORCA_THREAD_ARGS *args = (struct _ORCA_THREAD_ARGS *)inp;
+    int32 captured                 = 0;
+    DCAMERR err;
+    do
+    {
+        err = orcacam_snap_wait(args->cam, args->wait, (int32)args->num_frames,
+                                1000, &captured);
+    } while (err == DCAMERR_TIMEOUT);
+    if (!orcaerr_failed(err) && args->timestamps)
+    {
+        err = orcacam_snap_stamps(args->cam, captured, args->timestamps);
+    }
+    args->ret = err;
+    args->done(err, captured, args->user_data, args->sz_user_data);
+    return inp;
+}
@@ -0,0 +1,273 @@
+#include "orcacam_ae.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define ORCACAM_AE_BINS 4096 // MONO16 histogram bins of 16 counts
+
+struct _ORCA_AE
+{
+    ORCACAM cam;
+    ORCA_AE_CONFIG config;
+    pthread_mutex_t lock; // protects target and state
+    double target;
+    ORCA_AE_STATE state;
+    // capture thread only
+    uint64_t frames;
+    uint64_t next_frame; // frame count of the next measurement
+    double integral;     // integral of the log error
+    double prev_error;
+    double max_integral; // anti-windup limit
+    uint32_t hist[ORCACAM_AE_BINS];
+};
+
+DCAMERR orca_ae_create(ORCA_AE *ae, ORCACAM cam, const ORCA_AE_CONFIG *config)
+{
+    assert(ae);
+    assert(cam);
+    assert(config);
+    DCAMERR err;
+    *ae = NULL;
+    if (config->target <= 0 || config->min_exposure <= 0 ||
+        config->max_exposure < config->min_exposure ||
+        config->percentile < 0 || config->percentile > 100 ||
+        config->tolerance < 0 || config->max_ratio < 0 ||
+        (config->max_ratio > 0 && config->max_ratio <= 1) ||
+        config->interval < 0 || config->samples < 0)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    DCAMPROP_ATTR attr;
+    err = orca_get_attr(cam, DCAM_IDPROP_EXPOSURETIME, &attr);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    int32 mask = DCAMPROP_ATTR_WRITABLE | DCAMPROP_ATTR_ACCESSBUSY;
+    if ((attr.attribute & mask) != mask)
+    {
+        return DCAMERR_NOTWRITABLE;
+    }
+    struct _ORCA_AE *a = (struct _ORCA_AE *)malloc(sizeof(struct _ORCA_AE));
+    if (!a)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(a, 0, sizeof(struct _ORCA_AE));
+    a->cam    = cam;
+    a->config = *config;
+    a->target = config->target;
+    if (!a->config.max_ratio)
+    {
+        a->config.max_ratio = 4;
+    }
+    if (!a->config.interval)
+    {
+        a->config.interval = 4;
+    }
+    if (!a->config.samples)
+    {
+        a->config.samples = 1024;
+    }
+    a->max_integral = log(config->max_exposure / config->min_exposure);
+    err             = orca_get_exposure(cam, &(a->state.exposure));
+    if (orcaerr_failed(err))
+    {
+        free(a);
+        return err;
+    }
+    pthread_mutex_init(&(a->lock), NULL);
+    *ae = a;
+    return DCAMERR_SUCCESS;
+}
+
+// Compute the metric on a grid of about config.samples pixels
+static bool orcacam_ae_measure(struct _ORCA_AE *ae, const ORCA_FRAME *frame,
+                               double *metric)
+{
+    if (!frame->data || frame->width < 1 || frame->height < 1)
+    {
+        return false;
+    }
+    bool mono16;
+    switch (frame->fmt)
+    {
+    case DCAM_PIXELTYPE_MONO8:
+        mono16 = false;
+        break;
+    case DCAM_PIXELTYPE_MONO16:
+        mono16 = true;
+        break;
+    default:
+        return false;
+    }
+    int32 n      = (int32)sqrt((double)ae->config.samples);
+    int32 step_x = frame->width / n > 1 ? frame->width / n : 1;
+    int32 step_y = frame->height / n > 1 ? frame->height / n : 1;
+    bool hist    = ae->config.metric == ORCA_AE_PERCENTILE;
+    uint64_t sum = 0, count = 0;
+    if (hist)
+    {
+        memset(ae->hist, 0, sizeof(ae->hist));
+    }
+    for (int32 y = step_y / 2; y < frame->height; y += step_y)
+    {
+        const char *row = frame->data + (size_t)y * frame->row_stride;
+        for (int32 x = step_x / 2; x < frame->width; x += step_x)
+        {
+            uint32_t v = mono16 ? ((const uint16_t *)row)[x]
+                                : ((const uint8_t *)row)[x];
+            sum += v;
+            if (hist)
+            {
+                ae->hist[mono16 ? v >> 4 : v]++;
+            }
+            count++;
+        }
+    }
+    if (!hist)
+    {
+        *metric = (double)sum / count;
+        return true;
+    }
+    uint64_t rank = (uint64_t)(ae->config.percentile / 100 * (count - 1));
+    uint64_t cum  = 0;
+    int32 bin     = 0;
+    for (; bin < ORCACAM_AE_BINS - 1; bin++)
+    {
+        cum += ae->hist[bin];
+        if (cum > rank)
+        {
+            break;
+        }
+    }
+    *metric = mono16 ? bin * 16 + 8 : bin;
+    return true;
+}
+
+void orca_ae_stage(ORCA_FRAME *frame, void *ae_, size_t sz_ae)
+{
+    struct _ORCA_AE *ae = (struct _ORCA_AE *)ae_;
+    if (!ae)
+    {
+        return;
+    }
+    // frames between measurements only pay for the counter
+    uint64_t frames = ++(ae->frames);
+    if (frames < ae->next_frame)
+    {
+        return;
+    }
+    double metric;
+    if (!orcacam_ae_measure(ae, frame, &metric))
+    {
+        return;
+    }
+    ae->next_frame = frames + ae->config.interval;
+    pthread_mutex_lock(&(ae->lock));
+    double target     = ae->target;
+    bool settled      = fabs(metric - target) <= ae->config.tolerance * target;
+    ae->state.metric  = metric;
+    ae->state.frames  = frames;
+    ae->state.settled = settled;
+    pthread_mutex_unlock(&(ae->lock));
+    double error = log(target / (metric > 1 ? metric : 1));
+    if (settled)
+    {
+        ae->prev_error = error;
+        return;
+    }
+    // the exposure time already integrates the corrections, so the integral
+    // is reset on overshoot, and not accumulated while the step is clamped
+    if (error * ae->prev_error < 0)
+    {
+        ae->integral = 0;
+    }
+    double delta = ae->config.kp * error +
+                   ae->config.ki * (ae->integral + error) +
+                   ae->config.kd * (error - ae->prev_error);
+    double max_delta = log(ae->config.max_ratio);
+    ae->prev_error   = error;
+    if (delta > max_delta)
+    {
+        delta = max_delta;
+    }
+    else if (delta < -max_delta)
+    {
+        delta = -max_delta;
+    }
+    else
+    {
+        ae->integral += error;
+        if (ae->integral > ae->max_integral)
+        {
+            ae->integral = ae->max_integral;
+        }
+        else if (ae->integral < -ae->max_integral)
+        {
+            ae->integral = -ae->max_integral;
+        }
+    }
+    // the exposure time may have been changed by someone else
+    double exposure;
+    if (orcaerr_failed(orca_get_exposure(ae->cam, &exposure)))
+    {
+        return;
+    }
+    double v = exposure * exp(delta);
+    if (v < ae->config.min_exposure)
+    {
+        v = ae->config.min_exposure;
+    }
+    else if (v > ae->config.max_exposure)
+    {
+        v = ae->config.max_exposure;
+    }
+    if (v == exposure ||
+        orcaerr_failed(orca_setget_value(ae->cam, DCAM_IDPROP_EXPOSURETIME, &v,
+                                         0)))
+    {
+        return;
+    }
+    pthread_mutex_lock(&(ae->lock));
+    ae->state.exposure = v;
+    ae->state.adjustments++;
+    pthread_mutex_unlock(&(ae->lock));
+}
+
+DCAMERR orca_ae_set_target(ORCA_AE ae, double target)
+{
+    assert(ae);
+    if (target <= 0)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    pthread_mutex_lock(&(ae->lock));
+    ae->target = target;
+    pthread_mutex_unlock(&(ae->lock));
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_ae_get_state(ORCA_AE ae, ORCA_AE_STATE *state)
+{
+    assert(ae);
+    assert(state);
+    pthread_mutex_lock(&(ae->lock));
+    *state = ae->state;
+    pthread_mutex_unlock(&(ae->lock));
+    return DCAMERR_SUCCESS;
+}
+
+void orca_ae_destroy(ORCA_AE *ae)
+{
+    assert(ae);
+    struct _ORCA_AE *a = *ae;
+    if (!a)
+    {
+        return;
+    }
+    pthread_mutex_destroy(&(a->lock));
+    free(a);
+    *ae = NULL;
+}
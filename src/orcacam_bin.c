@@ -0,0 +1,436 @@
+#include "orcacam_bin.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct _ORCA_BINNER
+{
+    int32 bin_x, bin_y;
+    ORCA_BIN_OP op;
+    OrcaFrameCallback cb;
+    void *user_data;
+    size_t sz_user_data;
+    char *buf;
+    size_t buf_size;
+};
+
+size_t orca_bin_output_size(const ORCA_FRAME *src, int32 bin_x, int32 bin_y,
+                            ORCA_BIN_OP op, ORCA_FRAME *dst)
+{
+    assert(src);
+    assert(dst);
+    int32 bpp;
+    if (bin_x < 1 || bin_y < 1 || src->width < bin_x || src->height < bin_y)
+    {
+        return 0;
+    }
+    if (bin_x * bin_y > ORCA_BIN_MAX_PIXELS)
+    {
+        return 0;
+    }
+    switch (src->fmt)
+    {
+    case DCAM_PIXELTYPE_MONO8:
+    case DCAM_PIXELTYPE_MONO16:
+        break;
+    default:
+        return 0;
+    }
+    switch (op)
+    {
+    case ORCA_BIN_SUM:
+        dst->fmt = DCAM_PIXELTYPE_MONO16;
+        break;
+    case ORCA_BIN_MEAN:
+        dst->fmt = src->fmt;
+        break;
+    default:
+        return 0;
+    }
+    bpp             = dst->fmt == DCAM_PIXELTYPE_MONO8 ? 1 : 2;
+    dst->width      = src->width / bin_x;
+    dst->height     = src->height / bin_y;
+    dst->row_stride = dst->width * bpp;
+    dst->rsvd       = 0;
+    return (size_t)dst->row_stride * dst->height;
+}
+
+static inline uint16_t orcacam_bin_reduce(uint32_t sum, uint32_t npix,
+                                          ORCA_BIN_OP op)
+{
+    if (op == ORCA_BIN_MEAN)
+    {
+        return (uint16_t)((sum + npix / 2) / npix);
+    }
+    return sum > 0xffff ? 0xffff : (uint16_t)sum;
+}
+
+static void orcacam_bin2x2_u16(const ORCA_FRAME *src, ORCA_BIN_OP op,
+                               ORCA_FRAME *dst)
+{
+    for (int32 y = 0; y < dst->height; y++)
+    {
+        const uint16_t *r0 =
+            (const uint16_t *)(src->data + (size_t)(2 * y) * src->row_stride);
+        const uint16_t *r1 =
+            (const uint16_t *)((const char *)r0 + src->row_stride);
+        uint16_t *out =
+            (uint16_t *)(dst->data + (size_t)y * dst->row_stride);
+        int32 x = 0;
+#if defined(__SSE2__)
+        const __m128i lo   = _mm_set1_epi32(0xffff);
+        const __m128i bias = _mm_set1_epi32(0x8000);
+        const __m128i sign = _mm_set1_epi16((short)0x8000);
+        const __m128i rnd  = _mm_set1_epi32(2);
+        const __m128i max  = _mm_set1_epi32(0xffff);
+        for (; x + 8 <= dst->width; x += 8)
+        {
+            __m128i a0 = _mm_loadu_si128((const __m128i *)(r0 + 2 * x));
+            __m128i a1 = _mm_loadu_si128((const __m128i *)(r0 + 2 * x + 8));
+            __m128i b0 = _mm_loadu_si128((const __m128i *)(r1 + 2 * x));
+            __m128i b1 = _mm_loadu_si128((const __m128i *)(r1 + 2 * x + 8));
+            // pairwise horizontal sums widened to 32 bits
+            __m128i s0 = _mm_add_epi32(_mm_and_si128(a0, lo),
+                                       _mm_srli_epi32(a0, 16));
+            __m128i s1 = _mm_add_epi32(_mm_and_si128(a1, lo),
+                                       _mm_srli_epi32(a1, 16));
+            s0 = _mm_add_epi32(s0, _mm_and_si128(b0, lo));
+            s1 = _mm_add_epi32(s1, _mm_and_si128(b1, lo));
+            s0 = _mm_add_epi32(s0, _mm_srli_epi32(b0, 16));
+            s1 = _mm_add_epi32(s1, _mm_srli_epi32(b1, 16));
+            if (op == ORCA_BIN_MEAN)
+            {
+                s0 = _mm_srli_epi32(_mm_add_epi32(s0, rnd), 2);
+                s1 = _mm_srli_epi32(_mm_add_epi32(s1, rnd), 2);
+            }
+            else
+            {
+                s0 = _mm_or_si128(s0, _mm_cmpgt_epi32(s0, max));
+                s1 = _mm_or_si128(s1, _mm_cmpgt_epi32(s1, max));
+            }
+            // unsigned 32 -> 16 bit pack using a signed pack on biased values
+            s0 = _mm_sub_epi32(_mm_and_si128(s0, lo), bias);
+            s1 = _mm_sub_epi32(_mm_and_si128(s1, lo), bias);
+            __m128i res = _mm_xor_si128(_mm_packs_epi32(s0, s1), sign);
+            _mm_storeu_si128((__m128i *)(out + x), res);
+        }
+#endif
+        for (; x < dst->width; x++)
+        {
+            uint32_t sum = (uint32_t)r0[2 * x] + r0[2 * x + 1] + r1[2 * x] +
+                           r1[2 * x + 1];
+            out[x] = orcacam_bin_reduce(sum, 4, op);
+        }
+    }
+}
+
+static void orcacam_bin2x2_u8(const ORCA_FRAME *src, ORCA_BIN_OP op,
+                              ORCA_FRAME *dst)
+{
+    for (int32 y = 0; y < dst->height; y++)
+    {
+        const uint8_t *r0 =
+            (const uint8_t *)(src->data + (size_t)(2 * y) * src->row_stride);
+        const uint8_t *r1 = r0 + src->row_stride;
+        char *out         = dst->data + (size_t)y * dst->row_stride;
+        int32 x           = 0;
+#if defined(__SSE2__)
+        const __m128i lo  = _mm_set1_epi16(0x00ff);
+        const __m128i rnd = _mm_set1_epi16(2);
+        for (; x + 8 <= dst->width; x += 8)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(r0 + 2 * x));
+            __m128i b = _mm_loadu_si128((const __m128i *)(r1 + 2 * x));
+            // pairwise horizontal sums widened to 16 bits
+            __m128i s = _mm_add_epi16(_mm_and_si128(a, lo), _mm_srli_epi16(a, 8));
+            s = _mm_add_epi16(s, _mm_and_si128(b, lo));
+            s = _mm_add_epi16(s, _mm_srli_epi16(b, 8));
+            if (op == ORCA_BIN_MEAN)
+            {
+                s = _mm_srli_epi16(_mm_add_epi16(s, rnd), 2);
+                _mm_storel_epi64((__m128i *)(out + x), _mm_packus_epi16(s, s));
+            }
+            else
+            {
+                _mm_storeu_si128((__m128i *)(out + 2 * x), s);
+            }
+        }
+#endif
+        for (; x < dst->width; x++)
+        {
+            uint32_t sum = (uint32_t)r0[2 * x] + r0[2 * x + 1] + r1[2 * x] +
+                           r1[2 * x + 1];
+            if (op == ORCA_BIN_MEAN)
+            {
+                ((uint8_t *)out)[x] = (uint8_t)orcacam_bin_reduce(sum, 4, op);
+            }
+            else
+            {
+                ((uint16_t *)out)[x] = (uint16_t)sum;
+            }
+        }
+    }
+}
+
+// Accumulate one source row into a 32-bit line accumulator
+static inline void orcacam_bin_accumulate(const char *row, bool mono8,
+                                          int32 width, uint32_t *line)
+{
+    int32 x = 0;
+    if (mono8)
+    {
+        const uint8_t *src = (const uint8_t *)row;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i v  = _mm_loadu_si128((const __m128i *)(src + x));
+            __m128i vl = _mm_unpacklo_epi8(v, zero);
+            __m128i vh = _mm_unpackhi_epi8(v, zero);
+            __m128i *acc = (__m128i *)(line + x);
+            _mm_storeu_si128(acc, _mm_add_epi32(_mm_loadu_si128(acc), _mm_unpacklo_epi16(vl, zero)));
+            _mm_storeu_si128(acc + 1, _mm_add_epi32(_mm_loadu_si128(acc + 1), _mm_unpackhi_epi16(vl, zero)));
+            _mm_storeu_si128(acc + 2, _mm_add_epi32(_mm_loadu_si128(acc + 2), _mm_unpacklo_epi16(vh, zero)));
+            _mm_storeu_si128(acc + 3, _mm_add_epi32(_mm_loadu_si128(acc + 3), _mm_unpackhi_epi16(vh, zero)));
+        }
+#endif
+        for (; x < width; x++)
+        {
+            line[x] += src[x];
+        }
+    }
+    else
+    {
+        const uint16_t *src = (const uint16_t *)row;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i v    = _mm_loadu_si128((const __m128i *)(src + x));
+            __m128i *acc = (__m128i *)(line + x);
+            _mm_storeu_si128(acc, _mm_add_epi32(_mm_loadu_si128(acc), _mm_unpacklo_epi16(v, zero)));
+            _mm_storeu_si128(acc + 1, _mm_add_epi32(_mm_loadu_si128(acc + 1), _mm_unpackhi_epi16(v, zero)));
+        }
+#endif
+        for (; x < width; x++)
+        {
+            line[x] += src[x];
+        }
+    }
+}
+
+// Sum adjacent pairs of the line accumulator in place
+static inline void orcacam_bin_halve(uint32_t *line, int32 width)
+{
+    int32 x = 0;
+#if defined(__SSE2__)
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(line + 2 * x)));
+        __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(line + 2 * x + 4)));
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd  = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128((__m128i *)(line + x), _mm_add_epi32(even, odd));
+    }
+#endif
+    for (; x < width; x++)
+    {
+        line[x] = line[2 * x] + line[2 * x + 1];
+    }
+}
+
+// Reduce the accumulated line into an output row
+static inline void orcacam_bin_store(uint32_t *line, int32 width, int32 bin_x,
+                                     uint32_t npix, ORCA_BIN_OP op, bool mono8,
+                                     char *out)
+{
+    // even bin sizes are reduced pairwise with SIMD first
+    for (; bin_x % 2 == 0; bin_x /= 2)
+    {
+        orcacam_bin_halve(line, width * bin_x / 2);
+    }
+    // sum the remaining horizontal bins in place, bin x only reads
+    // line[x * bin_x ...]
+    for (int32 x = 0; bin_x > 1 && x < width; x++)
+    {
+        const uint32_t *src = line + x * bin_x;
+        uint32_t sum        = 0;
+        for (int32 i = 0; i < bin_x; i++)
+        {
+            sum += src[i];
+        }
+        line[x] = sum;
+    }
+    if (op == ORCA_BIN_MEAN)
+    {
+        // rounded division by a constant using a 64-bit reciprocal, exact
+        // for bins of up to ORCA_BIN_MAX_PIXELS 16-bit pixels
+        const uint64_t recip = (((uint64_t)1 << 44) + npix - 1) / npix;
+        for (int32 x = 0; x < width; x++)
+        {
+            line[x] = (uint32_t)(((line[x] + npix / 2) * recip) >> 44);
+        }
+    }
+    else
+    {
+        for (int32 x = 0; x < width; x++)
+        {
+            line[x] = line[x] > 0xffff ? 0xffff : line[x];
+        }
+    }
+    if (mono8)
+    {
+        for (int32 x = 0; x < width; x++)
+        {
+            ((uint8_t *)out)[x] = (uint8_t)line[x];
+        }
+    }
+    else
+    {
+        for (int32 x = 0; x < width; x++)
+        {
+            ((uint16_t *)out)[x] = (uint16_t)line[x];
+        }
+    }
+}
+
+static void orcacam_bin_generic(const ORCA_FRAME *src, int32 bin_x,
+                                int32 bin_y, ORCA_BIN_OP op, ORCA_FRAME *dst)
+{
+    bool mono8    = src->fmt == DCAM_PIXELTYPE_MONO8;
+    int32 width   = dst->width * bin_x;
+    uint32_t npix = (uint32_t)bin_x * bin_y;
+    uint32_t line[width];
+    for (int32 y = 0; y < dst->height; y++)
+    {
+        memset(line, 0, sizeof(line));
+        const char *row = src->data + (size_t)y * bin_y * src->row_stride;
+        for (int32 j = 0; j < bin_y; j++, row += src->row_stride)
+        {
+            orcacam_bin_accumulate(row, mono8, width, line);
+        }
+        orcacam_bin_store(line, dst->width, bin_x, npix, op,
+                          dst->fmt == DCAM_PIXELTYPE_MONO8,
+                          dst->data + (size_t)y * dst->row_stride);
+    }
+}
+
+DCAMERR orca_bin_frame(const ORCA_FRAME *src, int32 bin_x, int32 bin_y,
+                       ORCA_BIN_OP op, ORCA_FRAME *dst)
+{
+    assert(src);
+    assert(dst);
+    if (!src->data || !dst->data)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    if (orca_bin_output_size(src, bin_x, bin_y, op, dst) == 0)
+    {
+        return DCAMERR_NOTSUPPORT;
+    }
+    if (bin_x == 2 && bin_y == 2)
+    {
+        if (src->fmt == DCAM_PIXELTYPE_MONO8)
+        {
+            orcacam_bin2x2_u8(src, op, dst);
+        }
+        else
+        {
+            orcacam_bin2x2_u16(src, op, dst);
+        }
+    }
+    else
+    {
+        orcacam_bin_generic(src, bin_x, bin_y, op, dst);
+    }
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_binner_create(ORCA_BINNER *binner, int32 bin_x, int32 bin_y,
+                           ORCA_BIN_OP op, OrcaFrameCallback cb,
+                           void *user_data, size_t sz_user_data)
+{
+    assert(binner);
+    assert(cb);
+    *binner = NULL;
+    if (bin_x < 1 || bin_y < 1 || bin_x * bin_y > ORCA_BIN_MAX_PIXELS)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    if (op != ORCA_BIN_SUM && op != ORCA_BIN_MEAN)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    struct _ORCA_BINNER *b =
+        (struct _ORCA_BINNER *)malloc(sizeof(struct _ORCA_BINNER));
+    if (!b)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(b, 0, sizeof(struct _ORCA_BINNER));
+    b->bin_x        = bin_x;
+    b->bin_y        = bin_y;
+    b->op           = op;
+    b->cb           = cb;
+    b->user_data    = user_data;
+    b->sz_user_data = sz_user_data;
+    *binner         = b;
+    return DCAMERR_SUCCESS;
+}
+
+void orca_bin_stage(ORCA_FRAME *frame, void *binner, size_t sz_binner)
+{
+    (void)sz_binner;
+    struct _ORCA_BINNER *b = (struct _ORCA_BINNER *)binner;
+    if (!b || !frame->data)
+    {
+        return;
+    }
+    ORCA_FRAME out = {0};
+    size_t size = orca_bin_output_size(frame, b->bin_x, b->bin_y, b->op, &out);
+    if (size == 0)
+    {
+        return;
+    }
+    if (size > b->buf_size) // only on the first frame or a geometry change
+    {
+        char *buf = (char *)realloc(b->buf, size);
+        if (!buf)
+        {
+            return;
+        }
+        b->buf      = buf;
+        b->buf_size = size;
+    }
+    out.data = b->buf;
+    if (orcaerr_failed(orca_bin_frame(frame, b->bin_x, b->bin_y, b->op, &out)))
+    {
+        return;
+    }
+    // frame metadata still applies; pixel positions are of the source frame
+    out.meta[ORCA_META_SWEEP]   = frame->meta[ORCA_META_SWEEP];
+    out.meta[ORCA_META_HISTORY] = frame->meta[ORCA_META_HISTORY];
+    out.meta[ORCA_META_TRIGGER] = frame->meta[ORCA_META_TRIGGER];
+    out.meta[ORCA_META_CAPTURE] = frame->meta[ORCA_META_CAPTURE];
+    b->cb(&out, b->user_data, b->sz_user_data);
+}
+
+void orca_binner_destroy(ORCA_BINNER *binner)
+{
+    assert(binner);
+    struct _ORCA_BINNER *b = *binner;
+    if (!b)
+    {
+        return;
+    }
+    if (b->buf)
+    {
+        free(b->buf);
+    }
+    free(b);
+    *binner = NULL;
+}
@@ -0,0 +1,612 @@
+#include "orcacam_defect.h"
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define ORCACAM_DEFECT_MAGIC "ORCADEF1"
+#define ORCACAM_DEFECT_NBR 8     // neighbour slots per defect
+#define ORCACAM_DEFECT_LOW (-1)  // pad slot sorting below every pixel
+#define ORCACAM_DEFECT_HIGH (-2) // pad slot sorting above every pixel
+
+struct _ORCA_DEFECT_MAP
+{
+    char camera_id[64];
+    int32 width, height;
+    uint8_t *mask;     // defect flags
+    uint32_t *index;   // defect pixel indices, raster order
+    size_t num_defects;
+    // correction plan, rebuilt when the map or the frame layout changes
+    bool dirty;
+    int32 plan_stride, plan_bpp;
+    size_t plan_count;
+    int32 *plan_off; // defect byte offsets
+    int32 *nbr_off;  // neighbour byte offsets (or pad slots), 8 per defect
+    // dark statistics
+    uint64_t *sum, *sumsq;
+    uint64_t frames;
+};
+
+DCAMERR orca_defect_create(ORCA_DEFECT_MAP *map, const char *camera_id,
+                           int32 width, int32 height)
+{
+    assert(map);
+    assert(camera_id);
+    *map = NULL;
+    if (width < 1 || height < 1)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    struct _ORCA_DEFECT_MAP *m =
+        (struct _ORCA_DEFECT_MAP *)malloc(sizeof(struct _ORCA_DEFECT_MAP));
+    if (!m)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(m, 0, sizeof(struct _ORCA_DEFECT_MAP));
+    m->mask = (uint8_t *)calloc((size_t)width * height, sizeof(uint8_t));
+    if (!m->mask)
+    {
+        free(m);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    strncpy(m->camera_id, camera_id, sizeof(m->camera_id) - 1);
+    m->width  = width;
+    m->height = height;
+    m->dirty  = true;
+    *map      = m;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_defect_learn(ORCA_DEFECT_MAP map, const ORCA_FRAME *dark)
+{
+    assert(map);
+    assert(dark);
+    if (dark->fmt != DCAM_PIXELTYPE_MONO8 && dark->fmt != DCAM_PIXELTYPE_MONO16)
+    {
+        return DCAMERR_NOTSUPPORT;
+    }
+    if (!dark->data || dark->width != map->width || dark->height != map->height)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    size_t npix = (size_t)map->width * map->height;
+    if (!map->sum)
+    {
+        map->sum   = (uint64_t *)calloc(npix, sizeof(uint64_t));
+        map->sumsq = (uint64_t *)calloc(npix, sizeof(uint64_t));
+        if (!map->sum || !map->sumsq)
+        {
+            free(map->sum);
+            free(map->sumsq);
+            map->sum   = NULL;
+            map->sumsq = NULL;
+            return DCAMERR_LESSSYSTEMMEMORY;
+        }
+    }
+    for (int32 y = 0; y < dark->height; y++)
+    {
+        const char *row = dark->data + (size_t)y * dark->row_stride;
+        uint64_t *sum   = map->sum + (size_t)y * map->width;
+        uint64_t *sumsq = map->sumsq + (size_t)y * map->width;
+        for (int32 x = 0; x < dark->width; x++)
+        {
+            uint64_t v = dark->fmt == DCAM_PIXELTYPE_MONO8
+                             ? ((const uint8_t *)row)[x]
+                             : ((const uint16_t *)row)[x];
+            sum[x] += v;
+            sumsq[x] += v * v;
+        }
+    }
+    map->frames++;
+    return DCAMERR_SUCCESS;
+}
+
+// k-th smallest value, the values are reordered
+static float orcacam_defect_select(float *v, size_t n, size_t k)
+{
+    size_t lo = 0, hi = n - 1;
+    while (lo < hi)
+    {
+        float pivot = v[lo + (hi - lo) / 2];
+        size_t i = lo, j = hi;
+        while (i <= j)
+        {
+            while (v[i] < pivot)
+            {
+                i++;
+            }
+            while (v[j] > pivot)
+            {
+                j--;
+            }
+            if (i <= j)
+            {
+                float t = v[i];
+                v[i]    = v[j];
+                v[j]    = t;
+                i++;
+                if (j == 0)
+                {
+                    break;
+                }
+                j--;
+            }
+        }
+        if (k <= j)
+        {
+            hi = j;
+        }
+        else if (k >= i)
+        {
+            lo = i;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return v[k];
+}
+
+// Flag the pixels whose value exceeds the median by sigma robust standard
+// deviations
+static void orcacam_defect_classify(struct _ORCA_DEFECT_MAP *m,
+                                    const float *values, float *scratch,
+                                    double sigma)
+{
+    size_t npix = (size_t)m->width * m->height;
+    memcpy(scratch, values, sizeof(float) * npix);
+    float median = orcacam_defect_select(scratch, npix, npix / 2);
+    for (size_t i = 0; i < npix; i++)
+    {
+        scratch[i] = fabsf(values[i] - median);
+    }
+    double rsd = 1.4826 * orcacam_defect_select(scratch, npix, npix / 2);
+    // sub-count spreads are kept, only a map without any spread is guarded
+    if (rsd <= 0)
+    {
+        rsd = fmax(median * 1e-3, FLT_EPSILON);
+    }
+    double lim = median + sigma * rsd;
+    for (size_t i = 0; i < npix; i++)
+    {
+        if (values[i] > lim)
+        {
+            m->mask[i] = 1;
+        }
+    }
+}
+
+// Rebuild the defect index list from the mask
+static DCAMERR orcacam_defect_reindex(struct _ORCA_DEFECT_MAP *m)
+{
+    size_t npix = (size_t)m->width * m->height;
+    size_t count = 0;
+    for (size_t i = 0; i < npix; i++)
+    {
+        count += m->mask[i];
+    }
+    uint32_t *index = (uint32_t *)realloc(m->index, sizeof(uint32_t) * (count ? count : 1));
+    if (!index)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    count = 0;
+    for (size_t i = 0; i < npix; i++)
+    {
+        if (m->mask[i])
+        {
+            index[count++] = (uint32_t)i;
+        }
+    }
+    m->index       = index;
+    m->num_defects = count;
+    m->dirty       = true;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_defect_build(ORCA_DEFECT_MAP map, double hot_sigma,
+                          double noisy_sigma)
+{
+    assert(map);
+    if (!map->sum || map->frames == 0)
+    {
+        return DCAMERR_NOTREADY;
+    }
+    size_t npix    = (size_t)map->width * map->height;
+    float *values  = (float *)malloc(sizeof(float) * npix);
+    float *scratch = (float *)malloc(sizeof(float) * npix);
+    if (!values || !scratch)
+    {
+        free(values);
+        free(scratch);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    double n = (double)map->frames;
+    if (hot_sigma > 0)
+    {
+        for (size_t i = 0; i < npix; i++)
+        {
+            values[i] = (float)(map->sum[i] / n);
+        }
+        orcacam_defect_classify(map, values, scratch, hot_sigma);
+    }
+    if (noisy_sigma > 0 && map->frames > 1)
+    {
+        // a sub-count standard deviation is kept, not rounded
+        for (size_t i = 0; i < npix; i++)
+        {
+            double mean = map->sum[i] / n;
+            double var  = map->sumsq[i] / n - mean * mean;
+            values[i]   = var > 0 ? (float)sqrt(var) : 0.0f;
+        }
+        orcacam_defect_classify(map, values, scratch, noisy_sigma);
+    }
+    free(values);
+    free(scratch);
+    free(map->sum);
+    free(map->sumsq);
+    map->sum    = NULL;
+    map->sumsq  = NULL;
+    map->frames = 0;
+    return orcacam_defect_reindex(map);
+}
+
+DCAMERR orca_defect_add(ORCA_DEFECT_MAP map, int32 x, int32 y)
+{
+    assert(map);
+    if (x < 0 || y < 0 || x >= map->width || y >= map->height)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    size_t i = (size_t)y * map->width + x;
+    if (map->mask[i])
+    {
+        return DCAMERR_SUCCESS;
+    }
+    map->mask[i] = 1;
+    return orcacam_defect_reindex(map);
+}
+
+size_t orca_defect_count(ORCA_DEFECT_MAP map)
+{
+    assert(map);
+    return map->num_defects;
+}
+
+// Precompute the byte offsets of the defects and their neighbours
+static DCAMERR orcacam_defect_plan(struct _ORCA_DEFECT_MAP *m, int32 stride,
+                                   int32 bpp)
+{
+    size_t count = m->num_defects ? m->num_defects : 1;
+    int32 *plan_off = (int32 *)realloc(m->plan_off, sizeof(int32) * count);
+    if (!plan_off)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    m->plan_off = plan_off;
+    int32 *nbr_off =
+        (int32 *)realloc(m->nbr_off, sizeof(int32) * ORCACAM_DEFECT_NBR * count);
+    if (!nbr_off)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    m->nbr_off    = nbr_off;
+    m->plan_count = 0;
+    for (size_t d = 0; d < m->num_defects; d++)
+    {
+        int32 x = (int32)(m->index[d] % m->width);
+        int32 y = (int32)(m->index[d] / m->width);
+        int32 valid[ORCACAM_DEFECT_NBR];
+        int32 k = 0;
+        for (int32 dy = -1; dy <= 1; dy++)
+        {
+            for (int32 dx = -1; dx <= 1; dx++)
+            {
+                int32 nx = x + dx, ny = y + dy;
+                if ((!dx && !dy) || nx < 0 || ny < 0 || nx >= m->width ||
+                    ny >= m->height || m->mask[(size_t)ny * m->width + nx])
+                {
+                    continue;
+                }
+                valid[k++] = ny * stride + nx * bpp;
+            }
+        }
+        if (k == 0) // no good neighbour, leave as is
+        {
+            continue;
+        }
+        // pad to 8 slots so that the 4th smallest is the lower median
+        int32 low   = 3 - (k - 1) / 2;
+        int32 *nbr  = nbr_off + ORCACAM_DEFECT_NBR * m->plan_count;
+        for (int32 s = 0; s < ORCACAM_DEFECT_NBR; s++)
+        {
+            nbr[s] = s < low       ? ORCACAM_DEFECT_LOW
+                     : s < low + k ? valid[s - low]
+                                   : ORCACAM_DEFECT_HIGH;
+        }
+        plan_off[m->plan_count++] = y * stride + x * bpp;
+    }
+    m->plan_stride = stride;
+    m->plan_bpp    = bpp;
+    m->dirty       = false;
+    return DCAMERR_SUCCESS;
+}
+
+#define ORCACAM_CMPSWP(a, b)                                                   \
+    {                                                                          \
+        ORCACAM_T _t = ORCACAM_MIN(a, b);                                      \
+        b            = ORCACAM_MAX(a, b);                                      \
+        a            = _t;                                                     \
+    }
+
+// 19-comparator sorting network for 8 elements
+#define ORCACAM_SORT8(v)                                                       \
+    {                                                                          \
+        ORCACAM_CMPSWP(v[0], v[2]);                                            \
+        ORCACAM_CMPSWP(v[1], v[3]);                                            \
+        ORCACAM_CMPSWP(v[4], v[6]);                                            \
+        ORCACAM_CMPSWP(v[5], v[7]);                                            \
+        ORCACAM_CMPSWP(v[0], v[4]);                                            \
+        ORCACAM_CMPSWP(v[1], v[5]);                                            \
+        ORCACAM_CMPSWP(v[2], v[6]);                                            \
+        ORCACAM_CMPSWP(v[3], v[7]);                                            \
+        ORCACAM_CMPSWP(v[0], v[1]);                                            \
+        ORCACAM_CMPSWP(v[2], v[3]);                                            \
+        ORCACAM_CMPSWP(v[4], v[5]);                                            \
+        ORCACAM_CMPSWP(v[6], v[7]);                                            \
+        ORCACAM_CMPSWP(v[2], v[4]);                                            \
+        ORCACAM_CMPSWP(v[3], v[5]);                                            \
+        ORCACAM_CMPSWP(v[1], v[4]);                                            \
+        ORCACAM_CMPSWP(v[3], v[6]);                                            \
+        ORCACAM_CMPSWP(v[1], v[2]);                                            \
+        ORCACAM_CMPSWP(v[3], v[4]);                                            \
+        ORCACAM_CMPSWP(v[5], v[6]);                                            \
+    }
+
+static inline uint16_t orcacam_defect_load(const char *data, int32 off,
+                                           bool mono8)
+{
+    if (off == ORCACAM_DEFECT_LOW)
+    {
+        return 0;
+    }
+    if (off == ORCACAM_DEFECT_HIGH)
+    {
+        return 0xffff;
+    }
+    return mono8 ? *(const uint8_t *)(data + off)
+                 : *(const uint16_t *)(data + off);
+}
+
+static inline void orcacam_defect_store(char *data, int32 off, bool mono8,
+                                        uint16_t v)
+{
+    if (mono8)
+    {
+        *(uint8_t *)(data + off) = (uint8_t)v;
+    }
+    else
+    {
+        *(uint16_t *)(data + off) = v;
+    }
+}
+
+DCAMERR orca_defect_correct(ORCA_DEFECT_MAP map, ORCA_FRAME *frame)
+{
+    assert(map);
+    assert(frame);
+    DCAMERR err;
+    if (frame->fmt != DCAM_PIXELTYPE_MONO8 &&
+        frame->fmt != DCAM_PIXELTYPE_MONO16)
+    {
+        return DCAMERR_NOTSUPPORT;
+    }
+    if (!frame->data || frame->width != map->width ||
+        frame->height != map->height)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    bool mono8 = frame->fmt == DCAM_PIXELTYPE_MONO8;
+    int32 bpp  = mono8 ? 1 : 2;
+    if (map->dirty || map->plan_stride != frame->row_stride ||
+        map->plan_bpp != bpp)
+    {
+        err = orcacam_defect_plan(map, frame->row_stride, bpp);
+        if (orcaerr_failed(err))
+        {
+            return err;
+        }
+    }
+    char *data = frame->data;
+    size_t d   = 0;
+#if defined(__SSE2__)
+    // 8 defects per iteration, one per 16-bit lane, sign-flipped so that the
+    // signed min/max order unsigned values
+#define ORCACAM_T __m128i
+#define ORCACAM_MIN _mm_min_epi16
+#define ORCACAM_MAX _mm_max_epi16
+    const uint16_t sign = 0x8000;
+    for (; d + 8 <= map->plan_count; d += 8)
+    {
+        uint16_t lanes[ORCACAM_DEFECT_NBR][8] __attribute__((aligned(16)));
+        for (int32 l = 0; l < 8; l++)
+        {
+            const int32 *nbr = map->nbr_off + ORCACAM_DEFECT_NBR * (d + l);
+            for (int32 s = 0; s < ORCACAM_DEFECT_NBR; s++)
+            {
+                lanes[s][l] = orcacam_defect_load(data, nbr[s], mono8) ^ sign;
+            }
+        }
+        __m128i v[ORCACAM_DEFECT_NBR];
+        for (int32 s = 0; s < ORCACAM_DEFECT_NBR; s++)
+        {
+            v[s] = _mm_load_si128((const __m128i *)lanes[s]);
+        }
+        ORCACAM_SORT8(v);
+        _mm_store_si128((__m128i *)lanes[0], v[3]);
+        for (int32 l = 0; l < 8; l++)
+        {
+            orcacam_defect_store(data, map->plan_off[d + l], mono8,
+                                 lanes[0][l] ^ sign);
+        }
+    }
+#undef ORCACAM_T
+#undef ORCACAM_MIN
+#undef ORCACAM_MAX
+#endif
+#define ORCACAM_T uint16_t
+#define ORCACAM_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define ORCACAM_MAX(a, b) ((a) < (b) ? (b) : (a))
+    for (; d < map->plan_count; d++)
+    {
+        const int32 *nbr = map->nbr_off + ORCACAM_DEFECT_NBR * d;
+        uint16_t v[ORCACAM_DEFECT_NBR];
+        for (int32 s = 0; s < ORCACAM_DEFECT_NBR; s++)
+        {
+            v[s] = orcacam_defect_load(data, nbr[s], mono8);
+        }
+        ORCACAM_SORT8(v);
+        orcacam_defect_store(data, map->plan_off[d], mono8, v[3]);
+    }
+#undef ORCACAM_T
+#undef ORCACAM_MIN
+#undef ORCACAM_MAX
+    return DCAMERR_SUCCESS;
+}
+
+void orca_defect_stage(ORCA_FRAME *frame, void *map, size_t sz_map)
+{
+    (void)sz_map;
+    if (!map)
+    {
+        return;
+    }
+    orca_defect_correct((ORCA_DEFECT_MAP)map, frame);
+}
+
+// <dir>/orcacam_defects_<camera ID>.bin, with unsafe characters replaced
+static void orcacam_defect_path(char *path, size_t sz_path, const char *dir,
+                                const char *camera_id)
+{
+    char id[64];
+    size_t i;
+    for (i = 0; i < sizeof(id) - 1 && camera_id[i]; i++)
+    {
+        char c = camera_id[i];
+        bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+                  (c >= 'A' && c <= 'Z') || c == '-' || c == '.';
+        id[i] = ok ? c : '_';
+    }
+    id[i] = '\0';
+    snprintf(path, sz_path, "%s/orcacam_defects_%s.bin", dir, id);
+}
+
+DCAMERR orca_defect_save(ORCA_DEFECT_MAP map, const char *dir)
+{
+    assert(map);
+    assert(dir);
+    char path[4096];
+    orcacam_defect_path(path, sizeof(path), dir, map->camera_id);
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+    {
+        return DCAMERR_FAILEDWRITEDATA;
+    }
+    uint64_t count = map->num_defects;
+    bool ok        = fwrite(ORCACAM_DEFECT_MAGIC, 8, 1, fp) == 1 &&
+              fwrite(map->camera_id, sizeof(map->camera_id), 1, fp) == 1 &&
+              fwrite(&(map->width), sizeof(int32), 1, fp) == 1 &&
+              fwrite(&(map->height), sizeof(int32), 1, fp) == 1 &&
+              fwrite(&count, sizeof(count), 1, fp) == 1 &&
+              fwrite(map->index, sizeof(uint32_t), count, fp) == count;
+    ok = (fclose(fp) == 0) && ok;
+    return ok ? DCAMERR_SUCCESS : DCAMERR_FAILEDWRITEDATA;
+}
+
+DCAMERR orca_defect_load(ORCA_DEFECT_MAP *map, const char *dir,
+                         const char *camera_id)
+{
+    assert(map);
+    assert(dir);
+    assert(camera_id);
+    DCAMERR err;
+    char path[4096];
+    char magic[8];
+    char id[64];
+    int32 width, height;
+    uint64_t count;
+    *map = NULL;
+    orcacam_defect_path(path, sizeof(path), dir, camera_id);
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        return DCAMERR_NOTSUPPORT;
+    }
+    if (fread(magic, sizeof(magic), 1, fp) != 1 ||
+        memcmp(magic, ORCACAM_DEFECT_MAGIC, sizeof(magic)) ||
+        fread(id, sizeof(id), 1, fp) != 1 ||
+        fread(&width, sizeof(int32), 1, fp) != 1 ||
+        fread(&height, sizeof(int32), 1, fp) != 1 ||
+        fread(&count, sizeof(count), 1, fp) != 1)
+    {
+        err = DCAMERR_FAILEDREADDATA;
+        goto close_fp;
+    }
+    id[sizeof(id) - 1] = '\0';
+    // a copied or renamed map belongs to another sensor
+    if (strncmp(id, camera_id, sizeof(id) - 1))
+    {
+        err = DCAMERR_INVALIDPARAM;
+        goto close_fp;
+    }
+    err = orca_defect_create(map, id, width, height);
+    if (orcaerr_failed(err))
+    {
+        goto close_fp;
+    }
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint32_t idx;
+        if (fread(&idx, sizeof(idx), 1, fp) != 1 ||
+            idx >= (uint64_t)width * height)
+        {
+            orca_defect_destroy(map);
+            err = DCAMERR_FAILEDREADDATA;
+            goto close_fp;
+        }
+        (*map)->mask[idx] = 1;
+    }
+    err = orcacam_defect_reindex(*map);
+    if (orcaerr_failed(err))
+    {
+        orca_defect_destroy(map);
+    }
+close_fp:
+    fclose(fp);
+    return err;
+}
+
+void orca_defect_destroy(ORCA_DEFECT_MAP *map)
+{
+    assert(map);
+    struct _ORCA_DEFECT_MAP *m = *map;
+    if (!m)
+    {
+        return;
+    }
+    free(m->mask);
+    free(m->index);
+    free(m->plan_off);
+    free(m->nbr_off);
+    free(m->sum);
+    free(m->sumsq);
+    free(m);
+    *map = NULL;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file orcacam_hist.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Internal lock-free recording of the capture statistics.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_HIST_H_
+#define _ORCACAM_HIST_H_
+
+#include "orcacam_stats.h"
+#include <stdatomic.h>
+#include <time.h>
+
+/**
+ * @brief Histogram updated by one writer at a time
+ *
+ */
+struct _ORCA_HIST
+{
+    atomic_uint_fast64_t sum;
+    atomic_uint_fast64_t min;
+    atomic_uint_fast64_t max;
+    atomic_uint_fast64_t buckets[ORCA_HIST_BUCKETS];
+};
+
+/**
+ * @brief Capture statistics updated by the capture thread
+ *
+ */
+struct _ORCA_STATS_REC
+{
+    atomic_uint_fast64_t frames;
+    atomic_uint_fast64_t timeouts;
+    atomic_uint_fast64_t aborts;
+    atomic_uint_fast64_t errors;
+    atomic_uint_fast64_t dropped;
+    atomic_uint_fast64_t pending;     // gauge
+    atomic_uint_fast64_t ring_frames; // gauge, kept on reset
+    struct _ORCA_HIST hist[ORCA_STAT_MAX];
+};
+
+/**
+ * @brief Get the bucket of a value.
+ *
+ * @param v Value
+ * @return int Bucket index
+ */
+static inline int orcacam_hist_bucket(uint64_t v)
+{
+    const uint64_t sub = 1ULL << ORCA_HIST_SUB_BITS;
+    if (v >= (1ULL << ORCA_HIST_MAX_BITS))
+    {
+        return ORCA_HIST_BUCKETS - 1;
+    }
+    if (v < sub)
+    {
+        return (int)v;
+    }
+    int e = 63 - __builtin_clzll(v); // highest set bit, at least SUB_BITS
+    int s = e - ORCA_HIST_SUB_BITS;
+    return ((s + 1) << ORCA_HIST_SUB_BITS) + (int)((v >> s) & (sub - 1));
+}
+
+/**
+ * @brief Get the smallest value of a bucket.
+ *
+ * @param bucket Bucket index
+ * @return uint64_t Value
+ */
+static inline uint64_t orcacam_hist_lowest(int bucket)
+{
+    const int sub = 1 << ORCA_HIST_SUB_BITS;
+    if (bucket < sub)
+    {
+        return (uint64_t)bucket;
+    }
+    int s = (bucket >> ORCA_HIST_SUB_BITS) - 1;
+    return (uint64_t)(sub + (bucket & (sub - 1))) << s;
+}
+
+/**
+ * @brief Record a value. The minimum and maximum are updated without a
+ * compare-and-swap, as values come from a single thread.
+ *
+ * @param h Histogram
+ * @param v Value (ns)
+ */
+static inline void orcacam_hist_record(struct _ORCA_HIST *h, uint64_t v)
+{
+    atomic_fetch_add_explicit(&(h->buckets[orcacam_hist_bucket(v)]), 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&(h->sum), v, memory_order_relaxed);
+    if (v < atomic_load_explicit(&(h->min), memory_order_relaxed))
+    {
+        atomic_store_explicit(&(h->min), v, memory_order_relaxed);
+    }
+    if (v > atomic_load_explicit(&(h->max), memory_order_relaxed))
+    {
+        atomic_store_explicit(&(h->max), v, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Increment a counter.
+ *
+ * @param c Counter
+ */
+static inline void orcacam_stats_count(atomic_uint_fast64_t *c)
+{
+    atomic_fetch_add_explicit(c, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Get the monotonic time.
+ *
+ * @return uint64_t Time (ns)
+ */
+static inline uint64_t orcacam_stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Copy the statistics.
+ *
+ * @param stats Statistics
+ * @param out Output snapshot
+ */
+void orcacam_stats_snapshot(struct _ORCA_STATS_REC *stats, ORCA_STATS *out);
+
+/**
+ * @brief Reset the statistics.
+ *
+ * @param stats Statistics
+ */
+void orcacam_stats_reset(struct _ORCA_STATS_REC *stats);
+
+#endif // _ORCACAM_HIST_H_
@@ -0,0 +1,273 @@
+#define _GNU_SOURCE
+#include "orcacam_logsite.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+_Static_assert((ORCA_LOG_QUEUE_LEN & (ORCA_LOG_QUEUE_LEN - 1)) == 0,
+               "ORCA_LOG_QUEUE_LEN must be a power of two");
+
+// Bounded multi-producer queue: a cell is free for the producer of position
+// pos when its sequence is pos, and holds a record when it is pos + 1.
+struct _ORCA_LOG_CELL
+{
+    atomic_size_t seq;
+    ORCA_LOG_RECORD rec;
+};
+
+static struct
+{
+    struct _ORCA_LOG_CELL cells[ORCA_LOG_QUEUE_LEN];
+    atomic_size_t tail; // next position to write
+    atomic_size_t head; // next position to read, written by the logger only
+    sem_t ready;        // records queued
+    atomic_bool stop;
+    pthread_t thread;
+    bool running;
+    pthread_mutex_t sink_lock; // held while the sink is called
+    OrcaLogCallback sink;
+    void *user_data;
+} orcacam_logger = {
+    .sink_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static pthread_once_t orcacam_log_once = PTHREAD_ONCE_INIT;
+static atomic_uint_fast64_t orcacam_log_drops    = 0;
+static atomic_uint_fast32_t orcacam_log_burst    = ORCA_LOG_DEFAULT_BURST;
+static atomic_uint_fast32_t orcacam_log_interval = ORCA_LOG_DEFAULT_INTERVAL;
+atomic_int orcacam_log_level                     = ORCA_LOG_WARNING;
+
+static const char *orcacam_log_levels[] = {"DEBUG", "INFO", "WARNING",
+                                           "ERROR"};
+
+static void orcacam_log_stderr(const ORCA_LOG_RECORD *rec, void *user_data)
+{
+    fprintf(stderr, "%s: %s:%d:%s(): %s", orcacam_log_levels[rec->level],
+            rec->file, rec->line, rec->func, rec->message);
+    if (rec->err != DCAMERR_SUCCESS)
+    {
+        fprintf(stderr, " -> %s", orcacam_sterr(rec->err));
+    }
+    if (rec->suppressed)
+    {
+        fprintf(stderr, " (%u similar messages suppressed)", rec->suppressed);
+    }
+    fprintf(stderr, "\n");
+}
+
+// Pass the queued records to the sink
+static void orcacam_log_drain(void)
+{
+    size_t head = atomic_load_explicit(&orcacam_logger.head,
+                                       memory_order_relaxed);
+    while (true)
+    {
+        struct _ORCA_LOG_CELL *cell =
+            &(orcacam_logger.cells[head & (ORCA_LOG_QUEUE_LEN - 1)]);
+        if (atomic_load_explicit(&(cell->seq), memory_order_acquire) !=
+            head + 1)
+        {
+            break;
+        }
+        pthread_mutex_lock(&orcacam_logger.sink_lock);
+        if (orcacam_logger.sink)
+        {
+            orcacam_logger.sink(&(cell->rec), orcacam_logger.user_data);
+        }
+        else
+        {
+            orcacam_log_stderr(&(cell->rec), NULL);
+        }
+        pthread_mutex_unlock(&orcacam_logger.sink_lock);
+        atomic_store_explicit(&(cell->seq), head + ORCA_LOG_QUEUE_LEN,
+                              memory_order_release);
+        atomic_store_explicit(&orcacam_logger.head, ++head,
+                              memory_order_release);
+    }
+    if (!orcacam_logger.sink)
+    {
+        fflush(stderr);
+    }
+}
+
+static void *orcacam_log_thread(void *inp)
+{
+    while (!atomic_load(&orcacam_logger.stop))
+    {
+        if (sem_wait(&orcacam_logger.ready) == 0)
+        {
+            orcacam_log_drain();
+        }
+    }
+    orcacam_log_drain();
+    return inp;
+}
+
+// Pass the remaining records to the sink at exit
+static void orcacam_log_exit(void)
+{
+    atomic_store(&orcacam_logger.stop, true);
+    sem_post(&orcacam_logger.ready);
+    pthread_join(orcacam_logger.thread, NULL);
+}
+
+static void orcacam_log_init(void)
+{
+    for (size_t i = 0; i < ORCA_LOG_QUEUE_LEN; i++)
+    {
+        atomic_init(&(orcacam_logger.cells[i].seq), i);
+    }
+    sem_init(&orcacam_logger.ready, 0, 0);
+    // the logger thread must not receive the signals of the application
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    orcacam_logger.running =
+        pthread_create(&orcacam_logger.thread, NULL, orcacam_log_thread,
+                       NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (orcacam_logger.running)
+    {
+        atexit(orcacam_log_exit);
+    }
+}
+
+// Check the rate of a call site, counting the records it suppresses
+static bool orcacam_log_allowed(struct _ORCA_LOG_SITE *site)
+{
+    uint32_t burst =
+        atomic_load_explicit(&orcacam_log_burst, memory_order_relaxed);
+    if (!burst)
+    {
+        return true;
+    }
+    uint64_t interval =
+        atomic_load_explicit(&orcacam_log_interval, memory_order_relaxed);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    uint64_t now    = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    uint64_t window = now / (interval ? interval : 1) + 1;
+    uint64_t last =
+        atomic_load_explicit(&(site->window), memory_order_relaxed);
+    if (last != window &&
+        atomic_compare_exchange_strong(&(site->window), &last, window))
+    {
+        atomic_store_explicit(&(site->count), 0, memory_order_relaxed);
+    }
+    if (atomic_fetch_add_explicit(&(site->count), 1, memory_order_relaxed) <
+        burst)
+    {
+        return true;
+    }
+    atomic_fetch_add_explicit(&(site->suppressed), 1, memory_order_relaxed);
+    return false;
+}
+
+void orcacam_log(struct _ORCA_LOG_SITE *site, int level, DCAMERR err,
+                 const char *fmt, ...)
+{
+    if (!orcacam_log_allowed(site))
+    {
+        return;
+    }
+    pthread_once(&orcacam_log_once, orcacam_log_init);
+    if (!orcacam_logger.running)
+    {
+        return;
+    }
+    // claim a cell
+    struct _ORCA_LOG_CELL *cell;
+    size_t pos =
+        atomic_load_explicit(&orcacam_logger.tail, memory_order_relaxed);
+    while (true)
+    {
+        cell = &(orcacam_logger.cells[pos & (ORCA_LOG_QUEUE_LEN - 1)]);
+        size_t seq = atomic_load_explicit(&(cell->seq), memory_order_acquire);
+        if (seq == pos)
+        {
+            if (atomic_compare_exchange_weak_explicit(
+                    &orcacam_logger.tail, &pos, pos + 1, memory_order_relaxed,
+                    memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if ((intptr_t)(seq - pos) < 0)
+        {
+            atomic_fetch_add_explicit(&orcacam_log_drops, 1,
+                                      memory_order_relaxed);
+            return; // full
+        }
+        else
+        {
+            pos = atomic_load_explicit(&orcacam_logger.tail,
+                                       memory_order_relaxed);
+        }
+    }
+    ORCA_LOG_RECORD *rec = &(cell->rec);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->timestamp_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    rec->level        = level;
+    rec->err          = err;
+    rec->file         = site->file;
+    rec->func         = site->func;
+    rec->line         = site->line;
+    rec->tid          = (uint32_t)syscall(SYS_gettid);
+    rec->suppressed   = (uint32_t)atomic_exchange_explicit(
+        &(site->suppressed), 0, memory_order_relaxed);
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(rec->message, sizeof(rec->message), fmt, ap);
+    va_end(ap);
+    atomic_store_explicit(&(cell->seq), pos + 1, memory_order_release);
+    sem_post(&orcacam_logger.ready);
+}
+
+void orca_log_set_sink(OrcaLogCallback cb, void *user_data)
+{
+    pthread_mutex_lock(&orcacam_logger.sink_lock);
+    orcacam_logger.sink      = cb;
+    orcacam_logger.user_data = user_data;
+    pthread_mutex_unlock(&orcacam_logger.sink_lock);
+}
+
+void orca_log_set_level(ORCA_LOG_LEVEL level)
+{
+    atomic_store(&orcacam_log_level, (int)level);
+}
+
+ORCA_LOG_LEVEL orca_log_get_level(void)
+{
+    return (ORCA_LOG_LEVEL)atomic_load(&orcacam_log_level);
+}
+
+void orca_log_set_rate(uint32_t burst, uint32_t interval_ms)
+{
+    atomic_store(&orcacam_log_burst, burst);
+    atomic_store(&orcacam_log_interval, interval_ms);
+}
+
+void orca_log_flush(void)
+{
+    size_t tail = atomic_load(&orcacam_logger.tail);
+    // cells claimed before the flush may still be written
+    while (orcacam_logger.running &&
+           (intptr_t)(atomic_load(&orcacam_logger.head) - tail) < 0)
+    {
+        usleep(1000);
+    }
+}
+
+uint64_t orca_log_dropped(void)
+{
+    return atomic_load(&orcacam_log_drops);
+}
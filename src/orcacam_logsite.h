@@ -0,0 +1,83 @@
+/**
+ * @file orcacam_logsite.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Internal rate-limited log call sites.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_LOGSITE_H_
+#define _ORCACAM_LOGSITE_H_
+
+#include "orcacam_log.h"
+#include <stdatomic.h>
+
+/**
+ * @brief Log call site, with its rate limiting state
+ *
+ */
+struct _ORCA_LOG_SITE
+{
+    const char *file;
+    const char *func;
+    int32 line;
+    atomic_uint_fast64_t window;     // rate limiting interval, + 1
+    atomic_uint_fast32_t count;      // records in the interval
+    atomic_uint_fast32_t suppressed; // since the last record
+};
+
+extern atomic_int orcacam_log_level;
+
+/**
+ * @brief Queue a record, unless the call site exceeds its rate.
+ *
+ * @param site Call site
+ * @param level ORCA_LOG_LEVEL
+ * @param err DCAMERR
+ * @param fmt printf format of the message
+ */
+void orcacam_log(struct _ORCA_LOG_SITE *site, int level, DCAMERR err,
+                 const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/**
+ * @brief Get the severity of a failed driver call.
+ *
+ * @param err DCAMERR
+ * @return int ORCA_LOG_LEVEL
+ */
+static inline int orcacam_log_severity(DCAMERR err)
+{
+    if (err == DCAMERR_ABORT)
+    {
+        return ORCA_LOG_DEBUG;
+    }
+    if (err == DCAMERR_TIMEOUT)
+    {
+        return ORCA_LOG_WARNING;
+    }
+    return ORCA_LOG_ERROR;
+}
+
+/**
+ * @brief Log a message. The level is checked before the arguments are
+ * evaluated.
+ *
+ */
+#define ORCA_LOG(level, err, ...)                                              \
+    do                                                                         \
+    {                                                                          \
+        static struct _ORCA_LOG_SITE site_ = {                                 \
+            .file = __FILE__, .func = __func__, .line = __LINE__};             \
+        int level_ = (level);                                                  \
+        if (level_ >= atomic_load_explicit(&orcacam_log_level,                 \
+                                           memory_order_relaxed))              \
+        {                                                                      \
+            orcacam_log(&site_, level_, err, __VA_ARGS__);                     \
+        }                                                                      \
+    } while (0)
+
+#endif // _ORCACAM_LOGSITE_H_
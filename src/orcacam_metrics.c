@@ -0,0 +1,494 @@
+#define _GNU_SOURCE
+#include "orcacam_metrics.h"
+#include "orcacam_sock.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ORCACAM_METRICS_BACKLOG 8
+#define ORCACAM_METRICS_REQUEST 2048    // longest request read
+#define ORCACAM_METRICS_TEXT 16384      // metrics text buffer
+#define ORCACAM_METRICS_TIMEOUT_MS 1000 // time to receive a request
+#define ORCACAM_METRICS_NICE 19         // nice value of the exporter thread
+#define ORCACAM_METRICS_CONTENT_TYPE                                           \
+    "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+struct _ORCA_METRICS
+{
+    ORCACAM cam;
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)]; // empty for TCP
+    int listen_fd;
+    int wake_fd; // eventfd stopping the exporter thread
+    pthread_t thread;
+    pthread_mutex_t lock; // protects the frame rate state
+    uint64_t last_frames;
+    uint64_t last_ns;
+    ORCA_STATS stats; // snapshot, too large for the stack of a scrape
+    char text[ORCACAM_METRICS_TEXT];
+};
+
+static const char *orcacam_metrics_intervals[ORCA_STAT_MAX] = {
+    "wakeup",
+    "callback",
+    "transferinfo",
+    "delivery",
+};
+
+static const double orcacam_metrics_quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+struct _ORCA_METRICS_TEXT
+{
+    char *buf;
+    size_t size;
+    size_t len; // may exceed size
+};
+
+static void orcacam_metrics_printf(struct _ORCA_METRICS_TEXT *t,
+                                   const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    size_t left = t->len < t->size ? t->size - t->len : 0;
+    int n       = vsnprintf(left ? t->buf + t->len : NULL, left, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+    {
+        t->len += n;
+    }
+}
+
+static void orcacam_metrics_family(struct _ORCA_METRICS_TEXT *t,
+                                   const char *name, const char *type,
+                                   const char *unit, const char *help)
+{
+    orcacam_metrics_printf(t, "# TYPE %s %s\n", name, type);
+    if (unit)
+    {
+        orcacam_metrics_printf(t, "# UNIT %s %s\n", name, unit);
+    }
+    orcacam_metrics_printf(t, "# HELP %s %s\n", name, help);
+}
+
+static uint64_t orcacam_metrics_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+size_t orca_metrics_format(ORCA_METRICS metrics, char *buf, size_t size)
+{
+    assert(metrics);
+    assert(buf);
+    struct _ORCA_METRICS_TEXT t = {buf, size, 0};
+    ORCA_STATS *st              = &(metrics->stats);
+    pthread_mutex_lock(&(metrics->lock));
+    orca_get_stats(metrics->cam, st);
+    uint64_t now = orcacam_metrics_now_ns();
+    // frame rate since the previous scrape; the counters may have been reset
+    uint64_t frames = st->frames >= metrics->last_frames
+                          ? st->frames - metrics->last_frames
+                          : st->frames;
+    double fps = now > metrics->last_ns
+                     ? frames * 1e9 / (now - metrics->last_ns)
+                     : 0;
+    metrics->last_frames = st->frames;
+    metrics->last_ns     = now;
+
+    orcacam_metrics_family(&t, "orcacam_frames", "counter", NULL,
+                           "Frames delivered to the frame callback");
+    orcacam_metrics_printf(&t, "orcacam_frames_total %llu\n",
+                           (unsigned long long)st->frames);
+    orcacam_metrics_family(&t, "orcacam_dropped_frames", "counter", NULL,
+                           "Frames skipped as the callback fell behind");
+    orcacam_metrics_printf(&t, "orcacam_dropped_frames_total %llu\n",
+                           (unsigned long long)st->dropped);
+    orcacam_metrics_family(&t, "orcacam_wait_timeouts", "counter", NULL,
+                           "Frame waits that timed out");
+    orcacam_metrics_printf(&t, "orcacam_wait_timeouts_total %llu\n",
+                           (unsigned long long)st->timeouts);
+    orcacam_metrics_family(&t, "orcacam_capture_errors", "counter", NULL,
+                           "Failed frame waits and transfer info calls");
+    orcacam_metrics_printf(&t, "orcacam_capture_errors_total %llu\n",
+                           (unsigned long long)st->errors);
+    orcacam_metrics_family(&t, "orcacam_fps", "gauge", NULL,
+                           "Frames delivered per second since the previous "
+                           "scrape");
+    orcacam_metrics_printf(&t, "orcacam_fps %.6g\n", fps);
+    orcacam_metrics_family(&t, "orcacam_ring_pending_frames", "gauge", NULL,
+                           "Frames of the ring waiting for delivery at the "
+                           "last wakeup");
+    orcacam_metrics_printf(&t, "orcacam_ring_pending_frames %llu\n",
+                           (unsigned long long)st->pending);
+    orcacam_metrics_family(&t, "orcacam_ring_frames", "gauge", NULL,
+                           "Number of frames of the capture ring");
+    orcacam_metrics_printf(&t, "orcacam_ring_frames %llu\n",
+                           (unsigned long long)st->ring_frames);
+
+    // cameras without a sensor cooler do not have these properties
+    double v;
+    if (!orcaerr_failed(orca_get_temperature(metrics->cam, &v)))
+    {
+        orcacam_metrics_family(&t, "orcacam_sensor_temperature_celsius",
+                               "gauge", "celsius", "Sensor temperature");
+        orcacam_metrics_printf(&t, "orcacam_sensor_temperature_celsius %.6g\n",
+                               v);
+    }
+    if (!orcaerr_failed(orca_get_value(metrics->cam,
+                                       DCAM_IDPROP_SENSORCOOLERSTATUS, &v)))
+    {
+        orcacam_metrics_family(&t, "orcacam_sensor_cooler_status", "gauge",
+                               NULL,
+                               "Sensor cooler status, a "
+                               "DCAMPROP_SENSORCOOLERSTATUS value (2: ready, "
+                               "negative: error)");
+        orcacam_metrics_printf(&t, "orcacam_sensor_cooler_status %d\n",
+                               (int)v);
+    }
+
+    orcacam_metrics_family(&t, "orcacam_latency_seconds", "summary", "seconds",
+                           "Capture thread latencies");
+    for (int k = 0; k < ORCA_STAT_MAX; k++)
+    {
+        const ORCA_HISTOGRAM *h = &(st->hist[k]);
+        for (size_t q = 0; q < sizeof(orcacam_metrics_quantiles) /
+                                   sizeof(orcacam_metrics_quantiles[0]);
+             q++)
+        {
+            double p = orcacam_metrics_quantiles[q];
+            orcacam_metrics_printf(
+                &t, "orcacam_latency_seconds{interval=\"%s\",quantile=\"%g\"} "
+                    "%.9g\n",
+                orcacam_metrics_intervals[k], p,
+                orca_hist_percentile(h, p * 100) * 1e-9);
+        }
+        orcacam_metrics_printf(
+            &t, "orcacam_latency_seconds_sum{interval=\"%s\"} %.9g\n",
+            orcacam_metrics_intervals[k], h->sum * 1e-9);
+        orcacam_metrics_printf(
+            &t, "orcacam_latency_seconds_count{interval=\"%s\"} %llu\n",
+            orcacam_metrics_intervals[k], (unsigned long long)h->count);
+    }
+    orcacam_metrics_family(&t, "orcacam_latency_max_seconds", "gauge",
+                           "seconds", "Largest capture thread latencies");
+    for (int k = 0; k < ORCA_STAT_MAX; k++)
+    {
+        orcacam_metrics_printf(
+            &t, "orcacam_latency_max_seconds{interval=\"%s\"} %.9g\n",
+            orcacam_metrics_intervals[k], st->hist[k].max * 1e-9);
+    }
+    pthread_mutex_unlock(&(metrics->lock));
+    orcacam_metrics_printf(&t, "# EOF\n");
+    return t.len;
+}
+
+static void orcacam_metrics_send(int fd, const char *status,
+                                 const char *type, const char *body,
+                                 size_t len)
+{
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %s\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n",
+                     status, type, len);
+    if (send(fd, head, n, MSG_NOSIGNAL) != n)
+    {
+        return;
+    }
+    while (len)
+    {
+        ssize_t sent = send(fd, body, len, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        body += sent;
+        len -= sent;
+    }
+}
+
+// Read the request head, without waiting for a slow client for long
+static bool orcacam_metrics_recv(int fd, char *req, size_t size)
+{
+    size_t len = 0;
+    while (len + 1 < size)
+    {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (poll(&pfd, 1, ORCACAM_METRICS_TIMEOUT_MS) <= 0)
+        {
+            return false;
+        }
+        ssize_t n = recv(fd, req + len, size - len - 1, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        len += n;
+        req[len] = '\0';
+        if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+        {
+            return true;
+        }
+    }
+    return true; // the request line fits anyway
+}
+
+static void orcacam_metrics_serve(struct _ORCA_METRICS *m, int fd)
+{
+    static const char *text_type = "text/plain; charset=utf-8";
+    char req[ORCACAM_METRICS_REQUEST];
+    if (!orcacam_metrics_recv(fd, req, sizeof(req)))
+    {
+        return;
+    }
+    if (strncmp(req, "GET ", 4))
+    {
+        const char *msg = "Method not allowed\n";
+        orcacam_metrics_send(fd, "405 Method Not Allowed", text_type, msg,
+                             strlen(msg));
+        return;
+    }
+    const char *path = req + 4;
+    size_t plen      = strcspn(path, " ?\r\n");
+    if (!(plen == 8 && !strncmp(path, "/metrics", 8)) &&
+        !(plen == 1 && path[0] == '/'))
+    {
+        const char *msg = "Not found, try /metrics\n";
+        orcacam_metrics_send(fd, "404 Not Found", text_type, msg, strlen(msg));
+        return;
+    }
+    size_t len = orca_metrics_format(m, m->text, sizeof(m->text));
+    if (len >= sizeof(m->text))
+    {
+        const char *msg = "Metrics text too long\n";
+        orcacam_metrics_send(fd, "500 Internal Server Error", text_type, msg,
+                             strlen(msg));
+        return;
+    }
+    orcacam_metrics_send(fd, "200 OK", ORCACAM_METRICS_CONTENT_TYPE, m->text,
+                         len);
+}
+
+static void *orcacam_metrics_thread(void *inp)
+{
+    struct _ORCA_METRICS *m = (struct _ORCA_METRICS *)inp;
+    // Scrapes run at the lowest SCHED_OTHER priority, not at SCHED_IDLE: they
+    // take the property cache lock the capture path takes too, and an idle
+    // thread preempted while holding it would stall the capture thread.
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid),
+                ORCACAM_METRICS_NICE);
+    struct pollfd fds[2];
+    fds[0].fd     = m->wake_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd     = m->listen_fd;
+    fds[1].events = POLLIN;
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents)
+        {
+            break;
+        }
+        if (!(fds[1].revents & POLLIN))
+        {
+            continue;
+        }
+        int fd = accept4(m->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+        orcacam_metrics_serve(m, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+// Parse "[host:]port" into a loopback address by default
+static bool orcacam_metrics_inet(const char *address, struct sockaddr_in *in)
+{
+    memset(in, 0, sizeof(struct sockaddr_in));
+    in->sin_family      = AF_INET;
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const char *port    = strrchr(address, ':');
+    if (port)
+    {
+        char host[INET_ADDRSTRLEN];
+        size_t len = port - address;
+        if (len >= sizeof(host))
+        {
+            return false;
+        }
+        memcpy(host, address, len);
+        host[len] = '\0';
+        if (len && inet_pton(AF_INET, host, &(in->sin_addr)) != 1)
+        {
+            return false;
+        }
+        port++;
+    }
+    else
+    {
+        port = address;
+    }
+    char *end;
+    long p = strtol(port, &end, 10);
+    if (end == port || *end || p < 1 || p > 65535)
+    {
+        return false;
+    }
+    in->sin_port = htons((uint16_t)p);
+    return true;
+}
+
+DCAMERR orca_metrics_create(ORCA_METRICS *metrics, ORCACAM cam,
+                            const char *address)
+{
+    assert(metrics);
+    assert(cam);
+    assert(address);
+    *metrics = NULL;
+    struct sockaddr_un un;
+    struct sockaddr_in in;
+    bool is_unix = strchr(address, '/') != NULL;
+    if (is_unix)
+    {
+        if (strlen(address) >= sizeof(un.sun_path))
+        {
+            return DCAMERR_INVALIDPARAM;
+        }
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        strncpy(un.sun_path, address, sizeof(un.sun_path) - 1);
+    }
+    else if (!orcacam_metrics_inet(address, &in))
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    struct _ORCA_METRICS *m =
+        (struct _ORCA_METRICS *)malloc(sizeof(struct _ORCA_METRICS));
+    if (!m)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(m, 0, sizeof(struct _ORCA_METRICS));
+    m->cam     = cam;
+    m->last_ns = orcacam_metrics_now_ns();
+    if (is_unix)
+    {
+        strncpy(m->path, address, sizeof(m->path) - 1);
+    }
+    ORCA_STATS *st = &(m->stats);
+    orca_get_stats(cam, st);
+    m->last_frames = st->frames;
+
+    DCAMERR err = DCAMERR_NORESOURCE;
+    m->wake_fd  = eventfd(0, EFD_CLOEXEC);
+    if (m->wake_fd < 0)
+    {
+        goto free_m;
+    }
+    m->listen_fd =
+        socket(is_unix ? AF_UNIX : AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m->listen_fd < 0)
+    {
+        goto close_wake;
+    }
+    if (is_unix)
+    {
+        // only the socket of an exporter that is not running is replaced
+        err = orcacam_sock_unlink_stale(&un, SOCK_STREAM);
+        if (orcaerr_failed(err))
+        {
+            goto close_listen;
+        }
+        err = DCAMERR_NORESOURCE;
+        if (bind(m->listen_fd, (struct sockaddr *)&un, sizeof(un)) < 0)
+        {
+            goto close_listen;
+        }
+    }
+    else
+    {
+        int one = 1;
+        setsockopt(m->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(m->listen_fd, (struct sockaddr *)&in, sizeof(in)) < 0)
+        {
+            goto close_listen;
+        }
+    }
+    if (listen(m->listen_fd, ORCACAM_METRICS_BACKLOG) < 0)
+    {
+        goto unlink_path;
+    }
+    pthread_mutex_init(&(m->lock), NULL);
+    if (pthread_create(&(m->thread), NULL, orcacam_metrics_thread, m))
+    {
+        pthread_mutex_destroy(&(m->lock));
+        goto unlink_path;
+    }
+    *metrics = m;
+    return DCAMERR_SUCCESS;
+unlink_path:
+    if (is_unix)
+    {
+        unlink(address);
+    }
+close_listen:
+    close(m->listen_fd);
+close_wake:
+    close(m->wake_fd);
+free_m:
+    free(m);
+    return err;
+}
+
+void orca_metrics_destroy(ORCA_METRICS *metrics)
+{
+    assert(metrics);
+    struct _ORCA_METRICS *m = *metrics;
+    if (!m)
+    {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(m->wake_fd, &one, sizeof(one)) == sizeof(one))
+    {
+        pthread_join(m->thread, NULL);
+    }
+    close(m->listen_fd);
+    if (m->path[0])
+    {
+        unlink(m->path);
+    }
+    close(m->wake_fd);
+    pthread_mutex_destroy(&(m->lock));
+    free(m);
+    *metrics = NULL;
+}
@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+#include "orcacam_numa.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <limits.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define ORCACAM_NUMA_USB_VENDOR "0661" // Hamamatsu Photonics
+#define ORCACAM_NUMA_USB_DEVICES "/sys/bus/usb/devices"
+#define ORCACAM_NUMA_NODES "/sys/devices/system/node"
+#define ORCACAM_NUMA_MAX_NODES 1024
+
+// Read the first line of a sysfs file
+static bool orcacam_numa_read(const char *path, char *buf, size_t size)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        return false;
+    }
+    bool ok = fgets(buf, (int)size, fp) != NULL;
+    fclose(fp);
+    if (ok)
+    {
+        buf[strcspn(buf, "\n")] = '\0';
+    }
+    return ok;
+}
+
+// Keep the digits of a serial number, which DCAM reports as "S/N: 000123"
+static void orcacam_numa_digits(const char *in, char *out, size_t size)
+{
+    size_t n = 0;
+    for (; *in && n + 1 < size; in++)
+    {
+        if (isdigit((unsigned char)*in))
+        {
+            out[n++] = *in;
+        }
+    }
+    out[n] = '\0';
+}
+
+// Get the NUMA node of a device, reported by its closest PCI ancestor
+static int32 orcacam_numa_device_node(const char *path)
+{
+    char dir[PATH_MAX];
+    char file[PATH_MAX + 16];
+    char buf[32];
+    if (!realpath(path, dir))
+    {
+        return -1;
+    }
+    while (true)
+    {
+        snprintf(file, sizeof(file), "%s/numa_node", dir);
+        if (orcacam_numa_read(file, buf, sizeof(buf)))
+        {
+            return (int32)atoi(buf);
+        }
+        char *slash = strrchr(dir, '/');
+        if (!slash || slash == dir)
+        {
+            return -1;
+        }
+        *slash = '\0';
+    }
+}
+
+int32 orcacam_numa_node(const char *bus, const char *id)
+{
+    assert(bus);
+    assert(id);
+    if (!strcasestr(bus, "USB"))
+    {
+        return -1;
+    }
+    DIR *dir = opendir(ORCACAM_NUMA_USB_DEVICES);
+    if (!dir)
+    {
+        return -1;
+    }
+    char serial[64], sn[64], buf[64];
+    char path[PATH_MAX];
+    orcacam_numa_digits(id, serial, sizeof(serial));
+    int32 node = -1, count = 0;
+    struct dirent *e;
+    while ((e = readdir(dir)))
+    {
+        if (e->d_name[0] == '.')
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s/idVendor",
+                 ORCACAM_NUMA_USB_DEVICES, e->d_name);
+        if (!orcacam_numa_read(path, buf, sizeof(buf)) ||
+            strcmp(buf, ORCACAM_NUMA_USB_VENDOR))
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", ORCACAM_NUMA_USB_DEVICES,
+                 e->d_name);
+        int32 n = orcacam_numa_device_node(path);
+        snprintf(path, sizeof(path), "%s/%s/serial", ORCACAM_NUMA_USB_DEVICES,
+                 e->d_name);
+        if (serial[0] && orcacam_numa_read(path, buf, sizeof(buf)))
+        {
+            orcacam_numa_digits(buf, sn, sizeof(sn));
+            if (!strcmp(sn, serial))
+            {
+                node  = n;
+                count = 1;
+                break;
+            }
+        }
+        // without a serial match, cameras on different nodes are ambiguous
+        node = (count++ == 0 || n == node) ? n : -1;
+    }
+    closedir(dir);
+    return count ? node : -1;
+}
+
+bool orcacam_numa_valid(int32 node)
+{
+    char path[PATH_MAX];
+    if (node < 0 || node >= ORCACAM_NUMA_MAX_NODES)
+    {
+        return false;
+    }
+    snprintf(path, sizeof(path), "%s/node%d", ORCACAM_NUMA_NODES, node);
+    return access(path, F_OK) == 0;
+}
+
+bool orcacam_numa_bind(void *addr, size_t len, int32 node)
+{
+    if (node < 0 || !addr)
+    {
+        return true;
+    }
+    if (node >= ORCACAM_NUMA_MAX_NODES)
+    {
+        return false;
+    }
+    // only the pages entirely within the range are moved
+    uintptr_t page  = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)addr + page - 1) & ~(page - 1);
+    uintptr_t end   = ((uintptr_t)addr + len) & ~(page - 1);
+    if (end <= start)
+    {
+        return true;
+    }
+    unsigned long mask[ORCACAM_NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] |=
+        1UL << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, mask,
+                   ORCACAM_NUMA_MAX_NODES, MPOL_MF_MOVE) == 0;
+}
+
+bool orcacam_numa_pin(pthread_attr_t *attr, int32 node)
+{
+    assert(attr);
+    if (node < 0)
+    {
+        return true;
+    }
+    char path[PATH_MAX];
+    char list[4096];
+    snprintf(path, sizeof(path), "%s/node%d/cpulist", ORCACAM_NUMA_NODES,
+             node);
+    if (!orcacam_numa_read(path, list, sizeof(list)))
+    {
+        return false;
+    }
+    // the CPU list reads like "0-15,32-47"
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (char *s = list; *s;)
+    {
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last  = first;
+        if (end == s)
+        {
+            break;
+        }
+        if (*end == '-')
+        {
+            s    = end + 1;
+            last = strtol(s, &end, 10);
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+        {
+            CPU_SET(cpu, &cpus);
+        }
+        s = *end == ',' ? end + 1 : end;
+    }
+    if (!CPU_COUNT(&cpus))
+    {
+        return false;
+    }
+    return pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &cpus) == 0;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file orcacam_numa.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Internal helpers to place frame buffers and threads on the NUMA
+ * node of the camera.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_NUMA_H_
+#define _ORCACAM_NUMA_H_
+
+#include "orcacam.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+/**
+ * @brief Find the NUMA node of the host controller a camera is connected to.
+ *
+ * Only USB cameras are matched: the Hamamatsu USB devices are looked up in
+ * sysfs, by serial number if more than one is connected.
+ *
+ * @param bus Camera bus (ORCA_CAM_INFO::bus)
+ * @param id Camera ID (ORCA_CAM_INFO::id)
+ * @return int32 NUMA node, -1 if unknown
+ */
+int32 orcacam_numa_node(const char *bus, const char *id);
+
+/**
+ * @brief Check if a NUMA node exists.
+ *
+ * @param node NUMA node
+ * @return true if the node exists
+ */
+bool orcacam_numa_valid(int32 node);
+
+/**
+ * @brief Prefer a NUMA node for the whole pages of a memory range, and move
+ * the pages already allocated. Does nothing if node is negative.
+ *
+ * @param addr Start of the range
+ * @param len Length of the range (bytes)
+ * @param node NUMA node
+ * @return true on success
+ */
+bool orcacam_numa_bind(void *addr, size_t len, int32 node);
+
+/**
+ * @brief Restrict the threads created with a thread attribute to the CPUs of
+ * a NUMA node. Does nothing if node is negative.
+ *
+ * @param attr Thread attribute
+ * @param node NUMA node
+ * @return true on success
+ */
+bool orcacam_numa_pin(pthread_attr_t *attr, int32 node);
+
+#endif // _ORCACAM_NUMA_H_
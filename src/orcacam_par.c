@@ -0,0 +1,173 @@
+#define _GNU_SOURCE
+#include "orcacam_par.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+struct _ORCA_PAR
+{
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    pthread_t threads[ORCACAM_PAR_MAX_THREADS];
+    int32 num_threads;
+    int32 num_workers; // started worker threads
+    uint64_t generation;
+    int32 pending;
+    bool quit;
+    bool placed; // workers follow the CPUs of the running thread
+    orcacam_par_fn fn;
+    void *ctx;
+};
+
+struct _ORCA_PAR_WORKER
+{
+    struct _ORCA_PAR *par;
+    int32 band;
+};
+
+static void *orcacam_par_worker(void *inp)
+{
+    struct _ORCA_PAR_WORKER *worker = (struct _ORCA_PAR_WORKER *)inp;
+    struct _ORCA_PAR *par           = worker->par;
+    int32 band                      = worker->band;
+    free(worker);
+    uint64_t generation = 0;
+    pthread_mutex_lock(&(par->lock));
+    while (true)
+    {
+        while (!par->quit && par->generation == generation)
+        {
+            pthread_cond_wait(&(par->start), &(par->lock));
+        }
+        if (par->quit)
+        {
+            break;
+        }
+        generation        = par->generation;
+        orcacam_par_fn fn = par->fn;
+        void *ctx         = par->ctx;
+        pthread_mutex_unlock(&(par->lock));
+        fn(ctx, band, par->num_threads);
+        pthread_mutex_lock(&(par->lock));
+        if (--(par->pending) == 0)
+        {
+            pthread_cond_signal(&(par->done));
+        }
+    }
+    pthread_mutex_unlock(&(par->lock));
+    return NULL;
+}
+
+DCAMERR orcacam_par_create(struct _ORCA_PAR **par_, int32 num_threads)
+{
+    assert(par_);
+    *par_ = NULL;
+    if (num_threads < 1)
+    {
+        num_threads = 1;
+    }
+    if (num_threads > ORCACAM_PAR_MAX_THREADS)
+    {
+        num_threads = ORCACAM_PAR_MAX_THREADS;
+    }
+    struct _ORCA_PAR *par =
+        (struct _ORCA_PAR *)malloc(sizeof(struct _ORCA_PAR));
+    if (!par)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(par, 0, sizeof(struct _ORCA_PAR));
+    pthread_mutex_init(&(par->lock), NULL);
+    pthread_cond_init(&(par->start), NULL);
+    pthread_cond_init(&(par->done), NULL);
+    par->num_threads = num_threads;
+    for (int32 i = 1; i < num_threads; i++)
+    {
+        struct _ORCA_PAR_WORKER *worker = (struct _ORCA_PAR_WORKER *)malloc(
+            sizeof(struct _ORCA_PAR_WORKER));
+        if (!worker)
+        {
+            orcacam_par_destroy(&par);
+            return DCAMERR_LESSSYSTEMMEMORY;
+        }
+        worker->par  = par;
+        worker->band = i;
+        if (pthread_create(&(par->threads[par->num_workers]), NULL,
+                           orcacam_par_worker, worker))
+        {
+            free(worker);
+            orcacam_par_destroy(&par);
+            return DCAMERR_NORESOURCE;
+        }
+        par->num_workers++;
+    }
+    *par_ = par;
+    return DCAMERR_SUCCESS;
+}
+
+int32 orcacam_par_bands(const struct _ORCA_PAR *par)
+{
+    return par ? par->num_threads : 1;
+}
+
+void orcacam_par_run(struct _ORCA_PAR *par, orcacam_par_fn fn, void *ctx)
+{
+    if (!par || par->num_threads == 1)
+    {
+        fn(ctx, 0, 1);
+        return;
+    }
+    if (!par->placed)
+    {
+        // e.g. a capture thread pinned to the NUMA node of the camera
+        cpu_set_t cpus;
+        if (!pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus))
+        {
+            for (int32 i = 0; i < par->num_workers; i++)
+            {
+                pthread_setaffinity_np(par->threads[i], sizeof(cpu_set_t),
+                                       &cpus);
+            }
+        }
+        par->placed = true;
+    }
+    pthread_mutex_lock(&(par->lock));
+    par->fn      = fn;
+    par->ctx     = ctx;
+    par->pending = par->num_threads - 1;
+    par->generation++;
+    pthread_cond_broadcast(&(par->start));
+    pthread_mutex_unlock(&(par->lock));
+    fn(ctx, 0, par->num_threads);
+    pthread_mutex_lock(&(par->lock));
+    while (par->pending > 0)
+    {
+        pthread_cond_wait(&(par->done), &(par->lock));
+    }
+    pthread_mutex_unlock(&(par->lock));
+}
+
+void orcacam_par_destroy(struct _ORCA_PAR **par_)
+{
+    assert(par_);
+    struct _ORCA_PAR *par = *par_;
+    if (!par)
+    {
+        return;
+    }
+    pthread_mutex_lock(&(par->lock));
+    par->quit = true;
+    pthread_cond_broadcast(&(par->start));
+    pthread_mutex_unlock(&(par->lock));
+    for (int32 i = 0; i < par->num_workers; i++)
+    {
+        pthread_join(par->threads[i], NULL);
+    }
+    pthread_cond_destroy(&(par->done));
+    pthread_cond_destroy(&(par->start));
+    pthread_mutex_destroy(&(par->lock));
+    free(par);
+    *par_ = NULL;
+}
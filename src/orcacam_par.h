@@ -0,0 +1,87 @@
+/**
+ * @file orcacam_par.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Internal helper to run frame kernels over horizontal bands on a set
+ * of persistent worker threads.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_PAR_H_
+#define _ORCACAM_PAR_H_
+
+#include "orcacam.h"
+
+/**
+ * @brief Maximum number of threads of a band runner
+ *
+ */
+#define ORCACAM_PAR_MAX_THREADS 64
+
+/**
+ * @brief Band kernel
+ *
+ * @param ctx Kernel context
+ * @param band Band index
+ * @param num_bands Number of bands
+ */
+typedef void (*orcacam_par_fn)(void *ctx, int32 band, int32 num_bands);
+
+struct _ORCA_PAR;
+
+/**
+ * @brief Create a band runner.
+ *
+ * @param par Output band runner
+ * @param num_threads Number of threads, including the calling thread
+ * @return DCAMERR
+ */
+DCAMERR orcacam_par_create(struct _ORCA_PAR **par, int32 num_threads);
+
+/**
+ * @brief Run a kernel on every band and wait for completion. The calling
+ * thread processes band 0. On the first run, the worker threads are
+ * restricted to the CPUs the calling thread may run on.
+ *
+ * @param par Band runner. If NULL, the kernel runs as a single band on the
+ * calling thread.
+ * @param fn Band kernel
+ * @param ctx Kernel context
+ */
+void orcacam_par_run(struct _ORCA_PAR *par, orcacam_par_fn fn, void *ctx);
+
+/**
+ * @brief Get the number of bands of a band runner.
+ *
+ * @param par Band runner
+ * @return int32 Number of bands
+ */
+int32 orcacam_par_bands(const struct _ORCA_PAR *par);
+
+/**
+ * @brief Stop the worker threads and free the band runner.
+ *
+ * @param par Band runner
+ */
+void orcacam_par_destroy(struct _ORCA_PAR **par);
+
+/**
+ * @brief Get the row range of a band.
+ *
+ * @param height Frame height
+ * @param band Band index
+ * @param num_bands Number of bands
+ * @param y0 First row
+ * @param y1 One past the last row
+ */
+static inline void orcacam_par_rows(int32 height, int32 band, int32 num_bands,
+                                    int32 *y0, int32 *y1)
+{
+    *y0 = (int32)(((long long)height * band) / num_bands);
+    *y1 = (int32)(((long long)height * (band + 1)) / num_bands);
+}
+
+#endif // _ORCACAM_PAR_H_
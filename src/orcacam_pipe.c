@@ -0,0 +1,604 @@
+#define _GNU_SOURCE
+#include "orcacam_pipe.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum
+{
+    ORCACAM_PIPE_FREE = 0,
+    ORCACAM_PIPE_BUSY,
+    ORCACAM_PIPE_DONE,
+};
+
+// Tiles [next, end) of a frame
+struct _ORCA_PIPE_RANGE
+{
+    int32 slot;
+    int32 next;
+    int32 end;
+};
+
+// Ranges of a worker, oldest first
+struct _ORCA_PIPE_DEQUE
+{
+    pthread_mutex_t lock;
+    struct _ORCA_PIPE_RANGE *ranges; // ring of max_frames + 1
+    int32 head;
+    int32 count;
+} __attribute__((aligned(64)));
+
+struct _ORCA_PIPE_SLOT
+{
+    ORCA_FRAME frame;
+    uint64_t seq;
+    int32 count;
+    atomic_int remaining; // tiles
+    atomic_int state;
+};
+
+struct _ORCA_PIPE_WORKER
+{
+    struct _ORCA_PIPE *pipe;
+    int32 index;
+};
+
+struct _ORCA_PIPE
+{
+    int32 num_threads;
+    int32 tile_rows;
+    int32 max_frames;
+    OrcaFrameCallback output;
+    void *user_data;
+    size_t sz_user_data;
+    OrcaTileKernel kernels[ORCA_PIPE_MAX_KERNELS];
+    void *kernel_data[ORCA_PIPE_MAX_KERNELS];
+    int32 num_kernels;
+    struct _ORCA_PIPE_SLOT *slots;
+    struct _ORCA_PIPE_DEQUE *deques;
+    pthread_t threads[ORCA_PIPE_MAX_THREADS];
+    int32 num_workers; // started worker threads, to join
+    bool placed;       // workers follow the CPUs of the submitting thread
+    // idle workers wait for the epoch to change
+    pthread_mutex_t work_lock;
+    pthread_cond_t work;
+    atomic_uint_fast64_t epoch;
+    bool quit;
+    // frame slots, and their output in order
+    pthread_mutex_t out_lock;
+    pthread_cond_t freed;
+    uint64_t next_seq;
+    uint64_t next_out;
+    atomic_uint_fast64_t frames;
+    atomic_uint_fast64_t tiles;
+    atomic_uint_fast64_t steals;
+    atomic_uint_fast64_t waits;
+};
+
+static void orcacam_pipe_push(struct _ORCA_PIPE *pipe,
+                              struct _ORCA_PIPE_DEQUE *dq,
+                              struct _ORCA_PIPE_RANGE range)
+{
+    pthread_mutex_lock(&(dq->lock));
+    dq->ranges[(dq->head + dq->count) % (pipe->max_frames + 1)] = range;
+    dq->count++;
+    pthread_mutex_unlock(&(dq->lock));
+}
+
+// Take the next tile of the oldest range of the worker
+static bool orcacam_pipe_pop(struct _ORCA_PIPE *pipe,
+                             struct _ORCA_PIPE_DEQUE *dq, int32 *slot,
+                             int32 *tile)
+{
+    bool found = false;
+    pthread_mutex_lock(&(dq->lock));
+    if (dq->count)
+    {
+        struct _ORCA_PIPE_RANGE *r = &(dq->ranges[dq->head]);
+        *slot                      = r->slot;
+        *tile                      = r->next++;
+        found                      = true;
+        if (r->next == r->end)
+        {
+            dq->head = (dq->head + 1) % (pipe->max_frames + 1);
+            dq->count--;
+        }
+    }
+    pthread_mutex_unlock(&(dq->lock));
+    return found;
+}
+
+// Move half of the oldest range of another worker to an idle worker
+static bool orcacam_pipe_steal(struct _ORCA_PIPE *pipe, int32 thief)
+{
+    for (int32 i = 1; i < pipe->num_threads; i++)
+    {
+        struct _ORCA_PIPE_DEQUE *dq =
+            &(pipe->deques[(thief + i) % pipe->num_threads]);
+        struct _ORCA_PIPE_RANGE stolen;
+        bool found = false;
+        pthread_mutex_lock(&(dq->lock));
+        if (dq->count)
+        {
+            struct _ORCA_PIPE_RANGE *r = &(dq->ranges[dq->head]);
+            int32 half                 = (r->end - r->next + 1) / 2;
+            stolen.slot                = r->slot;
+            stolen.next                = r->end - half;
+            stolen.end                 = r->end;
+            r->end                     = stolen.next;
+            if (r->next == r->end)
+            {
+                dq->head = (dq->head + 1) % (pipe->max_frames + 1);
+                dq->count--;
+            }
+            found = true;
+        }
+        pthread_mutex_unlock(&(dq->lock));
+        if (found)
+        {
+            orcacam_pipe_push(pipe, &(pipe->deques[thief]), stolen);
+            atomic_fetch_add_explicit(&(pipe->steals), 1,
+                                      memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Output the frames completed so far, in order
+static void orcacam_pipe_output(struct _ORCA_PIPE *pipe)
+{
+    pthread_mutex_lock(&(pipe->out_lock));
+    while (pipe->next_out < pipe->next_seq)
+    {
+        struct _ORCA_PIPE_SLOT *s =
+            &(pipe->slots[pipe->next_out % pipe->max_frames]);
+        if (atomic_load_explicit(&(s->state), memory_order_acquire) !=
+            ORCACAM_PIPE_DONE)
+        {
+            break;
+        }
+        if (pipe->output)
+        {
+            pipe->output(&(s->frame), pipe->user_data, pipe->sz_user_data);
+        }
+        atomic_store_explicit(&(s->state), ORCACAM_PIPE_FREE,
+                              memory_order_relaxed);
+        pipe->next_out++;
+        atomic_fetch_add_explicit(&(pipe->frames), 1, memory_order_relaxed);
+        pthread_cond_broadcast(&(pipe->freed));
+    }
+    pthread_mutex_unlock(&(pipe->out_lock));
+}
+
+static void orcacam_pipe_complete(struct _ORCA_PIPE *pipe,
+                                  struct _ORCA_PIPE_SLOT *s)
+{
+    atomic_store_explicit(&(s->state), ORCACAM_PIPE_DONE,
+                          memory_order_release);
+    orcacam_pipe_output(pipe);
+}
+
+static void orcacam_pipe_run(struct _ORCA_PIPE *pipe, int32 slot, int32 tile)
+{
+    struct _ORCA_PIPE_SLOT *s = &(pipe->slots[slot]);
+    ORCA_TILE t = {
+        .frame = &(s->frame),
+        .y0    = tile * pipe->tile_rows,
+        .y1    = tile * pipe->tile_rows + pipe->tile_rows,
+        .index = tile,
+        .count = s->count,
+        .slot  = slot,
+        .seq   = s->seq,
+    };
+    if (t.y1 > s->frame.height)
+    {
+        t.y1 = s->frame.height;
+    }
+    for (int32 k = 0; k < pipe->num_kernels; k++)
+    {
+        pipe->kernels[k](&t, pipe->kernel_data[k]);
+    }
+    atomic_fetch_add_explicit(&(pipe->tiles), 1, memory_order_relaxed);
+    // the kernels of the other tiles are visible to the last one
+    if (atomic_fetch_sub_explicit(&(s->remaining), 1, memory_order_acq_rel) ==
+        1)
+    {
+        orcacam_pipe_complete(pipe, s);
+    }
+}
+
+static void *orcacam_pipe_worker(void *inp)
+{
+    struct _ORCA_PIPE_WORKER *worker = (struct _ORCA_PIPE_WORKER *)inp;
+    struct _ORCA_PIPE *pipe          = worker->pipe;
+    int32 index                      = worker->index;
+    free(worker);
+    struct _ORCA_PIPE_DEQUE *dq = &(pipe->deques[index]);
+    while (true)
+    {
+        uint64_t epoch = atomic_load(&(pipe->epoch));
+        int32 slot, tile;
+        if (orcacam_pipe_pop(pipe, dq, &slot, &tile))
+        {
+            orcacam_pipe_run(pipe, slot, tile);
+            continue;
+        }
+        if (orcacam_pipe_steal(pipe, index))
+        {
+            continue;
+        }
+        pthread_mutex_lock(&(pipe->work_lock));
+        while (!pipe->quit && atomic_load(&(pipe->epoch)) == epoch)
+        {
+            pthread_cond_wait(&(pipe->work), &(pipe->work_lock));
+        }
+        bool quit = pipe->quit;
+        pthread_mutex_unlock(&(pipe->work_lock));
+        if (quit)
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void orcacam_pipe_free(struct _ORCA_PIPE *pipe)
+{
+    pthread_mutex_lock(&(pipe->work_lock));
+    pipe->quit = true;
+    pthread_cond_broadcast(&(pipe->work));
+    pthread_mutex_unlock(&(pipe->work_lock));
+    for (int32 i = 0; i < pipe->num_workers; i++)
+    {
+        pthread_join(pipe->threads[i], NULL);
+    }
+    if (pipe->deques)
+    {
+        for (int32 i = 0; i < pipe->num_threads; i++)
+        {
+            pthread_mutex_destroy(&(pipe->deques[i].lock));
+            free(pipe->deques[i].ranges);
+        }
+    }
+    free(pipe->deques);
+    free(pipe->slots);
+    pthread_cond_destroy(&(pipe->freed));
+    pthread_mutex_destroy(&(pipe->out_lock));
+    pthread_cond_destroy(&(pipe->work));
+    pthread_mutex_destroy(&(pipe->work_lock));
+    free(pipe);
+}
+
+DCAMERR orca_pipe_create(ORCA_PIPE *pipe_, const ORCA_PIPE_CONFIG *config)
+{
+    assert(pipe_);
+    assert(config);
+    *pipe_ = NULL;
+    struct _ORCA_PIPE *pipe =
+        (struct _ORCA_PIPE *)calloc(1, sizeof(struct _ORCA_PIPE));
+    if (!pipe)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    pipe->num_threads = config->num_threads;
+    if (pipe->num_threads < 1)
+    {
+        pipe->num_threads = (int32)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (pipe->num_threads < 1)
+    {
+        pipe->num_threads = 1;
+    }
+    if (pipe->num_threads > ORCA_PIPE_MAX_THREADS)
+    {
+        pipe->num_threads = ORCA_PIPE_MAX_THREADS;
+    }
+    pipe->tile_rows = config->tile_rows > 0 ? config->tile_rows
+                                            : ORCA_PIPE_DEFAULT_TILE_ROWS;
+    pipe->max_frames =
+        config->max_frames > 0 ? config->max_frames : ORCA_PIPE_DEFAULT_FRAMES;
+    pipe->output       = config->output;
+    pipe->user_data    = config->user_data;
+    pipe->sz_user_data = config->sz_user_data;
+    pthread_mutex_init(&(pipe->work_lock), NULL);
+    pthread_cond_init(&(pipe->work), NULL);
+    pthread_mutex_init(&(pipe->out_lock), NULL);
+    pthread_cond_init(&(pipe->freed), NULL);
+    pipe->slots = (struct _ORCA_PIPE_SLOT *)calloc(
+        pipe->max_frames, sizeof(struct _ORCA_PIPE_SLOT));
+    pipe->deques = (struct _ORCA_PIPE_DEQUE *)aligned_alloc(
+        64, sizeof(struct _ORCA_PIPE_DEQUE) * pipe->num_threads);
+    if (!pipe->slots || !pipe->deques)
+    {
+        free(pipe->deques);
+        pipe->deques = NULL;
+        orcacam_pipe_free(pipe);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    bool ok = true;
+    for (int32 i = 0; i < pipe->num_threads; i++)
+    {
+        struct _ORCA_PIPE_DEQUE *dq = &(pipe->deques[i]);
+        pthread_mutex_init(&(dq->lock), NULL);
+        dq->ranges = (struct _ORCA_PIPE_RANGE *)malloc(
+            sizeof(struct _ORCA_PIPE_RANGE) * (pipe->max_frames + 1));
+        dq->head  = 0;
+        dq->count = 0;
+        ok        = ok && dq->ranges;
+    }
+    if (!ok)
+    {
+        orcacam_pipe_free(pipe);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    for (int32 i = 0; i < pipe->num_threads; i++)
+    {
+        struct _ORCA_PIPE_WORKER *worker = (struct _ORCA_PIPE_WORKER *)malloc(
+            sizeof(struct _ORCA_PIPE_WORKER));
+        if (!worker)
+        {
+            orcacam_pipe_free(pipe);
+            return DCAMERR_LESSSYSTEMMEMORY;
+        }
+        worker->pipe  = pipe;
+        worker->index = i;
+        if (pthread_create(&(pipe->threads[i]), NULL, orcacam_pipe_worker,
+                           worker))
+        {
+            free(worker);
+            orcacam_pipe_free(pipe);
+            return DCAMERR_NORESOURCE;
+        }
+        pipe->num_workers++;
+    }
+    *pipe_ = pipe;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_pipe_add_kernel(ORCA_PIPE pipe, OrcaTileKernel kernel,
+                             void *user_data)
+{
+    assert(pipe);
+    assert(kernel);
+    pthread_mutex_lock(&(pipe->out_lock));
+    bool started = pipe->next_seq > 0;
+    pthread_mutex_unlock(&(pipe->out_lock));
+    if (started)
+    {
+        return DCAMERR_BUSY;
+    }
+    if (pipe->num_kernels == ORCA_PIPE_MAX_KERNELS)
+    {
+        return DCAMERR_NORESOURCE;
+    }
+    pipe->kernels[pipe->num_kernels]     = kernel;
+    pipe->kernel_data[pipe->num_kernels] = user_data;
+    pipe->num_kernels++;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_pipe_submit(ORCA_PIPE pipe, const ORCA_FRAME *frame)
+{
+    assert(pipe);
+    assert(frame);
+    if (frame->height > 0 && !frame->data)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    if (!pipe->placed)
+    {
+        // e.g. a capture thread pinned to the NUMA node of the camera
+        cpu_set_t cpus;
+        if (!pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus))
+        {
+            for (int32 i = 0; i < pipe->num_workers; i++)
+            {
+                pthread_setaffinity_np(pipe->threads[i], sizeof(cpu_set_t),
+                                       &cpus);
+            }
+        }
+        pipe->placed = true;
+    }
+    // claim the slot of the frame, once its previous frame is output
+    pthread_mutex_lock(&(pipe->out_lock));
+    uint64_t seq              = pipe->next_seq;
+    int32 slot                = (int32)(seq % pipe->max_frames);
+    struct _ORCA_PIPE_SLOT *s = &(pipe->slots[slot]);
+    if (atomic_load(&(s->state)) != ORCACAM_PIPE_FREE)
+    {
+        atomic_fetch_add_explicit(&(pipe->waits), 1, memory_order_relaxed);
+        while (atomic_load(&(s->state)) != ORCACAM_PIPE_FREE)
+        {
+            pthread_cond_wait(&(pipe->freed), &(pipe->out_lock));
+        }
+    }
+    pipe->next_seq++;
+    atomic_store(&(s->state), ORCACAM_PIPE_BUSY);
+    pthread_mutex_unlock(&(pipe->out_lock));
+
+    s->frame = *frame;
+    memset(s->frame.meta, 0, sizeof(s->frame.meta));
+    s->seq   = seq;
+    s->count = frame->height > 0
+                   ? (frame->height + pipe->tile_rows - 1) / pipe->tile_rows
+                   : 0;
+    atomic_store(&(s->remaining), s->count);
+    if (!s->count)
+    {
+        orcacam_pipe_complete(pipe, s);
+        return DCAMERR_SUCCESS;
+    }
+    // contiguous ranges, so that a worker keeps to its rows
+    int32 n = pipe->num_threads;
+    for (int32 i = 0; i < n; i++)
+    {
+        struct _ORCA_PIPE_RANGE r = {
+            .slot = slot,
+            .next = (int32)(((long long)s->count * i) / n),
+            .end  = (int32)(((long long)s->count * (i + 1)) / n),
+        };
+        if (r.next < r.end)
+        {
+            orcacam_pipe_push(pipe, &(pipe->deques[i]), r);
+        }
+    }
+    pthread_mutex_lock(&(pipe->work_lock));
+    atomic_fetch_add(&(pipe->epoch), 1);
+    pthread_cond_broadcast(&(pipe->work));
+    pthread_mutex_unlock(&(pipe->work_lock));
+    return DCAMERR_SUCCESS;
+}
+
+void orca_pipe_frame(ORCA_FRAME *frame, void *pipe, size_t sz_pipe)
+{
+    (void)sz_pipe;
+    if (pipe)
+    {
+        orca_pipe_submit((ORCA_PIPE)pipe, frame);
+    }
+}
+
+void orca_pipe_flush(ORCA_PIPE pipe)
+{
+    assert(pipe);
+    pthread_mutex_lock(&(pipe->out_lock));
+    while (pipe->next_out != pipe->next_seq)
+    {
+        pthread_cond_wait(&(pipe->freed), &(pipe->out_lock));
+    }
+    pthread_mutex_unlock(&(pipe->out_lock));
+}
+
+void orca_pipe_get_stats(ORCA_PIPE pipe, ORCA_PIPE_STATS *stats)
+{
+    assert(pipe);
+    assert(stats);
+    stats->frames = atomic_load(&(pipe->frames));
+    stats->tiles  = atomic_load(&(pipe->tiles));
+    stats->steals = atomic_load(&(pipe->steals));
+    stats->waits  = atomic_load(&(pipe->waits));
+}
+
+void orca_pipe_destroy(ORCA_PIPE *pipe_)
+{
+    assert(pipe_);
+    struct _ORCA_PIPE *pipe = *pipe_;
+    if (!pipe)
+    {
+        return;
+    }
+    orca_pipe_flush(pipe);
+    orcacam_pipe_free(pipe);
+    *pipe_ = NULL;
+}
+
+// 16 pixels at a time, a trip count the compiler vectorizes at -O2
+#define ORCACAM_FLAT_BLOCK 16
+
+// Clamped in integers, as float compares do not vectorize without
+// -ffast-math; gains below 32768 keep the product in range
+static inline uint16_t orcacam_flat_pixel(uint16_t v, uint16_t dark,
+                                          float gain)
+{
+    int32 r = (int32)(((float)v - (float)dark) * gain + 0.5f);
+    r       = r < 0 ? 0 : r;
+    return (uint16_t)(r > 65535 ? 65535 : r);
+}
+
+static void orcacam_flat_row(uint16_t *restrict row,
+                             const uint16_t *restrict dark,
+                             const float *restrict gain, int32 width)
+{
+    int32 x = 0;
+    for (; x + ORCACAM_FLAT_BLOCK <= width; x += ORCACAM_FLAT_BLOCK)
+    {
+        uint16_t *r       = row + x;
+        const uint16_t *d = dark + x;
+        const float *g    = gain + x;
+        for (int32 i = 0; i < ORCACAM_FLAT_BLOCK; i++)
+        {
+            r[i] = orcacam_flat_pixel(r[i], d[i], g[i]);
+        }
+    }
+    for (; x < width; x++)
+    {
+        row[x] = orcacam_flat_pixel(row[x], dark[x], gain[x]);
+    }
+}
+
+static void orcacam_dark_row(uint16_t *restrict row,
+                             const uint16_t *restrict dark, int32 width)
+{
+    int32 x = 0;
+    for (; x + ORCACAM_FLAT_BLOCK <= width; x += ORCACAM_FLAT_BLOCK)
+    {
+        uint16_t *r       = row + x;
+        const uint16_t *d = dark + x;
+        for (int32 i = 0; i < ORCACAM_FLAT_BLOCK; i++)
+        {
+            int32 v = (int32)r[i] - d[i];
+            r[i]    = (uint16_t)(v < 0 ? 0 : v);
+        }
+    }
+    for (; x < width; x++)
+    {
+        int32 r = (int32)row[x] - dark[x];
+        row[x]  = (uint16_t)(r < 0 ? 0 : r);
+    }
+}
+
+static void orcacam_gain_row(uint16_t *restrict row,
+                             const float *restrict gain, int32 width)
+{
+    int32 x = 0;
+    for (; x + ORCACAM_FLAT_BLOCK <= width; x += ORCACAM_FLAT_BLOCK)
+    {
+        uint16_t *r    = row + x;
+        const float *g = gain + x;
+        for (int32 i = 0; i < ORCACAM_FLAT_BLOCK; i++)
+        {
+            r[i] = orcacam_flat_pixel(r[i], 0, g[i]);
+        }
+    }
+    for (; x < width; x++)
+    {
+        row[x] = orcacam_flat_pixel(row[x], 0, gain[x]);
+    }
+}
+
+void orca_tile_flatfield(const ORCA_TILE *tile, void *flatfield)
+{
+    const ORCA_FLATFIELD *ff = (const ORCA_FLATFIELD *)flatfield;
+    const ORCA_FRAME *frame  = tile->frame;
+    if (!ff || (!ff->dark && !ff->gain) ||
+        frame->fmt != DCAM_PIXELTYPE_MONO16 || frame->width != ff->width ||
+        frame->height != ff->height)
+    {
+        return;
+    }
+    int32 width = frame->width;
+    for (int32 y = tile->y0; y < tile->y1; y++)
+    {
+        uint16_t *row =
+            (uint16_t *)(frame->data + (size_t)y * frame->row_stride);
+        size_t off = (size_t)y * width;
+        if (ff->dark && ff->gain)
+        {
+            orcacam_flat_row(row, ff->dark + off, ff->gain + off, width);
+        }
+        else if (ff->dark)
+        {
+            orcacam_dark_row(row, ff->dark + off, width);
+        }
+        else
+        {
+            orcacam_gain_row(row, ff->gain + off, width);
+        }
+    }
+}
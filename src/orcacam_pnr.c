@@ -0,0 +1,376 @@
+#include "orcacam_pnr.h"
+#include "orcacam_par.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct _ORCA_PNR
+{
+    ORCA_PNR_CONFIG config;
+    struct _ORCA_PAR *par;
+    pthread_mutex_t lock;
+    int32 width, height;
+    uint32_t *acc;     // 32-bit accumulator
+    uint16_t *stage;   // 16-bit staging accumulator
+    int32 staged;      // frames in the staging accumulator
+    int32 max_staged;  // frames that fit in the staging accumulator
+    uint64_t frames;   // accumulated frames
+    // per-frame kernel arguments
+    const ORCA_FRAME *frame;
+    bool flush;
+};
+
+#if defined(__SSE2__)
+// a >= b, unsigned bytes
+static inline __m128i orcacam_pnr_ge(__m128i a, __m128i b)
+{
+    return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a);
+}
+
+// widen 16 bytes and add to the staging accumulator
+static inline void orcacam_pnr_add16(uint16_t *acc, __m128i v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i *a         = (__m128i *)acc;
+    _mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a), _mm_unpacklo_epi8(v, zero)));
+    _mm_storeu_si128(a + 1, _mm_add_epi16(_mm_loadu_si128(a + 1), _mm_unpackhi_epi8(v, zero)));
+}
+#endif
+
+static void orcacam_pnr_count_row(const uint8_t *row, int32 width,
+                                  uint8_t thr, uint16_t *acc)
+{
+    int32 x = 0;
+#if defined(__SSE2__)
+    const __m128i vthr = _mm_set1_epi8((char)thr);
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+        v         = _mm_and_si128(v, orcacam_pnr_ge(v, vthr));
+        orcacam_pnr_add16(acc + x, v);
+    }
+#endif
+    for (; x < width; x++)
+    {
+        acc[x] += row[x] >= thr ? row[x] : 0;
+    }
+}
+
+static void orcacam_pnr_event_row(const uint8_t *row, int32 width,
+                                  uint8_t thr, uint16_t *acc)
+{
+    int32 x = 0;
+#if defined(__SSE2__)
+    const __m128i vthr = _mm_set1_epi8((char)thr);
+    const __m128i one  = _mm_set1_epi8(1);
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+        orcacam_pnr_add16(acc + x, _mm_and_si128(orcacam_pnr_ge(v, vthr), one));
+    }
+#endif
+    for (; x < width; x++)
+    {
+        acc[x] += row[x] >= thr;
+    }
+}
+
+// local maximum: strictly greater than the preceding neighbours (up, left),
+// greater or equal to the following ones, so that a flat cluster counts once
+static inline bool orcacam_pnr_peak(const uint8_t *up, const uint8_t *row,
+                                    const uint8_t *dn, int32 x, uint8_t thr)
+{
+    uint8_t c = row[x];
+    return c >= thr && c > up[x - 1] && c > up[x] && c > up[x + 1] &&
+           c > row[x - 1] && c >= row[x + 1] && c >= dn[x - 1] &&
+           c >= dn[x] && c >= dn[x + 1];
+}
+
+static void orcacam_pnr_cluster_row(const uint8_t *up, const uint8_t *row,
+                                    const uint8_t *dn, int32 width,
+                                    uint8_t thr, uint16_t *acc)
+{
+    int32 x = 1;
+#if defined(__SSE2__)
+    const __m128i vthr = _mm_set1_epi8((char)thr);
+    const __m128i one  = _mm_set1_epi8(1);
+    for (; x + 17 <= width; x += 16)
+    {
+#define LD(ptr, off) _mm_loadu_si128((const __m128i *)((ptr) + x + (off)))
+        __m128i c = LD(row, 0);
+        // c >= following neighbours
+        __m128i m = orcacam_pnr_ge(c, vthr);
+        m         = _mm_and_si128(m, orcacam_pnr_ge(c, LD(row, 1)));
+        m         = _mm_and_si128(m, orcacam_pnr_ge(c, LD(dn, -1)));
+        m         = _mm_and_si128(m, orcacam_pnr_ge(c, LD(dn, 0)));
+        m         = _mm_and_si128(m, orcacam_pnr_ge(c, LD(dn, 1)));
+        // c > preceding neighbours, i.e. not (n >= c)
+        __m128i n = orcacam_pnr_ge(LD(row, -1), c);
+        n         = _mm_or_si128(n, orcacam_pnr_ge(LD(up, -1), c));
+        n         = _mm_or_si128(n, orcacam_pnr_ge(LD(up, 0), c));
+        n         = _mm_or_si128(n, orcacam_pnr_ge(LD(up, 1), c));
+        m         = _mm_andnot_si128(n, m);
+#undef LD
+        orcacam_pnr_add16(acc + x, _mm_and_si128(m, one));
+    }
+#endif
+    for (; x < width - 1; x++)
+    {
+        acc[x] += orcacam_pnr_peak(up, row, dn, x, thr);
+    }
+}
+
+static void orcacam_pnr_flush_row(uint16_t *stage, uint32_t *acc, int32 width)
+{
+    int32 x = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(stage + x));
+        __m128i *a = (__m128i *)(acc + x);
+        _mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), _mm_unpacklo_epi16(v, zero)));
+        _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), _mm_unpackhi_epi16(v, zero)));
+    }
+#endif
+    for (; x < width; x++)
+    {
+        acc[x] += stage[x];
+    }
+    memset(stage, 0, sizeof(uint16_t) * width);
+}
+
+static void orcacam_pnr_band(void *ctx, int32 band, int32 num_bands)
+{
+    struct _ORCA_PNR *p     = (struct _ORCA_PNR *)ctx;
+    const ORCA_FRAME *frame = p->frame;
+    uint8_t thr = (uint8_t)(p->config.threshold < 1 ? 1 : p->config.threshold);
+    int32 y0, y1;
+    orcacam_par_rows(p->height, band, num_bands, &y0, &y1);
+    for (int32 y = y0; y < y1; y++)
+    {
+        uint16_t *stage = p->stage + (size_t)y * p->width;
+        if (frame)
+        {
+            const uint8_t *row =
+                (const uint8_t *)(frame->data + (size_t)y * frame->row_stride);
+            switch (p->config.mode)
+            {
+            case ORCA_PNR_COUNT:
+                orcacam_pnr_count_row(row, p->width, thr, stage);
+                break;
+            case ORCA_PNR_EVENT:
+                orcacam_pnr_event_row(row, p->width, thr, stage);
+                break;
+            case ORCA_PNR_CLUSTER:
+                if (y > 0 && y < p->height - 1)
+                {
+                    orcacam_pnr_cluster_row(row - frame->row_stride, row,
+                                            row + frame->row_stride, p->width,
+                                            thr, stage);
+                }
+                break;
+            }
+        }
+        if (p->flush)
+        {
+            orcacam_pnr_flush_row(stage, p->acc + (size_t)y * p->width,
+                                  p->width);
+        }
+    }
+}
+
+// Run the band kernel, with the lock held
+static void orcacam_pnr_run(struct _ORCA_PNR *p, const ORCA_FRAME *frame,
+                            bool flush)
+{
+    p->frame = frame;
+    p->flush = flush;
+    orcacam_par_run(p->par, orcacam_pnr_band, p);
+    p->frame = NULL;
+    if (flush)
+    {
+        p->staged = 0;
+    }
+}
+
+static DCAMERR orcacam_pnr_resize(struct _ORCA_PNR *p, int32 width,
+                                  int32 height)
+{
+    size_t npix = (size_t)width * height;
+    free(p->acc);
+    free(p->stage);
+    p->acc   = (uint32_t *)calloc(npix, sizeof(uint32_t));
+    p->stage = (uint16_t *)calloc(npix, sizeof(uint16_t));
+    if (!p->acc || !p->stage)
+    {
+        free(p->acc);
+        free(p->stage);
+        p->acc    = NULL;
+        p->stage  = NULL;
+        p->width  = 0;
+        p->height = 0;
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    p->width  = width;
+    p->height = height;
+    p->staged = 0;
+    p->frames = 0;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_pnr_create(ORCA_PNR *pnr, const ORCA_PNR_CONFIG *config)
+{
+    assert(pnr);
+    assert(config);
+    DCAMERR err;
+    *pnr = NULL;
+    switch (config->mode)
+    {
+    case ORCA_PNR_COUNT:
+    case ORCA_PNR_EVENT:
+    case ORCA_PNR_CLUSTER:
+        break;
+    default:
+        return DCAMERR_INVALIDPARAM;
+    }
+    if (config->threshold < 0 || config->threshold > 255)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    struct _ORCA_PNR *p = (struct _ORCA_PNR *)malloc(sizeof(struct _ORCA_PNR));
+    if (!p)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(p, 0, sizeof(struct _ORCA_PNR));
+    p->config = *config;
+    // at most 255 photons per pixel per frame in count mode
+    p->max_staged = config->mode == ORCA_PNR_COUNT ? 0xffff / 0xff : 0xffff;
+    err           = orcacam_par_create(&(p->par), config->num_threads);
+    if (orcaerr_failed(err))
+    {
+        free(p);
+        return err;
+    }
+    pthread_mutex_init(&(p->lock), NULL);
+    *pnr = p;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_pnr_accumulate(ORCA_PNR pnr, const ORCA_FRAME *frame)
+{
+    assert(pnr);
+    assert(frame);
+    DCAMERR err = DCAMERR_SUCCESS;
+    if (frame->fmt != DCAM_PIXELTYPE_MONO8)
+    {
+        return DCAMERR_NOTSUPPORT;
+    }
+    if (!frame->data || frame->width < 1 || frame->height < 1)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    pthread_mutex_lock(&(pnr->lock));
+    if (frame->width != pnr->width || frame->height != pnr->height)
+    {
+        err = orcacam_pnr_resize(pnr, frame->width, frame->height);
+        if (orcaerr_failed(err))
+        {
+            goto ret;
+        }
+    }
+    pnr->frames++;
+    bool snapshot = pnr->config.snapshot && pnr->config.snapshot_interval > 0 &&
+                    pnr->frames % pnr->config.snapshot_interval == 0;
+    orcacam_pnr_run(pnr, frame,
+                    snapshot || ++(pnr->staged) == pnr->max_staged);
+    if (snapshot)
+    {
+        pnr->config.snapshot(pnr->acc, pnr->width, pnr->height, pnr->frames,
+                             pnr->config.user_data);
+    }
+ret:
+    pthread_mutex_unlock(&(pnr->lock));
+    return err;
+}
+
+void orca_pnr_stage(ORCA_FRAME *frame, void *pnr, size_t sz_pnr)
+{
+    (void)sz_pnr;
+    if (!pnr)
+    {
+        return;
+    }
+    orca_pnr_accumulate((ORCA_PNR)pnr, frame);
+}
+
+DCAMERR orca_pnr_export(ORCA_PNR pnr, uint32_t *image, size_t sz_image,
+                        int32 *width, int32 *height, uint64_t *frames)
+{
+    assert(pnr);
+    assert(image);
+    assert(width);
+    assert(height);
+    DCAMERR err = DCAMERR_SUCCESS;
+    pthread_mutex_lock(&(pnr->lock));
+    if (!pnr->acc || pnr->frames == 0)
+    {
+        err = DCAMERR_NOTREADY;
+        goto ret;
+    }
+    size_t size = sizeof(uint32_t) * pnr->width * pnr->height;
+    if (sz_image < size)
+    {
+        err = DCAMERR_INVALIDPARAM;
+        goto ret;
+    }
+    if (pnr->staged)
+    {
+        orcacam_pnr_run(pnr, NULL, true);
+    }
+    memcpy(image, pnr->acc, size);
+    *width  = pnr->width;
+    *height = pnr->height;
+    if (frames)
+    {
+        *frames = pnr->frames;
+    }
+ret:
+    pthread_mutex_unlock(&(pnr->lock));
+    return err;
+}
+
+void orca_pnr_reset(ORCA_PNR pnr)
+{
+    assert(pnr);
+    pthread_mutex_lock(&(pnr->lock));
+    if (pnr->acc)
+    {
+        memset(pnr->acc, 0, sizeof(uint32_t) * pnr->width * pnr->height);
+        memset(pnr->stage, 0, sizeof(uint16_t) * pnr->width * pnr->height);
+    }
+    pnr->staged = 0;
+    pnr->frames = 0;
+    pthread_mutex_unlock(&(pnr->lock));
+}
+
+void orca_pnr_destroy(ORCA_PNR *pnr)
+{
+    assert(pnr);
+    struct _ORCA_PNR *p = *pnr;
+    if (!p)
+    {
+        return;
+    }
+    orcacam_par_destroy(&(p->par));
+    pthread_mutex_destroy(&(p->lock));
+    free(p->acc);
+    free(p->stage);
+    free(p);
+    *pnr = NULL;
+}
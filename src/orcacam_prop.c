@@ -0,0 +1,324 @@
+#include "orcacam_prop.h"
+#include "orcacam_tracepoint.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ORCACAM_PROP_VALUE 0x1 // value is cached
+#define ORCACAM_PROP_ATTR 0x2  // attributes are current
+#define ORCACAM_PROP_KNOWN 0x4 // attributes were read at least once
+
+struct _ORCA_PROP_ENTRY
+{
+    int32 id; // 0 if the slot is empty
+    int32 flags;
+    DCAMPROP_ATTR attr;
+    double value;
+};
+
+struct _ORCA_PROPCACHE
+{
+    HDCAM hdcam;
+    pthread_mutex_t lock;
+    uint64_t generation; // bumped on every invalidation
+    struct _ORCA_PROP_ENTRY *entries;
+    uint32_t mask; // table size - 1
+    size_t count;
+};
+
+static inline struct _ORCA_PROP_ENTRY *
+orcacam_prop_find(struct _ORCA_PROPCACHE *cache, int32 id)
+{
+    uint32_t i = ((uint32_t)id * 2654435761u) & cache->mask;
+    while (cache->entries[i].id)
+    {
+        if (cache->entries[i].id == id)
+        {
+            return &(cache->entries[i]);
+        }
+        i = (i + 1) & cache->mask;
+    }
+    return NULL;
+}
+
+static inline struct _ORCA_PROP_ENTRY *
+orcacam_prop_insert(struct _ORCA_PROPCACHE *cache, int32 id)
+{
+    uint32_t i = ((uint32_t)id * 2654435761u) & cache->mask;
+    while (cache->entries[i].id && cache->entries[i].id != id)
+    {
+        i = (i + 1) & cache->mask;
+    }
+    cache->entries[i].id = id;
+    return &(cache->entries[i]);
+}
+
+// Invalidate the properties the driver reports as updated since the last
+// call. Returns false if the driver can not report them.
+static bool orcacam_prop_drain(struct _ORCA_PROPCACHE *cache)
+{
+    int32 id = 0;
+    while (true)
+    {
+        DCAMERR err =
+            dcamprop_getnextid(cache->hdcam, &id, DCAMPROP_OPTION_UPDATED);
+        if (orcaerr_failed(err))
+        {
+            return err == DCAMERR_NOPROPERTY;
+        }
+        if (!id)
+        {
+            return true;
+        }
+        struct _ORCA_PROP_ENTRY *e = orcacam_prop_find(cache, id);
+        if (e)
+        {
+            e->flags &= ~(ORCACAM_PROP_VALUE | ORCACAM_PROP_ATTR);
+        }
+    }
+}
+
+DCAMERR orcacam_prop_create(struct _ORCA_PROPCACHE **cache, HDCAM hdcam)
+{
+    assert(cache);
+    *cache = NULL;
+    // enumerate the supported properties
+    size_t count = 0, cap = 256;
+    int32 *ids   = (int32 *)malloc(sizeof(int32) * cap);
+    if (!ids)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    int32 id = 0;
+    while (!orcaerr_failed(
+               dcamprop_getnextid(hdcam, &id, DCAMPROP_OPTION_SUPPORT)) &&
+           id)
+    {
+        if (count == cap)
+        {
+            int32 *tmp = (int32 *)realloc(ids, sizeof(int32) * cap * 2);
+            if (!tmp)
+            {
+                free(ids);
+                return DCAMERR_LESSSYSTEMMEMORY;
+            }
+            ids = tmp;
+            cap *= 2;
+        }
+        ids[count++] = id;
+    }
+    struct _ORCA_PROPCACHE *c =
+        (struct _ORCA_PROPCACHE *)malloc(sizeof(struct _ORCA_PROPCACHE));
+    if (!c)
+    {
+        free(ids);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(c, 0, sizeof(struct _ORCA_PROPCACHE));
+    uint32_t size = 64;
+    while (size < 2 * count)
+    {
+        size *= 2;
+    }
+    c->entries = (struct _ORCA_PROP_ENTRY *)calloc(
+        size, sizeof(struct _ORCA_PROP_ENTRY));
+    if (!c->entries)
+    {
+        free(ids);
+        free(c);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    c->hdcam = hdcam;
+    c->mask  = size - 1;
+    c->count = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        struct _ORCA_PROP_ENTRY *e = orcacam_prop_insert(c, ids[i]);
+        memset(&(e->attr), 0, sizeof(DCAMPROP_ATTR));
+        e->attr.cbSize = sizeof(DCAMPROP_ATTR);
+        e->attr.iProp  = ids[i];
+        if (!orcaerr_failed(dcamprop_getattr(hdcam, &(e->attr))))
+        {
+            e->flags |= ORCACAM_PROP_ATTR | ORCACAM_PROP_KNOWN;
+        }
+    }
+    free(ids);
+    pthread_mutex_init(&(c->lock), NULL);
+    orcacam_prop_drain(c); // start from a clean update list
+    *cache = c;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orcacam_prop_getvalue(struct _ORCA_PROPCACHE *cache, int32 prop,
+                              double *value)
+{
+    assert(cache);
+    assert(value);
+    pthread_mutex_lock(&(cache->lock));
+    struct _ORCA_PROP_ENTRY *e = orcacam_prop_find(cache, prop);
+    if (e && (e->flags & ORCACAM_PROP_VALUE))
+    {
+        *value = e->value;
+        pthread_mutex_unlock(&(cache->lock));
+        return DCAMERR_SUCCESS;
+    }
+    // volatile values change on their own, and are always read
+    bool cacheable = e && (e->flags & ORCACAM_PROP_KNOWN) &&
+                     !(e->attr.attribute & DCAMPROP_ATTR_VOLATILE);
+    uint64_t generation = cache->generation;
+    pthread_mutex_unlock(&(cache->lock));
+    DCAMERR err = dcamprop_getvalue(cache->hdcam, prop, value);
+    if (!orcaerr_failed(err) && cacheable)
+    {
+        pthread_mutex_lock(&(cache->lock));
+        if (generation == cache->generation) // not invalidated meanwhile
+        {
+            e->value = *value;
+            e->flags |= ORCACAM_PROP_VALUE;
+        }
+        pthread_mutex_unlock(&(cache->lock));
+    }
+    return err;
+}
+
+// Invalidate the values affected by setting a property
+static void orcacam_prop_updated(struct _ORCA_PROPCACHE *cache, int32 prop,
+                                 const double *value)
+{
+    pthread_mutex_lock(&(cache->lock));
+    cache->generation++;
+    bool precise = orcacam_prop_drain(cache);
+    struct _ORCA_PROP_ENTRY *e = orcacam_prop_find(cache, prop);
+    // the sensor mode and image format properties change the ranges of others
+    bool reshape = prop == DCAM_IDPROP_SENSORMODE ||
+                   (e && (e->attr.attribute & DCAMPROP_ATTR_DATASTREAM));
+    if (!precise || reshape)
+    {
+        for (uint32_t i = 0; i <= cache->mask; i++)
+        {
+            if (!precise)
+            {
+                cache->entries[i].flags &= ~ORCACAM_PROP_VALUE;
+            }
+            if (reshape && cache->entries[i].id)
+            {
+                cache->entries[i].flags &= ~ORCACAM_PROP_ATTR;
+            }
+        }
+    }
+    if (e)
+    {
+        e->flags &= ~ORCACAM_PROP_VALUE;
+        if (value && !(e->attr.attribute & DCAMPROP_ATTR_VOLATILE))
+        {
+            e->value = *value;
+            e->flags |= ORCACAM_PROP_VALUE;
+        }
+    }
+    pthread_mutex_unlock(&(cache->lock));
+}
+
+DCAMERR orcacam_prop_setvalue(struct _ORCA_PROPCACHE *cache, int32 prop,
+                              double value)
+{
+    assert(cache);
+    ORCA_TRACE_BEGIN(ORCA_TRACE_PROP_SET, (uint32_t)prop);
+    DCAMERR err = dcamprop_setvalue(cache->hdcam, prop, value);
+    ORCA_TRACE_END(ORCA_TRACE_PROP_SET, (uint32_t)err);
+    // the driver may have rounded the value, so it is read back on demand
+    orcacam_prop_updated(cache, prop, NULL);
+    return err;
+}
+
+DCAMERR orcacam_prop_setgetvalue(struct _ORCA_PROPCACHE *cache, int32 prop,
+                                 double *value, int32 option)
+{
+    assert(cache);
+    assert(value);
+    ORCA_TRACE_BEGIN(ORCA_TRACE_PROP_SET, (uint32_t)prop);
+    DCAMERR err = dcamprop_setgetvalue(cache->hdcam, prop, value, option);
+    ORCA_TRACE_END(ORCA_TRACE_PROP_SET, (uint32_t)err);
+    orcacam_prop_updated(cache, prop, orcaerr_failed(err) ? NULL : value);
+    return err;
+}
+
+DCAMERR orcacam_prop_getattr(struct _ORCA_PROPCACHE *cache,
+                             DCAMPROP_ATTR *attr)
+{
+    assert(cache);
+    assert(attr);
+    int32 prop = attr->iProp;
+    pthread_mutex_lock(&(cache->lock));
+    struct _ORCA_PROP_ENTRY *e = orcacam_prop_find(cache, prop);
+    if (e && (e->flags & ORCACAM_PROP_ATTR))
+    {
+        *attr = e->attr;
+        pthread_mutex_unlock(&(cache->lock));
+        return DCAMERR_SUCCESS;
+    }
+    uint64_t generation = cache->generation;
+    pthread_mutex_unlock(&(cache->lock));
+    DCAMERR err = dcamprop_getattr(cache->hdcam, attr);
+    if (!orcaerr_failed(err) && e)
+    {
+        pthread_mutex_lock(&(cache->lock));
+        if (generation == cache->generation)
+        {
+            e->attr = *attr;
+            e->flags |= ORCACAM_PROP_ATTR | ORCACAM_PROP_KNOWN;
+        }
+        pthread_mutex_unlock(&(cache->lock));
+    }
+    return err;
+}
+
+size_t orcacam_prop_list(struct _ORCA_PROPCACHE *cache, int32 *ids,
+                         size_t max_ids, int32 attribute)
+{
+    assert(cache);
+    size_t count = 0;
+    pthread_mutex_lock(&(cache->lock));
+    for (uint32_t i = 0; i <= cache->mask; i++)
+    {
+        struct _ORCA_PROP_ENTRY *e = &(cache->entries[i]);
+        if (!e->id || !(e->flags & ORCACAM_PROP_KNOWN) ||
+            (e->attr.attribute & attribute) != attribute)
+        {
+            continue;
+        }
+        if (ids && count < max_ids)
+        {
+            ids[count] = e->id;
+        }
+        count++;
+    }
+    pthread_mutex_unlock(&(cache->lock));
+    return count;
+}
+
+void orcacam_prop_invalidate(struct _ORCA_PROPCACHE *cache)
+{
+    assert(cache);
+    pthread_mutex_lock(&(cache->lock));
+    cache->generation++;
+    for (uint32_t i = 0; i <= cache->mask; i++)
+    {
+        cache->entries[i].flags &= ~ORCACAM_PROP_VALUE;
+    }
+    pthread_mutex_unlock(&(cache->lock));
+}
+
+void orcacam_prop_destroy(struct _ORCA_PROPCACHE **cache)
+{
+    assert(cache);
+    struct _ORCA_PROPCACHE *c = *cache;
+    if (!c)
+    {
+        return;
+    }
+    pthread_mutex_destroy(&(c->lock));
+    free(c->entries);
+    free(c);
+    *cache = NULL;
+}
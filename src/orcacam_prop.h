@@ -0,0 +1,100 @@
+/**
+ * @file orcacam_prop.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Internal property attribute table and value cache.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_PROP_H_
+#define _ORCACAM_PROP_H_
+
+#include "orcacam.h"
+
+struct _ORCA_PROPCACHE;
+
+/**
+ * @brief Enumerate the properties of a camera and build the attribute table.
+ *
+ * @param cache Output property cache
+ * @param hdcam Camera handle
+ * @return DCAMERR
+ */
+DCAMERR orcacam_prop_create(struct _ORCA_PROPCACHE **cache, HDCAM hdcam);
+
+/**
+ * @brief Get a property value. Values of non-volatile properties are served
+ * from the cache after the first read.
+ *
+ * @param cache Property cache
+ * @param prop Property ID
+ * @param value Output value
+ * @return DCAMERR
+ */
+DCAMERR orcacam_prop_getvalue(struct _ORCA_PROPCACHE *cache, int32 prop,
+                              double *value);
+
+/**
+ * @brief Set a property value, and invalidate the values the driver reports
+ * as updated.
+ *
+ * @param cache Property cache
+ * @param prop Property ID
+ * @param value Value
+ * @return DCAMERR
+ */
+DCAMERR orcacam_prop_setvalue(struct _ORCA_PROPCACHE *cache, int32 prop,
+                              double value);
+
+/**
+ * @brief Set a property value and get the value the driver applied.
+ *
+ * @param cache Property cache
+ * @param prop Property ID
+ * @param value Value, overwritten with the applied value
+ * @param option DCAMPROP_OPTION
+ * @return DCAMERR
+ */
+DCAMERR orcacam_prop_setgetvalue(struct _ORCA_PROPCACHE *cache, int32 prop,
+                                 double *value, int32 option);
+
+/**
+ * @brief Get the attributes of a property from the attribute table.
+ *
+ * @param cache Property cache
+ * @param attr Attribute, with iProp set to the property ID
+ * @return DCAMERR
+ */
+DCAMERR orcacam_prop_getattr(struct _ORCA_PROPCACHE *cache, DCAMPROP_ATTR *attr);
+
+/**
+ * @brief List the properties whose known attributes include all the given
+ * attribute flags.
+ *
+ * @param cache Property cache
+ * @param ids Output property IDs, may be NULL to count
+ * @param max_ids Size of ids
+ * @param attribute DCAMPROP_ATTR flags
+ * @return size_t Number of matching properties (may exceed max_ids)
+ */
+size_t orcacam_prop_list(struct _ORCA_PROPCACHE *cache, int32 *ids,
+                         size_t max_ids, int32 attribute);
+
+/**
+ * @brief Invalidate every cached value.
+ *
+ * @param cache Property cache
+ */
+void orcacam_prop_invalidate(struct _ORCA_PROPCACHE *cache);
+
+/**
+ * @brief Free a property cache.
+ *
+ * @param cache Property cache
+ */
+void orcacam_prop_destroy(struct _ORCA_PROPCACHE **cache);
+
+#endif // _ORCACAM_PROP_H_
@@ -0,0 +1,748 @@
+#define _GNU_SOURCE
+#include "orcacam_server.h"
+#include "orcacam_sock.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ORCACAM_SERVER_PAGE 4096
+#define ORCACAM_CLIENT_PENDING 64 // queued frame messages
+
+// The ring starts with one page of slot sequence numbers (odd while the slot
+// is written, 2 * (index + 1) once frame index is complete), followed by the
+// page-aligned slots.
+#define ORCACAM_SERVER_DATA_OFFSET ORCACAM_SERVER_PAGE
+
+struct _ORCA_SERVER_CLIENT
+{
+    int fd;
+    bool subscribed;
+    bool reply_pending; // reply waiting for room in the socket
+    ORCA_SERVER_MSG reply;
+};
+
+struct _ORCA_SERVER
+{
+    ORCACAM cam;
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    int listen_fd;
+    int wake_fd; // eventfd stopping the server thread
+    int ring_fd; // sealed memfd
+    char *ring;
+    size_t ring_bytes;
+    size_t slot_bytes;
+    int32 num_slots;
+    uint64_t head; // frames stored, written by the capture thread only
+    pthread_t thread;
+    pthread_mutex_t ctl_lock; // serializes camera control and capture
+    bool capturing;
+    pthread_mutex_t lock; // protects the client list
+    struct _ORCA_SERVER_CLIENT clients[ORCA_SERVER_MAX_CLIENTS];
+    int32 num_clients;
+};
+
+struct _ORCA_CLIENT
+{
+    int fd;
+    const char *ring;
+    size_t ring_bytes;
+    size_t slot_bytes;
+    int32 num_slots;
+    ORCA_SERVER_MSG pending[ORCACAM_CLIENT_PENDING];
+    size_t pending_head, pending_count;
+    uint64_t next;   // expected frame index
+    int32 slot;      // slot being read, -1 if none
+    uint64_t seq;    // its sequence number when it was mapped
+};
+
+static inline _Atomic uint64_t *orcacam_server_seq(const char *ring)
+{
+    return (_Atomic uint64_t *)ring;
+}
+
+static inline uint64_t orcacam_server_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void orcacam_server_frame(ORCA_FRAME *frame, void *user_data,
+                                 size_t sz_user_data)
+{
+    (void)sz_user_data;
+    struct _ORCA_SERVER *srv = (struct _ORCA_SERVER *)user_data;
+    size_t size              = (size_t)frame->row_stride * frame->height;
+    if (!srv || !frame->data || size > srv->slot_bytes)
+    {
+        return;
+    }
+    uint64_t index = srv->head;
+    uint64_t s     = index % srv->num_slots;
+    _Atomic uint64_t *seq = orcacam_server_seq(srv->ring) + s;
+    char *data = srv->ring + ORCACAM_SERVER_DATA_OFFSET + s * srv->slot_bytes;
+    atomic_store_explicit(seq, 2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(data, frame->data, size);
+    atomic_store_explicit(seq, 2 * index + 2, memory_order_release);
+    srv->head = index + 1;
+
+    ORCA_SERVER_MSG msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type         = ORCA_SERVER_FRAME;
+    msg.status       = DCAMERR_SUCCESS;
+    msg.index        = index;
+    msg.offset       = data - srv->ring;
+    msg.timestamp_ns = orcacam_server_now_ns();
+    msg.width        = frame->width;
+    msg.height       = frame->height;
+    msg.fmt          = frame->fmt;
+    msg.row_stride   = frame->row_stride;
+    pthread_mutex_lock(&(srv->lock));
+    for (int32 i = 0; i < srv->num_clients; i++)
+    {
+        if (srv->clients[i].subscribed && !srv->clients[i].reply_pending)
+        {
+            // a full socket means the client is behind: it misses this frame
+            send(srv->clients[i].fd, &msg, sizeof(msg),
+                 MSG_DONTWAIT | MSG_NOSIGNAL);
+        }
+    }
+    pthread_mutex_unlock(&(srv->lock));
+}
+
+static DCAMERR orcacam_server_start(struct _ORCA_SERVER *srv)
+{
+    if (srv->capturing)
+    {
+        return DCAMERR_SUCCESS;
+    }
+    DCAMERR err =
+        orca_start_capture(srv->cam, orcacam_server_frame, srv, sizeof(srv));
+    if (!orcaerr_failed(err))
+    {
+        srv->capturing = true;
+    }
+    return err;
+}
+
+static DCAMERR orcacam_server_stop(struct _ORCA_SERVER *srv)
+{
+    if (!srv->capturing)
+    {
+        return DCAMERR_SUCCESS;
+    }
+    DCAMERR err = orca_stop_capture(srv->cam);
+    if (!orcaerr_failed(err))
+    {
+        srv->capturing = false;
+    }
+    return err;
+}
+
+// Run a control request, pausing the capture if the camera is busy
+static DCAMERR orcacam_server_control(struct _ORCA_SERVER *srv,
+                                      ORCA_SERVER_MSG *msg)
+{
+    DCAMERR err      = DCAMERR_INVALIDPARAM;
+    bool paused      = false;
+    int32 attempts   = 2;
+    double exposure;
+    while (attempts--)
+    {
+        switch (msg->type)
+        {
+        case ORCA_SERVER_START:
+            err = orcacam_server_start(srv);
+            break;
+        case ORCA_SERVER_STOP:
+            err = orcacam_server_stop(srv);
+            break;
+        case ORCA_SERVER_GET_EXPOSURE:
+            err = orca_get_exposure(srv->cam, &exposure);
+            if (!orcaerr_failed(err))
+            {
+                msg->value = exposure;
+            }
+            break;
+        case ORCA_SERVER_SET_EXPOSURE:
+            err = orca_set_exposure(srv->cam, msg->value);
+            break;
+        case ORCA_SERVER_SET_ROI:
+            err = orca_set_roi(srv->cam, msg->roi[0], msg->roi[1], msg->roi[2],
+                               msg->roi[3]);
+            break;
+        case ORCA_SERVER_SWITCH_MODE:
+            err = orca_switch_mode(srv->cam, (DCAMPROPMODEVALUE)msg->value);
+            break;
+        default:
+            err = DCAMERR_INVALIDPARAM;
+            break;
+        }
+        if (err != DCAMERR_BUSY || !srv->capturing || paused)
+        {
+            break;
+        }
+        if (orcaerr_failed(orcacam_server_stop(srv)))
+        {
+            break;
+        }
+        paused = true;
+    }
+    if (paused)
+    {
+        DCAMERR ret = orcacam_server_start(srv);
+        err         = orcaerr_failed(err) ? err : ret;
+    }
+    return err;
+}
+
+static bool orcacam_server_send_ring(struct _ORCA_SERVER *srv, int fd,
+                                     ORCA_SERVER_MSG *msg)
+{
+    msg->status     = DCAMERR_SUCCESS;
+    msg->ring_bytes = srv->ring_bytes;
+    msg->slot_bytes = srv->slot_bytes;
+    msg->num_slots  = srv->num_slots;
+    struct iovec iov = {.iov_base = msg, .iov_len = sizeof(ORCA_SERVER_MSG)};
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctl;
+    memset(&ctl, 0, sizeof(ctl));
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov               = &iov;
+    mh.msg_iovlen            = 1;
+    mh.msg_control           = ctl.buf;
+    mh.msg_controllen        = sizeof(ctl.buf);
+    struct cmsghdr *cm       = CMSG_FIRSTHDR(&mh);
+    cm->cmsg_level           = SOL_SOCKET;
+    cm->cmsg_type            = SCM_RIGHTS;
+    cm->cmsg_len             = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &(srv->ring_fd), sizeof(int));
+    return sendmsg(fd, &mh, MSG_DONTWAIT | MSG_NOSIGNAL) ==
+           (ssize_t)sizeof(ORCA_SERVER_MSG);
+}
+
+// Send a reply, or keep it until the client has read enough frame messages
+// to make room for it. The request has already taken effect, so the client
+// is only dropped if it is gone.
+static bool orcacam_server_reply(struct _ORCA_SERVER *srv, int32 idx,
+                                 const ORCA_SERVER_MSG *msg)
+{
+    struct _ORCA_SERVER_CLIENT *client = srv->clients + idx;
+    if (send(client->fd, msg, sizeof(*msg), MSG_DONTWAIT | MSG_NOSIGNAL) ==
+        (ssize_t)sizeof(*msg))
+    {
+        return true;
+    }
+    if (errno != EAGAIN && errno != EINTR)
+    {
+        return false;
+    }
+    // no more frame messages until the reply is out
+    pthread_mutex_lock(&(srv->lock));
+    client->reply         = *msg;
+    client->reply_pending = true;
+    pthread_mutex_unlock(&(srv->lock));
+    return true;
+}
+
+// Send the reply kept by orcacam_server_reply, returns false if the client
+// is gone
+static bool orcacam_server_flush(struct _ORCA_SERVER *srv, int32 idx)
+{
+    struct _ORCA_SERVER_CLIENT *client = srv->clients + idx;
+    if (send(client->fd, &(client->reply), sizeof(client->reply),
+             MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)sizeof(client->reply))
+    {
+        return errno == EAGAIN || errno == EINTR;
+    }
+    pthread_mutex_lock(&(srv->lock));
+    client->reply_pending = false;
+    pthread_mutex_unlock(&(srv->lock));
+    return true;
+}
+
+// Handle one request of a client, returns false if the client is gone
+static bool orcacam_server_request(struct _ORCA_SERVER *srv, int32 idx)
+{
+    ORCA_SERVER_MSG msg;
+    int fd    = srv->clients[idx].fd;
+    ssize_t n = recv(fd, &msg, sizeof(msg), MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+        return true;
+    }
+    if (n != (ssize_t)sizeof(msg))
+    {
+        return false;
+    }
+    switch (msg.type)
+    {
+    case ORCA_SERVER_HELLO:
+        return orcacam_server_send_ring(srv, fd, &msg);
+    case ORCA_SERVER_SUBSCRIBE:
+    case ORCA_SERVER_UNSUBSCRIBE:
+        pthread_mutex_lock(&(srv->lock));
+        srv->clients[idx].subscribed = msg.type == ORCA_SERVER_SUBSCRIBE;
+        pthread_mutex_unlock(&(srv->lock));
+        msg.status = DCAMERR_SUCCESS;
+        break;
+    default:
+        pthread_mutex_lock(&(srv->ctl_lock));
+        msg.status = orcacam_server_control(srv, &msg);
+        pthread_mutex_unlock(&(srv->ctl_lock));
+        break;
+    }
+    return orcacam_server_reply(srv, idx, &msg);
+}
+
+static void *orcacam_server_thread(void *inp)
+{
+    struct _ORCA_SERVER *srv = (struct _ORCA_SERVER *)inp;
+    struct pollfd fds[ORCA_SERVER_MAX_CLIENTS + 2];
+    while (true)
+    {
+        // only this thread changes the client list, so it can read it unlocked
+        int32 num_clients = srv->num_clients;
+        fds[0].fd         = srv->wake_fd;
+        fds[0].events     = POLLIN;
+        fds[1].fd         = srv->listen_fd;
+        fds[1].events     = POLLIN;
+        for (int32 i = 0; i < num_clients; i++)
+        {
+            // a client with a reply pending is not read until it is sent
+            fds[i + 2].fd = srv->clients[i].fd;
+            fds[i + 2].events =
+                srv->clients[i].reply_pending ? POLLOUT : POLLIN;
+        }
+        if (poll(fds, num_clients + 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents)
+        {
+            break;
+        }
+        // in reverse so that removing a client does not move the others
+        for (int32 i = num_clients - 1; i >= 0; i--)
+        {
+            short revents = fds[i + 2].revents;
+            if (!revents ||
+                (revents & POLLOUT ? orcacam_server_flush(srv, i)
+                                   : orcacam_server_request(srv, i)))
+            {
+                continue;
+            }
+            pthread_mutex_lock(&(srv->lock));
+            close(srv->clients[i].fd);
+            srv->clients[i] = srv->clients[--srv->num_clients];
+            pthread_mutex_unlock(&(srv->lock));
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            int fd = accept4(srv->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                continue;
+            }
+            if (srv->num_clients == ORCA_SERVER_MAX_CLIENTS)
+            {
+                close(fd);
+                continue;
+            }
+            pthread_mutex_lock(&(srv->lock));
+            srv->clients[srv->num_clients].fd            = fd;
+            srv->clients[srv->num_clients].subscribed    = false;
+            srv->clients[srv->num_clients].reply_pending = false;
+            srv->num_clients++;
+            pthread_mutex_unlock(&(srv->lock));
+        }
+    }
+    return NULL;
+}
+
+DCAMERR orca_server_create(ORCA_SERVER *server, ORCACAM cam, const char *path,
+                           int32 num_slots)
+{
+    assert(server);
+    assert(cam);
+    assert(path);
+    DCAMERR err;
+    *server = NULL;
+    if (num_slots < 1 || num_slots > ORCA_SERVER_MAX_SLOTS ||
+        strlen(path) >= sizeof(((struct sockaddr_un *)0)->sun_path))
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    int32 width, height;
+    err = orca_get_sensor_size(cam, &width, &height);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    struct _ORCA_SERVER *srv =
+        (struct _ORCA_SERVER *)malloc(sizeof(struct _ORCA_SERVER));
+    if (!srv)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(srv, 0, sizeof(struct _ORCA_SERVER));
+    srv->cam       = cam;
+    srv->num_slots = num_slots;
+    // room for the full sensor at 16 bits per pixel
+    srv->slot_bytes = ((size_t)width * height * sizeof(uint16_t) +
+                       ORCACAM_SERVER_PAGE - 1) &
+                      ~((size_t)ORCACAM_SERVER_PAGE - 1);
+    srv->ring_bytes = ORCACAM_SERVER_DATA_OFFSET + srv->slot_bytes * num_slots;
+    strncpy(srv->path, path, sizeof(srv->path) - 1);
+    srv->listen_fd = srv->wake_fd = -1;
+
+    err          = DCAMERR_NORESOURCE;
+    srv->ring_fd = memfd_create("orcacam_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (srv->ring_fd < 0)
+    {
+        goto free_srv;
+    }
+    if (ftruncate(srv->ring_fd, srv->ring_bytes) < 0)
+    {
+        err = DCAMERR_LESSSYSTEMMEMORY;
+        goto close_ring;
+    }
+    srv->ring = (char *)mmap(NULL, srv->ring_bytes, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, srv->ring_fd, 0);
+    if (srv->ring == MAP_FAILED)
+    {
+        err = DCAMERR_LESSSYSTEMMEMORY;
+        goto close_ring;
+    }
+    // clients can not resize the ring, nor (where supported) map it writable
+    int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+#ifdef F_SEAL_FUTURE_WRITE
+    seals |= F_SEAL_FUTURE_WRITE;
+#endif
+    if (fcntl(srv->ring_fd, F_ADD_SEALS, seals) < 0)
+    {
+        goto unmap_ring;
+    }
+    srv->wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (srv->wake_fd < 0)
+    {
+        goto unmap_ring;
+    }
+    srv->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (srv->listen_fd < 0)
+    {
+        goto close_wake;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    err = orcacam_sock_unlink_stale(&addr, SOCK_SEQPACKET);
+    if (orcaerr_failed(err))
+    {
+        goto close_listen;
+    }
+    err = DCAMERR_NORESOURCE;
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(srv->listen_fd, ORCA_SERVER_MAX_CLIENTS) < 0)
+    {
+        goto close_listen;
+    }
+    pthread_mutex_init(&(srv->lock), NULL);
+    pthread_mutex_init(&(srv->ctl_lock), NULL);
+    if (pthread_create(&(srv->thread), NULL, orcacam_server_thread, srv))
+    {
+        pthread_mutex_destroy(&(srv->lock));
+        pthread_mutex_destroy(&(srv->ctl_lock));
+        unlink(path);
+        goto close_listen;
+    }
+    *server = srv;
+    return DCAMERR_SUCCESS;
+close_listen:
+    close(srv->listen_fd);
+close_wake:
+    close(srv->wake_fd);
+unmap_ring:
+    munmap(srv->ring, srv->ring_bytes);
+close_ring:
+    close(srv->ring_fd);
+free_srv:
+    free(srv);
+    return err;
+}
+
+DCAMERR orca_server_start_capture(ORCA_SERVER server)
+{
+    assert(server);
+    pthread_mutex_lock(&(server->ctl_lock));
+    DCAMERR err = orcacam_server_start(server);
+    pthread_mutex_unlock(&(server->ctl_lock));
+    return err;
+}
+
+DCAMERR orca_server_stop_capture(ORCA_SERVER server)
+{
+    assert(server);
+    pthread_mutex_lock(&(server->ctl_lock));
+    DCAMERR err = orcacam_server_stop(server);
+    pthread_mutex_unlock(&(server->ctl_lock));
+    return err;
+}
+
+void orca_server_destroy(ORCA_SERVER *server)
+{
+    assert(server);
+    struct _ORCA_SERVER *srv = *server;
+    if (!srv)
+    {
+        return;
+    }
+    orca_server_stop_capture(srv);
+    uint64_t one = 1;
+    if (write(srv->wake_fd, &one, sizeof(one)) == sizeof(one))
+    {
+        pthread_join(srv->thread, NULL);
+    }
+    for (int32 i = 0; i < srv->num_clients; i++)
+    {
+        close(srv->clients[i].fd);
+    }
+    close(srv->listen_fd);
+    unlink(srv->path);
+    close(srv->wake_fd);
+    munmap(srv->ring, srv->ring_bytes);
+    close(srv->ring_fd);
+    pthread_mutex_destroy(&(srv->lock));
+    pthread_mutex_destroy(&(srv->ctl_lock));
+    free(srv);
+    *server = NULL;
+}
+
+DCAMERR orca_client_connect(ORCA_CLIENT *client, const char *path)
+{
+    assert(client);
+    assert(path);
+    DCAMERR err = DCAMERR_NOTREADY;
+    *client     = NULL;
+    struct _ORCA_CLIENT *c =
+        (struct _ORCA_CLIENT *)malloc(sizeof(struct _ORCA_CLIENT));
+    if (!c)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(c, 0, sizeof(struct _ORCA_CLIENT));
+    c->slot = -1;
+    c->fd   = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (c->fd < 0)
+    {
+        free(c);
+        return DCAMERR_NORESOURCE;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        goto close_fd;
+    }
+    ORCA_SERVER_MSG msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = ORCA_SERVER_HELLO;
+    if (send(c->fd, &msg, sizeof(msg), MSG_NOSIGNAL) != (ssize_t)sizeof(msg))
+    {
+        goto close_fd;
+    }
+    struct iovec iov = {.iov_base = &msg, .iov_len = sizeof(msg)};
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } ctl;
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov         = &iov;
+    mh.msg_iovlen      = 1;
+    mh.msg_control     = ctl.buf;
+    mh.msg_controllen  = sizeof(ctl.buf);
+    struct cmsghdr *cm = NULL;
+    if (recvmsg(c->fd, &mh, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(msg) ||
+        msg.type != ORCA_SERVER_HELLO || !(cm = CMSG_FIRSTHDR(&mh)) ||
+        cm->cmsg_type != SCM_RIGHTS)
+    {
+        goto close_fd;
+    }
+    int ring_fd;
+    memcpy(&ring_fd, CMSG_DATA(cm), sizeof(int));
+    c->ring = (const char *)mmap(NULL, msg.ring_bytes, PROT_READ, MAP_SHARED,
+                                 ring_fd, 0);
+    close(ring_fd);
+    if (c->ring == MAP_FAILED)
+    {
+        err = DCAMERR_LESSSYSTEMMEMORY;
+        goto close_fd;
+    }
+    c->ring_bytes = msg.ring_bytes;
+    c->slot_bytes = msg.slot_bytes;
+    c->num_slots  = msg.num_slots;
+    *client       = c;
+    return DCAMERR_SUCCESS;
+close_fd:
+    close(c->fd);
+    free(c);
+    return err;
+}
+
+// Receive one message, returns DCAMERR_TIMEOUT if none arrived in time
+static DCAMERR orcacam_client_recv(struct _ORCA_CLIENT *c, ORCA_SERVER_MSG *msg,
+                                   int32 timeout_ms)
+{
+    struct pollfd pfd = {.fd = c->fd, .events = POLLIN};
+    int ret;
+    do
+    {
+        ret = poll(&pfd, 1, timeout_ms < 0 ? -1 : timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+    if (ret == 0)
+    {
+        return DCAMERR_TIMEOUT;
+    }
+    if (ret < 0 || recv(c->fd, msg, sizeof(*msg), 0) != (ssize_t)sizeof(*msg))
+    {
+        return DCAMERR_ABORT;
+    }
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_client_request(ORCA_CLIENT client, ORCA_SERVER_MSG *msg)
+{
+    assert(client);
+    assert(msg);
+    DCAMERR err;
+    int32 type = msg->type;
+    if (send(client->fd, msg, sizeof(*msg), MSG_NOSIGNAL) != (ssize_t)sizeof(*msg))
+    {
+        return DCAMERR_ABORT;
+    }
+    while (true)
+    {
+        err = orcacam_client_recv(client, msg, -1);
+        if (orcaerr_failed(err))
+        {
+            return err;
+        }
+        if (msg->type == type)
+        {
+            return (DCAMERR)msg->status;
+        }
+        if (msg->type == ORCA_SERVER_FRAME)
+        {
+            if (client->pending_count == ORCACAM_CLIENT_PENDING) // drop oldest
+            {
+                client->pending_head = (client->pending_head + 1) % ORCACAM_CLIENT_PENDING;
+                client->pending_count--;
+            }
+            size_t tail = (client->pending_head + client->pending_count) % ORCACAM_CLIENT_PENDING;
+            client->pending[tail] = *msg;
+            client->pending_count++;
+        }
+    }
+}
+
+DCAMERR orca_client_next(ORCA_CLIENT client, ORCA_FRAME *frame,
+                         ORCA_SHM_INFO *info, int32 timeout_ms)
+{
+    assert(client);
+    assert(frame);
+    DCAMERR err;
+    ORCA_SERVER_MSG msg;
+    client->slot = -1;
+    do
+    {
+        if (client->pending_count)
+        {
+            msg                  = client->pending[client->pending_head];
+            client->pending_head = (client->pending_head + 1) % ORCACAM_CLIENT_PENDING;
+            client->pending_count--;
+        }
+        else
+        {
+            err = orcacam_client_recv(client, &msg, timeout_ms);
+            if (orcaerr_failed(err))
+            {
+                return err;
+            }
+        }
+    } while (msg.type != ORCA_SERVER_FRAME);
+    if (msg.offset < ORCACAM_SERVER_DATA_OFFSET ||
+        msg.offset + (uint64_t)msg.row_stride * msg.height > client->ring_bytes)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    frame->data       = (char *)client->ring + msg.offset;
+    frame->width      = msg.width;
+    frame->height     = msg.height;
+    frame->fmt        = (DCAM_PIXELTYPE)msg.fmt;
+    frame->row_stride = msg.row_stride;
+    frame->rsvd       = 0;
+    memset(frame->meta, 0, sizeof(frame->meta));
+    if (info)
+    {
+        info->index        = msg.index;
+        info->timestamp_ns = msg.timestamp_ns;
+        info->dropped      = msg.index > client->next ? msg.index - client->next : 0;
+    }
+    client->next = msg.index + 1;
+    client->slot = (int32)((msg.offset - ORCACAM_SERVER_DATA_OFFSET) / client->slot_bytes);
+    client->seq  = 2 * msg.index + 2;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_client_release(ORCA_CLIENT client)
+{
+    assert(client);
+    if (client->slot < 0)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t seq = atomic_load_explicit(
+        orcacam_server_seq(client->ring) + client->slot, memory_order_relaxed);
+    client->slot = -1;
+    return seq == client->seq ? DCAMERR_SUCCESS : DCAMERR_LOSTFRAME;
+}
+
+void orca_client_close(ORCA_CLIENT *client)
+{
+    assert(client);
+    struct _ORCA_CLIENT *c = *client;
+    if (!c)
+    {
+        return;
+    }
+    munmap((void *)c->ring, c->ring_bytes);
+    close(c->fd);
+    free(c);
+    *client = NULL;
+}
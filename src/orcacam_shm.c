@@ -0,0 +1,507 @@
+#include "orcacam_shm.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ORCACAM_SHM_MAGIC "ORCASHM3"
+#define ORCACAM_SHM_ALIGN 4096
+
+// Per-slot frame metadata, protected by the slot sequence number: odd while
+// the slot is written, 2 * (index + 1) once frame index is complete
+struct _ORCA_SHM_SLOT
+{
+    alignas(64) _Atomic uint64_t seq;
+    uint64_t index;
+    uint64_t timestamp_ns;
+    uint64_t size;
+    uint64_t offset; // of the frame data in the slot
+    int32_t width;
+    int32_t height;
+    int32_t fmt;
+    int32_t row_stride;
+    int32_t rsvd;
+};
+
+// Segment header, followed by the slot headers and the page-aligned frame data.
+// The header has a page of its own, the only one subscribers map writable.
+struct _ORCA_SHM_HEADER
+{
+    char magic[8];
+    uint32_t num_slots;
+    uint32_t pid; // publisher
+    uint64_t slot_bytes;  // frame data capacity of a slot
+    uint64_t data_offset; // offset of the first slot's frame data
+    uint64_t total_bytes;
+    alignas(64) _Atomic uint64_t head; // number of frames published
+    _Atomic uint32_t notify;           // futex word, bumped on every publish
+    _Atomic uint32_t waiters;          // subscribers sleeping on the futex
+    _Atomic uint32_t closed;
+    alignas(ORCACAM_SHM_ALIGN) struct _ORCA_SHM_SLOT slots[];
+};
+
+struct _ORCA_SHM_PUBLISHER
+{
+    char name[NAME_MAX];
+    struct _ORCA_SHM_HEADER *hdr;
+    size_t size;
+    int32 lead; // frames the producer may write ahead, 0 if frames are copied
+};
+
+struct _ORCA_SHM_SUBSCRIBER
+{
+    struct _ORCA_SHM_HEADER *hdr;
+    size_t size;
+    uint64_t next; // next frame to read
+    struct _ORCA_SHM_SLOT *slot; // slot being read
+    uint64_t seq;                // its sequence number when it was mapped
+};
+
+static inline size_t orcacam_shm_align(size_t sz)
+{
+    return (sz + ORCACAM_SHM_ALIGN - 1) & ~((size_t)ORCACAM_SHM_ALIGN - 1);
+}
+
+static inline uint64_t orcacam_shm_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline char *orcacam_shm_data(struct _ORCA_SHM_HEADER *hdr, uint64_t slot)
+{
+    return (char *)hdr + hdr->data_offset + slot * hdr->slot_bytes;
+}
+
+// Whether the segment was left by a publisher that exited without
+// orca_shm_destroy(); segments of a running publisher are never removed
+static bool orcacam_shm_stale(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return errno == ENOENT; // removed in the meantime
+    }
+    struct stat st;
+    bool stale = false;
+    if (!fstat(fd, &st) &&
+        (size_t)st.st_size >= sizeof(struct _ORCA_SHM_HEADER))
+    {
+        struct _ORCA_SHM_HEADER *hdr = (struct _ORCA_SHM_HEADER *)mmap(
+            NULL, sizeof(struct _ORCA_SHM_HEADER), PROT_READ, MAP_SHARED, fd,
+            0);
+        if (hdr != MAP_FAILED)
+        {
+            // the magic is only written once the publisher is set up
+            stale = !memcmp(hdr->magic, ORCACAM_SHM_MAGIC,
+                            sizeof(hdr->magic)) &&
+                    kill((pid_t)hdr->pid, 0) < 0 && errno == ESRCH;
+            munmap(hdr, sizeof(struct _ORCA_SHM_HEADER));
+        }
+    }
+    close(fd);
+    return stale;
+}
+
+DCAMERR orca_shm_create(ORCA_SHM_PUBLISHER *pub, const char *name,
+                        size_t max_frame_bytes, int32 num_slots)
+{
+    assert(pub);
+    assert(name);
+    *pub = NULL;
+    if (max_frame_bytes == 0 || num_slots < 1 || strlen(name) >= NAME_MAX)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    size_t slot_bytes  = orcacam_shm_align(max_frame_bytes);
+    size_t data_offset = orcacam_shm_align(
+        sizeof(struct _ORCA_SHM_HEADER) +
+        sizeof(struct _ORCA_SHM_SLOT) * num_slots);
+    size_t total = data_offset + slot_bytes * num_slots;
+    struct _ORCA_SHM_PUBLISHER *p =
+        (struct _ORCA_SHM_PUBLISHER *)malloc(sizeof(struct _ORCA_SHM_PUBLISHER));
+    if (!p)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(p, 0, sizeof(struct _ORCA_SHM_PUBLISHER));
+    strncpy(p->name, name, sizeof(p->name) - 1);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 && errno == EEXIST && orcacam_shm_stale(name))
+    {
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (fd < 0)
+    {
+        DCAMERR err = errno == EEXIST ? DCAMERR_BUSY : DCAMERR_NORESOURCE;
+        free(p);
+        return err;
+    }
+    if (ftruncate(fd, total) < 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        free(p);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    void *mem = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        shm_unlink(name);
+        free(p);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    struct _ORCA_SHM_HEADER *hdr = (struct _ORCA_SHM_HEADER *)mem;
+    hdr->num_slots               = num_slots;
+    hdr->slot_bytes              = slot_bytes;
+    hdr->data_offset             = data_offset;
+    hdr->total_bytes             = total;
+    hdr->pid                     = (uint32_t)getpid();
+    // magic last: subscribers check it before trusting the layout
+    atomic_thread_fence(memory_order_release);
+    memcpy(hdr->magic, ORCACAM_SHM_MAGIC, sizeof(hdr->magic));
+    p->hdr  = hdr;
+    p->size = total;
+    *pub    = p;
+    return DCAMERR_SUCCESS;
+}
+
+static inline void orcacam_shm_wake(struct _ORCA_SHM_HEADER *hdr)
+{
+    atomic_fetch_add(&(hdr->notify), 1);
+    if (atomic_load(&(hdr->waiters)))
+    {
+        syscall(SYS_futex, &(hdr->notify), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+DCAMERR orca_shm_buffers(ORCA_SHM_PUBLISHER pub, void **buffers,
+                         size_t *buffer_bytes, int32 lead)
+{
+    assert(pub);
+    assert(buffers);
+    assert(buffer_bytes);
+    struct _ORCA_SHM_HEADER *hdr = pub->hdr;
+    if (lead < 1 || (uint32_t)lead >= hdr->num_slots)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    for (uint32_t i = 0; i < hdr->num_slots; i++)
+    {
+        buffers[i] = orcacam_shm_data(hdr, i);
+    }
+    *buffer_bytes = hdr->slot_bytes;
+    pub->lead     = lead;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_shm_attach(ORCA_SHM_PUBLISHER pub, ORCACAM cam, int32 lead)
+{
+    assert(pub);
+    assert(cam);
+    void **buffers = (void **)malloc(sizeof(void *) * pub->hdr->num_slots);
+    if (!buffers)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    size_t bytes;
+    DCAMERR err = orca_shm_buffers(pub, buffers, &bytes, lead);
+    if (!orcaerr_failed(err))
+    {
+        err = orca_attach_buffers(cam, buffers, pub->hdr->num_slots, bytes);
+        if (orcaerr_failed(err))
+        {
+            pub->lead = 0;
+        }
+    }
+    free(buffers);
+    return err;
+}
+
+// Mark the slots of frames [begin, end) as being written, but for the slot
+// of frame `skip`
+static void orcacam_shm_invalidate(struct _ORCA_SHM_HEADER *hdr,
+                                   uint64_t begin, uint64_t end, uint64_t skip)
+{
+    for (uint64_t i = begin; i < end; i++)
+    {
+        if (i != skip)
+        {
+            atomic_fetch_or_explicit(&(hdr->slots[i % hdr->num_slots].seq), 1,
+                                     memory_order_relaxed);
+        }
+    }
+}
+
+DCAMERR orca_shm_publish(ORCA_SHM_PUBLISHER pub, const ORCA_FRAME *frame)
+{
+    assert(pub);
+    assert(frame);
+    struct _ORCA_SHM_HEADER *hdr = pub->hdr;
+    size_t size = (size_t)frame->row_stride * frame->height;
+    if (!frame->data)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    uint64_t head = atomic_load_explicit(&(hdr->head), memory_order_relaxed);
+    uint64_t n      = hdr->num_slots;
+    uint64_t index  = head;
+    uint64_t s      = index % n;
+    size_t offset   = 0;
+    const char *buf = orcacam_shm_data(hdr, 0);
+    if (pub->lead)
+    {
+        // written in place, the frame is published from the slot it is in
+        if (frame->data < buf || frame->data >= buf + n * hdr->slot_bytes)
+        {
+            return DCAMERR_INVALIDPARAM;
+        }
+        s      = (size_t)(frame->data - buf) / hdr->slot_bytes;
+        offset = (size_t)(frame->data - buf) % hdr->slot_bytes;
+    }
+    if (size > hdr->slot_bytes - offset)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    if (pub->lead)
+    {
+        // the frames before it that were not published went to the slots
+        // in between, and the producer may write up to lead frames ahead
+        // before the next one is published: none of those slots hold the
+        // frames they had anymore
+        index = head + (s + n - head % n) % n;
+        orcacam_shm_invalidate(hdr, head, index + pub->lead + 1, index);
+    }
+    struct _ORCA_SHM_SLOT *slot = &(hdr->slots[s]);
+    atomic_store_explicit(&(slot->seq), 2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->index        = index;
+    slot->size         = size;
+    slot->offset       = offset;
+    slot->width        = frame->width;
+    slot->height       = frame->height;
+    slot->fmt          = frame->fmt;
+    slot->row_stride   = frame->row_stride;
+    slot->rsvd         = frame->rsvd;
+    if (!pub->lead)
+    {
+        memcpy(orcacam_shm_data(hdr, s), frame->data, size);
+    }
+    slot->timestamp_ns = orcacam_shm_now_ns();
+    atomic_store_explicit(&(slot->seq), 2 * index + 2, memory_order_release);
+    atomic_store_explicit(&(hdr->head), index + 1, memory_order_release);
+    orcacam_shm_wake(hdr);
+    return DCAMERR_SUCCESS;
+}
+
+void orca_shm_stage(ORCA_FRAME *frame, void *pub, size_t sz_pub)
+{
+    (void)sz_pub;
+    if (!pub)
+    {
+        return;
+    }
+    orca_shm_publish((ORCA_SHM_PUBLISHER)pub, frame);
+}
+
+void orca_shm_destroy(ORCA_SHM_PUBLISHER *pub)
+{
+    assert(pub);
+    struct _ORCA_SHM_PUBLISHER *p = *pub;
+    if (!p)
+    {
+        return;
+    }
+    atomic_store(&(p->hdr->closed), 1);
+    orcacam_shm_wake(p->hdr);
+    munmap(p->hdr, p->size);
+    shm_unlink(p->name);
+    free(p);
+    *pub = NULL;
+}
+
+DCAMERR orca_shm_subscribe(ORCA_SHM_SUBSCRIBER *sub, const char *name)
+{
+    assert(sub);
+    assert(name);
+    *sub   = NULL;
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+    {
+        return DCAMERR_NOTREADY;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 ||
+        (size_t)st.st_size < sizeof(struct _ORCA_SHM_HEADER))
+    {
+        close(fd);
+        return DCAMERR_NOTREADY;
+    }
+    // read-only, but for the header page holding the waiters count
+    void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    if (mprotect(mem, ORCACAM_SHM_ALIGN, PROT_READ | PROT_WRITE) < 0)
+    {
+        munmap(mem, st.st_size);
+        return DCAMERR_NOTREADY;
+    }
+    struct _ORCA_SHM_HEADER *hdr = (struct _ORCA_SHM_HEADER *)mem;
+    if (memcmp(hdr->magic, ORCACAM_SHM_MAGIC, sizeof(hdr->magic)) ||
+        hdr->total_bytes > (size_t)st.st_size)
+    {
+        munmap(mem, st.st_size);
+        return DCAMERR_NOTREADY;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    struct _ORCA_SHM_SUBSCRIBER *s =
+        (struct _ORCA_SHM_SUBSCRIBER *)malloc(sizeof(struct _ORCA_SHM_SUBSCRIBER));
+    if (!s)
+    {
+        munmap(mem, st.st_size);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(s, 0, sizeof(struct _ORCA_SHM_SUBSCRIBER));
+    s->hdr  = hdr;
+    s->size = st.st_size;
+    s->next = atomic_load_explicit(&(hdr->head), memory_order_acquire);
+    *sub    = s;
+    return DCAMERR_SUCCESS;
+}
+
+// Sleep on the futex until a frame after `next` is published, or the deadline
+static DCAMERR orcacam_shm_wait(struct _ORCA_SHM_HEADER *hdr, uint64_t next,
+                                int32 timeout_ms, uint64_t deadline)
+{
+    DCAMERR err = DCAMERR_SUCCESS;
+    atomic_fetch_add(&(hdr->waiters), 1);
+    uint32_t notify = atomic_load(&(hdr->notify));
+    if (atomic_load(&(hdr->head)) <= next && !atomic_load(&(hdr->closed)))
+    {
+        struct timespec ts, *pts = NULL;
+        if (timeout_ms >= 0)
+        {
+            uint64_t now = orcacam_shm_now_ns();
+            uint64_t rem = deadline > now ? deadline - now : 0;
+            ts.tv_sec    = rem / 1000000000ULL;
+            ts.tv_nsec   = rem % 1000000000ULL;
+            pts          = &ts;
+        }
+        if (syscall(SYS_futex, &(hdr->notify), FUTEX_WAIT, notify, pts, NULL, 0) < 0 &&
+            errno == ETIMEDOUT)
+        {
+            err = DCAMERR_TIMEOUT;
+        }
+    }
+    atomic_fetch_sub(&(hdr->waiters), 1);
+    return err;
+}
+
+DCAMERR orca_shm_next(ORCA_SHM_SUBSCRIBER sub, ORCA_FRAME *frame,
+                      ORCA_SHM_INFO *info, int32 timeout_ms)
+{
+    assert(sub);
+    assert(frame);
+    DCAMERR err;
+    struct _ORCA_SHM_HEADER *hdr = sub->hdr;
+    uint64_t deadline =
+        timeout_ms >= 0 ? orcacam_shm_now_ns() + timeout_ms * 1000000ULL : 0;
+    uint64_t dropped = 0;
+    sub->slot        = NULL;
+    while (true)
+    {
+        uint64_t head = atomic_load_explicit(&(hdr->head), memory_order_acquire);
+        if (sub->next < head)
+        {
+            if (head - sub->next > hdr->num_slots) // lapped, skip to the newest
+            {
+                dropped += head - 1 - sub->next;
+                sub->next = head - 1;
+            }
+            uint64_t s = sub->next % hdr->num_slots;
+            struct _ORCA_SHM_SLOT *slot = &(hdr->slots[s]);
+            uint64_t seq = atomic_load_explicit(&(slot->seq), memory_order_acquire);
+            if (seq != 2 * sub->next + 2) // overwritten in the meantime
+            {
+                dropped++;
+                sub->next++;
+                continue;
+            }
+            frame->data       = orcacam_shm_data(hdr, s) + slot->offset;
+            frame->width      = slot->width;
+            frame->height     = slot->height;
+            frame->fmt        = (DCAM_PIXELTYPE)slot->fmt;
+            frame->row_stride = slot->row_stride;
+            frame->rsvd       = slot->rsvd;
+            memset(frame->meta, 0, sizeof(frame->meta));
+            if (info)
+            {
+                info->index        = slot->index;
+                info->timestamp_ns = slot->timestamp_ns;
+                info->dropped      = dropped;
+            }
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&(slot->seq), memory_order_relaxed) != seq)
+            {
+                dropped++;
+                sub->next++;
+                continue;
+            }
+            sub->slot = slot;
+            sub->seq  = seq;
+            sub->next++;
+            return DCAMERR_SUCCESS;
+        }
+        if (atomic_load(&(hdr->closed)))
+        {
+            return DCAMERR_ABORT;
+        }
+        err = orcacam_shm_wait(hdr, sub->next, timeout_ms, deadline);
+        if (orcaerr_failed(err))
+        {
+            return err;
+        }
+    }
+}
+
+DCAMERR orca_shm_release(ORCA_SHM_SUBSCRIBER sub)
+{
+    assert(sub);
+    if (!sub->slot)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t seq = atomic_load_explicit(&(sub->slot->seq), memory_order_relaxed);
+    sub->slot    = NULL;
+    return seq == sub->seq ? DCAMERR_SUCCESS : DCAMERR_LOSTFRAME;
+}
+
+void orca_shm_unsubscribe(ORCA_SHM_SUBSCRIBER *sub)
+{
+    assert(sub);
+    struct _ORCA_SHM_SUBSCRIBER *s = *sub;
+    if (!s)
+    {
+        return;
+    }
+    munmap(s->hdr, s->size);
+    free(s);
+    *sub = NULL;
+}
@@ -0,0 +1,36 @@
+#include "orcacam_sock.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+DCAMERR orcacam_sock_unlink_stale(const struct sockaddr_un *addr, int type)
+{
+    struct stat st;
+    if (lstat(addr->sun_path, &st) < 0)
+    {
+        return DCAMERR_SUCCESS; // nothing to remove
+    }
+    if (!S_ISSOCK(st.st_mode))
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    int fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return DCAMERR_NORESOURCE;
+    }
+    int rc  = connect(fd, (const struct sockaddr *)addr, sizeof(*addr));
+    int err = errno;
+    close(fd);
+    if (rc == 0)
+    {
+        return DCAMERR_BUSY; // a listener is running
+    }
+    if (err != ECONNREFUSED)
+    {
+        return DCAMERR_NORESOURCE;
+    }
+    unlink(addr->sun_path);
+    return DCAMERR_SUCCESS;
+}
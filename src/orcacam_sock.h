@@ -0,0 +1,30 @@
+/**
+ * @file orcacam_sock.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Internal helpers for the Unix sockets of the server and the metrics
+ * exporter.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_SOCK_H_
+#define _ORCACAM_SOCK_H_
+
+#include "orcacam.h"
+#include <sys/un.h>
+
+/**
+ * @brief Remove the socket left at a path by a process that exited without
+ * removing it. Only a socket nobody listens on is removed.
+ *
+ * @param addr Socket address
+ * @param type Socket type of the listener (SOCK_STREAM, SOCK_SEQPACKET)
+ * @return DCAMERR DCAMERR_BUSY if a listener is running on the path,
+ * DCAMERR_INVALIDPARAM if the path exists and is not a socket
+ */
+DCAMERR orcacam_sock_unlink_stale(const struct sockaddr_un *addr, int type);
+
+#endif // _ORCACAM_SOCK_H_
@@ -0,0 +1,385 @@
+#include "orcacam_sparse.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+struct _ORCA_SPARSE
+{
+    ORCA_SPARSE_CONFIG config;
+    uint16_t *background; // background map
+    int32 bg_width, bg_height;
+    void *limit; // threshold map (background + threshold) in the frame pixel type
+    int32 lim_width, lim_height;
+    DCAM_PIXELTYPE lim_fmt;
+    uint8_t *tiles; // tiles hit in the current frame
+    int32 tiles_x, tiles_y;
+    ORCA_EVENT *events;
+    ORCA_PATCH *patches;
+    char *patch_data;
+    ORCA_SPARSE_FRAME out;
+};
+
+DCAMERR orca_sparse_create(ORCA_SPARSE *sparse, const ORCA_SPARSE_CONFIG *config)
+{
+    assert(sparse);
+    assert(config);
+    *sparse = NULL;
+    if (config->threshold < 0 || config->patch_size < 0 ||
+        config->patch_size > 256)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    struct _ORCA_SPARSE *sp =
+        (struct _ORCA_SPARSE *)malloc(sizeof(struct _ORCA_SPARSE));
+    if (!sp)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(sp, 0, sizeof(struct _ORCA_SPARSE));
+    sp->config = *config;
+    if (config->max_events)
+    {
+        sp->events = (ORCA_EVENT *)malloc(sizeof(ORCA_EVENT) * config->max_events);
+        if (!sp->events)
+        {
+            goto free_sp;
+        }
+    }
+    if (config->patch_size && config->max_patches)
+    {
+        sp->patches =
+            (ORCA_PATCH *)malloc(sizeof(ORCA_PATCH) * config->max_patches);
+        sp->patch_data = (char *)malloc((size_t)config->patch_size *
+                                        config->patch_size * sizeof(uint16_t) *
+                                        config->max_patches);
+        if (!sp->patches || !sp->patch_data)
+        {
+            goto free_sp;
+        }
+    }
+    *sparse = sp;
+    return DCAMERR_SUCCESS;
+free_sp:
+    free(sp->events);
+    free(sp->patches);
+    free(sp->patch_data);
+    free(sp);
+    return DCAMERR_LESSSYSTEMMEMORY;
+}
+
+DCAMERR orca_sparse_set_background(ORCA_SPARSE sparse,
+                                   const ORCA_FRAME *background)
+{
+    assert(sparse);
+    assert(background);
+    if (!background->data || background->width < 1 || background->height < 1)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    if (background->fmt != DCAM_PIXELTYPE_MONO8 &&
+        background->fmt != DCAM_PIXELTYPE_MONO16)
+    {
+        return DCAMERR_NOTSUPPORT;
+    }
+    size_t npix  = (size_t)background->width * background->height;
+    uint16_t *bg = (uint16_t *)realloc(sparse->background, sizeof(uint16_t) * npix);
+    if (!bg)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    for (int32 y = 0; y < background->height; y++)
+    {
+        const char *row = background->data + (size_t)y * background->row_stride;
+        uint16_t *dst   = bg + (size_t)y * background->width;
+        for (int32 x = 0; x < background->width; x++)
+        {
+            dst[x] = background->fmt == DCAM_PIXELTYPE_MONO8
+                         ? ((const uint8_t *)row)[x]
+                         : ((const uint16_t *)row)[x];
+        }
+    }
+    sparse->background = bg;
+    sparse->bg_width   = background->width;
+    sparse->bg_height  = background->height;
+    sparse->lim_width  = 0; // rebuild the threshold map on the next frame
+    return DCAMERR_SUCCESS;
+}
+
+// Build the threshold map and tile map for the frame geometry
+static DCAMERR orcacam_sparse_prepare(struct _ORCA_SPARSE *sp,
+                                      const ORCA_FRAME *frame)
+{
+    if (sp->limit && sp->lim_width == frame->width &&
+        sp->lim_height == frame->height && sp->lim_fmt == frame->fmt)
+    {
+        return DCAMERR_SUCCESS;
+    }
+    if (sp->background &&
+        (sp->bg_width != frame->width || sp->bg_height != frame->height))
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    bool mono8      = frame->fmt == DCAM_PIXELTYPE_MONO8;
+    uint32_t maxval = mono8 ? 0xff : 0xffff;
+    size_t npix     = (size_t)frame->width * frame->height;
+    void *limit     = realloc(sp->limit, npix * (mono8 ? 1 : 2));
+    if (!limit)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    sp->limit = limit;
+    for (size_t i = 0; i < npix; i++)
+    {
+        uint32_t lim = (sp->background ? sp->background[i] : 0) +
+                       (uint32_t)sp->config.threshold;
+        lim = lim > maxval ? maxval : lim;
+        if (mono8)
+        {
+            ((uint8_t *)limit)[i] = (uint8_t)lim;
+        }
+        else
+        {
+            ((uint16_t *)limit)[i] = (uint16_t)lim;
+        }
+    }
+    if (sp->config.patch_size)
+    {
+        int32 ps      = sp->config.patch_size;
+        sp->tiles_x   = (frame->width + ps - 1) / ps;
+        sp->tiles_y   = (frame->height + ps - 1) / ps;
+        uint8_t *tiles = (uint8_t *)realloc(sp->tiles, (size_t)sp->tiles_x * sp->tiles_y);
+        if (!tiles)
+        {
+            return DCAMERR_LESSSYSTEMMEMORY;
+        }
+        memset(tiles, 0, (size_t)sp->tiles_x * sp->tiles_y);
+        sp->tiles = tiles;
+    }
+    sp->lim_width  = frame->width;
+    sp->lim_height = frame->height;
+    sp->lim_fmt    = frame->fmt;
+    return DCAMERR_SUCCESS;
+}
+
+static inline void orcacam_sparse_emit(struct _ORCA_SPARSE *sp, int32 x,
+                                       int32 y, uint16_t value)
+{
+    if (sp->out.num_events < sp->config.max_events)
+    {
+        ORCA_EVENT *ev = &(sp->events[sp->out.num_events++]);
+        ev->x          = (uint16_t)x;
+        ev->y          = (uint16_t)y;
+        ev->value      = value;
+        ev->background = sp->background
+                             ? sp->background[(size_t)y * sp->lim_width + x]
+                             : 0;
+    }
+    else
+    {
+        sp->out.truncated = 1;
+    }
+    if (sp->tiles)
+    {
+        int32 ps = sp->config.patch_size;
+        sp->tiles[(y / ps) * sp->tiles_x + x / ps] = 1;
+    }
+}
+
+static void orcacam_sparse_row_u8(struct _ORCA_SPARSE *sp, const uint8_t *row,
+                                  const uint8_t *lim, int32 y)
+{
+    int32 x = 0;
+    int32 w = sp->lim_width;
+#if defined(__SSE2__)
+    for (; x + 16 <= w; x += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+        __m128i l = _mm_loadu_si128((const __m128i *)(lim + x));
+        // v <= l
+        unsigned mask =
+            ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, l), l)) & 0xffff;
+        while (mask)
+        {
+            int32 b = __builtin_ctz(mask);
+            orcacam_sparse_emit(sp, x + b, y, row[x + b]);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; x < w; x++)
+    {
+        if (row[x] > lim[x])
+        {
+            orcacam_sparse_emit(sp, x, y, row[x]);
+        }
+    }
+}
+
+static void orcacam_sparse_row_u16(struct _ORCA_SPARSE *sp,
+                                   const uint16_t *row, const uint16_t *lim,
+                                   int32 y)
+{
+    int32 x = 0;
+    int32 w = sp->lim_width;
+#if defined(__SSE2__)
+    const __m128i sign = _mm_set1_epi16((short)0x8000);
+    for (; x + 16 <= w; x += 16)
+    {
+        // unsigned compare via signed compare of sign-flipped values
+        __m128i v0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(row + x)), sign);
+        __m128i v1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(row + x + 8)), sign);
+        __m128i l0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(lim + x)), sign);
+        __m128i l1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(lim + x + 8)), sign);
+        __m128i m  = _mm_packs_epi16(_mm_cmpgt_epi16(v0, l0), _mm_cmpgt_epi16(v1, l1));
+        unsigned mask = _mm_movemask_epi8(m);
+        while (mask)
+        {
+            int32 b = __builtin_ctz(mask);
+            orcacam_sparse_emit(sp, x + b, y, row[x + b]);
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; x < w; x++)
+    {
+        if (row[x] > lim[x])
+        {
+            orcacam_sparse_emit(sp, x, y, row[x]);
+        }
+    }
+}
+
+// Copy the tiles hit by events, and clear the tile map
+static void orcacam_sparse_patches(struct _ORCA_SPARSE *sp,
+                                   const ORCA_FRAME *frame)
+{
+    int32 ps     = sp->config.patch_size;
+    int32 bpp    = frame->fmt == DCAM_PIXELTYPE_MONO8 ? 1 : 2;
+    size_t bytes = (size_t)ps * ps * bpp;
+    for (int32 ty = 0; ty < sp->tiles_y; ty++)
+    {
+        uint8_t *tiles = sp->tiles + (size_t)ty * sp->tiles_x;
+        for (int32 tx = 0; tx < sp->tiles_x; tx++)
+        {
+            if (!tiles[tx])
+            {
+                continue;
+            }
+            tiles[tx] = 0;
+            if (sp->out.num_patches >= sp->config.max_patches)
+            {
+                sp->out.truncated = 1;
+                continue;
+            }
+            int32 x0 = tx * ps, y0 = ty * ps;
+            int32 w  = frame->width - x0 < ps ? frame->width - x0 : ps;
+            int32 h  = frame->height - y0 < ps ? frame->height - y0 : ps;
+            ORCA_PATCH *patch = &(sp->patches[sp->out.num_patches]);
+            char *dst         = sp->patch_data + bytes * sp->out.num_patches++;
+            patch->x          = (uint16_t)x0;
+            patch->y          = (uint16_t)y0;
+            if (w < ps || h < ps)
+            {
+                memset(dst, 0, bytes);
+            }
+            for (int32 y = 0; y < h; y++)
+            {
+                memcpy(dst + (size_t)y * ps * bpp,
+                       frame->data + (size_t)(y0 + y) * frame->row_stride +
+                           (size_t)x0 * bpp,
+                       (size_t)w * bpp);
+            }
+        }
+    }
+}
+
+DCAMERR orca_sparse_extract(ORCA_SPARSE sparse, const ORCA_FRAME *frame,
+                            ORCA_SPARSE_FRAME *out)
+{
+    assert(sparse);
+    assert(frame);
+    assert(out);
+    DCAMERR err;
+    if (frame->fmt != DCAM_PIXELTYPE_MONO8 &&
+        frame->fmt != DCAM_PIXELTYPE_MONO16)
+    {
+        return DCAMERR_NOTSUPPORT;
+    }
+    if (!frame->data || frame->width < 1 || frame->height < 1 ||
+        frame->width > 0xffff || frame->height > 0xffff)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    err = orcacam_sparse_prepare(sparse, frame);
+    if (orcaerr_failed(err))
+    {
+        return err;
+    }
+    ORCA_SPARSE_FRAME *sf = &(sparse->out);
+    memset(sf, 0, sizeof(ORCA_SPARSE_FRAME));
+    sf->width      = frame->width;
+    sf->height     = frame->height;
+    sf->fmt        = frame->fmt;
+    sf->events     = sparse->events;
+    sf->patch_size = sparse->config.patch_size;
+    sf->patches    = sparse->patches;
+    sf->patch_data = sparse->patch_data;
+    for (int32 y = 0; y < frame->height; y++)
+    {
+        const char *row = frame->data + (size_t)y * frame->row_stride;
+        size_t offset   = (size_t)y * frame->width;
+        if (frame->fmt == DCAM_PIXELTYPE_MONO8)
+        {
+            orcacam_sparse_row_u8(sparse, (const uint8_t *)row,
+                                  (const uint8_t *)sparse->limit + offset, y);
+        }
+        else
+        {
+            orcacam_sparse_row_u16(sparse, (const uint16_t *)row,
+                                   (const uint16_t *)sparse->limit + offset, y);
+        }
+    }
+    if (sparse->tiles)
+    {
+        orcacam_sparse_patches(sparse, frame);
+    }
+    *out = *sf;
+    return DCAMERR_SUCCESS;
+}
+
+void orca_sparse_stage(ORCA_FRAME *frame, void *sparse, size_t sz_sparse)
+{
+    (void)sz_sparse;
+    ORCA_SPARSE sp = (ORCA_SPARSE)sparse;
+    ORCA_SPARSE_FRAME out;
+    if (!sp)
+    {
+        return;
+    }
+    if (orcaerr_failed(orca_sparse_extract(sp, frame, &out)))
+    {
+        return;
+    }
+    frame->meta[ORCA_META_SPARSE] = &(sp->out);
+}
+
+void orca_sparse_destroy(ORCA_SPARSE *sparse)
+{
+    assert(sparse);
+    struct _ORCA_SPARSE *sp = *sparse;
+    if (!sp)
+    {
+        return;
+    }
+    free(sp->background);
+    free(sp->limit);
+    free(sp->tiles);
+    free(sp->events);
+    free(sp->patches);
+    free(sp->patch_data);
+    free(sp);
+    *sparse = NULL;
+}
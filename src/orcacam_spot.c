@@ -0,0 +1,526 @@
+#include "orcacam_spot.h"
+#include "orcacam_par.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Horizontal run of pixels above the threshold
+struct _ORCA_SPOT_RUN
+{
+    int32 y, xs, xe; // xe inclusive
+    int32 parent;    // union-find parent run, then local component
+    uint64_t sw, swx, sx;
+    uint32_t n;
+    uint16_t peak;
+};
+
+// Connected component moments
+struct _ORCA_SPOT_COMP
+{
+    uint64_t sw, swx, swy; // weighted moments
+    uint64_t sx, sy;       // unweighted moments
+    uint32_t n;
+    uint16_t peak;
+    int32 xmin, ymin, xmax, ymax;
+};
+
+struct _ORCA_SPOT_BAND
+{
+    struct _ORCA_SPOT_RUN *runs;
+    size_t num_runs, cap_runs;
+    struct _ORCA_SPOT_COMP *comps;
+    size_t num_comps, cap_comps;
+    int32 *label;
+    size_t cap_label;
+    size_t first_end;  // runs of the first row: [0, first_end)
+    size_t last_start; // runs of the last row: [last_start, num_runs)
+    int32 y0, y1;
+    bool overflow;
+};
+
+struct _ORCA_SPOTFINDER
+{
+    ORCA_SPOT_CONFIG config;
+    struct _ORCA_PAR *par;
+    struct _ORCA_SPOT_BAND *bands;
+    int32 num_bands;
+    struct _ORCA_SPOT_COMP *comps; // all components
+    int32 *parent;                 // component union-find
+    size_t cap_comps;
+    ORCA_SPOT *spots;
+    ORCA_SPOT_LIST out;
+    const ORCA_FRAME *frame;
+};
+
+static inline int32 orcacam_spot_find_root(int32 *parent, int32 i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i         = parent[i];
+    }
+    return i;
+}
+
+static inline int32 orcacam_spot_run_root(struct _ORCA_SPOT_RUN *runs,
+                                          int32 i)
+{
+    while (runs[i].parent != i)
+    {
+        runs[i].parent = runs[runs[i].parent].parent;
+        i              = runs[i].parent;
+    }
+    return i;
+}
+
+static inline bool orcacam_spot_grow(void **buf, size_t *cap, size_t need,
+                                     size_t elem)
+{
+    if (need <= *cap)
+    {
+        return true;
+    }
+    size_t ncap = *cap ? *cap : 256;
+    while (ncap < need)
+    {
+        ncap *= 2;
+    }
+    void *nbuf = realloc(*buf, ncap * elem);
+    if (!nbuf)
+    {
+        return false;
+    }
+    *buf = nbuf;
+    *cap = ncap;
+    return true;
+}
+
+static inline void orcacam_spot_pixel(struct _ORCA_SPOT_BAND *band,
+                                      struct _ORCA_SPOT_RUN **run, int32 x,
+                                      int32 y, uint16_t v, int32 threshold,
+                                      int32 background)
+{
+    if (v <= threshold)
+    {
+        *run = NULL;
+        return;
+    }
+    if (!*run)
+    {
+        if (!orcacam_spot_grow((void **)&(band->runs), &(band->cap_runs),
+                               band->num_runs + 1,
+                               sizeof(struct _ORCA_SPOT_RUN)))
+        {
+            band->overflow = true;
+            return;
+        }
+        struct _ORCA_SPOT_RUN *r = &(band->runs[band->num_runs]);
+        memset(r, 0, sizeof(struct _ORCA_SPOT_RUN));
+        r->y      = y;
+        r->xs     = x;
+        r->parent = (int32)band->num_runs++;
+        *run      = r;
+    }
+    struct _ORCA_SPOT_RUN *r = *run;
+    uint32_t w               = v > background ? (uint32_t)(v - background) : 0;
+    r->xe                    = x;
+    r->sw += w;
+    r->swx += (uint64_t)w * x;
+    r->sx += x;
+    r->n++;
+    r->peak = v > r->peak ? v : r->peak;
+}
+
+static void orcacam_spot_row(struct _ORCA_SPOT_BAND *band, const uint16_t *row,
+                             int32 width, int32 y, int32 threshold,
+                             int32 background)
+{
+    struct _ORCA_SPOT_RUN *run = NULL;
+    int32 x                    = 0;
+#if defined(__SSE2__)
+    const __m128i sign = _mm_set1_epi16((short)0x8000);
+    const __m128i thr  = _mm_xor_si128(_mm_set1_epi16((short)threshold), sign);
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i v0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(row + x)), sign);
+        __m128i v1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(row + x + 8)), sign);
+        int mask   = _mm_movemask_epi8(_mm_packs_epi16(_mm_cmpgt_epi16(v0, thr), _mm_cmpgt_epi16(v1, thr)));
+        if (!mask) // background
+        {
+            run = NULL;
+            continue;
+        }
+        for (int32 i = 0; i < 16; i++)
+        {
+            orcacam_spot_pixel(band, &run, x + i, y, row[x + i], threshold,
+                               background);
+        }
+    }
+#endif
+    for (; x < width; x++)
+    {
+        orcacam_spot_pixel(band, &run, x, y, row[x], threshold, background);
+    }
+}
+
+// Union the 8-connected runs of two consecutive rows
+static void orcacam_spot_connect(struct _ORCA_SPOT_RUN *runs, size_t a0,
+                                 size_t a1, size_t b0, size_t b1)
+{
+    size_t i = a0, j = b0;
+    while (i < a1 && j < b1)
+    {
+        if (runs[i].xs <= runs[j].xe + 1 && runs[j].xs <= runs[i].xe + 1)
+        {
+            int32 ra = orcacam_spot_run_root(runs, (int32)i);
+            int32 rb = orcacam_spot_run_root(runs, (int32)j);
+            if (ra != rb)
+            {
+                // keep the earlier run as the root
+                if (ra < rb)
+                {
+                    runs[rb].parent = ra;
+                }
+                else
+                {
+                    runs[ra].parent = rb;
+                }
+            }
+        }
+        if (runs[i].xe < runs[j].xe)
+        {
+            i++;
+        }
+        else
+        {
+            j++;
+        }
+    }
+}
+
+static void orcacam_spot_band(void *ctx, int32 b, int32 num_bands)
+{
+    struct _ORCA_SPOTFINDER *sf   = (struct _ORCA_SPOTFINDER *)ctx;
+    struct _ORCA_SPOT_BAND *band  = &(sf->bands[b]);
+    const ORCA_FRAME *frame       = sf->frame;
+    int32 threshold               = sf->config.threshold;
+    int32 background              = sf->config.background;
+    orcacam_par_rows(frame->height, b, num_bands, &(band->y0), &(band->y1));
+    band->num_runs   = 0;
+    band->num_comps  = 0;
+    band->first_end  = 0;
+    band->last_start = 0;
+    band->overflow   = false;
+    size_t prev0 = 0, prev1 = 0;
+    for (int32 y = band->y0; y < band->y1; y++)
+    {
+        size_t cur0 = band->num_runs;
+        orcacam_spot_row(band,
+                         (const uint16_t *)(frame->data +
+                                            (size_t)y * frame->row_stride),
+                         frame->width, y, threshold, background);
+        size_t cur1 = band->num_runs;
+        if (y == band->y0)
+        {
+            band->first_end = cur1;
+        }
+        orcacam_spot_connect(band->runs, prev0, prev1, cur0, cur1);
+        prev0 = cur0;
+        prev1 = cur1;
+    }
+    band->last_start = prev0;
+    // aggregate the runs into components
+    if (!orcacam_spot_grow((void **)&(band->label), &(band->cap_label),
+                           band->num_runs, sizeof(int32)))
+    {
+        band->overflow = true;
+        band->num_runs = 0;
+        return;
+    }
+    for (size_t i = 0; i < band->num_runs; i++)
+    {
+        struct _ORCA_SPOT_RUN *r = &(band->runs[i]);
+        int32 root               = orcacam_spot_run_root(band->runs, (int32)i);
+        int32 c;
+        // roots precede their children, so the root is labeled first
+        if (root == (int32)i)
+        {
+            if (!orcacam_spot_grow((void **)&(band->comps), &(band->cap_comps),
+                                   band->num_comps + 1,
+                                   sizeof(struct _ORCA_SPOT_COMP)))
+            {
+                band->overflow = true;
+                band->num_runs = i;
+                break;
+            }
+            c = (int32)band->num_comps++;
+            memset(&(band->comps[c]), 0, sizeof(struct _ORCA_SPOT_COMP));
+            band->comps[c].xmin = r->xs;
+            band->comps[c].ymin = r->y;
+            band->comps[c].xmax = r->xe;
+            band->comps[c].ymax = r->y;
+        }
+        else
+        {
+            c = band->label[root];
+        }
+        band->label[i]             = c;
+        struct _ORCA_SPOT_COMP *cp = &(band->comps[c]);
+        cp->sw += r->sw;
+        cp->swx += r->swx;
+        cp->swy += r->sw * r->y;
+        cp->sx += r->sx;
+        cp->sy += (uint64_t)r->n * r->y;
+        cp->n += r->n;
+        cp->peak = r->peak > cp->peak ? r->peak : cp->peak;
+        cp->xmin = r->xs < cp->xmin ? r->xs : cp->xmin;
+        cp->xmax = r->xe > cp->xmax ? r->xe : cp->xmax;
+        cp->ymax = r->y;
+    }
+}
+
+static inline void orcacam_spot_merge(struct _ORCA_SPOT_COMP *dst,
+                                      const struct _ORCA_SPOT_COMP *src)
+{
+    dst->sw += src->sw;
+    dst->swx += src->swx;
+    dst->swy += src->swy;
+    dst->sx += src->sx;
+    dst->sy += src->sy;
+    dst->n += src->n;
+    dst->peak = src->peak > dst->peak ? src->peak : dst->peak;
+    dst->xmin = src->xmin < dst->xmin ? src->xmin : dst->xmin;
+    dst->ymin = src->ymin < dst->ymin ? src->ymin : dst->ymin;
+    dst->xmax = src->xmax > dst->xmax ? src->xmax : dst->xmax;
+    dst->ymax = src->ymax > dst->ymax ? src->ymax : dst->ymax;
+}
+
+DCAMERR orca_spot_create(ORCA_SPOTFINDER *finder, const ORCA_SPOT_CONFIG *config)
+{
+    assert(finder);
+    assert(config);
+    DCAMERR err;
+    *finder = NULL;
+    if (config->threshold < 0 || config->threshold > 0xffff ||
+        config->background < 0 || config->background > 0xffff)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    struct _ORCA_SPOTFINDER *sf =
+        (struct _ORCA_SPOTFINDER *)malloc(sizeof(struct _ORCA_SPOTFINDER));
+    if (!sf)
+    {
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    memset(sf, 0, sizeof(struct _ORCA_SPOTFINDER));
+    sf->config = *config;
+    err        = orcacam_par_create(&(sf->par), config->num_threads);
+    if (orcaerr_failed(err))
+    {
+        free(sf);
+        return err;
+    }
+    sf->num_bands = orcacam_par_bands(sf->par);
+    sf->bands     = (struct _ORCA_SPOT_BAND *)calloc(
+        sf->num_bands, sizeof(struct _ORCA_SPOT_BAND));
+    sf->spots = (ORCA_SPOT *)malloc(sizeof(ORCA_SPOT) *
+                                    (config->max_spots ? config->max_spots : 1));
+    if (!sf->bands || !sf->spots)
+    {
+        orca_spot_destroy(&sf);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    *finder = sf;
+    return DCAMERR_SUCCESS;
+}
+
+DCAMERR orca_spot_find(ORCA_SPOTFINDER finder, const ORCA_FRAME *frame,
+                       ORCA_SPOT_LIST *out)
+{
+    assert(finder);
+    assert(frame);
+    assert(out);
+    struct _ORCA_SPOTFINDER *sf = finder;
+    if (frame->fmt != DCAM_PIXELTYPE_MONO16)
+    {
+        return DCAMERR_NOTSUPPORT;
+    }
+    if (!frame->data || frame->width < 1 || frame->height < 1)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    memset(&(sf->out), 0, sizeof(ORCA_SPOT_LIST));
+    sf->out.spots = sf->spots;
+    // label every band in parallel
+    sf->frame = frame;
+    orcacam_par_run(sf->par, orcacam_spot_band, sf);
+    sf->frame = NULL;
+    // gather the components of all bands
+    size_t total = 0;
+    for (int32 b = 0; b < sf->num_bands; b++)
+    {
+        total += sf->bands[b].num_comps;
+        sf->out.truncated |= sf->bands[b].overflow;
+    }
+    if (total > sf->cap_comps)
+    {
+        struct _ORCA_SPOT_COMP *comps = (struct _ORCA_SPOT_COMP *)realloc(
+            sf->comps, total * sizeof(struct _ORCA_SPOT_COMP));
+        if (comps)
+        {
+            sf->comps = comps;
+        }
+        int32 *parent = (int32 *)realloc(sf->parent, total * sizeof(int32));
+        if (parent)
+        {
+            sf->parent = parent;
+        }
+        if (!comps || !parent)
+        {
+            return DCAMERR_LESSSYSTEMMEMORY;
+        }
+        sf->cap_comps = total;
+    }
+    size_t offset = 0, prev_offset = 0;
+    struct _ORCA_SPOT_BAND *prev = NULL;
+    for (int32 b = 0; b < sf->num_bands; b++)
+    {
+        struct _ORCA_SPOT_BAND *band = &(sf->bands[b]);
+        if (band->y0 == band->y1)
+        {
+            continue;
+        }
+        memcpy(sf->comps + offset, band->comps,
+               band->num_comps * sizeof(struct _ORCA_SPOT_COMP));
+        for (size_t c = 0; c < band->num_comps; c++)
+        {
+            sf->parent[offset + c] = (int32)(offset + c);
+        }
+        // merge the components across the band boundary
+        if (prev)
+        {
+            size_t i = prev->last_start, j = 0;
+            while (i < prev->num_runs && j < band->first_end &&
+                   j < band->num_runs)
+            {
+                struct _ORCA_SPOT_RUN *ra = &(prev->runs[i]);
+                struct _ORCA_SPOT_RUN *rb = &(band->runs[j]);
+                if (ra->y == band->y0 - 1 && rb->y == band->y0 &&
+                    ra->xs <= rb->xe + 1 && rb->xs <= ra->xe + 1)
+                {
+                    int32 ca = orcacam_spot_find_root(
+                        sf->parent, (int32)(prev_offset + prev->label[i]));
+                    int32 cb = orcacam_spot_find_root(
+                        sf->parent, (int32)(offset + band->label[j]));
+                    if (ca < cb)
+                    {
+                        sf->parent[cb] = ca;
+                    }
+                    else if (cb < ca)
+                    {
+                        sf->parent[ca] = cb;
+                    }
+                }
+                if (ra->xe < rb->xe)
+                {
+                    i++;
+                }
+                else
+                {
+                    j++;
+                }
+            }
+        }
+        prev        = band;
+        prev_offset = offset;
+        offset += band->num_comps;
+    }
+    // accumulate the merged components into their roots
+    for (size_t c = 0; c < total; c++)
+    {
+        int32 root = orcacam_spot_find_root(sf->parent, (int32)c);
+        if (root != (int32)c)
+        {
+            orcacam_spot_merge(&(sf->comps[root]), &(sf->comps[c]));
+        }
+    }
+    for (size_t c = 0; c < total; c++)
+    {
+        struct _ORCA_SPOT_COMP *cp = &(sf->comps[c]);
+        if (sf->parent[c] != (int32)c || cp->n < (uint32_t)sf->config.min_pixels)
+        {
+            continue;
+        }
+        if (sf->out.num_spots >= sf->config.max_spots)
+        {
+            sf->out.truncated = 1;
+            break;
+        }
+        ORCA_SPOT *spot = &(sf->spots[sf->out.num_spots++]);
+        if (cp->sw)
+        {
+            spot->x = (double)cp->swx / cp->sw;
+            spot->y = (double)cp->swy / cp->sw;
+        }
+        else // flat spot at the background level
+        {
+            spot->x = (double)cp->sx / cp->n;
+            spot->y = (double)cp->sy / cp->n;
+        }
+        spot->intensity = (double)cp->sw;
+        spot->npix      = cp->n;
+        spot->peak      = cp->peak;
+        spot->rsvd      = 0;
+        spot->xmin      = cp->xmin;
+        spot->ymin      = cp->ymin;
+        spot->xmax      = cp->xmax;
+        spot->ymax      = cp->ymax;
+    }
+    *out = sf->out;
+    return DCAMERR_SUCCESS;
+}
+
+void orca_spot_stage(ORCA_FRAME *frame, void *finder, size_t sz_finder)
+{
+    (void)sz_finder;
+    ORCA_SPOTFINDER sf = (ORCA_SPOTFINDER)finder;
+    ORCA_SPOT_LIST out;
+    if (!sf)
+    {
+        return;
+    }
+    if (orcaerr_failed(orca_spot_find(sf, frame, &out)))
+    {
+        return;
+    }
+    frame->meta[ORCA_META_SPOTS] = &(sf->out);
+}
+
+void orca_spot_destroy(ORCA_SPOTFINDER *finder)
+{
+    assert(finder);
+    struct _ORCA_SPOTFINDER *sf = *finder;
+    if (!sf)
+    {
+        return;
+    }
+    orcacam_par_destroy(&(sf->par));
+    if (sf->bands)
+    {
+        for (int32 b = 0; b < sf->num_bands; b++)
+        {
+            free(sf->bands[b].runs);
+            free(sf->bands[b].comps);
+            free(sf->bands[b].label);
+        }
+        free(sf->bands);
+    }
+    free(sf->comps);
+    free(sf->parent);
+    free(sf->spots);
+    free(sf);
+    *finder = NULL;
+}
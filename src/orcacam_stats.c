@@ -0,0 +1,101 @@
+#include "orcacam_hist.h"
+#include <stdint.h>
+
+void orcacam_stats_snapshot(struct _ORCA_STATS_REC *stats, ORCA_STATS *out)
+{
+    assert(stats);
+    assert(out);
+    out->frames   = atomic_load_explicit(&(stats->frames),
+                                         memory_order_relaxed);
+    out->timeouts = atomic_load_explicit(&(stats->timeouts),
+                                         memory_order_relaxed);
+    out->aborts   = atomic_load_explicit(&(stats->aborts),
+                                         memory_order_relaxed);
+    out->errors   = atomic_load_explicit(&(stats->errors),
+                                         memory_order_relaxed);
+    out->dropped  = atomic_load_explicit(&(stats->dropped),
+                                         memory_order_relaxed);
+    out->pending  = atomic_load_explicit(&(stats->pending),
+                                         memory_order_relaxed);
+    out->ring_frames =
+        atomic_load_explicit(&(stats->ring_frames), memory_order_relaxed);
+    for (int k = 0; k < ORCA_STAT_MAX; k++)
+    {
+        struct _ORCA_HIST *h = &(stats->hist[k]);
+        ORCA_HISTOGRAM *o    = &(out->hist[k]);
+        o->count             = 0;
+        for (int i = 0; i < ORCA_HIST_BUCKETS; i++)
+        {
+            o->buckets[i] =
+                atomic_load_explicit(&(h->buckets[i]), memory_order_relaxed);
+            o->count += o->buckets[i];
+        }
+        o->sum = atomic_load_explicit(&(h->sum), memory_order_relaxed);
+        o->min = atomic_load_explicit(&(h->min), memory_order_relaxed);
+        o->max = atomic_load_explicit(&(h->max), memory_order_relaxed);
+        if (!o->count)
+        {
+            o->min = 0;
+        }
+    }
+}
+
+void orcacam_stats_reset(struct _ORCA_STATS_REC *stats)
+{
+    assert(stats);
+    atomic_store_explicit(&(stats->frames), 0, memory_order_relaxed);
+    atomic_store_explicit(&(stats->timeouts), 0, memory_order_relaxed);
+    atomic_store_explicit(&(stats->aborts), 0, memory_order_relaxed);
+    atomic_store_explicit(&(stats->errors), 0, memory_order_relaxed);
+    atomic_store_explicit(&(stats->dropped), 0, memory_order_relaxed);
+    atomic_store_explicit(&(stats->pending), 0, memory_order_relaxed);
+    for (int k = 0; k < ORCA_STAT_MAX; k++)
+    {
+        struct _ORCA_HIST *h = &(stats->hist[k]);
+        for (int i = 0; i < ORCA_HIST_BUCKETS; i++)
+        {
+            atomic_store_explicit(&(h->buckets[i]), 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&(h->sum), 0, memory_order_relaxed);
+        atomic_store_explicit(&(h->min), UINT64_MAX, memory_order_relaxed);
+        atomic_store_explicit(&(h->max), 0, memory_order_relaxed);
+    }
+}
+
+uint64_t orca_hist_percentile(const ORCA_HISTOGRAM *hist, double percentile)
+{
+    assert(hist);
+    if (!hist->count)
+    {
+        return 0;
+    }
+    if (percentile < 0)
+    {
+        percentile = 0;
+    }
+    // rank of the value, starting at 1
+    uint64_t rank = (uint64_t)(percentile / 100.0 * hist->count + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < ORCA_HIST_BUCKETS; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t v = i + 1 < ORCA_HIST_BUCKETS
+                             ? orcacam_hist_lowest(i + 1) - 1
+                             : hist->max;
+            return v < hist->max ? v : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+double orca_hist_mean(const ORCA_HISTOGRAM *hist)
+{
+    assert(hist);
+    return hist->count ? (double)hist->sum / hist->count : 0;
+}
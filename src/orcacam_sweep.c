@@ -0,0 +1,279 @@
+#include "orcacam_sweep.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define ORCACAM_SWEEP_TIMEOUT_MS 1000 // wait for a frame beyond its period
+
+struct _ORCA_SWEEP
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t count;      // frames received
+    uint64_t skip_until; // frames received before this count are discarded
+    int32 collected;     // frames delivered in the current step
+    int32 frames_per_step;
+    ORCA_SWEEP_INFO info;
+    OrcaFrameCallback cb;
+    void *user_data;
+    size_t sz_user_data;
+};
+
+static void orcacam_sweep_frame(ORCA_FRAME *frame, void *user_data,
+                                size_t sz_user_data)
+{
+    struct _ORCA_SWEEP *sw = (struct _ORCA_SWEEP *)user_data;
+    pthread_mutex_lock(&(sw->lock));
+    uint64_t n = sw->count++;
+    if (n < sw->skip_until || sw->collected >= sw->frames_per_step)
+    {
+        // settling, or waiting for the next step
+        pthread_cond_signal(&(sw->cond));
+        pthread_mutex_unlock(&(sw->lock));
+        return;
+    }
+    ORCA_SWEEP_INFO info = sw->info;
+    info.frame           = sw->collected;
+    pthread_mutex_unlock(&(sw->lock));
+    frame->meta[ORCA_META_SWEEP] = &info;
+    sw->cb(frame, sw->user_data, sw->sz_user_data);
+    frame->meta[ORCA_META_SWEEP] = NULL;
+    pthread_mutex_lock(&(sw->lock));
+    sw->collected++;
+    pthread_cond_signal(&(sw->cond));
+    pthread_mutex_unlock(&(sw->lock));
+}
+
+// Check if a property can be written while the camera is busy
+static bool orcacam_sweep_busy_writable(ORCACAM cam, DCAMIDPROP prop)
+{
+    DCAMPROP_ATTR attr;
+    if (orcaerr_failed(orca_get_attr(cam, prop, &attr)))
+    {
+        return false;
+    }
+    int32 mask = DCAMPROP_ATTR_WRITABLE | DCAMPROP_ATTR_ACCESSBUSY;
+    return (attr.attribute & mask) == mask;
+}
+
+// Check if a step changes a value. The camera rounds the exposure and the
+// frame rate, so a value requested by the previous step is unchanged as long
+// as the camera holds the value it applied for it.
+static bool orcacam_sweep_changed(double current, double value,
+                                  double requested, double applied)
+{
+    return current != value && (value != requested || current != applied);
+}
+
+// Start delivering the frames of a step, after skipping the given number of
+// frames.
+static void orcacam_sweep_next(ORCACAM cam, struct _ORCA_SWEEP *sw,
+                               int32 step, int32 restarted, uint64_t skip)
+{
+    double exposure = 0, framerate = 0;
+    orca_get_exposure(cam, &exposure);
+    orca_get_acq_framerate(cam, &framerate);
+    pthread_mutex_lock(&(sw->lock));
+    sw->info.step      = step;
+    sw->info.frame     = 0;
+    sw->info.exposure  = exposure;
+    sw->info.framerate = framerate;
+    sw->info.restarted = restarted;
+    sw->skip_until     = sw->count + skip;
+    sw->collected      = 0;
+    pthread_mutex_unlock(&(sw->lock));
+}
+
+// Wait for the frames of the current step. Times out if no frame at all
+// arrives within the frame period and ORCACAM_SWEEP_TIMEOUT_MS.
+static DCAMERR orcacam_sweep_wait(struct _ORCA_SWEEP *sw)
+{
+    DCAMERR err   = DCAMERR_SUCCESS;
+    double period = sw->info.exposure;
+    if (sw->info.framerate > 0 && 1 / sw->info.framerate > period)
+    {
+        period = 1 / sw->info.framerate;
+    }
+    int64_t timeout_ns = (int64_t)(period * 2e9) +
+                         (int64_t)ORCACAM_SWEEP_TIMEOUT_MS * 1000000;
+    pthread_mutex_lock(&(sw->lock));
+    while (sw->collected < sw->frames_per_step)
+    {
+        uint64_t count = sw->count;
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        int64_t ns = ts.tv_nsec + timeout_ns;
+        ts.tv_sec += ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+        int rc     = 0;
+        while (sw->count == count && rc != ETIMEDOUT)
+        {
+            rc = pthread_cond_timedwait(&(sw->cond), &(sw->lock), &ts);
+        }
+        if (sw->count == count)
+        {
+            err = DCAMERR_TIMEOUT;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&(sw->lock));
+    return err;
+}
+
+DCAMERR orca_sweep_run(ORCACAM cam, const ORCA_SWEEP_STEP *_Nonnull steps,
+                       int32 num_steps, int32 frames_per_step,
+                       int32 settle_frames, OrcaFrameCallback cb,
+                       void *user_data, size_t sz_user_data)
+{
+    assert(cam);
+    assert(steps);
+    assert(cb);
+    if (num_steps <= 0 || frames_per_step <= 0 || settle_frames < 0)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    DCAMERR err = DCAMERR_SUCCESS;
+    struct _ORCA_SWEEP sw;
+    memset(&sw, 0, sizeof(struct _ORCA_SWEEP));
+    sw.frames_per_step = frames_per_step;
+    sw.collected       = frames_per_step; // nothing is delivered until step 0
+    sw.cb              = cb;
+    sw.user_data       = user_data;
+    sw.sz_user_data    = sz_user_data;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&(sw.cond), &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&(sw.lock), NULL);
+    // the attributes do not change with the exposure or the frame rate
+    bool busy_exposure =
+        orcacam_sweep_busy_writable(cam, DCAM_IDPROP_EXPOSURETIME);
+    bool busy_framerate =
+        orcacam_sweep_busy_writable(cam, DCAM_IDPROP_INTERNALFRAMERATE);
+    bool capturing = false;
+    // values requested by the previous step, sw.info holds the applied ones
+    double exposure = 0, framerate = 0;
+    for (int32 i = 0; i < num_steps && !orcaerr_failed(err); i++)
+    {
+        const ORCA_SWEEP_STEP *step = &(steps[i]);
+        bool restart                = !capturing;
+        bool changed                = false;
+        bool geometry               = false;
+        double v;
+        if (step->exposure > 0 &&
+            (orcaerr_failed(orca_get_exposure(cam, &v)) ||
+             orcacam_sweep_changed(v, step->exposure, exposure,
+                                   sw.info.exposure)))
+        {
+            changed = true;
+            restart |= !busy_exposure;
+        }
+        if (step->framerate > 0 &&
+            (orcaerr_failed(orca_get_acq_framerate(cam, &v)) ||
+             orcacam_sweep_changed(v, step->framerate, framerate,
+                                   sw.info.framerate)))
+        {
+            changed = true;
+            restart |= !busy_framerate;
+        }
+        if (step->roi[2] > 0)
+        {
+            int32 x, y, w, h;
+            err = orca_get_roi(cam, &x, &y, &w, &h);
+            if (orcaerr_failed(err))
+            {
+                break;
+            }
+            // geometry changes need the frame buffer to be rebuilt
+            if (x != step->roi[0] || y != step->roi[1] || w != step->roi[2] ||
+                h != step->roi[3])
+            {
+                geometry = true;
+                restart  = true;
+            }
+        }
+        if (restart)
+        {
+            if (capturing)
+            {
+                err       = orca_stop_capture(cam);
+                capturing = false;
+                if (orcaerr_failed(err))
+                {
+                    break;
+                }
+            }
+            ORCA_CONFIG cfg;
+            err = orca_config_begin(cam, &cfg);
+            if (orcaerr_failed(err))
+            {
+                break;
+            }
+            if (step->exposure > 0)
+            {
+                orca_config_exposure(cfg, step->exposure);
+            }
+            if (step->framerate > 0)
+            {
+                orca_config_set(cfg, DCAM_IDPROP_INTERNALFRAMERATE,
+                                step->framerate);
+            }
+            if (geometry)
+            {
+                orca_config_roi(cfg, step->roi[0], step->roi[1], step->roi[2],
+                                step->roi[3]);
+            }
+            err = orca_config_commit(&cfg);
+            if (orcaerr_failed(err))
+            {
+                break;
+            }
+            // frames of the new capture are taken with the new settings
+            orcacam_sweep_next(cam, &sw, i, 1, 0);
+            err = orca_start_capture(cam, orcacam_sweep_frame, &sw,
+                                     sizeof(struct _ORCA_SWEEP));
+            if (orcaerr_failed(err))
+            {
+                break;
+            }
+            capturing = true;
+        }
+        else
+        {
+            if (step->exposure > 0)
+            {
+                v   = step->exposure;
+                err = orca_setget_value(cam, DCAM_IDPROP_EXPOSURETIME, &v, 0);
+            }
+            if (!orcaerr_failed(err) && step->framerate > 0)
+            {
+                v   = step->framerate;
+                err = orca_setget_value(cam, DCAM_IDPROP_INTERNALFRAMERATE, &v,
+                                        0);
+            }
+            if (orcaerr_failed(err))
+            {
+                break;
+            }
+            // frames exposed before the change may still be in flight
+            orcacam_sweep_next(cam, &sw, i, 0, changed ? settle_frames : 0);
+        }
+        exposure  = step->exposure > 0 ? step->exposure : exposure;
+        framerate = step->framerate > 0 ? step->framerate : framerate;
+        err       = orcacam_sweep_wait(&sw);
+    }
+    if (capturing)
+    {
+        DCAMERR ret = orca_stop_capture(cam);
+        if (!orcaerr_failed(err))
+        {
+            err = ret;
+        }
+    }
+    pthread_mutex_destroy(&(sw.lock));
+    pthread_cond_destroy(&(sw.cond));
+    return err;
+}
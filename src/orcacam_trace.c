@@ -0,0 +1,326 @@
+#define _GNU_SOURCE
+#include "orcacam_tracepoint.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define ORCACAM_TRACE_MAGIC "ORCATRC1"
+#define ORCACAM_TRACE_VERSION 1
+#define ORCACAM_TRACE_CHUNK 4096 // records converted at a time
+
+_Static_assert((ORCA_TRACE_RING_RECORDS & (ORCA_TRACE_RING_RECORDS - 1)) == 0,
+               "ORCA_TRACE_RING_RECORDS must be a power of two");
+
+__thread struct _ORCA_TRACE_RING *orcacam_trace_ring = NULL;
+
+static _Atomic(struct _ORCA_TRACE_RING *) orcacam_trace_rings = NULL;
+static pthread_once_t orcacam_trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t orcacam_trace_key;
+// time stamp counter and CLOCK_MONOTONIC at the first record
+static uint64_t orcacam_trace_tsc0;
+static uint64_t orcacam_trace_ns0;
+
+struct _ORCA_TRACE_HEADER
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_bytes;
+    uint64_t count;
+    uint64_t tsc_base;
+    double ticks_per_us;
+    uint32_t pid;
+    uint32_t rsvd;
+};
+
+static const struct
+{
+    const char *name;
+    const char *begin_arg; // argument of the begin and instant records
+    const char *end_arg;
+} orcacam_trace_events[ORCA_TRACE_EVENT_MAX] = {
+    {"wait", NULL, "err"},
+    {"transferinfo", NULL, "err"},
+    {"callback", "frame_count", NULL},
+    {"stage", "stage", NULL},
+    {"prop_set", "prop", "err"},
+    {"buf_attach", "frames", "err"},
+    {"buf_release", NULL, "err"},
+    {"cap_start", "mode", "err"},
+    {"cap_stop", NULL, "err"},
+    {"error", "err", NULL},
+};
+
+static uint64_t orcacam_trace_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Hand the ring of an exiting thread over to the next new thread
+static void orcacam_trace_release(void *inp)
+{
+    struct _ORCA_TRACE_RING *ring = (struct _ORCA_TRACE_RING *)inp;
+    atomic_store_explicit(&(ring->owned), false, memory_order_release);
+}
+
+static void orcacam_trace_init(void)
+{
+    pthread_key_create(&orcacam_trace_key, orcacam_trace_release);
+    orcacam_trace_tsc0 = orcacam_trace_tsc();
+    orcacam_trace_ns0  = orcacam_trace_now_ns();
+}
+
+struct _ORCA_TRACE_RING *orcacam_trace_attach(void)
+{
+    pthread_once(&orcacam_trace_once, orcacam_trace_init);
+    struct _ORCA_TRACE_RING *ring =
+        atomic_load_explicit(&orcacam_trace_rings, memory_order_acquire);
+    for (; ring; ring = ring->next)
+    {
+        bool owned = false;
+        if (atomic_compare_exchange_strong(&(ring->owned), &owned, true))
+        {
+            break;
+        }
+    }
+    if (!ring)
+    {
+        ring = (struct _ORCA_TRACE_RING *)calloc(1, sizeof(*ring));
+        if (!ring)
+        {
+            return NULL;
+        }
+        atomic_init(&(ring->owned), true);
+        ring->next =
+            atomic_load_explicit(&orcacam_trace_rings, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak(&orcacam_trace_rings,
+                                             &(ring->next), ring))
+        {
+        }
+    }
+    ring->tid = (uint32_t)syscall(SYS_gettid);
+    pthread_setspecific(orcacam_trace_key, ring);
+    orcacam_trace_ring = ring;
+    return ring;
+}
+
+bool orca_trace_enabled(void)
+{
+#ifdef ORCACAM_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void orca_trace_clear(void)
+{
+    struct _ORCA_TRACE_RING *ring =
+        atomic_load_explicit(&orcacam_trace_rings, memory_order_acquire);
+    for (; ring; ring = ring->next)
+    {
+        atomic_store_explicit(
+            &(ring->start),
+            atomic_load_explicit(&(ring->head), memory_order_acquire),
+            memory_order_relaxed);
+    }
+}
+
+// Copy the valid records of a ring, returns the number of records copied
+static size_t orcacam_trace_copy(struct _ORCA_TRACE_RING *ring,
+                                 ORCA_TRACE_RECORD *out)
+{
+    const uint64_t cap = ORCA_TRACE_RING_RECORDS;
+    uint64_t head  = atomic_load_explicit(&(ring->head), memory_order_acquire);
+    uint64_t start = atomic_load_explicit(&(ring->start), memory_order_relaxed);
+    uint64_t first = head > cap ? head - cap : 0;
+    first          = first > start ? first : start;
+    for (uint64_t i = first; i < head; i++)
+    {
+        out[i - first] = ring->recs[i & (cap - 1)];
+    }
+    // the writer may have overwritten the oldest records meanwhile; the
+    // record it is writing now replaces the one at index head - cap
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t now  = atomic_load_explicit(&(ring->head), memory_order_relaxed);
+    uint64_t keep = now + 1 > cap ? now + 1 - cap : 0;
+    if (keep <= first)
+    {
+        return head - first;
+    }
+    if (keep >= head)
+    {
+        return 0;
+    }
+    memmove(out, out + (keep - first),
+            (head - keep) * sizeof(ORCA_TRACE_RECORD));
+    return head - keep;
+}
+
+DCAMERR orca_trace_save(const char *path)
+{
+    assert(path);
+    DCAMERR err = DCAMERR_SUCCESS;
+    FILE *fp    = fopen(path, "wb");
+    if (!fp)
+    {
+        return DCAMERR_INVALIDPARAM;
+    }
+    ORCA_TRACE_RECORD *recs = (ORCA_TRACE_RECORD *)malloc(
+        ORCA_TRACE_RING_RECORDS * sizeof(ORCA_TRACE_RECORD));
+    if (!recs)
+    {
+        fclose(fp);
+        return DCAMERR_LESSSYSTEMMEMORY;
+    }
+    pthread_once(&orcacam_trace_once, orcacam_trace_init);
+    struct _ORCA_TRACE_HEADER hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, ORCACAM_TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.version      = ORCACAM_TRACE_VERSION;
+    hdr.record_bytes = sizeof(ORCA_TRACE_RECORD);
+    hdr.tsc_base     = orcacam_trace_tsc0;
+    hdr.pid          = (uint32_t)getpid();
+    // header first, completed once the records are counted
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+    {
+        err = DCAMERR_NORESOURCE;
+        goto ret;
+    }
+    struct _ORCA_TRACE_RING *ring =
+        atomic_load_explicit(&orcacam_trace_rings, memory_order_acquire);
+    for (; ring; ring = ring->next)
+    {
+        size_t n = orcacam_trace_copy(ring, recs);
+        if (fwrite(recs, sizeof(ORCA_TRACE_RECORD), n, fp) != n)
+        {
+            err = DCAMERR_NORESOURCE;
+            goto ret;
+        }
+        hdr.count += n;
+    }
+    // measure the counter rate over at least 10 ms
+    uint64_t ns = orcacam_trace_now_ns();
+    if (ns - orcacam_trace_ns0 < 10000000)
+    {
+        usleep((10000000 - (ns - orcacam_trace_ns0)) / 1000 + 1);
+    }
+    uint64_t tsc     = orcacam_trace_tsc();
+    ns               = orcacam_trace_now_ns();
+    hdr.ticks_per_us = (double)(tsc - orcacam_trace_tsc0) * 1e3 /
+                       (ns - orcacam_trace_ns0);
+    if (fseek(fp, 0, SEEK_SET) || fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+    {
+        err = DCAMERR_NORESOURCE;
+    }
+ret:
+    free(recs);
+    if (fclose(fp))
+    {
+        err = DCAMERR_NORESOURCE;
+    }
+    return err;
+}
+
+static void orcacam_trace_arg(FILE *out, const char *name, uint64_t arg)
+{
+    if (!name)
+    {
+        return;
+    }
+    // DCAMERR and property IDs read best in hexadecimal
+    if (!strcmp(name, "err") || !strcmp(name, "prop"))
+    {
+        fprintf(out, ",\"args\":{\"%s\":\"0x%08x\"}", name, (uint32_t)arg);
+    }
+    else
+    {
+        fprintf(out, ",\"args\":{\"%s\":%lld}", name, (long long)arg);
+    }
+}
+
+DCAMERR orca_trace_export(const char *path, const char *json_path)
+{
+    assert(path);
+    assert(json_path);
+    static const char phases[] = {'B', 'E', 'i'};
+    DCAMERR err = DCAMERR_INVALIDPARAM;
+    FILE *in    = fopen(path, "rb");
+    if (!in)
+    {
+        return err;
+    }
+    struct _ORCA_TRACE_HEADER hdr;
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+        memcmp(hdr.magic, ORCACAM_TRACE_MAGIC, sizeof(hdr.magic)) ||
+        hdr.version != ORCACAM_TRACE_VERSION ||
+        hdr.record_bytes != sizeof(ORCA_TRACE_RECORD) || hdr.ticks_per_us <= 0)
+    {
+        fclose(in);
+        return err;
+    }
+    FILE *out = fopen(json_path, "w");
+    if (!out)
+    {
+        fclose(in);
+        return err;
+    }
+    ORCA_TRACE_RECORD *recs = (ORCA_TRACE_RECORD *)malloc(
+        ORCACAM_TRACE_CHUNK * sizeof(ORCA_TRACE_RECORD));
+    if (!recs)
+    {
+        err = DCAMERR_LESSSYSTEMMEMORY;
+        goto ret;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (uint64_t left = hdr.count; left;)
+    {
+        size_t n = left < ORCACAM_TRACE_CHUNK ? left : ORCACAM_TRACE_CHUNK;
+        if (fread(recs, sizeof(ORCA_TRACE_RECORD), n, in) != n)
+        {
+            goto ret; // truncated
+        }
+        left -= n;
+        for (size_t i = 0; i < n; i++)
+        {
+            const ORCA_TRACE_RECORD *r = &(recs[i]);
+            if (r->event >= ORCA_TRACE_EVENT_MAX ||
+                r->phase > ORCA_TRACE_INSTANT)
+            {
+                continue;
+            }
+            double ts = ((double)r->tsc - (double)hdr.tsc_base) /
+                        hdr.ticks_per_us;
+            fprintf(out,
+                    "%s{\"name\":\"%s\",\"cat\":\"orcacam\",\"ph\":\"%c\","
+                    "\"ts\":%.3f,\"pid\":%u,\"tid\":%u",
+                    first ? "" : ",\n", orcacam_trace_events[r->event].name,
+                    phases[r->phase], ts, hdr.pid, r->tid);
+            if (r->phase == ORCA_TRACE_INSTANT)
+            {
+                fprintf(out, ",\"s\":\"t\"");
+            }
+            orcacam_trace_arg(out,
+                              r->phase == ORCA_TRACE_END
+                                  ? orcacam_trace_events[r->event].end_arg
+                                  : orcacam_trace_events[r->event].begin_arg,
+                              r->arg);
+            fprintf(out, "}");
+            first = false;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    err = DCAMERR_SUCCESS;
+ret:
+    free(recs);
+    fclose(in);
+    if (fclose(out))
+    {
+        err = DCAMERR_NORESOURCE;
+    }
+    return err;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file orcacam_tracepoint.h
+ * @author Sunip K. Mukherjee (sunipkmukherjee@gmail.com)
+ * @brief Internal trace points, compiled in with -DORCACAM_TRACE.
+ * @version 0.0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#ifndef _ORCACAM_TRACEPOINT_H_
+#define _ORCACAM_TRACEPOINT_H_
+
+#include "orcacam_trace.h"
+#include <stdatomic.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Trace ring of a thread, written by that thread only. Rings of
+ * exited threads are reused.
+ *
+ */
+struct _ORCA_TRACE_RING
+{
+    struct _ORCA_TRACE_RING *next;
+    atomic_bool owned;
+    uint32_t tid;
+    atomic_uint_fast64_t head;  // records written
+    atomic_uint_fast64_t start; // first record not cleared
+    ORCA_TRACE_RECORD recs[ORCA_TRACE_RING_RECORDS];
+};
+
+extern __thread struct _ORCA_TRACE_RING *orcacam_trace_ring;
+
+/**
+ * @brief Get a trace ring for the calling thread.
+ *
+ * @return struct _ORCA_TRACE_RING* Ring, NULL if out of memory
+ */
+struct _ORCA_TRACE_RING *orcacam_trace_attach(void);
+
+/**
+ * @brief Read the time stamp counter.
+ *
+ * @return uint64_t Ticks
+ */
+static inline uint64_t orcacam_trace_tsc(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Record an event in the ring of the calling thread.
+ *
+ * @param event ORCA_TRACE_EVENT
+ * @param phase ORCA_TRACE_PHASE
+ * @param arg Event argument
+ */
+static inline void orcacam_trace_record(int event, int phase, uint64_t arg)
+{
+    struct _ORCA_TRACE_RING *ring = orcacam_trace_ring;
+    if (!ring && !(ring = orcacam_trace_attach()))
+    {
+        return;
+    }
+    uint64_t head =
+        atomic_load_explicit(&(ring->head), memory_order_relaxed);
+    ORCA_TRACE_RECORD *rec =
+        &(ring->recs[head & (ORCA_TRACE_RING_RECORDS - 1)]);
+    rec->tsc   = orcacam_trace_tsc();
+    rec->arg   = arg;
+    rec->event = (uint16_t)event;
+    rec->phase = (uint16_t)phase;
+    rec->tid   = ring->tid;
+    atomic_store_explicit(&(ring->head), head + 1, memory_order_release);
+}
+
+#ifdef ORCACAM_TRACE
+#define ORCA_TRACE_BEGIN(event, arg)                                           \
+    orcacam_trace_record(event, ORCA_TRACE_BEGIN, (uint64_t)(arg))
+#define ORCA_TRACE_END(event, arg)                                             \
+    orcacam_trace_record(event, ORCA_TRACE_END, (uint64_t)(arg))
+#define ORCA_TRACE_INSTANT(event, arg)                                         \
+    orcacam_trace_record(event, ORCA_TRACE_INSTANT, (uint64_t)(arg))
+#else
+#define ORCA_TRACE_BEGIN(event, arg) ((void)0)
+#define ORCA_TRACE_END(event, arg) ((void)0)
+#define ORCA_TRACE_INSTANT(event, arg) ((void)0)
+#endif
+
+#endif // _ORCACAM_TRACEPOINT_H_